@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Compares the vectorised fb inner loops (fills, blits and 1bpp stipple
+ * expansion) against the generic word-at-a-time versions. Needs no X
+ * server, just run it.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/sna/fb/fbsimd.h"
+
+#define STRIDE 4096 /* words, i.e. 4096x768 @ 32bpp */
+#define HEIGHT 768
+
+static const uint32_t rop_copy[4] = { 0, 0, ~0u, 0 };
+static const uint32_t rop_xor[4] = { 0, ~0u, ~0u, 0 };
+static const uint32_t rop_and[4] = { ~0u, 0, 0, 0 };
+
+static double elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return 1e3 * (end->tv_sec - start->tv_sec) + 1e-6 * (end->tv_nsec - start->tv_nsec);
+}
+
+static void fill_random(uint32_t *ptr, int len)
+{
+	while (len--)
+		*ptr++ = rand() << 16 ^ rand();
+}
+
+enum op { SOLID, SOLID_XOR, COPY, XOR, AND, AND_SHIFT, STIPPLE8, STIPPLE16, STIPPLE32, STIPPLE32_ROP };
+
+static const char *op_name[] = {
+	"fill GXcopy", "fill GXxor", "blt GXcopy", "blt GXxor", "blt GXand", "blt GXand (misaligned)",
+	"stipple 8bpp", "stipple 16bpp", "stipple 32bpp", "stipple 32bpp GXxor",
+};
+
+static void stipple(uint32_t *dst, const uint32_t *src, int width, int height,
+		    int bpp, uint32_t fgand, uint32_t bgand)
+{
+	int y, x;
+
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x += bpp) {
+			int n = width - x < bpp ? width - x : bpp;
+			fbStippleWords(dst + y * STRIDE + x, src[y * STRIDE + x / bpp],
+				       n, bpp, fgand, 0xc0ffee, bgand, 0xdecade);
+		}
+	}
+}
+
+static void run(enum op op, uint32_t *dst, const uint32_t *src, int width, int height)
+{
+	int y;
+
+	switch (op) {
+	case SOLID:
+		fbSolidWords(dst, STRIDE, width, height, 0, 0xc0ffee);
+		break;
+	case SOLID_XOR:
+		fbSolidWords(dst, STRIDE, width, height, ~0u, 0xc0ffee);
+		break;
+	case COPY:
+	case XOR:
+	case AND:
+		for (y = 0; y < height; y++)
+			fbMergeRopWords(src + y * STRIDE, dst + y * STRIDE, width,
+					op == COPY ? rop_copy : op == XOR ? rop_xor : rop_and);
+		break;
+	case AND_SHIFT:
+		for (y = 0; y < height; y++)
+			fbMergeRopWordsShift(0, src + y * STRIDE, dst + y * STRIDE, width,
+					     8, 24, rop_and);
+		break;
+	case STIPPLE8:
+		stipple(dst, src, width, height, 8, 0, 0);
+		break;
+	case STIPPLE16:
+		stipple(dst, src, width, height, 16, 0, 0);
+		break;
+	case STIPPLE32:
+		stipple(dst, src, width, height, 32, 0, 0);
+		break;
+	case STIPPLE32_ROP:
+		stipple(dst, src, width, height, 32, ~0u, ~0u);
+		break;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const struct {
+		unsigned flags;
+		const char *name;
+	} impl[] = {
+		{ 0, "generic" },
+		{ FB_SIMD_SSE2, "sse2" },
+		{ FB_SIMD_AVX2, "avx2" },
+	};
+	/* The widest, 12MiB, is past FB_SIMD_STREAM_BYTES so that solid
+	 * fills take the non-temporal path.
+	 */
+	static const int widths[] = { 16, 64, 1023, STRIDE };
+	uint32_t *src, *dst, *ref, *seed;
+	unsigned cpu = 0;
+	enum op op;
+	unsigned i, w;
+
+	(void)argc; (void)argv;
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		cpu |= FB_SIMD_SSE2;
+	if (__builtin_cpu_supports("avx2"))
+		cpu |= FB_SIMD_AVX2;
+#endif
+
+	src = malloc(STRIDE * HEIGHT * 4);
+	dst = malloc(STRIDE * HEIGHT * 4);
+	ref = malloc(STRIDE * HEIGHT * 4);
+	seed = malloc(STRIDE * HEIGHT * 4);
+	if (!src || !dst || !ref || !seed)
+		return 1;
+
+	fill_random(src, STRIDE * HEIGHT);
+	fill_random(seed, STRIDE * HEIGHT);
+
+	for (op = SOLID; op <= STIPPLE32_ROP; op++) {
+		for (w = 0; w < sizeof(widths)/sizeof(widths[0]); w++) {
+			int width = widths[w];
+			double base = 0;
+
+			fbSimdInit(0);
+			memcpy(ref, seed, STRIDE * HEIGHT * 4);
+			run(op, ref, src, width, HEIGHT);
+
+			for (i = 0; i < sizeof(impl)/sizeof(impl[0]); i++) {
+				struct timespec start, end;
+				int reps = 0;
+				double t;
+
+				if (impl[i].flags & ~cpu)
+					continue;
+				fbSimdInit(impl[i].flags);
+				if (strcmp(fbSimdName(), impl[i].name))
+					continue;
+
+				memcpy(dst, seed, STRIDE * HEIGHT * 4);
+				run(op, dst, src, width, HEIGHT);
+				if (memcmp(dst, ref, STRIDE * HEIGHT * 4)) {
+					fprintf(stderr, "%s, width=%d: %s does not match generic\n",
+						op_name[op], width, impl[i].name);
+					return 1;
+				}
+
+				clock_gettime(CLOCK_MONOTONIC, &start);
+				do {
+					run(op, dst, src, width, HEIGHT);
+					reps++;
+					clock_gettime(CLOCK_MONOTONIC, &end);
+				} while (elapsed(&start, &end) < 200);
+
+				t = elapsed(&start, &end) / reps;
+				if (base == 0)
+					base = t;
+				printf("%-24s width=%4d %-8s %8.1f MiB/s (%.2fx)\n",
+				       op_name[op], width, impl[i].name,
+				       width * HEIGHT * 4. / (1 << 20) / (t / 1e3),
+				       base / t);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Compares the tiled rotation kernels used for transformed CRTC
+ * fallbacks against compositing through a pixman transform, as the
+ * redisplay fallback did before. A single 4K frame is rotated each time,
+ * on one thread. Needs no X server, just run it.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pixman.h>
+
+#include "../src/sna/rotate.h"
+
+#define WIDTH 3840
+#define HEIGHT 2160
+
+static const struct {
+	const char *name;
+	int step[4];
+} orient[] = {
+	{ "rotate 90", { 0, 1, -1, 0 } },
+	{ "rotate 180", { -1, 0, 0, -1 } },
+	{ "rotate 270", { 0, -1, 1, 0 } },
+	{ "reflect x", { -1, 0, 0, 1 } },
+	{ "reflect y", { 1, 0, 0, -1 } },
+	{ "rotate 90, reflect x", { 0, 1, 1, 0 } },
+};
+
+static double elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return 1e3 * (end->tv_sec - start->tv_sec) + 1e-6 * (end->tv_nsec - start->tv_nsec);
+}
+
+static void fill_random(uint32_t *ptr, int len)
+{
+	while (len--)
+		*ptr++ = rand() << 16 ^ rand();
+}
+
+/* The dst->src transform taking dst (0, 0) to src (x0, y0) */
+static void transform(struct pixman_f_transform *t, const int *step, int x0, int y0)
+{
+	pixman_f_transform_init_identity(t);
+	t->m[0][0] = step[0];
+	t->m[1][0] = step[1];
+	t->m[0][1] = step[2];
+	t->m[1][1] = step[3];
+	t->m[0][2] = x0 + .5 - (step[0] + step[2]) * .5;
+	t->m[1][2] = y0 + .5 - (step[1] + step[3]) * .5;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct {
+		unsigned flags;
+		const char *name;
+	} impl[] = {
+		{ 0, "generic" },
+		{ ROTATE_SSE2, "sse2" },
+	};
+	static const int bpps[] = { 32, 16 };
+	uint32_t *src, *dst, *ref;
+	unsigned cpu = 0;
+	unsigned o, b, i;
+
+	(void)argc; (void)argv;
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		cpu |= ROTATE_SSE2;
+#endif
+
+	src = malloc(WIDTH * HEIGHT * 4);
+	dst = malloc(WIDTH * HEIGHT * 4);
+	ref = malloc(WIDTH * HEIGHT * 4);
+	if (!src || !dst || !ref)
+		return 1;
+
+	fill_random(src, WIDTH * HEIGHT);
+
+	for (b = 0; b < sizeof(bpps)/sizeof(bpps[0]); b++) {
+		int bpp = bpps[b];
+		pixman_format_code_t format = bpp == 32 ? PIXMAN_x8r8g8b8 : PIXMAN_r5g6b5;
+
+		for (o = 0; o < sizeof(orient)/sizeof(orient[0]); o++) {
+			const int *step = orient[o].step;
+			int w = step[0] ? WIDTH : HEIGHT;
+			int h = step[0] ? HEIGHT : WIDTH;
+			int src_stride = WIDTH * bpp / 8;
+			int dst_stride = w * bpp / 8;
+			int x0 = step[0] < 0 || step[2] < 0 ? WIDTH - 1 : 0;
+			int y0 = step[1] < 0 || step[3] < 0 ? HEIGHT - 1 : 0;
+			struct pixman_f_transform ft;
+			struct pixman_transform t;
+			pixman_image_t *s, *d;
+			struct timespec start, end;
+			double base;
+			int reps;
+
+			transform(&ft, step, x0, y0);
+			pixman_transform_from_pixman_f_transform(&t, &ft);
+
+			s = pixman_image_create_bits(format, WIDTH, HEIGHT, src, src_stride);
+			d = pixman_image_create_bits(format, w, h, ref, dst_stride);
+			pixman_image_set_transform(s, &t);
+			pixman_image_set_filter(s, PIXMAN_FILTER_NEAREST, NULL, 0);
+
+			reps = 0;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			do {
+				pixman_image_composite(PIXMAN_OP_SRC, s, NULL, d,
+						       0, 0, 0, 0, 0, 0, w, h);
+				reps++;
+				clock_gettime(CLOCK_MONOTONIC, &end);
+			} while (elapsed(&start, &end) < 500);
+			base = elapsed(&start, &end) / reps;
+			printf("%2dbpp %-22s %-8s %8.2f ms\n",
+			       bpp, orient[o].name, "pixman", base);
+
+			pixman_image_unref(d);
+			pixman_image_unref(s);
+
+			for (i = 0; i < sizeof(impl)/sizeof(impl[0]); i++) {
+				int16_t sx, sy;
+				int x, y, s4[4];
+				double tm;
+
+				if (impl[i].flags & ~cpu)
+					continue;
+
+				rotate_blt_init(impl[i].flags);
+				if (!rotate_blt_transform(ft.m, 0, 0, &x, &y, s4)) {
+					fprintf(stderr, "%s: transform not recognised\n",
+						orient[o].name);
+					return 1;
+				}
+				sx = x;
+				sy = y;
+
+				memset(dst, 0, WIDTH * HEIGHT * 4);
+				rotate_blt(src, dst, bpp, src_stride, dst_stride,
+					   sx, sy, 0, 0, w, h, s4);
+				if (memcmp(dst, ref, h * dst_stride)) {
+					fprintf(stderr, "%dbpp %s: %s does not match pixman\n",
+						bpp, orient[o].name, rotate_blt_name());
+					return 1;
+				}
+
+				reps = 0;
+				clock_gettime(CLOCK_MONOTONIC, &start);
+				do {
+					rotate_blt(src, dst, bpp, src_stride, dst_stride,
+						   sx, sy, 0, 0, w, h, s4);
+					reps++;
+					clock_gettime(CLOCK_MONOTONIC, &end);
+				} while (elapsed(&start, &end) < 500);
+				tm = elapsed(&start, &end) / reps;
+				printf("%2dbpp %-22s %-8s %8.2f ms (%.1fx)\n",
+				       bpp, orient[o].name, rotate_blt_name(),
+				       tm, base / tm);
+			}
+		}
+	}
+
+	return 0;
+}
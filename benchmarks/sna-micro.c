@@ -0,0 +1,670 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Microbenchmarks of the CPU paths inside SNA, built from the driver's own
+ * sources: the (de)tiling copies for each bit-6 swizzle, memcpy_blt(),
+ * memcpy_xor(), memmove_box() and affine_blt() from blt.c, adding,
+ * subtracting, reducing and querying sna_damage, the imprecise trapezoid
+ * scan converter from sna_trapezoids_tor.h, the gradient cache lookup of
+ * sna_render_get_gradient(), and the pixman glyph cache lookups of the
+ * glyph fallbacks. It needs the X server headers to build, but neither an
+ * X server nor Intel hardware to run.
+ *
+ * Results are printed as CSV, one line per case, with the time per call
+ * (the best of several runs) and, for the copies, the bandwidth, so that
+ * they can be compared from one commit to the next. An optional argument
+ * only runs the cases whose name contains it.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/sna/sna.h"
+#include "../src/sna/sna_trapezoids_tor.h"
+
+/* What little of the X server the kernels refer to */
+BoxRec RegionEmptyBox;
+RegDataRec RegionEmptyData;
+RegDataRec RegionBrokenData;
+
+void ErrorF(const char *f, ...)
+{
+	va_list ap;
+
+	va_start(ap, f);
+	vfprintf(stderr, f, ap);
+	va_end(ap);
+}
+
+void FatalError(const char *f, ...)
+{
+	va_list ap;
+
+	va_start(ap, f);
+	vfprintf(stderr, f, ap);
+	va_end(ap);
+	abort();
+}
+
+void xorg_backtrace(void)
+{
+}
+
+/* sna_gradient.c only reaches for kgem on a cache miss, which we never take */
+struct kgem_bo *kgem_create_linear(struct kgem *kgem, int size, unsigned flags)
+{
+	abort();
+}
+
+struct kgem_bo *kgem_create_proxy(struct kgem *kgem,
+				  struct kgem_bo *target,
+				  int offset, int length)
+{
+	abort();
+}
+
+bool kgem_bo_write(struct kgem *kgem, struct kgem_bo *bo,
+		   const void *data, int length)
+{
+	abort();
+}
+
+void _kgem_bo_destroy(struct kgem *kgem, struct kgem_bo *bo)
+{
+	abort();
+}
+
+#if HAS_DEBUG_FULL
+void LogF(const char *f, ...)
+{
+	va_list ap;
+
+	va_start(ap, f);
+	vfprintf(stderr, f, ap);
+	va_end(ap);
+}
+#endif
+
+#define WIDTH 1920
+#define HEIGHT 1080
+#define NBOX 100
+#define NTRAP 100
+#define NSTOP 4
+#define NGLYPH 256
+
+#define RUNS 5
+#define MIN_TIME 20e6 /* ns per run */
+
+static const char *filter;
+
+static struct kgem kgem;
+static struct sna sna;
+static uint8_t *src, *dst;
+static BoxRec boxes[NBOX];
+static xTrapezoid traps[NTRAP];
+static PictGradient gradients[GRADIENT_CACHE_SIZE];
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return 1e9 * ts.tv_sec + ts.tv_nsec;
+}
+
+static void fill_random(uint8_t *ptr, int len)
+{
+	while (len--)
+		*ptr++ = rand();
+}
+
+struct bench {
+	const char *name;
+	char variant[64];
+	int width, height, bpp;
+	int src_stride, dst_stride;
+	uint32_t and, or;
+	memcpy_box_func copy;
+	struct pixman_f_transform t;
+	int ntrap;
+#if HAS_PIXMAN_GLYPHS
+	pixman_glyph_cache_t *cache;
+#endif
+	void (*op)(struct bench *b);
+};
+
+/*
+ * Report the best time per call. Calls are repeated until each run takes
+ * long enough for the clock to be accurate.
+ */
+static void measure(struct bench *b, double bytes)
+{
+	double best = 0;
+	long count = 1, n;
+	int run;
+
+	if (filter && strstr(b->name, filter) == NULL)
+		return;
+
+	b->op(b); /* warm up */
+	do {
+		double start = now_ns();
+
+		for (n = 0; n < count; n++)
+			b->op(b);
+		best = now_ns() - start;
+		if (best >= MIN_TIME)
+			break;
+		count *= 2;
+	} while (1);
+
+	for (run = 1; run < RUNS; run++) {
+		double start = now_ns(), t;
+
+		for (n = 0; n < count; n++)
+			b->op(b);
+		t = now_ns() - start;
+		if (t < best)
+			best = t;
+	}
+
+	best /= count;
+	printf("%s,%s,%dx%d,%d,%.1f,", b->name, b->variant,
+	       b->width, b->height, b->bpp, best);
+	if (bytes)
+		printf("%.3f\n", bytes / best);
+	else
+		printf("\n");
+	fflush(stdout);
+}
+
+static void op_copy(struct bench *b)
+{
+	b->copy(src, dst, b->bpp, b->src_stride, b->dst_stride,
+		0, 0, 0, 0, b->width, b->height);
+}
+
+static void op_xor(struct bench *b)
+{
+	memcpy_xor(src, dst, b->bpp, b->src_stride, b->dst_stride,
+		   0, 0, 0, 0, b->width, b->height, b->and, b->or);
+}
+
+/* As a fallback CopyArea within a pixmap, scrolling up and left */
+static void op_memmove(struct bench *b)
+{
+	BoxRec box = { 0, 0, b->width - 8, b->height - 8 };
+
+	memmove_box(dst + 8 * b->dst_stride + 8 * b->bpp / 8, dst,
+		    b->bpp, b->dst_stride, &box, -8, -8);
+}
+
+static void op_affine(struct bench *b)
+{
+	affine_blt(src, dst, 32,
+		   0, 0, b->width, b->height, b->src_stride,
+		   0, 0, b->width, b->height, b->dst_stride,
+		   &b->t);
+}
+
+static void op_damage_add(struct bench *b)
+{
+	struct sna_damage *damage = NULL;
+	int n;
+
+	(void)b;
+	for (n = 0; n < NBOX; n++)
+		sna_damage_add_box(&damage, &boxes[n]);
+	sna_damage_reduce(&damage);
+	sna_damage_destroy(&damage);
+}
+
+static void op_damage_subtract(struct bench *b)
+{
+	BoxRec all = { 0, 0, b->width, b->height };
+	struct sna_damage *damage = NULL;
+	int n;
+
+	sna_damage_add_box(&damage, &all);
+	for (n = 0; n < NBOX; n++)
+		sna_damage_subtract_box(&damage, &boxes[n]);
+	sna_damage_reduce(&damage);
+	sna_damage_destroy(&damage);
+}
+
+static struct sna_damage *contains;
+
+static void op_damage_contains(struct bench *b)
+{
+	int n;
+
+	(void)b;
+	for (n = 0; n < NBOX; n++)
+		sna_damage_contains_box(&contains, &boxes[n]);
+}
+
+/* As the mask of a trapezoid fallback, wider than TOR_INPLACE_SIZE */
+static void op_tor_render(struct bench *b)
+{
+	BoxRec extents = { 0, 0, b->width, b->height };
+	struct tor tor;
+	int n;
+
+	if (!tor_init(&tor, &extents, 2 * b->ntrap))
+		return;
+
+	for (n = 0; n < b->ntrap; n++)
+		tor_add_trapezoid(&tor, &traps[n], 0, 0);
+
+	tor_render(NULL, &tor,
+		   (void *)dst, (void *)(intptr_t)b->dst_stride,
+		   tor_blt_mask, true);
+	tor_fini(&tor);
+}
+
+/* And narrower, rendering each row into a temporary before the upload buffer */
+static void op_tor_inplace(struct bench *b)
+{
+	BoxRec extents = { 0, 0, b->width, b->height };
+	uint8_t buf[TOR_INPLACE_SIZE];
+	PixmapRec scratch;
+	struct tor tor;
+	int n;
+
+	memset(&scratch, 0, sizeof(scratch));
+	scratch.drawable.width = b->width;
+	scratch.drawable.height = b->height;
+	scratch.drawable.depth = 8;
+	scratch.devKind = b->dst_stride;
+	scratch.devPrivate.ptr = dst;
+
+	if (!tor_init(&tor, &extents, 2 * b->ntrap))
+		return;
+
+	for (n = 0; n < b->ntrap; n++)
+		tor_add_trapezoid(&tor, &traps[n], 0, 0);
+
+	tor_inplace(&tor, &scratch, false, buf);
+	tor_fini(&tor);
+}
+
+static void op_gradient_lookup(struct bench *b)
+{
+	int n;
+
+	(void)b;
+	for (n = 0; n < GRADIENT_CACHE_SIZE; n++)
+		kgem_bo_destroy(&sna.kgem,
+				sna_render_get_gradient(&sna, &gradients[n]));
+}
+
+#if HAS_PIXMAN_GLYPHS
+static char glyphs[NGLYPH]; /* only their addresses, as GlyphPtr */
+
+static void op_glyph_lookup(struct bench *b)
+{
+	int n;
+
+	pixman_glyph_cache_freeze(b->cache);
+	for (n = 0; n < 80; n++) /* a line of text */
+		pixman_glyph_cache_lookup(b->cache, &glyphs[(n * 37) % NGLYPH], NULL);
+	pixman_glyph_cache_thaw(b->cache);
+}
+#endif
+
+static void bench_tiled(struct bench *b, int swizzle, const char *swizzle_name)
+{
+	static const int sizes[][2] = { { 64, 64 }, { 256, 256 }, { WIDTH, HEIGHT } };
+	static const int bpps[] = { 8, 32 };
+	unsigned s, i;
+
+	choose_memcpy_tiled_x(&kgem, swizzle, sna_cpu_detect());
+
+	for (s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+		for (i = 0; i < sizeof(bpps)/sizeof(bpps[0]); i++) {
+			int linear, tiled;
+			double bytes;
+
+			b->width = sizes[s][0];
+			b->height = sizes[s][1];
+			b->bpp = bpps[i];
+
+			linear = ALIGN(b->width * b->bpp / 8, 4);
+			tiled = ALIGN(b->width * b->bpp / 8, 512);
+			bytes = (double)b->width * b->height * b->bpp / 8;
+			b->op = op_copy;
+
+			if (kgem.memcpy_to_tiled_x) {
+				b->name = "to_tiled_x";
+				b->copy = kgem.memcpy_to_tiled_x;
+				b->src_stride = linear;
+				b->dst_stride = tiled;
+				snprintf(b->variant, sizeof(b->variant), "%s", swizzle_name);
+				measure(b, bytes);
+			}
+
+			if (kgem.memcpy_from_tiled_x) {
+				b->name = "from_tiled_x";
+				b->copy = kgem.memcpy_from_tiled_x;
+				b->src_stride = tiled;
+				b->dst_stride = linear;
+				snprintf(b->variant, sizeof(b->variant), "%s", swizzle_name);
+				measure(b, bytes);
+			}
+
+			if (kgem.memcpy_between_tiled_x) {
+				b->name = "between_tiled_x";
+				b->copy = kgem.memcpy_between_tiled_x;
+				b->src_stride = tiled;
+				b->dst_stride = tiled;
+				snprintf(b->variant, sizeof(b->variant), "%s", swizzle_name);
+				measure(b, bytes);
+			}
+		}
+	}
+
+	kgem.memcpy_to_tiled_x = NULL;
+	kgem.memcpy_from_tiled_x = NULL;
+	kgem.memcpy_between_tiled_x = NULL;
+}
+
+/* A disc, as cairo would tessellate it, one trapezoid per band */
+static int circle_traps(int size)
+{
+	double c = size / 2., r = size / 2. - 1;
+	int n;
+
+	for (n = 0; n < NTRAP; n++) {
+		double y0 = c - r + 2 * r * n / NTRAP;
+		double y1 = c - r + 2 * r * (n + 1) / NTRAP;
+		double w0 = sqrt(fmax(r * r - (y0 - c) * (y0 - c), 0));
+		double w1 = sqrt(fmax(r * r - (y1 - c) * (y1 - c), 0));
+
+		traps[n].top = pixman_double_to_fixed(y0);
+		traps[n].bottom = pixman_double_to_fixed(y1);
+		traps[n].left.p1.x = pixman_double_to_fixed(c - w0);
+		traps[n].left.p1.y = traps[n].top;
+		traps[n].left.p2.x = pixman_double_to_fixed(c - w1);
+		traps[n].left.p2.y = traps[n].bottom;
+		traps[n].right.p1.x = pixman_double_to_fixed(c + w0);
+		traps[n].right.p1.y = traps[n].top;
+		traps[n].right.p2.x = pixman_double_to_fixed(c + w1);
+		traps[n].right.p2.y = traps[n].bottom;
+	}
+
+	return NTRAP;
+}
+
+/* Overlapping slanted trapezoids, so that many edges are active on each row */
+static int random_traps(int size)
+{
+	int n;
+
+	srand(1);
+	for (n = 0; n < NTRAP; n++) {
+		double y0 = rand() % (size - size / 4);
+		double y1 = y0 + 1 + rand() % (size / 4);
+		double x = size / 8 + rand() % (size - size / 2) + .37;
+		double w = 1 + rand() % (size / 4);
+		double dx = rand() % (size / 8 + 1) - size / 16;
+
+		traps[n].top = pixman_double_to_fixed(y0);
+		traps[n].bottom = pixman_double_to_fixed(y1);
+		traps[n].left.p1.x = pixman_double_to_fixed(x);
+		traps[n].left.p1.y = traps[n].top;
+		traps[n].left.p2.x = pixman_double_to_fixed(x + dx);
+		traps[n].left.p2.y = traps[n].bottom;
+		traps[n].right.p1.x = pixman_double_to_fixed(x + w);
+		traps[n].right.p1.y = traps[n].top;
+		traps[n].right.p2.x = pixman_double_to_fixed(x + w + dx);
+		traps[n].right.p2.y = traps[n].bottom;
+	}
+
+	return NTRAP;
+}
+
+static void bench_tor(struct bench *b)
+{
+	static const struct {
+		const char *name;
+		int (*init)(int size);
+	} shapes[] = {
+		{ "circle", circle_traps },
+		{ "random", random_traps },
+	};
+	static const int sizes[] = { TOR_INPLACE_SIZE, 512 };
+	unsigned s, i;
+
+	b->bpp = 8;
+	for (s = 0; s < sizeof(shapes)/sizeof(shapes[0]); s++) {
+		for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+			b->width = b->height = sizes[i];
+			b->dst_stride = ALIGN(sizes[i], 4);
+			b->ntrap = shapes[s].init(sizes[i]);
+			snprintf(b->variant, sizeof(b->variant), "%d traps, %s",
+				 b->ntrap, shapes[s].name);
+
+			b->name = "tor_render";
+			b->op = op_tor_render;
+			measure(b, (double)b->width * b->height);
+
+			if (sizes[i] <= TOR_INPLACE_SIZE) {
+				b->name = "tor_inplace";
+				b->op = op_tor_inplace;
+				measure(b, (double)b->width * b->height);
+			}
+		}
+	}
+}
+
+/*
+ * Fill the cache as sna_render_get_gradient() would, with gradients that
+ * differ only in their last stop so that every comparison runs its length.
+ */
+static void bench_gradient(struct bench *b)
+{
+	static struct kgem_bo bo[GRADIENT_CACHE_SIZE];
+	static PictGradientStop stops[2][GRADIENT_CACHE_SIZE][NSTOP];
+	int n, i;
+
+	for (n = 0; n < GRADIENT_CACHE_SIZE; n++) {
+		for (i = 0; i < NSTOP; i++) {
+			PictGradientStop *stop = &stops[0][n][i];
+
+			stop->x = pixman_int_to_fixed(i) / (NSTOP - 1);
+			stop->color.red = 0x1000 * i;
+			stop->color.green = 0x2000 * i;
+			stop->color.blue = i == NSTOP - 1 ? 0x1000 * n : 0;
+			stop->color.alpha = 0xffff;
+		}
+		memcpy(stops[1][n], stops[0][n], sizeof(stops[0][n]));
+
+		gradients[n].nstops = NSTOP;
+		gradients[n].stops = stops[0][n];
+
+		bo[n].refcnt = 1;
+		sna.render.gradient_cache.cache[n].bo = &bo[n];
+		sna.render.gradient_cache.cache[n].nstops = NSTOP;
+		sna.render.gradient_cache.cache[n].stops = stops[1][n];
+	}
+	sna.render.gradient_cache.size = GRADIENT_CACHE_SIZE;
+
+	b->name = "gradient_cache_lookup";
+	b->op = op_gradient_lookup;
+	b->width = NSTOP;
+	b->height = 1;
+	b->bpp = 0;
+	snprintf(b->variant, sizeof(b->variant), "%d cached, %d stops",
+		 GRADIENT_CACHE_SIZE, NSTOP);
+	measure(b, 0);
+
+	sna.render.gradient_cache.size = 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct {
+		int swizzle;
+		const char *name;
+	} swizzles[] = {
+		{ I915_BIT_6_SWIZZLE_NONE, "none" },
+		{ I915_BIT_6_SWIZZLE_9, "9" },
+		{ I915_BIT_6_SWIZZLE_9_10, "9_10" },
+		{ I915_BIT_6_SWIZZLE_9_11, "9_11" },
+		{ I915_BIT_6_SWIZZLE_9_10_11, "9_10_11" },
+	};
+	struct bench b;
+	char features[1024];
+	unsigned cpu, i;
+	int size = 4 * ALIGN(WIDTH, 128) * ALIGN(HEIGHT, 8);
+
+	if (argc > 1)
+		filter = argv[1];
+
+	cpu = sna_cpu_detect();
+	rotate_blt_init(cpu & SSE2 ? ROTATE_SSE2 : 0);
+
+	src = malloc(size);
+	dst = malloc(size);
+	if (src == NULL || dst == NULL)
+		return 1;
+
+	srand(0);
+	fill_random(src, size);
+	memset(dst, 0, size);
+
+	for (i = 0; i < NBOX; i++) {
+		boxes[i].x1 = rand() % (WIDTH - 64);
+		boxes[i].y1 = rand() % (HEIGHT - 64);
+		boxes[i].x2 = boxes[i].x1 + 1 + rand() % 64;
+		boxes[i].y2 = boxes[i].y1 + 1 + rand() % 64;
+	}
+
+	printf("# cpu:%s\n", sna_cpu_features_to_string(cpu, features));
+	printf("benchmark,variant,size,bpp,ns_per_op,gb_per_s\n");
+
+	memset(&b, 0, sizeof(b));
+
+	kgem.gen = 060;
+	for (i = 0; i < sizeof(swizzles)/sizeof(swizzles[0]); i++)
+		bench_tiled(&b, swizzles[i].swizzle, swizzles[i].name);
+	kgem.gen = 020;
+	bench_tiled(&b, I915_BIT_6_SWIZZLE_NONE, "gen2");
+
+	b.width = WIDTH;
+	b.height = HEIGHT;
+	b.bpp = 32;
+	b.src_stride = b.dst_stride = 4 * WIDTH;
+
+	b.name = "memcpy_blt";
+	b.op = op_copy;
+	b.copy = memcpy_blt;
+	strcpy(b.variant, "linear");
+	measure(&b, 4. * WIDTH * HEIGHT);
+
+	b.name = "memcpy_xor";
+	b.op = op_xor;
+	b.and = 0x00ffffff;
+	b.or = 0xff000000;
+	strcpy(b.variant, "x8r8g8b8");
+	measure(&b, 4. * WIDTH * HEIGHT);
+
+	b.name = "memmove_box";
+	b.op = op_memmove;
+	strcpy(b.variant, "scroll");
+	measure(&b, 4. * (WIDTH - 8) * (HEIGHT - 8));
+
+	b.name = "affine_blt";
+	b.op = op_affine;
+	pixman_f_transform_init_identity(&b.t);
+	b.t.m[0][0] = 0; b.t.m[0][1] = -1; b.t.m[0][2] = HEIGHT;
+	b.t.m[1][0] = 1; b.t.m[1][1] = 0; b.t.m[1][2] = 0;
+	b.width = b.height = HEIGHT;
+	strcpy(b.variant, "rotate 90");
+	measure(&b, 4. * HEIGHT * HEIGHT);
+	pixman_f_transform_init_scale(&b.t, .75, .75);
+	strcpy(b.variant, "bilinear scale");
+	measure(&b, 4. * HEIGHT * HEIGHT);
+
+	b.width = WIDTH;
+	b.height = HEIGHT;
+	b.bpp = 0;
+
+	b.name = "damage_add";
+	b.op = op_damage_add;
+	snprintf(b.variant, sizeof(b.variant), "%d boxes, reduce", NBOX);
+	measure(&b, 0);
+
+	b.name = "damage_subtract";
+	b.op = op_damage_subtract;
+	snprintf(b.variant, sizeof(b.variant), "%d boxes, reduce", NBOX);
+	measure(&b, 0);
+
+	for (i = 0; i < NBOX; i += 2)
+		sna_damage_add_box(&contains, &boxes[i]);
+	sna_damage_reduce(&contains);
+	b.name = "damage_contains_box";
+	b.op = op_damage_contains;
+	snprintf(b.variant, sizeof(b.variant), "%d boxes", NBOX);
+	measure(&b, 0);
+	sna_damage_destroy(&contains);
+
+	bench_tor(&b);
+	bench_gradient(&b);
+
+#if HAS_PIXMAN_GLYPHS
+	b.cache = pixman_glyph_cache_create();
+	if (b.cache) {
+		pixman_image_t *image;
+
+		image = pixman_image_create_bits(PIXMAN_a8, 8, 12, NULL, 0);
+		pixman_glyph_cache_freeze(b.cache);
+		for (i = 0; i < NGLYPH; i++)
+			pixman_glyph_cache_insert(b.cache, &glyphs[i], NULL,
+						  0, 0, image);
+		pixman_glyph_cache_thaw(b.cache);
+		pixman_image_unref(image);
+
+		b.name = "pixman_glyph_cache_lookup";
+		b.op = op_glyph_lookup;
+		b.width = 8;
+		b.height = 12;
+		strcpy(b.variant, "80 of 256");
+		measure(&b, 0);
+
+		pixman_glyph_cache_destroy(b.cache);
+	}
+#endif
+
+	free(dst);
+	free(src);
+	return 0;
+}
@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Stresses the per-CRTC queue of Present vblank events with many clients,
+ * comparing the wheel of MSC slots against the sorted list that it
+ * replaced. Both coalesce the events for the same MSC into a growing
+ * array, the list after walking to it and the wheel by its slot. Every client
+ * keeps a number of frames queued ahead, each vblank completes the events
+ * that are due and the clients queue their next. Both queues must complete
+ * the same events at the same vblanks. Needs no X server, just run it.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/sna/sna_vblank_wheel.h"
+
+#define FRAMES 2000
+
+struct event {
+	struct vblank_node node;
+	struct event *prev, *next;
+	uint64_t target_msc;
+	uint64_t *event_id;
+	int n_event_id;
+	uint64_t id[1];
+};
+
+struct workload {
+	const char *name;
+	int depth; /* frames each client keeps queued */
+	int spread; /* clients run at 1..spread frames per swap */
+};
+
+static const struct workload workloads[] = {
+	{ "every vblank", 1, 1 },
+	{ "swap interval 1-4", 1, 4 },
+	{ "3 frames ahead", 3, 1 },
+	{ "8 frames ahead, 1-4", 8, 4 },
+	{ "scattered, 1-120", 1, 120 },
+};
+
+/* As info_alloc()/info_free(), which keep the last event freed */
+static struct event *freed;
+
+static struct event *event_alloc(void)
+{
+	struct event *e = freed;
+
+	if (e) {
+		freed = NULL;
+		return e;
+	}
+
+	return malloc(sizeof(*e));
+}
+
+static void event_free(struct event *e)
+{
+	free(freed);
+	freed = e;
+}
+
+static void event_append(struct event *e, uint64_t id)
+{
+	uint64_t *events = e->event_id;
+
+	if (e->n_event_id && (e->n_event_id & (e->n_event_id - 1)) == 0) {
+		events = malloc(2*sizeof(uint64_t)*e->n_event_id);
+		memcpy(events, e->event_id, e->n_event_id*sizeof(uint64_t));
+		if (e->n_event_id != 1)
+			free(e->event_id);
+		e->event_id = events;
+	}
+	events[e->n_event_id++] = id;
+}
+
+static double elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return 1e3 * (end->tv_sec - start->tv_sec) + 1e-6 * (end->tv_nsec - start->tv_nsec);
+}
+
+/* As sna_present_queue_vblank() before, a sorted list of MSC */
+struct list_queue {
+	struct event head;
+};
+
+static void list_queue(struct list_queue *q, uint64_t id, uint64_t msc)
+{
+	struct event *tmp, *e;
+
+	for (tmp = q->head.next; tmp != &q->head; tmp = tmp->next) {
+		if (tmp->target_msc == msc) {
+			event_append(tmp, id);
+			return;
+		}
+		if ((int64_t)(tmp->target_msc - msc) > 0)
+			break;
+	}
+
+	e = event_alloc();
+	e->target_msc = msc;
+	e->event_id = e->id;
+	e->id[0] = id;
+	e->n_event_id = 1;
+
+	e->next = tmp;
+	e->prev = tmp->prev;
+	tmp->prev->next = e;
+	tmp->prev = e;
+}
+
+static uint64_t list_complete(struct list_queue *q, uint64_t msc,
+			      void (*notify)(uint64_t id, uint64_t msc, void *), void *data)
+{
+	uint64_t count = 0;
+
+	while (q->head.next != &q->head &&
+	       !vblank_msc_before(msc, q->head.next->target_msc)) {
+		struct event *e = q->head.next;
+		int n;
+
+		for (n = 0; n < e->n_event_id; n++)
+			notify(e->event_id[n], msc, data);
+		count += e->n_event_id;
+
+		if (e->n_event_id > 1)
+			free(e->event_id);
+		e->prev->next = e->next;
+		e->next->prev = e->prev;
+		event_free(e);
+	}
+
+	return count;
+}
+
+/* As sna_present_queue_vblank() now */
+static void wheel_queue(struct vblank_wheel *q, uint64_t id, uint64_t msc)
+{
+	struct vblank_node *node;
+	struct event *e;
+
+	node = vblank_wheel_find(q, msc);
+	if (node) {
+		event_append((struct event *)node, id);
+		return;
+	}
+
+	e = event_alloc();
+	e->target_msc = msc;
+	e->event_id = e->id;
+	e->id[0] = id;
+	e->n_event_id = 1;
+	vblank_wheel_push(q, &e->node, msc);
+}
+
+static uint64_t wheel_complete(struct vblank_wheel *q, uint64_t msc,
+			      void (*notify)(uint64_t id, uint64_t msc, void *), void *data)
+{
+	uint64_t count = 0;
+	struct vblank_node *node;
+
+	while ((node = vblank_wheel_top(q)) &&
+	       !vblank_msc_before(msc, node->msc)) {
+		struct event *e = (struct event *)node;
+		int n;
+
+		vblank_wheel_remove(q, node);
+		for (n = 0; n < e->n_event_id; n++)
+			notify(e->event_id[n], msc, data);
+		count += e->n_event_id;
+
+		if (e->n_event_id > 1)
+			free(e->event_id);
+		event_free(e);
+	}
+
+	return count;
+}
+
+struct state {
+	int clients;
+	const struct workload *w;
+	uint64_t *next_msc; /* per client, the MSC of its last queued frame */
+	uint64_t sum;
+	void (*queue)(void *q, uint64_t id, uint64_t msc);
+	void *q;
+};
+
+static int interval(const struct state *s, int client)
+{
+	return 1 + client % s->w->spread;
+}
+
+/* A completed client queues its next frame, as Present would on the swap */
+static void notify(uint64_t id, uint64_t msc, void *data)
+{
+	struct state *s = data;
+	int client = id % s->clients;
+
+	s->sum += (id * 0x9e3779b97f4a7c15ull) ^ msc;
+	s->next_msc[client] += interval(s, client);
+	s->queue(s->q, id + s->clients, s->next_msc[client]);
+}
+
+static void queue_list(void *q, uint64_t id, uint64_t msc)
+{
+	list_queue(q, id, msc);
+}
+
+static void queue_wheel(void *q, uint64_t id, uint64_t msc)
+{
+	wheel_queue(q, id, msc);
+}
+
+static double run(const struct workload *w, int clients, int use_wheel,
+		  uint64_t *sum, uint64_t *events)
+{
+	struct list_queue lq;
+	struct vblank_wheel wq;
+	struct state s;
+	struct timespec start, end;
+	uint64_t msc = (uint64_t)-FRAMES / 2; /* wrap half-way through */
+	int c, d, f;
+
+	lq.head.next = lq.head.prev = &lq.head;
+	vblank_wheel_init(&wq);
+
+	s.clients = clients;
+	s.w = w;
+	s.sum = 0;
+	s.next_msc = malloc(clients * sizeof(uint64_t));
+	s.queue = use_wheel ? queue_wheel : queue_list;
+	s.q = use_wheel ? (void *)&wq : (void *)&lq;
+
+	for (c = 0; c < clients; c++) {
+		s.next_msc[c] = msc;
+		for (d = 0; d < w->depth; d++) {
+			s.next_msc[c] += interval(&s, c);
+			s.queue(s.q, c + (uint64_t)d * clients * 1000000, s.next_msc[c]);
+		}
+	}
+
+	*events = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (f = 0; f < FRAMES; f++) {
+		msc++;
+		if (use_wheel)
+			*events += wheel_complete(&wq, msc, notify, &s);
+		else
+			*events += list_complete(&lq, msc, notify, &s);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	/* drain */
+	if (use_wheel) {
+		struct vblank_node *node;
+		while ((node = vblank_wheel_top(&wq))) {
+			struct event *e = (struct event *)node;
+
+			vblank_wheel_remove(&wq, node);
+			if (e->n_event_id > 1)
+				free(e->event_id);
+			free(e);
+		}
+	} else {
+		while (lq.head.next != &lq.head) {
+			struct event *e = lq.head.next;
+			lq.head.next = e->next;
+			if (e->n_event_id > 1)
+				free(e->event_id);
+			free(e);
+		}
+	}
+	free(s.next_msc);
+	event_free(NULL);
+
+	*sum = s.sum;
+	return elapsed(&start, &end);
+}
+
+int main(int argc, char **argv)
+{
+	static const int clients[] = { 1, 10, 40, 160, 640 };
+	unsigned w, c;
+	int ret = 0;
+
+	(void)argc; (void)argv;
+
+	printf("%-22s %7s %12s %12s\n", "", "clients", "list ns/ev", "wheel ns/ev");
+	for (w = 0; w < sizeof(workloads)/sizeof(workloads[0]); w++) {
+		for (c = 0; c < sizeof(clients)/sizeof(clients[0]); c++) {
+			uint64_t list_sum, wheel_sum, list_events, wheel_events;
+			double list_ms, wheel_ms;
+
+			list_ms = run(&workloads[w], clients[c], 0, &list_sum, &list_events);
+			wheel_ms = run(&workloads[w], clients[c], 1, &wheel_sum, &wheel_events);
+			/* events sharing an MSC may complete in either order */
+			if (list_events != wheel_events || list_sum != wheel_sum) {
+				fprintf(stderr, "%s, %d clients: list completed %llu events, wheel %llu, or at different vblanks\n",
+					workloads[w].name, clients[c],
+					(unsigned long long)list_events,
+					(unsigned long long)wheel_events);
+				ret = 1;
+			}
+
+			printf("%-22s %7d %12.1f %12.1f\n",
+			       workloads[w].name, clients[c],
+			       1e6 * list_ms / list_events,
+			       1e6 * wheel_ms / wheel_events);
+		}
+	}
+
+	return ret;
+}
@@ -32,7 +32,10 @@ const OptionInfoRec intel_options[] = {
 	{OPTION_ZAPHOD,		"ZaphodHeads",	OPTV_STRING,	{0},	0},
 	{OPTION_VIRTUAL,	"VirtualHeads",	OPTV_INTEGER,	{0},	0},
 	{OPTION_TEAR_FREE,	"TearFree",	OPTV_BOOLEAN,	{0},	0},
+	{OPTION_LATE_LATCH,	"LateLatching",	OPTV_BOOLEAN,	{0},	0},
 	{OPTION_CRTC_PIXMAPS,	"PerCrtcPixmaps", OPTV_BOOLEAN,	{0},	0},
+	{OPTION_ADAPTIVE_PLACEMENT, "AdaptivePlacement", OPTV_BOOLEAN, {0}, 1},
+	{OPTION_READBACK_PREFETCH, "ReadbackPrefetch", OPTV_BOOLEAN, {0}, 1},
 #endif
 #ifdef USE_UXA
 	{OPTION_FALLBACKDEBUG,	"FallbackDebug",OPTV_BOOLEAN,	{0},	0},
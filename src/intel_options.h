@@ -38,7 +38,10 @@ enum intel_options {
 	OPTION_ZAPHOD,
 	OPTION_VIRTUAL,
 	OPTION_TEAR_FREE,
+	OPTION_LATE_LATCH,
 	OPTION_CRTC_PIXMAPS,
+	OPTION_ADAPTIVE_PLACEMENT,
+	OPTION_READBACK_PREFETCH,
 #endif
 #ifdef USE_UXA
 	OPTION_FALLBACKDEBUG,
@@ -1704,10 +1704,32 @@ affine_blt(const void *src, void *dst, int bpp,
 	static const uint8_t zero[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
 	const pixman_fixed_t ux = pixman_double_to_fixed(t->m[0][0]);
 	const pixman_fixed_t uy = pixman_double_to_fixed(t->m[1][0]);
-	int i, j;
+	int i, j, sx, sy, step[4];
 
 	assert(bpp == 32);
 
+	/* A pure rotation or reflection samples exactly on the pixel
+	 * centres, so the bilinear filter reduces to a direct copy.
+	 */
+	if (src_x == dst_x && src_y == dst_y &&
+	    rotate_blt_transform(t->m, dst_x, dst_y, &sx, &sy, step)) {
+		int x = dst_x, y = dst_y, w = dst_width, h = dst_height;
+
+		if (!rotate_blt_clip(src_width, src_height, &sx, &sy, step,
+				     &x, &y, &w, &h))
+			w = h = 0;
+
+		if (w != dst_width || h != dst_height) {
+			for (j = 0; j < dst_height; j++)
+				memset((uint8_t *)dst + (dst_y + j) * dst_stride + dst_x * bpp / 8,
+				       0, dst_width * bpp / 8);
+		}
+		if (w && h)
+			rotate_blt(src, dst, bpp, src_stride, dst_stride,
+				   sx, sy, x, y, w, h, step);
+		return;
+	}
+
 	for (j = 0; j < dst_height; j++) {
 		pixman_fixed_t x, y;
 		struct pixman_f_vector v;
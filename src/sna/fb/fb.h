@@ -38,6 +38,7 @@
 #include <pixman.h>
 
 #include "sfb.h"
+#include "fbsimd.h"
 
 #include "../../compat-api.h"
 #include "../debug.h"
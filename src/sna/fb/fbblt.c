@@ -92,10 +92,16 @@ fbBlt__rop(FbBits *srcLine, FbStride srcStride, int srcX,
 	Bool destInvarient;
 	int startbyte, endbyte;
 
+	FbBits rop[4];
+
 	FbDeclareMergeRop();
 
 	FbInitializeMergeRop(alu, pm);
 	destInvarient = FbDestInvarientMergeRop();
+	rop[0] = _ca1;
+	rop[1] = _cx1;
+	rop[2] = _ca2;
+	rop[3] = _cx2;
 	if (upsidedown) {
 		srcLine += (height - 1) * (srcStride);
 		dstLine += (height - 1) * (dstStride);
@@ -150,7 +156,11 @@ fbBlt__rop(FbBits *srcLine, FbStride srcStride, int srcX,
 					dst++;
 				}
 				n = nmiddle;
-				if (destInvarient) {
+				if (n >= FB_SIMD_MIN_WORDS) {
+					fbMergeRopWords(src, dst, n, rop);
+					src += n;
+					dst += n;
+				} else if (destInvarient) {
 					while (n--)
 						WRITE(dst++, FbDoDestInvarientMergeRop(READ(src++)));
 				} else {
@@ -233,7 +243,13 @@ fbBlt__rop(FbBits *srcLine, FbStride srcStride, int srcX,
 					dst++;
 				}
 				n = nmiddle;
-				if (destInvarient) {
+				if (n >= FB_SIMD_MIN_WORDS) {
+					bits1 = fbMergeRopWordsShift(bits1, src, dst, n,
+								     leftShift, rightShift,
+								     rop);
+					src += n;
+					dst += n;
+				} else if (destInvarient) {
 					while (n--) {
 						bits = FbScrLeft(bits1, leftShift);
 						bits1 = READ(src++);
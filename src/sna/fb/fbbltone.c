@@ -248,7 +248,13 @@ fbBltOne(FbStip * src, FbStride srcStride,      /* FbStip units per scanline */
 			 */
 			for (;;) {
 				w -= n;
-				if (copy) {
+				if (n >= 4 && dstBpp >= 8 && !fbLane) {
+					fbStippleWords(dst, bits, n, dstBpp,
+						       fgand, fgxor, bgand, bgxor);
+					dst += n;
+					n *= pixelsPerDst;
+					bits = n < FB_STIP_UNIT ? FbStipLeft(bits, n) : 0;
+				} else if (copy) {
 					while (n--) {
 #if FB_UNIT > 32
 						if (pixelsPerDst == 16)
@@ -37,6 +37,28 @@ fbSolid(FbBits * dst,
 	dstX &= FB_MASK;
 	FbMaskBitsBytes(dstX, width, and == 0, startmask, startbyte,
 			nmiddle, endmask, endbyte);
+
+	if (nmiddle >= FB_SIMD_MIN_WORDS) {
+		/* Edges first, then hand the body over in a single pass */
+		if (startmask || endmask) {
+			FbBits *d = dst;
+			int h = height;
+
+			while (h--) {
+				if (startmask)
+					FbDoLeftMaskByteRRop(d, startbyte, startmask, and, xor);
+				if (endmask) {
+					FbBits *e = d + !!startmask + nmiddle;
+					FbDoRightMaskByteRRop(e, endbyte, endmask, and, xor);
+				}
+				d += dstStride;
+			}
+		}
+		fbSolidWords(dst + !!startmask, dstStride,
+			     nmiddle, height, and, xor);
+		return;
+	}
+
 	if (startmask)
 		dstStride--;
 	dstStride -= nmiddle;
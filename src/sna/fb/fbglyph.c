@@ -70,6 +70,35 @@ fbGlyphIn(GCPtr gc, int x, int y, int width, int height)
 	return RegionContainsRect(gc->pCompositeClip, &box) == rgnIN;
 }
 
+/*
+ * Check the bounding box of the whole string against the clip, so that
+ * a string lying entirely within the clip need not query the clip region
+ * for every glyph.
+ */
+static bool
+fbGlyphsIn(GCPtr gc, int x, int y,
+	   unsigned int nglyph, CharInfoPtr *ppci)
+{
+	FontPtr font = gc->font;
+	int x1 = x, x2 = x;
+
+	while (nglyph--) {
+		x += (*ppci++)->metrics.characterWidth;
+		if (x < x1)
+			x1 = x;
+		if (x > x2)
+			x2 = x;
+	}
+
+	x1 += FONTMINBOUNDS(font, leftSideBearing);
+	x2 += FONTMAXBOUNDS(font, rightSideBearing);
+	if (x2 <= x1)
+		return false;
+
+	return fbGlyphIn(gc, x1, y - FONTMAXBOUNDS(font, ascent), x2 - x1,
+			 FONTMAXBOUNDS(font, ascent) + FONTMAXBOUNDS(font, descent));
+}
+
 #define WRITE1(d,n,fg)	WRITE((d) + (n), (CARD8) fg)
 #define WRITE2(d,n,fg)	WRITE((CARD16 *) &(d[n]), (CARD16) fg)
 #define WRITE4(d,n,fg)	WRITE((CARD32 *) &(d[n]), (CARD32) fg)
@@ -135,6 +164,7 @@ fbPolyGlyphBlt(DrawablePtr drawable, GCPtr gc,
 	FbStride dstStride = 0;
 	int dstBpp = 0;
 	int dstXoff = 0, dstYoff = 0;
+	bool inside = false;
 
 	DBG(("%s x %d\n", __FUNCTION__, nglyph));
 
@@ -156,6 +186,13 @@ fbPolyGlyphBlt(DrawablePtr drawable, GCPtr gc,
 	x += drawable->x;
 	y += drawable->y;
 
+	if (raster) {
+		inside = fbGlyphsIn(gc, x, y, nglyph, ppci);
+		if (inside)
+			fbGetDrawable(drawable, dst, dstStride, dstBpp,
+				      dstXoff, dstYoff);
+	}
+
 	while (nglyph--) {
 		pci = *ppci++;
 		pglyph = FONTGLYPHBITS(glyphs, pci);
@@ -165,9 +202,10 @@ fbPolyGlyphBlt(DrawablePtr drawable, GCPtr gc,
 			gx = x + pci->metrics.leftSideBearing;
 			gy = y - pci->metrics.ascent;
 			if (raster && gWidth <= sizeof(FbStip) * 8 &&
-			    fbGlyphIn(gc, gx, gy, gWidth, gHeight)) {
-				fbGetDrawable(drawable, dst, dstStride, dstBpp, dstXoff,
-					      dstYoff);
+			    (inside || fbGlyphIn(gc, gx, gy, gWidth, gHeight))) {
+				if (!inside)
+					fbGetDrawable(drawable, dst, dstStride, dstBpp,
+						      dstXoff, dstYoff);
 				raster(dst + (gy + dstYoff) * dstStride, dstStride, dstBpp,
 					  (FbStip *) pglyph, pgc->xor, gx + dstXoff, gHeight);
 			} else {
@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fbsimd.h"
+#include "../compiler.h"
+
+#define MERGE_ROP(s, d, rop) \
+	(((d) & (((s) & rop[0]) ^ rop[1])) ^ (((s) & rop[2]) ^ rop[3]))
+
+static void
+fbSolidWords__generic(uint32_t *dst, int stride,
+		      int width, int height,
+		      uint32_t and, uint32_t xor)
+{
+	stride -= width;
+	while (height--) {
+		int n = width;
+		if (!and)
+			while (n--)
+				*dst++ = xor;
+		else
+			while (n--) {
+				*dst = (*dst & and) ^ xor;
+				dst++;
+			}
+		dst += stride;
+	}
+}
+
+static void
+fbMergeRopWords__generic(const uint32_t *src, uint32_t *dst, int n,
+			 const uint32_t *rop)
+{
+	if (rop[0] == 0 && rop[1] == 0) {
+		while (n--)
+			*dst++ = (*src++ & rop[2]) ^ rop[3];
+	} else {
+		while (n--) {
+			uint32_t s = *src++;
+			*dst = MERGE_ROP(s, *dst, rop);
+			dst++;
+		}
+	}
+}
+
+static uint32_t
+fbMergeRopWordsShift__generic(uint32_t bits1,
+			      const uint32_t *src, uint32_t *dst,
+			      int n, int leftShift, int rightShift,
+			      const uint32_t *rop)
+{
+	while (n--) {
+		uint32_t bits = bits1 >> leftShift;
+		bits1 = *src++;
+		bits |= bits1 << rightShift;
+		*dst = MERGE_ROP(bits, *dst, rop);
+		dst++;
+	}
+
+	return bits1;
+}
+
+static const uint32_t stipple2[4] = {
+	0x00000000, 0x0000ffff, 0xffff0000, 0xffffffff,
+};
+
+static const uint32_t stipple4[16] = {
+	0x00000000, 0x000000ff, 0x0000ff00, 0x0000ffff,
+	0x00ff0000, 0x00ff00ff, 0x00ffff00, 0x00ffffff,
+	0xff000000, 0xff0000ff, 0xff00ff00, 0xff00ffff,
+	0xffff0000, 0xffff00ff, 0xffffff00, 0xffffffff,
+};
+
+static force_inline uint32_t
+stipple_mask(uint32_t bits, int bpp)
+{
+	switch (bpp) {
+	case 8: return stipple4[bits & 15];
+	case 16: return stipple2[bits & 3];
+	default: return -(bits & 1);
+	}
+}
+
+static void
+fbStippleWords__generic(uint32_t *dst, uint32_t bits, int n, int bpp,
+			uint32_t fgand, uint32_t fgxor,
+			uint32_t bgand, uint32_t bgxor)
+{
+	const int shift = 32 / bpp;
+
+	if ((fgand | bgand) == 0) {
+		while (n--) {
+			uint32_t mask = stipple_mask(bits, bpp);
+			*dst++ = (fgxor & mask) | (bgxor & ~mask);
+			bits >>= shift;
+		}
+	} else {
+		while (n--) {
+			uint32_t mask = stipple_mask(bits, bpp);
+			uint32_t and = (fgand & mask) | (bgand & ~mask);
+			uint32_t xor = (fgxor & mask) | (bgxor & ~mask);
+			*dst = (*dst & and) ^ xor;
+			dst++;
+			bits >>= shift;
+		}
+	}
+}
+
+void (*fbStippleWords)(uint32_t *dst, uint32_t bits, int n, int bpp,
+		       uint32_t fgand, uint32_t fgxor,
+		       uint32_t bgand, uint32_t bgxor) = fbStippleWords__generic;
+
+void (*fbSolidWords)(uint32_t *dst, int stride,
+		     int width, int height,
+		     uint32_t and, uint32_t xor) = fbSolidWords__generic;
+
+void (*fbMergeRopWords)(const uint32_t *src, uint32_t *dst, int n,
+			const uint32_t *rop) = fbMergeRopWords__generic;
+
+uint32_t (*fbMergeRopWordsShift)(uint32_t bits1,
+				 const uint32_t *src, uint32_t *dst,
+				 int n, int leftShift, int rightShift,
+				 const uint32_t *rop) = fbMergeRopWordsShift__generic;
+
+static const char *fb_simd_name = "generic";
+
+#if defined(sse2)
+#pragma GCC push_options
+#pragma GCC target("sse2,fpmath=sse")
+#pragma GCC optimize("Ofast")
+#include <emmintrin.h>
+
+static force_inline __m128i
+xmm_merge_rop(__m128i s, __m128i d, const __m128i *rop)
+{
+	return _mm_xor_si128(_mm_and_si128(d, _mm_xor_si128(_mm_and_si128(s, rop[0]), rop[1])),
+			     _mm_xor_si128(_mm_and_si128(s, rop[2]), rop[3]));
+}
+
+static force_inline __m128i
+xmm_invariant_rop(__m128i s, const __m128i *rop)
+{
+	return _mm_xor_si128(_mm_and_si128(s, rop[2]), rop[3]);
+}
+
+static void
+fbSolidWords__sse2(uint32_t *dst, int stride,
+		   int width, int height,
+		   uint32_t and, uint32_t xor)
+{
+	const __m128i vand = _mm_set1_epi32(and);
+	const __m128i vxor = _mm_set1_epi32(xor);
+	bool stream;
+
+	stream = and == 0 &&
+		(int64_t)width * height * sizeof(uint32_t) >= FB_SIMD_STREAM_BYTES;
+
+	while (height--) {
+		uint32_t *d = dst;
+		int n = width;
+
+		while (n && (uintptr_t)d & 15) {
+			*d = (*d & and) ^ xor;
+			d++;
+			n--;
+		}
+
+		if (and == 0) {
+			if (stream) {
+				while (n >= 16) {
+					_mm_stream_si128((__m128i *)d + 0, vxor);
+					_mm_stream_si128((__m128i *)d + 1, vxor);
+					_mm_stream_si128((__m128i *)d + 2, vxor);
+					_mm_stream_si128((__m128i *)d + 3, vxor);
+					d += 16;
+					n -= 16;
+				}
+			} else {
+				while (n >= 16) {
+					_mm_store_si128((__m128i *)d + 0, vxor);
+					_mm_store_si128((__m128i *)d + 1, vxor);
+					_mm_store_si128((__m128i *)d + 2, vxor);
+					_mm_store_si128((__m128i *)d + 3, vxor);
+					d += 16;
+					n -= 16;
+				}
+			}
+			while (n >= 4) {
+				_mm_store_si128((__m128i *)d, vxor);
+				d += 4;
+				n -= 4;
+			}
+		} else {
+			while (n >= 8) {
+				__m128i xmm0, xmm1;
+
+				xmm0 = _mm_load_si128((__m128i *)d + 0);
+				xmm1 = _mm_load_si128((__m128i *)d + 1);
+				xmm0 = _mm_xor_si128(_mm_and_si128(xmm0, vand), vxor);
+				xmm1 = _mm_xor_si128(_mm_and_si128(xmm1, vand), vxor);
+				_mm_store_si128((__m128i *)d + 0, xmm0);
+				_mm_store_si128((__m128i *)d + 1, xmm1);
+				d += 8;
+				n -= 8;
+			}
+		}
+
+		while (n--) {
+			*d = (*d & and) ^ xor;
+			d++;
+		}
+
+		dst += stride;
+	}
+
+	if (stream)
+		_mm_sfence();
+}
+
+static void
+fbMergeRopWords__sse2(const uint32_t *src, uint32_t *dst, int n,
+		      const uint32_t *rop)
+{
+	__m128i vrop[4];
+
+	while (n && (uintptr_t)dst & 15) {
+		uint32_t s = *src++;
+		*dst = MERGE_ROP(s, *dst, rop);
+		dst++;
+		n--;
+	}
+
+	vrop[0] = _mm_set1_epi32(rop[0]);
+	vrop[1] = _mm_set1_epi32(rop[1]);
+	vrop[2] = _mm_set1_epi32(rop[2]);
+	vrop[3] = _mm_set1_epi32(rop[3]);
+
+	if (rop[0] == 0 && rop[1] == 0) {
+		while (n >= 8) {
+			__m128i xmm0, xmm1;
+
+			xmm0 = _mm_loadu_si128((const __m128i *)src + 0);
+			xmm1 = _mm_loadu_si128((const __m128i *)src + 1);
+			_mm_store_si128((__m128i *)dst + 0,
+					xmm_invariant_rop(xmm0, vrop));
+			_mm_store_si128((__m128i *)dst + 1,
+					xmm_invariant_rop(xmm1, vrop));
+			src += 8;
+			dst += 8;
+			n -= 8;
+		}
+	} else {
+		while (n >= 8) {
+			__m128i xmm0, xmm1;
+
+			xmm0 = _mm_loadu_si128((const __m128i *)src + 0);
+			xmm1 = _mm_loadu_si128((const __m128i *)src + 1);
+			xmm0 = xmm_merge_rop(xmm0,
+					     _mm_load_si128((__m128i *)dst + 0),
+					     vrop);
+			xmm1 = xmm_merge_rop(xmm1,
+					     _mm_load_si128((__m128i *)dst + 1),
+					     vrop);
+			_mm_store_si128((__m128i *)dst + 0, xmm0);
+			_mm_store_si128((__m128i *)dst + 1, xmm1);
+			src += 8;
+			dst += 8;
+			n -= 8;
+		}
+	}
+
+	while (n--) {
+		uint32_t s = *src++;
+		*dst = MERGE_ROP(s, *dst, rop);
+		dst++;
+	}
+}
+
+static uint32_t
+fbMergeRopWordsShift__sse2(uint32_t bits1,
+			   const uint32_t *src, uint32_t *dst,
+			   int n, int leftShift, int rightShift,
+			   const uint32_t *rop)
+{
+	const __m128i ls = _mm_cvtsi32_si128(leftShift);
+	const __m128i rs = _mm_cvtsi32_si128(rightShift);
+	__m128i vrop[4];
+
+	if (n == 0)
+		return bits1;
+
+	/* Consume the carried word so that the loop can read src[-1] */
+	do {
+		uint32_t bits = bits1 >> leftShift;
+		bits1 = *src++;
+		bits |= bits1 << rightShift;
+		*dst = MERGE_ROP(bits, *dst, rop);
+		dst++;
+		n--;
+	} while (n && (uintptr_t)dst & 15);
+
+	vrop[0] = _mm_set1_epi32(rop[0]);
+	vrop[1] = _mm_set1_epi32(rop[1]);
+	vrop[2] = _mm_set1_epi32(rop[2]);
+	vrop[3] = _mm_set1_epi32(rop[3]);
+
+	while (n >= 4) {
+		__m128i prev, cur, bits;
+
+		prev = _mm_loadu_si128((const __m128i *)(src - 1));
+		cur = _mm_loadu_si128((const __m128i *)src);
+		bits = _mm_or_si128(_mm_srl_epi32(prev, ls),
+				    _mm_sll_epi32(cur, rs));
+		_mm_store_si128((__m128i *)dst,
+				xmm_merge_rop(bits,
+					      _mm_load_si128((__m128i *)dst),
+					      vrop));
+		src += 4;
+		dst += 4;
+		n -= 4;
+	}
+	bits1 = src[-1];
+
+	while (n--) {
+		uint32_t bits = bits1 >> leftShift;
+		bits1 = *src++;
+		bits |= bits1 << rightShift;
+		*dst = MERGE_ROP(bits, *dst, rop);
+		dst++;
+	}
+
+	return bits1;
+}
+
+/*
+ * Turn the next four words worth of stipple into a per-pixel mask by
+ * broadcasting the bits and comparing against each lane's select bit.
+ */
+static force_inline __m128i
+xmm_stipple_mask(uint32_t bits, int bpp)
+{
+	__m128i sel, v;
+
+	switch (bpp) {
+	case 8:
+		sel = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1,
+				   -128, 64, 32, 16, 8, 4, 2, 1);
+		v = _mm_set_epi32(((bits >> 8) & 0xff) * 0x01010101,
+				  ((bits >> 8) & 0xff) * 0x01010101,
+				  (bits & 0xff) * 0x01010101,
+				  (bits & 0xff) * 0x01010101);
+		return _mm_cmpeq_epi8(_mm_and_si128(v, sel), sel);
+	case 16:
+		sel = _mm_set_epi16(128, 64, 32, 16, 8, 4, 2, 1);
+		v = _mm_set1_epi16(bits & 0xff);
+		return _mm_cmpeq_epi16(_mm_and_si128(v, sel), sel);
+	default:
+		sel = _mm_set_epi32(8, 4, 2, 1);
+		v = _mm_set1_epi32(bits & 0xf);
+		return _mm_cmpeq_epi32(_mm_and_si128(v, sel), sel);
+	}
+}
+
+static force_inline __m128i
+xmm_select(__m128i mask, __m128i fg, __m128i bg)
+{
+	return _mm_or_si128(_mm_and_si128(mask, fg), _mm_andnot_si128(mask, bg));
+}
+
+static void
+fbStippleWords__sse2(uint32_t *dst, uint32_t bits, int n, int bpp,
+		     uint32_t fgand, uint32_t fgxor,
+		     uint32_t bgand, uint32_t bgxor)
+{
+	const int shift = 128 / bpp; /* pixels per 4 words */
+	const __m128i vfgxor = _mm_set1_epi32(fgxor);
+	const __m128i vbgxor = _mm_set1_epi32(bgxor);
+
+	if ((fgand | bgand) == 0) {
+		while (n >= 4) {
+			__m128i mask = xmm_stipple_mask(bits, bpp);
+			_mm_storeu_si128((__m128i *)dst,
+					 xmm_select(mask, vfgxor, vbgxor));
+			bits >>= shift;
+			dst += 4;
+			n -= 4;
+		}
+	} else {
+		const __m128i vfgand = _mm_set1_epi32(fgand);
+		const __m128i vbgand = _mm_set1_epi32(bgand);
+
+		while (n >= 4) {
+			__m128i mask = xmm_stipple_mask(bits, bpp);
+			__m128i d = _mm_loadu_si128((__m128i *)dst);
+
+			d = _mm_and_si128(d, xmm_select(mask, vfgand, vbgand));
+			d = _mm_xor_si128(d, xmm_select(mask, vfgxor, vbgxor));
+			_mm_storeu_si128((__m128i *)dst, d);
+			bits >>= shift;
+			dst += 4;
+			n -= 4;
+		}
+	}
+
+	if (n)
+		fbStippleWords__generic(dst, bits, n, bpp,
+					fgand, fgxor, bgand, bgxor);
+}
+
+#pragma GCC pop_options
+#endif
+
+#if defined(avx2)
+#pragma GCC push_options
+#pragma GCC target("avx2,avx,sse4.2,sse2,fpmath=sse")
+#pragma GCC optimize("Ofast")
+#include <immintrin.h>
+
+static force_inline __m256i
+ymm_merge_rop(__m256i s, __m256i d, const __m256i *rop)
+{
+	return _mm256_xor_si256(_mm256_and_si256(d, _mm256_xor_si256(_mm256_and_si256(s, rop[0]), rop[1])),
+				_mm256_xor_si256(_mm256_and_si256(s, rop[2]), rop[3]));
+}
+
+static force_inline __m256i
+ymm_invariant_rop(__m256i s, const __m256i *rop)
+{
+	return _mm256_xor_si256(_mm256_and_si256(s, rop[2]), rop[3]);
+}
+
+static void
+fbSolidWords__avx2(uint32_t *dst, int stride,
+		   int width, int height,
+		   uint32_t and, uint32_t xor)
+{
+	const __m256i vand = _mm256_set1_epi32(and);
+	const __m256i vxor = _mm256_set1_epi32(xor);
+	bool stream;
+
+	stream = and == 0 &&
+		(int64_t)width * height * sizeof(uint32_t) >= FB_SIMD_STREAM_BYTES;
+
+	while (height--) {
+		uint32_t *d = dst;
+		int n = width;
+
+		while (n && (uintptr_t)d & 31) {
+			*d = (*d & and) ^ xor;
+			d++;
+			n--;
+		}
+
+		if (and == 0) {
+			if (stream) {
+				while (n >= 32) {
+					_mm256_stream_si256((__m256i *)d + 0, vxor);
+					_mm256_stream_si256((__m256i *)d + 1, vxor);
+					_mm256_stream_si256((__m256i *)d + 2, vxor);
+					_mm256_stream_si256((__m256i *)d + 3, vxor);
+					d += 32;
+					n -= 32;
+				}
+			} else {
+				while (n >= 32) {
+					_mm256_store_si256((__m256i *)d + 0, vxor);
+					_mm256_store_si256((__m256i *)d + 1, vxor);
+					_mm256_store_si256((__m256i *)d + 2, vxor);
+					_mm256_store_si256((__m256i *)d + 3, vxor);
+					d += 32;
+					n -= 32;
+				}
+			}
+			while (n >= 8) {
+				_mm256_store_si256((__m256i *)d, vxor);
+				d += 8;
+				n -= 8;
+			}
+		} else {
+			while (n >= 16) {
+				__m256i ymm0, ymm1;
+
+				ymm0 = _mm256_load_si256((__m256i *)d + 0);
+				ymm1 = _mm256_load_si256((__m256i *)d + 1);
+				ymm0 = _mm256_xor_si256(_mm256_and_si256(ymm0, vand), vxor);
+				ymm1 = _mm256_xor_si256(_mm256_and_si256(ymm1, vand), vxor);
+				_mm256_store_si256((__m256i *)d + 0, ymm0);
+				_mm256_store_si256((__m256i *)d + 1, ymm1);
+				d += 16;
+				n -= 16;
+			}
+		}
+
+		while (n--) {
+			*d = (*d & and) ^ xor;
+			d++;
+		}
+
+		dst += stride;
+	}
+
+	if (stream)
+		_mm_sfence();
+}
+
+static void
+fbMergeRopWords__avx2(const uint32_t *src, uint32_t *dst, int n,
+		      const uint32_t *rop)
+{
+	__m256i vrop[4];
+
+	while (n && (uintptr_t)dst & 31) {
+		uint32_t s = *src++;
+		*dst = MERGE_ROP(s, *dst, rop);
+		dst++;
+		n--;
+	}
+
+	vrop[0] = _mm256_set1_epi32(rop[0]);
+	vrop[1] = _mm256_set1_epi32(rop[1]);
+	vrop[2] = _mm256_set1_epi32(rop[2]);
+	vrop[3] = _mm256_set1_epi32(rop[3]);
+
+	if (rop[0] == 0 && rop[1] == 0) {
+		while (n >= 16) {
+			__m256i ymm0, ymm1;
+
+			ymm0 = _mm256_loadu_si256((const __m256i *)src + 0);
+			ymm1 = _mm256_loadu_si256((const __m256i *)src + 1);
+			_mm256_store_si256((__m256i *)dst + 0,
+					   ymm_invariant_rop(ymm0, vrop));
+			_mm256_store_si256((__m256i *)dst + 1,
+					   ymm_invariant_rop(ymm1, vrop));
+			src += 16;
+			dst += 16;
+			n -= 16;
+		}
+	} else {
+		while (n >= 16) {
+			__m256i ymm0, ymm1;
+
+			ymm0 = _mm256_loadu_si256((const __m256i *)src + 0);
+			ymm1 = _mm256_loadu_si256((const __m256i *)src + 1);
+			ymm0 = ymm_merge_rop(ymm0,
+					     _mm256_load_si256((__m256i *)dst + 0),
+					     vrop);
+			ymm1 = ymm_merge_rop(ymm1,
+					     _mm256_load_si256((__m256i *)dst + 1),
+					     vrop);
+			_mm256_store_si256((__m256i *)dst + 0, ymm0);
+			_mm256_store_si256((__m256i *)dst + 1, ymm1);
+			src += 16;
+			dst += 16;
+			n -= 16;
+		}
+	}
+
+	while (n--) {
+		uint32_t s = *src++;
+		*dst = MERGE_ROP(s, *dst, rop);
+		dst++;
+	}
+}
+
+static uint32_t
+fbMergeRopWordsShift__avx2(uint32_t bits1,
+			   const uint32_t *src, uint32_t *dst,
+			   int n, int leftShift, int rightShift,
+			   const uint32_t *rop)
+{
+	const __m128i ls = _mm_cvtsi32_si128(leftShift);
+	const __m128i rs = _mm_cvtsi32_si128(rightShift);
+	__m256i vrop[4];
+
+	if (n == 0)
+		return bits1;
+
+	do {
+		uint32_t bits = bits1 >> leftShift;
+		bits1 = *src++;
+		bits |= bits1 << rightShift;
+		*dst = MERGE_ROP(bits, *dst, rop);
+		dst++;
+		n--;
+	} while (n && (uintptr_t)dst & 31);
+
+	vrop[0] = _mm256_set1_epi32(rop[0]);
+	vrop[1] = _mm256_set1_epi32(rop[1]);
+	vrop[2] = _mm256_set1_epi32(rop[2]);
+	vrop[3] = _mm256_set1_epi32(rop[3]);
+
+	while (n >= 8) {
+		__m256i prev, cur, bits;
+
+		prev = _mm256_loadu_si256((const __m256i *)(src - 1));
+		cur = _mm256_loadu_si256((const __m256i *)src);
+		bits = _mm256_or_si256(_mm256_srl_epi32(prev, ls),
+				       _mm256_sll_epi32(cur, rs));
+		_mm256_store_si256((__m256i *)dst,
+				   ymm_merge_rop(bits,
+						 _mm256_load_si256((__m256i *)dst),
+						 vrop));
+		src += 8;
+		dst += 8;
+		n -= 8;
+	}
+	bits1 = src[-1];
+
+	while (n--) {
+		uint32_t bits = bits1 >> leftShift;
+		bits1 = *src++;
+		bits |= bits1 << rightShift;
+		*dst = MERGE_ROP(bits, *dst, rop);
+		dst++;
+	}
+
+	return bits1;
+}
+
+#pragma GCC pop_options
+#endif
+
+void fbSimdInit(unsigned flags)
+{
+	fbSolidWords = fbSolidWords__generic;
+	fbMergeRopWords = fbMergeRopWords__generic;
+	fbMergeRopWordsShift = fbMergeRopWordsShift__generic;
+	fbStippleWords = fbStippleWords__generic;
+	fb_simd_name = "generic";
+
+#if defined(avx2)
+	if (flags & FB_SIMD_AVX2) {
+		fbSolidWords = fbSolidWords__avx2;
+		fbMergeRopWords = fbMergeRopWords__avx2;
+		fbMergeRopWordsShift = fbMergeRopWordsShift__avx2;
+#if defined(sse2)
+		fbStippleWords = fbStippleWords__sse2;
+#endif
+		fb_simd_name = "avx2";
+		return;
+	}
+#endif
+#if defined(sse2)
+	if (flags & FB_SIMD_SSE2) {
+		fbSolidWords = fbSolidWords__sse2;
+		fbMergeRopWords = fbMergeRopWords__sse2;
+		fbMergeRopWordsShift = fbMergeRopWordsShift__sse2;
+		fbStippleWords = fbStippleWords__sse2;
+		fb_simd_name = "sse2";
+		return;
+	}
+#endif
+	(void)flags;
+}
+
+const char *fbSimdName(void)
+{
+	return fb_simd_name;
+}
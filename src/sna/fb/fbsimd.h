@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef FBSIMD_H
+#define FBSIMD_H
+
+#include <stdint.h>
+
+/*
+ * Vectorised inner loops for the word-at-a-time fb routines.
+ *
+ * These only operate upon whole FbBits, the partial start/end words are
+ * still handled by the callers using the usual masks. As we work in whole
+ * words, the kernels are independent of bpp and so cover 8/16/32bpp alike.
+ * The raster op is passed in its merge form, rop[] = {ca1, cx1, ca2, cx2},
+ * i.e. dst = (dst & ((src & ca1) ^ cx1)) ^ ((src & ca2) ^ cx2).
+ */
+
+#define FB_SIMD_SSE2 0x1
+#define FB_SIMD_AVX2 0x2
+
+/* Solid fills larger than this bypass the cache with non-temporal stores */
+#define FB_SIMD_STREAM_BYTES (8 * 1024 * 1024)
+
+/* Below this many words per row, the setup cost outweighs the vector loop */
+#define FB_SIMD_MIN_WORDS 16
+
+/* Fill width words of each of height rows with dst = (dst & and) ^ xor */
+extern void (*fbSolidWords)(uint32_t *dst, int stride,
+			    int width, int height,
+			    uint32_t and, uint32_t xor);
+
+/* Combine n words, walking forwards, of a source aligned to the dest */
+extern void (*fbMergeRopWords)(const uint32_t *src, uint32_t *dst, int n,
+			       const uint32_t *rop);
+
+/*
+ * Combine n words, walking forwards, of a source misaligned with the
+ * dest, i.e. dst[i] = src[i-1] >> leftShift | src[i] << rightShift. The
+ * previous source word is passed in as bits1 and the last word read is
+ * returned for the caller to continue with.
+ */
+extern uint32_t (*fbMergeRopWordsShift)(uint32_t bits1,
+					const uint32_t *src, uint32_t *dst,
+					int n, int leftShift, int rightShift,
+					const uint32_t *rop);
+
+/*
+ * Expand the stipple bits, least significant bit first, across n words of
+ * a bpp (8/16/32) destination, i.e. dst = (dst & and) ^ xor with the
+ * fg/bg rrop chosen per pixel. n must not exceed the number of words
+ * covered by the 32 bits supplied.
+ */
+extern void (*fbStippleWords)(uint32_t *dst, uint32_t bits, int n, int bpp,
+			      uint32_t fgand, uint32_t fgxor,
+			      uint32_t bgand, uint32_t bgxor);
+
+void fbSimdInit(unsigned flags);
+const char *fbSimdName(void);
+
+#endif /* FBSIMD_H */
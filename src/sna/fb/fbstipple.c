@@ -143,7 +143,10 @@ fbEvenStipple(FbBits *dst, FbStride dstStride, int dstX, int dstBpp,
 				dst++;
 			}
 			n = nmiddle;
-			if (!and)
+			if (n >= FB_SIMD_MIN_WORDS) {
+				fbSolidWords(dst, 0, n, 1, and, xor);
+				dst += n;
+			} else if (!and)
 				while (n--)
 					WRITE(dst++, xor);
 			else {
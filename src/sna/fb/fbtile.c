@@ -76,7 +76,10 @@ fbEvenTile(FbBits *dst, FbStride dstStride, int dstX, int width, int height,
 			dst++;
 		}
 		n = nmiddle;
-		if (!and)
+		if (n >= FB_SIMD_MIN_WORDS) {
+			fbSolidWords(dst, 0, n, 1, and, xor);
+			dst += n;
+		} else if (!and)
 			while (n--)
 				WRITE(dst++, xor);
 		else
@@ -4356,12 +4356,34 @@ void kgem_clean_large_cache(struct kgem *kgem)
 	}
 }
 
+static bool kgem_expire_userptr_cache(struct kgem *kgem, time_t now)
+{
+	int n;
+
+	for (n = 0; n < kgem->nuserptr; n++) {
+		if (kgem->userptr[n].delta == 0)
+			kgem->userptr[n].delta = now;
+	}
+
+	/* Most recently used first, so the oldest are at the end */
+	while (kgem->nuserptr &&
+	       kgem->userptr[kgem->nuserptr-1].delta + MAX_INACTIVE_TIME/2 <= now) {
+		n = --kgem->nuserptr;
+		DBG(("%s: expiring userptr of %lx, handle=%d\n",
+		     __FUNCTION__, (long)kgem->userptr[n].addr,
+		     kgem->userptr[n].bo->handle));
+		kgem_bo_destroy(kgem, kgem->userptr[n].bo);
+	}
+
+	return kgem->nuserptr;
+}
+
 bool kgem_expire_cache(struct kgem *kgem)
 {
 	time_t now, expire;
 	struct kgem_bo *bo;
 	unsigned int size = 0, count = 0;
-	bool idle;
+	bool idle, userptr;
 	unsigned int i;
 
 	if (!time(&now))
@@ -4414,6 +4436,8 @@ bool kgem_expire_cache(struct kgem *kgem)
 	}
 #endif
 
+	userptr = kgem_expire_userptr_cache(kgem, now);
+
 	kgem_retire(kgem);
 	if (unlikely(kgem->wedged))
 		kgem_cleanup(kgem);
@@ -4443,7 +4467,7 @@ bool kgem_expire_cache(struct kgem *kgem)
 	}
 	if (expire == 0) {
 		DBG(("%s: idle? %d\n", __FUNCTION__, idle));
-		kgem->need_expire = !idle;
+		kgem->need_expire = !idle || userptr;
 		return false;
 	}
 
@@ -4490,7 +4514,7 @@ bool kgem_expire_cache(struct kgem *kgem)
 	DBG(("%s: expired %d objects, %d bytes, idle? %d\n",
 	     __FUNCTION__, count, size, idle));
 
-	kgem->need_expire = !idle;
+	kgem->need_expire = !idle || userptr;
 	return count;
 	(void)count;
 	(void)size;
@@ -4523,6 +4547,7 @@ bool kgem_cleanup_cache(struct kgem *kgem)
 
 	kgem_retire(kgem);
 	kgem_cleanup(kgem);
+	kgem_clean_userptr_cache(kgem);
 
 	DBG(("%s: need_expire?=%d\n", __FUNCTION__, kgem->need_expire));
 	if (!kgem->need_expire)
@@ -7089,6 +7114,142 @@ struct kgem_bo *kgem_create_map(struct kgem *kgem,
 	return bo;
 }
 
+static struct kgem_bo *
+create_tracked_userptr(struct kgem *kgem,
+		       uintptr_t addr, uint32_t size,
+		       bool read_only)
+{
+	struct local_i915_gem_userptr arg;
+	struct kgem_bo *bo;
+
+	/* Only a synchronized userptr is safe to keep around, as the
+	 * kernel then follows the client unmapping (and remapping) the
+	 * range underneath us via its mmu notifier.
+	 */
+	VG_CLEAR(arg);
+	arg.user_ptr = addr;
+	arg.user_size = size;
+	arg.flags = read_only ? I915_USERPTR_READ_ONLY : 0;
+	if (do_ioctl(kgem->fd, LOCAL_IOCTL_I915_GEM_USERPTR, &arg)) {
+		/* Older kernels refuse read-only userptr, so retry
+		 * writable under the same condition as kgem_create_map().
+		 */
+		arg.flags = 0;
+		if (!read_only || !kgem->has_wc_mmap ||
+		    do_ioctl(kgem->fd, LOCAL_IOCTL_I915_GEM_USERPTR, &arg)) {
+			DBG(("%s: failed to track %lx + %d bytes: %d\n",
+			     __FUNCTION__, (long)addr, size, errno));
+			return NULL;
+		}
+	}
+
+	if (!probe(kgem, arg.handle)) {
+		gem_close(kgem->fd, arg.handle);
+		return NULL;
+	}
+
+	bo = __kgem_bo_alloc(arg.handle, size / PAGE_SIZE);
+	if (bo == NULL) {
+		gem_close(kgem->fd, arg.handle);
+		return NULL;
+	}
+
+	bo->unique_id = kgem_get_unique_id(kgem);
+	bo->snoop = !kgem->has_llc;
+	bo->reusable = false;
+	bo->map__cpu = MAKE_USER_MAP(addr);
+	debug_alloc__bo(kgem, bo);
+
+	return bo;
+}
+
+/* As kgem_create_map(), but the underlying page-aligned userptr is kept
+ * in a small cache so that clients repeatedly handing us the same memory
+ * (ShmPutImage from a fixed segment, GetImage into one) do not pay for
+ * creating and binding a fresh userptr on every request. The caller
+ * owns the returned reference, as before.
+ */
+struct kgem_bo *kgem_create_map__cached(struct kgem *kgem,
+					void *ptr, uint32_t size,
+					bool read_only)
+{
+	struct kgem_userptr tmp;
+	struct kgem_bo *bo;
+	uintptr_t first_page, last_page;
+	int n;
+
+	assert(MAP(ptr) == ptr);
+
+	if (!kgem->has_userptr)
+		return NULL;
+
+	first_page = (uintptr_t)ptr & ~(uintptr_t)(PAGE_SIZE-1);
+	last_page = ((uintptr_t)ptr + size + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE-1);
+	assert(last_page > first_page);
+
+	for (n = 0; n < kgem->nuserptr; n++) {
+		if (kgem->userptr[n].addr == first_page &&
+		    kgem->userptr[n].size == last_page - first_page)
+			break;
+	}
+
+	if (n < kgem->nuserptr && kgem->userptr[n].read_only > read_only) {
+		DBG(("%s: upgrading read-only map of %lx\n",
+		     __FUNCTION__, (long)first_page));
+		kgem_bo_destroy(kgem, kgem->userptr[n].bo);
+		memmove(&kgem->userptr[n], &kgem->userptr[n+1],
+			(--kgem->nuserptr - n) * sizeof(kgem->userptr[0]));
+		n = kgem->nuserptr;
+	}
+
+	if (n == kgem->nuserptr) {
+		bo = create_tracked_userptr(kgem, first_page,
+					    last_page - first_page,
+					    read_only);
+		if (bo == NULL)
+			return kgem_create_map(kgem, ptr, size, read_only);
+
+		if (n == ARRAY_SIZE(kgem->userptr)) {
+			DBG(("%s: evicting %lx\n",
+			     __FUNCTION__, (long)kgem->userptr[n-1].addr));
+			kgem_bo_destroy(kgem, kgem->userptr[--n].bo);
+		} else
+			kgem->nuserptr++;
+
+		kgem->userptr[n].addr = first_page;
+		kgem->userptr[n].size = last_page - first_page;
+		kgem->userptr[n].read_only = read_only;
+		kgem->userptr[n].bo = bo;
+		kgem->need_expire = true;
+	} else
+		DBG(("%s: hit %lx, handle=%d\n",
+		     __FUNCTION__, (long)first_page, kgem->userptr[n].bo->handle));
+
+	tmp = kgem->userptr[n];
+	tmp.delta = 0;
+	memmove(&kgem->userptr[1], &kgem->userptr[0],
+		n * sizeof(kgem->userptr[0]));
+	kgem->userptr[0] = tmp;
+
+	if (first_page != (uintptr_t)ptr) {
+		bo = kgem_create_proxy(kgem, tmp.bo,
+				       (uintptr_t)ptr - first_page, size);
+		if (bo == NULL)
+			return NULL;
+
+		bo->map__cpu = MAKE_USER_MAP(ptr);
+	} else
+		bo = kgem_bo_reference(tmp.bo);
+
+	return bo;
+}
+
+void kgem_clean_userptr_cache(struct kgem *kgem)
+{
+	while (kgem->nuserptr)
+		kgem_bo_destroy(kgem, kgem->userptr[--kgem->nuserptr].bo);
+}
+
 void kgem_bo_sync__cpu(struct kgem *kgem, struct kgem_bo *bo)
 {
 	DBG(("%s: handle=%d\n", __FUNCTION__, bo->handle));
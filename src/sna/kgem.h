@@ -226,6 +226,18 @@ struct kgem {
 
 	struct kgem_bo *batch_bo;
 
+	/* Page-aligned userptr maps of client memory (e.g. SHM segments)
+	 * kept across requests, most recently used first.
+	 */
+	struct kgem_userptr {
+		uintptr_t addr;
+		uint32_t size;
+		bool read_only;
+		uint32_t delta; /* first seen idle by kgem_expire_cache() */
+		struct kgem_bo *bo;
+	} userptr[8];
+	int nuserptr;
+
 	uint16_t reloc__self[256];
 	struct drm_i915_gem_exec_object2 exec[384] page_aligned;
 	struct drm_i915_gem_relocation_entry reloc[8192] page_aligned;
@@ -258,6 +270,10 @@ void kgem_reset(struct kgem *kgem);
 struct kgem_bo *kgem_create_map(struct kgem *kgem,
 				void *ptr, uint32_t size,
 				bool read_only);
+struct kgem_bo *kgem_create_map__cached(struct kgem *kgem,
+					void *ptr, uint32_t size,
+					bool read_only);
+void kgem_clean_userptr_cache(struct kgem *kgem);
 
 struct kgem_bo *kgem_create_for_name(struct kgem *kgem, uint32_t name);
 struct kgem_bo *kgem_create_for_prime(struct kgem *kgem, int name, uint32_t size);
@@ -0,0 +1,684 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "rotate.h"
+#include "compiler.h"
+
+static const char *rotate_name = "generic";
+
+static inline int min(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+/*
+ * Copy width x height pixels, where src points to the source of the first
+ * destination pixel and step_x/step_y are the byte offsets in the source
+ * for a step along a destination row/column. Walking the destination in
+ * square tiles keeps the source lines for a transpose resident in cache.
+ */
+static void
+rotate_rect__generic(const uint8_t *src, uint8_t *dst, int cpp,
+		     int32_t dst_stride, int width, int height,
+		     intptr_t step_x, intptr_t step_y)
+{
+	int tx, ty, x, y;
+
+	if (step_x == cpp) {
+		for (y = 0; y < height; y++)
+			memcpy(dst + y * dst_stride, src + y * step_y, width * cpp);
+		return;
+	}
+
+	for (ty = 0; ty < height; ty += ROTATE_TILE) {
+		int th = min(ROTATE_TILE, height - ty);
+		for (tx = 0; tx < width; tx += ROTATE_TILE) {
+			int tw = min(ROTATE_TILE, width - tx);
+			for (y = ty; y < ty + th; y++) {
+				const uint8_t *s = src + y * step_y + tx * step_x;
+				uint8_t *d = dst + y * dst_stride + tx * cpp;
+
+				switch (cpp) {
+				case 4:
+					for (x = 0; x < tw; x++) {
+						((uint32_t *)d)[x] = *(const uint32_t *)s;
+						s += step_x;
+					}
+					break;
+				case 2:
+					for (x = 0; x < tw; x++) {
+						((uint16_t *)d)[x] = *(const uint16_t *)s;
+						s += step_x;
+					}
+					break;
+				default:
+					for (x = 0; x < tw; x++) {
+						d[x] = *s;
+						s += step_x;
+					}
+					break;
+				}
+			}
+		}
+	}
+}
+
+static fast void
+rotate_blt__generic(const void *src, void *dst, int bpp,
+		    int32_t src_stride, int32_t dst_stride,
+		    int16_t src_x, int16_t src_y,
+		    int16_t dst_x, int16_t dst_y,
+		    uint16_t width, uint16_t height,
+		    const int step[4])
+{
+	const int cpp = bpp / 8;
+
+	rotate_rect__generic((const uint8_t *)src + src_y * src_stride + src_x * cpp,
+			     (uint8_t *)dst + dst_y * dst_stride + dst_x * cpp,
+			     cpp, dst_stride, width, height,
+			     step[0] * cpp + step[1] * src_stride,
+			     step[2] * cpp + step[3] * src_stride);
+}
+
+/*
+ * Packed 4:2:2 video is rotated in 2x2 pixel blocks, i.e. a pair of
+ * vertically adjacent macropixels a (top) and b (bottom). After rotating
+ * by 90 degrees the columns of the block become its rows, so each
+ * destination macropixel takes the two luma samples of a source column
+ * and the chroma of one source row:
+ *
+ *   90:  p = (a0 a1 b0 a3) on row width-1-2x,  q = (a2 b1 b2 b3) on row width-2-2x
+ *   270: p = (b0 a1 a0 a3) on row 2x,          q = (b2 b1 a2 b3) on row 2x+1
+ *
+ * (bytes in memory order). The masks assume a little-endian CPU.
+ */
+static force_inline void
+yuy2_90(uint32_t a, uint32_t b, uint32_t *p, uint32_t *q)
+{
+	*p = (a & 0xff00ffff) | (b << 16 & 0x00ff0000);
+	*q = (a >> 16 & 0x000000ff) | (b & 0xffffff00);
+}
+
+static force_inline void
+yuy2_270(uint32_t a, uint32_t b, uint32_t *p, uint32_t *q)
+{
+	*p = (b & 0x000000ff) | (a & 0xff00ff00) | (a << 16 & 0x00ff0000);
+	*q = (b >> 16 & 0x000000ff) | (b & 0xff00ff00) | (a & 0x00ff0000);
+}
+
+/*
+ * Rotate the blocks [x1, x2) x [y1, y2) of an image of width x height
+ * pixels, where x counts macropixels along a row and y pairs of rows.
+ */
+static void
+rotate_yuy2_blocks(const uint8_t *src, uint8_t *dst,
+		   int32_t src_stride, int32_t dst_stride,
+		   int width, int height, int angle,
+		   int x1, int y1, int x2, int y2)
+{
+	int tx, ty, x, y;
+
+	for (ty = y1; ty < y2; ty += ROTATE_TILE) {
+		int th = min(ROTATE_TILE, y2 - ty);
+		for (tx = x1; tx < x2; tx += ROTATE_TILE) {
+			int tw = min(ROTATE_TILE, x2 - tx);
+			for (y = ty; y < ty + th; y++) {
+				const uint32_t *a = (const uint32_t *)(src + 2 * y * src_stride);
+				const uint32_t *b = (const uint32_t *)(src + (2 * y + 1) * src_stride);
+				uint32_t p, q;
+
+				if (angle == 90) {
+					uint32_t *d = (uint32_t *)dst + y;
+					for (x = tx; x < tx + tw; x++) {
+						yuy2_90(a[x], b[x], &p, &q);
+						*(uint32_t *)((uint8_t *)d + (width - 1 - 2 * x) * dst_stride) = p;
+						*(uint32_t *)((uint8_t *)d + (width - 2 - 2 * x) * dst_stride) = q;
+					}
+				} else {
+					uint32_t *d = (uint32_t *)dst + height / 2 - 1 - y;
+					for (x = tx; x < tx + tw; x++) {
+						yuy2_270(a[x], b[x], &p, &q);
+						*(uint32_t *)((uint8_t *)d + (2 * x + 0) * dst_stride) = p;
+						*(uint32_t *)((uint8_t *)d + (2 * x + 1) * dst_stride) = q;
+					}
+				}
+			}
+		}
+	}
+}
+
+static fast void
+rotate_yuy2__generic(const void *src, void *dst,
+		     int32_t src_stride, int32_t dst_stride,
+		     uint16_t width, uint16_t height, int angle)
+{
+	rotate_yuy2_blocks(src, dst, src_stride, dst_stride,
+			   width, height, angle,
+			   0, 0, width / 2, height / 2);
+}
+
+#if defined(sse2)
+#pragma GCC push_options
+#pragma GCC target("sse2,inline-all-stringops,fpmath=sse")
+#pragma GCC optimize("Ofast")
+#include <emmintrin.h>
+
+static force_inline __m128i
+reverse_epi32(__m128i v)
+{
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+static force_inline __m128i
+reverse_epi16(__m128i v)
+{
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+static force_inline __m128i
+reverse_epi8(__m128i v)
+{
+	v = reverse_epi16(v);
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+/*
+ * Each destination column is a source row (step_y = +-4), so load 4
+ * pixels from each of 4 source rows and transpose the 4x4 block in
+ * registers to produce 4 destination rows.
+ */
+static force_inline void
+transpose32(const uint8_t *src, uint8_t *dst, int32_t dst_stride,
+	    int width, int height, intptr_t step_x, intptr_t step_y,
+	    const bool reverse)
+{
+	const intptr_t lo = reverse ? 3 * step_y : 0;
+	int tx, ty, x, y;
+
+	for (ty = 0; ty < height; ty += ROTATE_TILE) {
+		int th = min(ROTATE_TILE, height - ty);
+		for (tx = 0; tx < width; tx += ROTATE_TILE) {
+			int tw = min(ROTATE_TILE, width - tx);
+			for (y = ty; y < ty + th; y += 4) {
+				const uint8_t *s = src + y * step_y + tx * step_x + lo;
+				uint8_t *d = dst + y * dst_stride + tx * 4;
+
+				for (x = 0; x < tw; x += 4) {
+					__m128i v0, v1, v2, v3, t0, t1, t2, t3;
+
+					v0 = _mm_loadu_si128((const __m128i *)s); s += step_x;
+					v1 = _mm_loadu_si128((const __m128i *)s); s += step_x;
+					v2 = _mm_loadu_si128((const __m128i *)s); s += step_x;
+					v3 = _mm_loadu_si128((const __m128i *)s); s += step_x;
+					if (reverse) {
+						v0 = reverse_epi32(v0);
+						v1 = reverse_epi32(v1);
+						v2 = reverse_epi32(v2);
+						v3 = reverse_epi32(v3);
+					}
+
+					t0 = _mm_unpacklo_epi32(v0, v1);
+					t1 = _mm_unpacklo_epi32(v2, v3);
+					t2 = _mm_unpackhi_epi32(v0, v1);
+					t3 = _mm_unpackhi_epi32(v2, v3);
+
+					_mm_storeu_si128((__m128i *)(d + 0 * dst_stride),
+							 _mm_unpacklo_epi64(t0, t1));
+					_mm_storeu_si128((__m128i *)(d + 1 * dst_stride),
+							 _mm_unpackhi_epi64(t0, t1));
+					_mm_storeu_si128((__m128i *)(d + 2 * dst_stride),
+							 _mm_unpacklo_epi64(t2, t3));
+					_mm_storeu_si128((__m128i *)(d + 3 * dst_stride),
+							 _mm_unpackhi_epi64(t2, t3));
+					d += 16;
+				}
+			}
+		}
+	}
+}
+
+/* As transpose32, but for 16bpp using 8x8 blocks */
+static force_inline void
+transpose16(const uint8_t *src, uint8_t *dst, int32_t dst_stride,
+	    int width, int height, intptr_t step_x, intptr_t step_y,
+	    const bool reverse)
+{
+	const intptr_t lo = reverse ? 7 * step_y : 0;
+	int tx, ty, x, y, i;
+
+	for (ty = 0; ty < height; ty += ROTATE_TILE) {
+		int th = min(ROTATE_TILE, height - ty);
+		for (tx = 0; tx < width; tx += ROTATE_TILE) {
+			int tw = min(ROTATE_TILE, width - tx);
+			for (y = ty; y < ty + th; y += 8) {
+				const uint8_t *s = src + y * step_y + tx * step_x + lo;
+				uint8_t *d = dst + y * dst_stride + tx * 2;
+
+				for (x = 0; x < tw; x += 8) {
+					__m128i v[8], t[8], u[8];
+
+					for (i = 0; i < 8; i++) {
+						v[i] = _mm_loadu_si128((const __m128i *)s);
+						if (reverse)
+							v[i] = reverse_epi16(v[i]);
+						s += step_x;
+					}
+
+					for (i = 0; i < 4; i++) {
+						t[2*i + 0] = _mm_unpacklo_epi16(v[2*i], v[2*i + 1]);
+						t[2*i + 1] = _mm_unpackhi_epi16(v[2*i], v[2*i + 1]);
+					}
+
+					u[0] = _mm_unpacklo_epi32(t[0], t[2]);
+					u[1] = _mm_unpackhi_epi32(t[0], t[2]);
+					u[2] = _mm_unpacklo_epi32(t[1], t[3]);
+					u[3] = _mm_unpackhi_epi32(t[1], t[3]);
+					u[4] = _mm_unpacklo_epi32(t[4], t[6]);
+					u[5] = _mm_unpackhi_epi32(t[4], t[6]);
+					u[6] = _mm_unpacklo_epi32(t[5], t[7]);
+					u[7] = _mm_unpackhi_epi32(t[5], t[7]);
+
+					for (i = 0; i < 4; i++) {
+						_mm_storeu_si128((__m128i *)(d + (2*i + 0) * dst_stride),
+								 _mm_unpacklo_epi64(u[i], u[i + 4]));
+						_mm_storeu_si128((__m128i *)(d + (2*i + 1) * dst_stride),
+								 _mm_unpackhi_epi64(u[i], u[i + 4]));
+					}
+					d += 16;
+				}
+			}
+		}
+	}
+}
+
+/*
+ * As transpose32, but for 8bpp (video planes) using 16x16 blocks. Each
+ * round interleaves rows i and i+8 bytewise, which rotates the 4 bits
+ * of row and 4 bits of column index of every byte by one; after four
+ * rounds rows and columns have swapped.
+ */
+static force_inline void
+transpose8(const uint8_t *src, uint8_t *dst, int32_t dst_stride,
+	   int width, int height, intptr_t step_x, intptr_t step_y,
+	   const bool reverse)
+{
+	const intptr_t lo = reverse ? 15 * step_y : 0;
+	int tx, ty, x, y, i, n;
+
+	for (ty = 0; ty < height; ty += ROTATE_TILE) {
+		int th = min(ROTATE_TILE, height - ty);
+		for (tx = 0; tx < width; tx += ROTATE_TILE) {
+			int tw = min(ROTATE_TILE, width - tx);
+			for (y = ty; y < ty + th; y += 16) {
+				const uint8_t *s = src + y * step_y + tx * step_x + lo;
+				uint8_t *d = dst + y * dst_stride + tx;
+
+				for (x = 0; x < tw; x += 16) {
+					__m128i v[16], t[16];
+
+					for (i = 0; i < 16; i++) {
+						v[i] = _mm_loadu_si128((const __m128i *)s);
+						if (reverse)
+							v[i] = reverse_epi8(v[i]);
+						s += step_x;
+					}
+
+					for (n = 0; n < 4; n++) {
+						for (i = 0; i < 8; i++) {
+							t[2*i + 0] = _mm_unpacklo_epi8(v[i], v[i + 8]);
+							t[2*i + 1] = _mm_unpackhi_epi8(v[i], v[i + 8]);
+						}
+						for (i = 0; i < 16; i++)
+							v[i] = t[i];
+					}
+
+					for (i = 0; i < 16; i++)
+						_mm_storeu_si128((__m128i *)(d + i * dst_stride), v[i]);
+					d += 16;
+				}
+			}
+		}
+	}
+}
+
+/* Mirrored rows (step_x = -4), reversing 4 pixels at a time */
+static void
+reverse32(const uint8_t *src, uint8_t *dst, int32_t dst_stride,
+	  int width, int height, intptr_t step_y)
+{
+	int x, y;
+
+	for (y = 0; y < height; y++) {
+		const uint8_t *s = src + y * step_y - 12;
+		uint8_t *d = dst + y * dst_stride;
+
+		for (x = 0; x + 4 <= width; x += 4) {
+			_mm_storeu_si128((__m128i *)d,
+					 reverse_epi32(_mm_loadu_si128((const __m128i *)s)));
+			s -= 16;
+			d += 16;
+		}
+		s += 12;
+		for (; x < width; x++) {
+			*(uint32_t *)d = *(const uint32_t *)s;
+			s -= 4;
+			d += 4;
+		}
+	}
+}
+
+static void
+rotate_blt__sse2(const void *src, void *dst, int bpp,
+		 int32_t src_stride, int32_t dst_stride,
+		 int16_t src_x, int16_t src_y,
+		 int16_t dst_x, int16_t dst_y,
+		 uint16_t width, uint16_t height,
+		 const int step[4])
+{
+	const int cpp = bpp / 8;
+	const uint8_t *s = (const uint8_t *)src + src_y * src_stride + src_x * cpp;
+	uint8_t *d = (uint8_t *)dst + dst_y * dst_stride + dst_x * cpp;
+	intptr_t step_x = step[0] * cpp + step[1] * src_stride;
+	intptr_t step_y = step[2] * cpp + step[3] * src_stride;
+	int block, w, h;
+
+	if (cpp == 4 && step_x == -4) {
+		reverse32(s, d, dst_stride, width, height, step_y);
+		return;
+	}
+
+	if (cpp == 3 || (step_y != cpp && step_y != -cpp)) {
+		rotate_rect__generic(s, d, cpp, dst_stride,
+				     width, height, step_x, step_y);
+		return;
+	}
+
+	block = 16 / cpp;
+	w = width & -block;
+	h = height & -block;
+	if (w && h) {
+		if (cpp == 4) {
+			if (step_y < 0)
+				transpose32(s, d, dst_stride, w, h, step_x, step_y, true);
+			else
+				transpose32(s, d, dst_stride, w, h, step_x, step_y, false);
+		} else if (cpp == 2) {
+			if (step_y < 0)
+				transpose16(s, d, dst_stride, w, h, step_x, step_y, true);
+			else
+				transpose16(s, d, dst_stride, w, h, step_x, step_y, false);
+		} else {
+			if (step_y < 0)
+				transpose8(s, d, dst_stride, w, h, step_x, step_y, true);
+			else
+				transpose8(s, d, dst_stride, w, h, step_x, step_y, false);
+		}
+	} else
+		w = h = 0;
+
+	/* and the ragged right and bottom edges */
+	if (w < width)
+		rotate_rect__generic(s + w * step_x, d + w * cpp,
+				     cpp, dst_stride, width - w, height,
+				     step_x, step_y);
+	if (h < height && w)
+		rotate_rect__generic(s + h * step_y, d + h * dst_stride,
+				     cpp, dst_stride, w, height - h,
+				     step_x, step_y);
+}
+
+static force_inline void
+transpose4x4_epi32(__m128i v[4])
+{
+	__m128i t0, t1, t2, t3;
+
+	t0 = _mm_unpacklo_epi32(v[0], v[1]);
+	t1 = _mm_unpacklo_epi32(v[2], v[3]);
+	t2 = _mm_unpackhi_epi32(v[0], v[1]);
+	t3 = _mm_unpackhi_epi32(v[2], v[3]);
+
+	v[0] = _mm_unpacklo_epi64(t0, t1);
+	v[1] = _mm_unpackhi_epi64(t0, t1);
+	v[2] = _mm_unpacklo_epi64(t2, t3);
+	v[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+/*
+ * As yuy2_90() and yuy2_270() on 4 blocks at once, then transpose 4x4
+ * blocks of the resulting p and q so that each register holds 4
+ * consecutive destination macropixels.
+ */
+static void
+rotate_yuy2__sse2(const void *src, void *dst,
+		  int32_t src_stride, int32_t dst_stride,
+		  uint16_t width, uint16_t height, int angle)
+{
+	const __m128i m_ff00ffff = _mm_set1_epi32(0xff00ffff);
+	const __m128i m_00ff0000 = _mm_set1_epi32(0x00ff0000);
+	const __m128i m_000000ff = _mm_set1_epi32(0x000000ff);
+	const __m128i m_ffffff00 = _mm_set1_epi32(0xffffff00);
+	const __m128i m_ff00ff00 = _mm_set1_epi32(0xff00ff00);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	int bw = width / 2, bh = height / 2;
+	int w = bw & -4, h = bh & -4;
+	int tx, ty, x, y, i;
+
+	for (ty = 0; ty < h; ty += ROTATE_TILE) {
+		int th = min(ROTATE_TILE, h - ty);
+		for (tx = 0; tx < w; tx += ROTATE_TILE) {
+			int tw = min(ROTATE_TILE, w - tx);
+			for (y = ty; y < ty + th; y += 4) {
+				for (x = tx; x < tx + tw; x += 4) {
+					__m128i p[4], q[4];
+
+					for (i = 0; i < 4; i++) {
+						const uint8_t *row = s + 2 * (y + i) * src_stride + 4 * x;
+						__m128i a = _mm_loadu_si128((const __m128i *)row);
+						__m128i b = _mm_loadu_si128((const __m128i *)(row + src_stride));
+
+						if (angle == 90) {
+							p[i] = _mm_or_si128(_mm_and_si128(a, m_ff00ffff),
+									    _mm_and_si128(_mm_slli_epi32(b, 16), m_00ff0000));
+							q[i] = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(a, 16), m_000000ff),
+									    _mm_and_si128(b, m_ffffff00));
+						} else {
+							p[i] = _mm_or_si128(_mm_or_si128(_mm_and_si128(b, m_000000ff),
+											 _mm_and_si128(a, m_ff00ff00)),
+									    _mm_and_si128(_mm_slli_epi32(a, 16), m_00ff0000));
+							q[i] = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(b, 16), m_000000ff),
+											 _mm_and_si128(b, m_ff00ff00)),
+									    _mm_and_si128(a, m_00ff0000));
+						}
+					}
+
+					transpose4x4_epi32(p);
+					transpose4x4_epi32(q);
+
+					for (i = 0; i < 4; i++) {
+						if (angle == 90) {
+							uint8_t *row = d + 4 * y;
+							_mm_storeu_si128((__m128i *)(row + (width - 1 - 2 * (x + i)) * dst_stride), p[i]);
+							_mm_storeu_si128((__m128i *)(row + (width - 2 - 2 * (x + i)) * dst_stride), q[i]);
+						} else {
+							uint8_t *row = d + 4 * (bh - 4 - y);
+							_mm_storeu_si128((__m128i *)(row + (2 * (x + i) + 0) * dst_stride), reverse_epi32(p[i]));
+							_mm_storeu_si128((__m128i *)(row + (2 * (x + i) + 1) * dst_stride), reverse_epi32(q[i]));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/* and the ragged right and bottom edges */
+	if (w < bw)
+		rotate_yuy2_blocks(s, d, src_stride, dst_stride,
+				   width, height, angle,
+				   w, 0, bw, bh);
+	if (h < bh && w)
+		rotate_yuy2_blocks(s, d, src_stride, dst_stride,
+				   width, height, angle,
+				   0, h, w, bh);
+}
+
+#pragma GCC pop_options
+#endif
+
+void (*rotate_yuy2)(const void *src, void *dst,
+		    int32_t src_stride, int32_t dst_stride,
+		    uint16_t width, uint16_t height, int angle) = rotate_yuy2__generic;
+
+void (*rotate_blt)(const void *src, void *dst, int bpp,
+		   int32_t src_stride, int32_t dst_stride,
+		   int16_t src_x, int16_t src_y,
+		   int16_t dst_x, int16_t dst_y,
+		   uint16_t width, uint16_t height,
+		   const int step[4]) = rotate_blt__generic;
+
+static bool to_unit(double v, int *out)
+{
+	if (v == 0.)
+		*out = 0;
+	else if (v == 1.)
+		*out = 1;
+	else if (v == -1.)
+		*out = -1;
+	else
+		return false;
+
+	return true;
+}
+
+/* Map the centre of a destination pixel onto the centre of a source pixel */
+static bool to_pixel(const double *row, int x, int y, int *out)
+{
+	double v = row[0] * (x + .5) + row[1] * (y + .5) + row[2];
+	double f = floor(v);
+
+	if (fabs(v - f - .5) > 1e-6)
+		return false;
+
+	*out = f;
+	return true;
+}
+
+bool rotate_blt_transform(const double m[3][3], int dst_x, int dst_y,
+			  int *src_x, int *src_y, int step[4])
+{
+	if (m[2][0] != 0. || m[2][1] != 0. || m[2][2] != 1.)
+		return false;
+
+	if (!to_unit(m[0][0], &step[0]) ||
+	    !to_unit(m[1][0], &step[1]) ||
+	    !to_unit(m[0][1], &step[2]) ||
+	    !to_unit(m[1][1], &step[3]))
+		return false;
+
+	/* one source axis for each destination axis, no shears */
+	if ((step[0] == 0) == (step[1] == 0) ||
+	    (step[2] == 0) == (step[3] == 0) ||
+	    (step[0] == 0) != (step[3] == 0))
+		return false;
+
+	return (to_pixel(m[0], dst_x, dst_y, src_x) &&
+		to_pixel(m[1], dst_x, dst_y, src_y));
+}
+
+/* Restrict [*start, *start + *len) so that 0 <= s + u*i < size */
+static bool clip_span(int size, int s, int u, int *start, int *len)
+{
+	int lo = 0, hi = *len;
+
+	if (u > 0) {
+		if (s < 0)
+			lo = -s;
+		if (s + hi > size)
+			hi = size - s;
+	} else {
+		if (s >= size)
+			lo = s - size + 1;
+		if (s - hi < -1)
+			hi = s + 1;
+	}
+	if (lo >= hi)
+		return false;
+
+	*start += lo;
+	*len = hi - lo;
+	return true;
+}
+
+bool rotate_blt_clip(int src_width, int src_height,
+		     int *src_x, int *src_y, const int step[4],
+		     int *dst_x, int *dst_y, int *width, int *height)
+{
+	int x = 0, y = 0;
+
+	if (step[0]) {
+		/* source x follows dst x, source y follows dst y */
+		if (!clip_span(src_width, *src_x, step[0], &x, width) ||
+		    !clip_span(src_height, *src_y, step[3], &y, height))
+			return false;
+	} else {
+		if (!clip_span(src_height, *src_y, step[1], &x, width) ||
+		    !clip_span(src_width, *src_x, step[2], &y, height))
+			return false;
+	}
+
+	*src_x += step[0] * x + step[2] * y;
+	*src_y += step[1] * x + step[3] * y;
+	*dst_x += x;
+	*dst_y += y;
+	return true;
+}
+
+void rotate_blt_init(unsigned flags)
+{
+	rotate_blt = rotate_blt__generic;
+	rotate_yuy2 = rotate_yuy2__generic;
+	rotate_name = "generic";
+
+#if defined(sse2)
+	if (flags & ROTATE_SSE2) {
+		rotate_blt = rotate_blt__sse2;
+		rotate_yuy2 = rotate_yuy2__sse2;
+		rotate_name = "sse2";
+		return;
+	}
+#endif
+	(void)flags;
+}
+
+const char *rotate_blt_name(void)
+{
+	return rotate_name;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ROTATE_H
+#define ROTATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * CPU copies under the 8 orientations of RandR, i.e. rotation by a
+ * multiple of 90 degrees with an optional reflection, and a whole pixel
+ * translation. These are exact, so we can bypass the generic transformed
+ * composite (which samples every pixel through the full matrix) and copy
+ * the pixels directly, transposing in cache-sized tiles.
+ *
+ * The mapping is given as the source pixel for the first destination
+ * pixel, and the steps in source pixels taken for each step along the
+ * destination, step[] = { ux, uy, vx, vy } so that
+ *   dst(dst_x + i, dst_y + j) = src(src_x + ux*i + vx*j, src_y + uy*i + vy*j)
+ */
+
+#define ROTATE_SSE2 0x1
+
+/* Edge of the square tiles (in pixels) that we transpose at a time */
+#define ROTATE_TILE 32
+
+extern void (*rotate_blt)(const void *src, void *dst, int bpp,
+			  int32_t src_stride, int32_t dst_stride,
+			  int16_t src_x, int16_t src_y,
+			  int16_t dst_x, int16_t dst_y,
+			  uint16_t width, uint16_t height,
+			  const int step[4]);
+
+/*
+ * Rotate packed 4:2:2 video (two pixels to each 32-bit Y0 C0 Y1 C1
+ * macropixel, e.g. YUY2) by 90 or 270 degrees, as the Xv copies do.
+ * Luma is rotated per pixel, whereas chroma stays with its source row so
+ * that the two rows of a rotated macropixel take the chroma of the two
+ * source rows it came from. width and height are the (even) size of the
+ * source in pixels.
+ */
+extern void (*rotate_yuy2)(const void *src, void *dst,
+			   int32_t src_stride, int32_t dst_stride,
+			   uint16_t width, uint16_t height, int angle);
+
+/*
+ * Decompose the affine dst->src matrix (e.g. pixman_f_transform.m) into
+ * the source pixel for (dst_x, dst_y) and the steps. Returns false unless
+ * it is one of the orientations above, mapping whole pixels onto whole
+ * pixels.
+ */
+bool rotate_blt_transform(const double m[3][3], int dst_x, int dst_y,
+			  int *src_x, int *src_y, int step[4]);
+
+/*
+ * Shrink the destination rectangle to the pixels whose source lies
+ * within src_width x src_height, returning false if none do.
+ */
+bool rotate_blt_clip(int src_width, int src_height,
+		     int *src_x, int *src_y, const int step[4],
+		     int *dst_x, int *dst_y, int *width, int *height);
+
+/*
+ * The source origin and steps to rotate a whole width x height image
+ * anticlockwise by angle degrees (as RandR) into the top-left of the
+ * destination.
+ */
+static inline void rotate_blt_angle(int angle, int width, int height,
+				    int *src_x, int *src_y, int step[4])
+{
+	switch (angle) {
+	default:
+		*src_x = 0; *src_y = 0;
+		step[0] = 1; step[1] = 0; step[2] = 0; step[3] = 1;
+		break;
+	case 90:
+		*src_x = width - 1; *src_y = 0;
+		step[0] = 0; step[1] = 1; step[2] = -1; step[3] = 0;
+		break;
+	case 180:
+		*src_x = width - 1; *src_y = height - 1;
+		step[0] = -1; step[1] = 0; step[2] = 0; step[3] = -1;
+		break;
+	case 270:
+		*src_x = 0; *src_y = height - 1;
+		step[0] = 0; step[1] = -1; step[2] = 1; step[3] = 0;
+		break;
+	}
+}
+
+void rotate_blt_init(unsigned flags);
+const char *rotate_blt_name(void);
+
+#endif /* ROTATE_H */
@@ -101,6 +101,12 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "sna_damage.h"
 #include "sna_render.h"
 #include "fb/fb.h"
+#include "rotate.h"
+#include "sna_vblank_wheel.h"
+#include "sna_vblank_clock.h"
+#include "sna_trace.h"
+#include "sna_residency.h"
+#include "sna_damage_history.h"
 
 struct sna_cursor;
 struct sna_crtc;
@@ -136,6 +142,7 @@ struct sna_pixmap {
 
 	struct list flush_list;
 	struct list cow_list;
+	struct list upload_list;
 
 	uint32_t stride;
 	uint32_t clear_color;
@@ -159,6 +166,9 @@ struct sna_pixmap {
 	uint8_t clear :1;
 	uint8_t header :1;
 	uint8_t cpu :1;
+	uint8_t residency :2;
+
+	struct sna_access access;
 };
 
 #define IS_STATIC_PTR(ptr) ((uintptr_t)(ptr) & 1)
@@ -258,6 +268,9 @@ struct sna {
 #define SNA_HAS_FLIP		0x10000
 #define SNA_HAS_ASYNC_FLIP	0x20000
 #define SNA_LINEAR_FB		0x40000
+#define SNA_LATE_LATCH		0x80000
+#define SNA_ADAPTIVE		0x100000
+#define SNA_READBACK		0x200000
 #define SNA_REPROBE		0x80000000
 
 	unsigned cpu_features;
@@ -287,6 +300,7 @@ struct sna {
 
 	struct list flush_pixmaps;
 	struct list active_pixmaps;
+	struct list upload_pixmaps;
 
 	PixmapPtr front;
 	PixmapPtr freed_pixmap;
@@ -312,6 +326,12 @@ struct sna {
 		struct list shadow_crtc;
 		bool shadow_dirty;
 
+		/* Pixels repainted into per-CRTC TearFree buffers */
+		struct {
+			uint64_t pixels;
+			unsigned frames;
+		} redisplay;
+
 		unsigned num_real_crtc;
 		unsigned num_real_output;
 		unsigned num_real_encoder;
@@ -334,6 +354,7 @@ struct sna {
 		CursorPtr ref;
 
 		unsigned serial;
+		uint64_t hash;
 		uint32_t fg, bg;
 		int size;
 
@@ -347,7 +368,10 @@ struct sna {
 
 		int num_stash;
 		struct sna_cursor *stash;
+		unsigned num_cursors;
 		void *scratch;
+
+		unsigned converted, reused;
 	} cursor;
 
 	struct sna_dri2 {
@@ -377,6 +401,9 @@ struct sna {
 		bool available;
 		bool open;
 		struct list vblank_queue;
+		struct list fake;
+		OsTimerPtr fake_timer;
+		int fake_fd;
 		uint64_t unflip;
 		void *freed_info;
 	} present;
@@ -429,6 +456,47 @@ struct sna {
 
 	struct sna_render render;
 
+	/* Bytes moved by PutImage/GetImage, by the blitter or the CPU,
+	 * of Xv frames, copied by the CPU or sampled in place, and of
+	 * pixmaps migrating between their CPU and GPU copies, with the
+	 * upload boxes saved by coalescing and the uploads batched
+	 * from the block handler; and of whole pixmap copies replaced
+	 * by sharing the bo copy-on-write, against what was copied
+	 * after all once either side was written to; and read back
+	 * from the front ahead of GetImage, against what was served.
+	 */
+	struct {
+		uint64_t put_blt, put_cpu;
+		uint64_t get_blt, get_cpu;
+		uint64_t video_cpu, video_zero;
+		unsigned video_frames;
+		unsigned uploads, downloads;
+		uint64_t upload_bytes, download_bytes;
+		unsigned upload_boxes_saved, upload_batched;
+		unsigned cow_shared;
+		uint64_t cow_shared_bytes, cow_copied_bytes;
+		unsigned prefetch;
+		uint64_t prefetch_bytes, get_prefetch;
+	} xfer;
+
+	/* Copies of the front buffer read back ahead of GetImage */
+	struct sna_readback {
+		DamagePtr damage;
+		struct damage_history history;
+		BoxRec area;
+		uint32_t last_poll;
+		bool wanted; /* polled since the last copy was taken */
+		unsigned next;
+		struct {
+			struct kgem_bo *bo;
+			BoxRec box;
+			uint32_t serial;
+			uint32_t source;
+		} ring[3];
+	} readback;
+
+	struct sna_trace_ring *trace;
+
 #if DEBUG_MEMORY
 	struct {
 		int pixmap_allocs;
@@ -450,6 +518,8 @@ extern void sna_mode_enable(struct sna *sna);
 extern void sna_mode_reset(struct sna *sna);
 extern int sna_mode_wakeup(struct sna *sna);
 extern void sna_mode_redisplay(struct sna *sna);
+extern int sna_mode_flush_delay(struct sna *sna, int delay);
+extern void sna_mode_report_pacing(struct sna *sna);
 extern void sna_shadow_set_crtc(struct sna *sna, xf86CrtcPtr crtc, struct kgem_bo *bo);
 extern void sna_shadow_steal_crtcs(struct sna *sna, struct list *list);
 extern void sna_shadow_unsteal_crtcs(struct sna *sna, struct list *list);
@@ -549,6 +619,7 @@ const struct ust_msc {
 
 uint64_t sna_crtc_record_swap(xf86CrtcPtr crtc,
 			      int tv_sec, int tv_usec, unsigned seq);
+void sna_crtc_record_request(xf86CrtcPtr crtc);
 
 static inline uint64_t sna_crtc_record_vblank(xf86CrtcPtr crtc,
 					      const union drm_wait_vblank *vbl)
@@ -624,7 +695,8 @@ uint32_t sna_crtc_id(xf86CrtcPtr crtc);
 
 struct sna_crtc_public {
 	unsigned long flags;
-	struct list vblank_queue;
+	struct vblank_wheel vblank_queue;
+	struct vblank_clock fake_vblank;
 };
 
 static inline unsigned long *sna_crtc_flags(xf86CrtcPtr crtc)
@@ -634,13 +706,30 @@ static inline unsigned long *sna_crtc_flags(xf86CrtcPtr crtc)
 	return &pub->flags;
 }
 
-static inline struct list *sna_crtc_vblank_queue(xf86CrtcPtr crtc)
+static inline struct vblank_wheel *sna_crtc_vblank_queue(xf86CrtcPtr crtc)
 {
 	struct sna_crtc_public *pub = crtc->driver_private;
 	assert(pub);
 	return &pub->vblank_queue;
 }
 
+static inline struct vblank_clock *sna_crtc_fake_vblank(xf86CrtcPtr crtc)
+{
+	struct sna_crtc_public *pub = crtc->driver_private;
+	assert(pub);
+	return &pub->fake_vblank;
+}
+
+/* Our best guess at the current vblank when the CRTC cannot tell us */
+static inline uint64_t sna_crtc_fake_msc(xf86CrtcPtr crtc, uint64_t *ust)
+{
+	const struct vblank_clock *clock = sna_crtc_fake_vblank(crtc);
+	uint64_t msc = vblank_clock_msc(clock, vblank_clock_now());
+
+	*ust = vblank_clock_time(clock, msc) / 1000;
+	return msc;
+}
+
 static inline unsigned sna_crtc_pipe(xf86CrtcPtr crtc)
 {
 	return *sna_crtc_flags(crtc) >> 8 & 0xff;
@@ -791,6 +880,8 @@ static inline void sna_pixmap_unmap(PixmapPtr pixmap, struct sna_pixmap *priv)
 
 bool
 sna_pixmap_undo_cow(struct sna *sna, struct sna_pixmap *priv, unsigned flags);
+bool
+sna_pixmap_share_cow(struct sna *sna, PixmapPtr src, PixmapPtr dst);
 
 #define MOVE_WRITE 0x1
 #define MOVE_READ 0x2
@@ -838,6 +929,36 @@ sna_drawable_move_to_gpu(DrawablePtr drawable, unsigned flags)
 	return sna_pixmap_move_to_gpu(get_drawable_pixmap(drawable), flags) != NULL;
 }
 
+/* Feed the access history, and so priv->residency (sna_residency.h) */
+static inline void
+sna_pixmap_access(struct sna *sna, struct sna_pixmap *priv,
+		  unsigned side, bool writing, const BoxRec *box)
+{
+	unsigned residency;
+
+	if ((sna->flags & SNA_ADAPTIVE) == 0)
+		return;
+
+	sna_access_record(&priv->access, side, writing,
+			  (uint32_t)(box->x2 - box->x1) * (box->y2 - box->y1));
+	residency = sna_access_residency(&priv->access, priv->residency,
+					 (priv->create & KGEM_CAN_CREATE_LARGE) == 0);
+	if (residency != priv->residency) {
+		DBG(("%s: pixmap=%ld residency %d -> %d\n", __FUNCTION__,
+		     priv->pixmap->drawable.serialNumber,
+		     priv->residency, residency));
+		priv->residency = residency;
+	}
+
+	/* Both copies are wanted, so push the CPU writes across together
+	 * from the block handler, rather than one by one as the GPU
+	 * stumbles across them.
+	 */
+	if (side == ACCESS_CPU && writing &&
+	    priv->residency == RESIDENCY_MIRROR && !priv->shm)
+		list_move(&priv->upload_list, &sna->upload_pixmaps);
+}
+
 void sna_add_flush_pixmap(struct sna *sna,
 			  struct sna_pixmap *priv,
 			  struct kgem_bo *bo);
@@ -1324,6 +1445,36 @@ static inline void sna_acpi_wakeup(struct sna *sna, void *read_mask)
 }
 void sna_acpi_fini(struct sna *sna);
 
+/* sna_trace.c */
+void sna_trace_init(struct sna *sna);
+void __sna_trace(struct sna *sna, unsigned op, unsigned path, unsigned reason,
+		 PixmapPtr pixmap, const BoxRec *box, uint64_t bytes);
+static inline bool sna_trace_enabled(struct sna *sna)
+{
+	return unlikely(sna->trace && sna->trace->enabled);
+}
+static inline void sna_trace(struct sna *sna,
+			     unsigned op, unsigned path, unsigned reason,
+			     PixmapPtr pixmap, const BoxRec *box,
+			     uint64_t bytes)
+{
+	if (sna_trace_enabled(sna))
+		__sna_trace(sna, op, path, reason, pixmap, box, bytes);
+}
+static inline unsigned sna_trace_engine(struct sna *sna)
+{
+	return sna->kgem.ring == KGEM_BLT ? SNA_TRACE_BLT : SNA_TRACE_RENDER;
+}
+void sna_trace_fini(struct sna *sna);
+
+/* sna_readback.c */
+void sna_readback_init(struct sna *sna);
+bool sna_readback_get_image(struct sna *sna, PixmapPtr pixmap,
+			    const BoxRec *box, char *dst);
+void sna_readback_prefetch(struct sna *sna);
+void sna_readback_reset(struct sna *sna);
+void sna_readback_fini(struct sna *sna);
+
 void sna_threads_init(void);
 int sna_use_threads (int width, int height, int threshold);
 void sna_threads_run(int id, void (*func)(void *arg), void *arg);
@@ -1343,6 +1494,15 @@ void sna_image_composite(pixman_op_t        op,
 			 int16_t            dst_y,
 			 uint16_t           width,
 			 uint16_t           height);
+void sna_rotate_blt(const void *src, void *dst, int bpp,
+		    int32_t src_stride, int32_t dst_stride,
+		    int16_t src_x, int16_t src_y,
+		    int16_t dst_x, int16_t dst_y,
+		    uint16_t width, uint16_t height,
+		    const int step[4]);
+void sna_rotate_yuy2(const void *src, void *dst,
+		     int32_t src_stride, int32_t dst_stride,
+		     uint16_t width, uint16_t height, int angle);
 
 extern sigjmp_buf sigjmp_buffer[4];
 extern volatile sig_atomic_t sigtrap;
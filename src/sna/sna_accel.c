@@ -29,6 +29,8 @@
 #include "sna.h"
 #include "sna_reg.h"
 #include "sna_video.h"
+#include "sna_coalesce.h"
+#include "sna_cow_split.h"
 #include "rop.h"
 
 #include "intel_options.h"
@@ -41,6 +43,8 @@
 #include <mi.h>
 #include <migc.h>
 #include <miline.h>
+#include <mizerarc.h>
+#include <mifillarc.h>
 #include <micmap.h>
 #ifdef RENDER
 #include <mipict.h>
@@ -82,6 +86,7 @@
 #define DBG_NO_PARTIAL_MOVE_TO_CPU 0
 #define DBG_NO_CPU_UPLOAD 0
 #define DBG_NO_CPU_DOWNLOAD 0
+#define DBG_NO_UPLOAD_COALESCE 0
 
 #define ACCEL_FILL_SPANS 1
 #define ACCEL_SET_SPANS 1
@@ -673,6 +678,7 @@ _sna_pixmap_init(struct sna_pixmap *priv, PixmapPtr pixmap)
 {
 	list_init(&priv->flush_list);
 	list_init(&priv->cow_list);
+	list_init(&priv->upload_list);
 	priv->source_count = SOURCE_BIAS;
 	priv->pixmap = pixmap;
 
@@ -1448,6 +1454,7 @@ static Bool sna_destroy_pixmap(PixmapPtr pixmap)
 	sna_damage_destroy(&priv->cpu_damage);
 
 	list_del(&priv->cow_list);
+	list_del(&priv->upload_list);
 	if (priv->cow) {
 		struct sna_cow *cow = COW(priv->cow);
 		DBG(("%s: pixmap=%ld discarding cow, refcnt=%d\n",
@@ -1611,6 +1618,16 @@ static inline bool pixmap_inplace(struct sna *sna,
 		return false;
 	}
 
+	switch (priv->residency) {
+	case RESIDENCY_GPU:
+		DBG(("%s: yes, recently used mostly by the GPU\n", __FUNCTION__));
+		return true;
+	case RESIDENCY_CPU:
+	case RESIDENCY_MIRROR:
+		DBG(("%s: no, recent use wants a copy in system memory\n", __FUNCTION__));
+		return false;
+	}
+
 	return (priv->stride * pixmap->drawable.height >> 12) >
 		sna->kgem.half_cpu_cache_pages;
 }
@@ -1795,17 +1812,51 @@ static inline bool cpu_bo_download(struct sna *sna,
 				      box, n, COPY_LAST);
 }
 
+/* Count every migration, and describe it to the tracer if attached */
+static void trace_migrate(struct sna *sna, unsigned op, bool gpu,
+			  PixmapPtr pixmap, const BoxRec *box, int n)
+{
+	BoxRec extents = *box;
+	uint64_t bytes = 0;
+
+	do {
+		if (box->x1 < extents.x1)
+			extents.x1 = box->x1;
+		if (box->x2 > extents.x2)
+			extents.x2 = box->x2;
+		if (box->y1 < extents.y1)
+			extents.y1 = box->y1;
+		if (box->y2 > extents.y2)
+			extents.y2 = box->y2;
+		bytes += (box->x2 - box->x1) * (box->y2 - box->y1);
+		box++;
+	} while (--n);
+	bytes = bytes * pixmap->drawable.bitsPerPixel >> 3;
+
+	if (op == SNA_TRACE_UPLOAD) {
+		sna->xfer.uploads++;
+		sna->xfer.upload_bytes += bytes;
+	} else {
+		sna->xfer.downloads++;
+		sna->xfer.download_bytes += bytes;
+	}
+
+	if (sna_trace_enabled(sna))
+		__sna_trace(sna, op, gpu ? sna_trace_engine(sna) : SNA_TRACE_CPU,
+			    SNA_TRACE_NONE, pixmap, &extents, bytes);
+}
+
 static void download_boxes(struct sna *sna,
 			   struct sna_pixmap *priv,
 			   int n, const BoxRec *box)
 {
-	bool ok;
+	bool ok, gpu = false;
 
 	DBG(("%s: nbox=%d\n", __FUNCTION__, n));
 
 	ok = gpu_bo_download(sna, priv, n, box, true);
 	if (!ok)
-		ok = cpu_bo_download(sna, priv, n, box);
+		ok = gpu = cpu_bo_download(sna, priv, n, box);
 	if (!ok)
 		ok = gpu_bo_download(sna, priv, n, box, false);
 	if (!ok) {
@@ -1815,6 +1866,8 @@ static void download_boxes(struct sna *sna,
 		assert(has_coherent_ptr(sna, priv, MOVE_WRITE));
 		sna_read_boxes(sna, priv->pixmap, priv->gpu_bo, box, n);
 	}
+
+	trace_migrate(sna, SNA_TRACE_DOWNLOAD, gpu, priv->pixmap, box, n);
 }
 
 static inline bool use_cpu_bo_for_upload(struct sna *sna,
@@ -1847,18 +1900,81 @@ static inline bool use_cpu_bo_for_upload(struct sna *sna,
 	return kgem_bo_is_busy(priv->gpu_bo) || kgem_bo_is_busy(priv->cpu_bo);
 }
 
-bool
-sna_pixmap_undo_cow(struct sna *sna, struct sna_pixmap *priv, unsigned flags)
+static bool coalesce_allow(void *closure, const BoxRec *box)
+{
+	struct sna_damage **damage = closure;
+
+	/* Outside of the GPU damage, the CPU copy is at least as new */
+	return sna_damage_contains_box(damage, box) == PIXMAN_REGION_OUT;
+}
+
+/* Merge the damage boxes to be uploaded into fewer, larger boxes, the
+ * result pointing into either stack[] or a fresh allocation.
+ */
+static int upload_coalesce(struct sna *sna, struct sna_pixmap *priv,
+			   const BoxRec **box, int n,
+			   BoxRec *stack, int size)
+{
+	BoxRec *out;
+	int count;
+
+	if (DBG_NO_UPLOAD_COALESCE || n <= 1)
+		return n;
+
+	out = stack;
+	if (n > size) {
+		out = malloc(n * sizeof(BoxRec));
+		if (out == NULL)
+			return n;
+	}
+
+	count = box_coalesce(*box, n, out,
+			     priv->gpu_damage ? coalesce_allow : NULL,
+			     &priv->gpu_damage);
+	DBG(("%s: pixmap=%ld, %d boxes coalesced into %d\n", __FUNCTION__,
+	     priv->pixmap->drawable.serialNumber, n, count));
+
+	sna->xfer.upload_boxes_saved += n - count;
+	*box = out;
+	return count;
+}
+
+static void upload_coalesce_fini(const BoxRec *box,
+				 const BoxRec *orig,
+				 const BoxRec *stack)
+{
+	if (box != orig && box != stack)
+		free((void *)box);
+}
+
+static uint64_t cow_bytes(PixmapPtr pixmap, const BoxRec *box, int n)
+{
+	uint64_t bytes = 0;
+
+	while (n--) {
+		bytes += (box->x2 - box->x1) * (box->y2 - box->y1);
+		box++;
+	}
+
+	return bytes * pixmap->drawable.bitsPerPixel >> 3;
+}
+
+/* Decouple from the shared bo; if the caller is about to overwrite the
+ * write box, only the remainder of the pixmap needs to be copied.
+ */
+static bool
+__sna_pixmap_undo_cow(struct sna *sna, struct sna_pixmap *priv,
+		      unsigned flags, const BoxRec *write)
 {
 	struct sna_cow *cow = COW(priv->cow);
 
-	DBG(("%s: pixmap=%ld, handle=%d [refcnt=%d], cow refcnt=%d, flags=%x\n",
+	DBG(("%s: pixmap=%ld, handle=%d [refcnt=%d], cow refcnt=%d, flags=%x, write=%d\n",
 	     __FUNCTION__,
 	     priv->pixmap->drawable.serialNumber,
 	     priv->gpu_bo->handle,
 	     priv->gpu_bo->refcnt,
 	     cow->refcnt,
-	     flags));
+	     flags, write != NULL));
 
 	assert(priv->gpu_bo == cow->bo);
 	assert(cow->refcnt);
@@ -1907,6 +2023,8 @@ sna_pixmap_undo_cow(struct sna *sna, struct sna_pixmap *priv, unsigned flags)
 			return false;
 		}
 
+		sna->xfer.cow_copied_bytes += cow_bytes(pixmap, &box, 1);
+
 		assert(!list_is_empty(&cow->list));
 		while (!list_is_empty(&cow->list)) {
 			struct sna_pixmap *clone;
@@ -1928,7 +2046,8 @@ sna_pixmap_undo_cow(struct sna *sna, struct sna_pixmap *priv, unsigned flags)
 		if (flags & MOVE_READ) {
 			PixmapPtr pixmap = priv->pixmap;
 			unsigned create, tiling;
-			BoxRec box;
+			BoxRec box, split[4], *copy = &box;
+			int n = 1;
 
 			DBG(("%s: copying cow\n", __FUNCTION__));
 
@@ -1954,15 +2073,35 @@ sna_pixmap_undo_cow(struct sna *sna, struct sna_pixmap *priv, unsigned flags)
 				return false;
 			}
 
-			if (!sna->render.copy_boxes(sna, GXcopy,
+			if (write) {
+				int tile_width, tile_height, tile_size;
+
+				kgem_get_tile_size(&sna->kgem, bo->tiling, bo->pitch,
+						   &tile_width, &tile_height, &tile_size);
+				tile_width = tile_width * 8 / pixmap->drawable.bitsPerPixel;
+				if (tile_width == 0)
+					tile_width = 1;
+
+				n = cow_split(write, box.x2, box.y2,
+					      tile_width, tile_height, split);
+				copy = split;
+				DBG(("%s: skipping write (%d, %d), (%d, %d), copying %d boxes\n",
+				     __FUNCTION__,
+				     write->x1, write->y1, write->x2, write->y2, n));
+			}
+
+			if (n &&
+			    !sna->render.copy_boxes(sna, GXcopy,
 						    &pixmap->drawable, priv->gpu_bo, 0, 0,
 						    &pixmap->drawable, bo, 0, 0,
-						    &box, 1, 0)) {
+						    copy, n, 0)) {
 				DBG(("%s: copy failed\n", __FUNCTION__));
 				kgem_bo_destroy(&sna->kgem, bo);
 				cow->refcnt++;
 				return false;
 			}
+
+			sna->xfer.cow_copied_bytes += cow_bytes(pixmap, copy, n);
 		}
 
 		assert(priv->gpu_bo);
@@ -1975,6 +2114,12 @@ sna_pixmap_undo_cow(struct sna *sna, struct sna_pixmap *priv, unsigned flags)
 	return true;
 }
 
+bool
+sna_pixmap_undo_cow(struct sna *sna, struct sna_pixmap *priv, unsigned flags)
+{
+	return __sna_pixmap_undo_cow(sna, priv, flags, NULL);
+}
+
 static bool
 sna_pixmap_make_cow(struct sna *sna,
 		    struct sna_pixmap *src_priv,
@@ -2055,6 +2200,64 @@ sna_pixmap_make_cow(struct sna *sna,
 	     src_priv->pixmap->drawable.serialNumber,
 	     cow->bo->handle));
 
+	sna->xfer.cow_shared++;
+	sna->xfer.cow_shared_bytes +=
+		(uint64_t)dst_priv->pixmap->drawable.height *
+		dst_priv->pixmap->drawable.width *
+		dst_priv->pixmap->drawable.bitsPerPixel >> 3;
+
+	return true;
+}
+
+bool
+sna_pixmap_share_cow(struct sna *sna, PixmapPtr src, PixmapPtr dst)
+{
+	struct sna_pixmap *src_priv = sna_pixmap(src);
+	struct sna_pixmap *dst_priv = sna_pixmap(dst);
+
+	if (src_priv == NULL || dst_priv == NULL)
+		return false;
+
+	if (src->drawable.width != dst->drawable.width ||
+	    src->drawable.height != dst->drawable.height ||
+	    src->drawable.depth != dst->drawable.depth ||
+	    src->drawable.bitsPerPixel != dst->drawable.bitsPerPixel) {
+		DBG(("%s: no, mismatching formats\n", __FUNCTION__));
+		return false;
+	}
+
+	/* Only worth sharing if the source is already complete on the GPU */
+	if (src_priv->gpu_bo == NULL ||
+	    src_priv->cpu_damage ||
+	    src_priv->move_to_gpu) {
+		DBG(("%s: no, source not on the GPU\n", __FUNCTION__));
+		return false;
+	}
+
+	if (dst_priv->pinned || dst_priv->flush || dst_priv->move_to_gpu) {
+		DBG(("%s: no, destination is pinned=%x or exported=%x\n",
+		     __FUNCTION__, dst_priv->pinned, dst_priv->flush));
+		return false;
+	}
+
+	if (dst_priv->cow == NULL || COW(dst_priv->cow) != COW(src_priv->cow)) {
+		if (dst_priv->cow && !sna_pixmap_undo_cow(sna, dst_priv, 0))
+			return false;
+
+		if (UNDO)
+			kgem_bo_pair_undo(&sna->kgem, dst_priv->gpu_bo, dst_priv->cpu_bo);
+
+		if (!sna_pixmap_make_cow(sna, src_priv, dst_priv))
+			return false;
+	}
+
+	assert(dst_priv->gpu_bo == src_priv->gpu_bo);
+	sna_damage_all(&dst_priv->gpu_damage, dst);
+	sna_damage_destroy(&dst_priv->cpu_damage);
+	list_del(&dst_priv->flush_list);
+	add_shm_flush(sna, dst_priv);
+	dst_priv->clear = false;
+	dst_priv->cpu = false;
 	return true;
 }
 
@@ -2114,8 +2317,8 @@ static inline bool operate_inplace(struct sna_pixmap *priv, unsigned flags)
 	return true;
 }
 
-bool
-_sna_pixmap_move_to_cpu(PixmapPtr pixmap, unsigned int flags)
+static bool
+__sna_pixmap_move_to_cpu(PixmapPtr pixmap, unsigned int flags)
 {
 	struct sna *sna = to_sna_from_pixmap(pixmap);
 	struct sna_pixmap *priv;
@@ -2460,6 +2663,24 @@ skip:
 	return true;
 }
 
+bool
+_sna_pixmap_move_to_cpu(PixmapPtr pixmap, unsigned int flags)
+{
+	struct sna_pixmap *priv = sna_pixmap(pixmap);
+
+	if (priv) {
+		BoxRec box;
+
+		box.x1 = box.y1 = 0;
+		box.x2 = pixmap->drawable.width;
+		box.y2 = pixmap->drawable.height;
+		sna_pixmap_access(to_sna_from_pixmap(pixmap), priv,
+				  ACCESS_CPU, flags & MOVE_WRITE, &box);
+	}
+
+	return __sna_pixmap_move_to_cpu(pixmap, flags);
+}
+
 static bool
 region_overlaps_damage(const RegionRec *region,
 		       struct sna_damage *damage,
@@ -2530,6 +2751,16 @@ static inline bool region_inplace(struct sna *sna,
 		return true;
 	}
 
+	switch (priv->residency) {
+	case RESIDENCY_GPU:
+		DBG(("%s: yes, recently used mostly by the GPU\n", __FUNCTION__));
+		return true;
+	case RESIDENCY_CPU:
+	case RESIDENCY_MIRROR:
+		DBG(("%s: no, recent use wants a copy in system memory\n", __FUNCTION__));
+		return false;
+	}
+
 	if (priv->cpu_bo && priv->cpu) {
 		DBG(("%s: no, has CPU bo and was last active on CPU, presume future CPU activity\n", __FUNCTION__));
 		return false;
@@ -2612,6 +2843,9 @@ sna_drawable_move_region_to_cpu(DrawablePtr drawable,
 		return true;
 	}
 
+	sna_pixmap_access(sna, priv, ACCESS_CPU, flags & MOVE_WRITE,
+			  &region->extents);
+
 	assert(priv->gpu_damage == NULL || priv->gpu_bo);
 
 	if (kgem_bo_discard_cache(priv->gpu_bo, flags & MOVE_WRITE)) {
@@ -2733,7 +2967,7 @@ sna_drawable_move_region_to_cpu(DrawablePtr drawable,
 		       get_drawable_dx(drawable), get_drawable_dy(drawable),
 		       pixmap->drawable.width,
 		       pixmap->drawable.height));
-		return _sna_pixmap_move_to_cpu(pixmap, flags);
+		return __sna_pixmap_move_to_cpu(pixmap, flags);
 	}
 
 	assert(priv->gpu_bo == NULL || priv->gpu_bo->proxy == NULL || (flags & MOVE_WRITE) == 0);
@@ -2806,7 +3040,7 @@ sna_drawable_move_region_to_cpu(DrawablePtr drawable,
 demote_to_cpu:
 		if (dx | dy)
 			RegionTranslate(region, -dx, -dy);
-		return _sna_pixmap_move_to_cpu(pixmap, flags | MOVE_READ);
+		return __sna_pixmap_move_to_cpu(pixmap, flags | MOVE_READ);
 	}
 
 	if (flags & MOVE_WHOLE_HINT) {
@@ -2980,6 +3214,8 @@ clear_done:
 				DBG(("%s: single pixel read\n", __FUNCTION__));
 				sna_read_boxes(sna, pixmap, priv->gpu_bo,
 					       &region->extents, 1);
+				trace_migrate(sna, SNA_TRACE_DOWNLOAD, false,
+					      pixmap, &region->extents, 1);
 				goto done;
 			}
 		} else {
@@ -3009,6 +3245,8 @@ clear_done:
 			    region->extents.y2 - region->extents.y1 == 1) {
 				sna_read_boxes(sna, pixmap, priv->gpu_bo,
 					       &region->extents, 1);
+				trace_migrate(sna, SNA_TRACE_DOWNLOAD, false,
+					      pixmap, &region->extents, 1);
 				goto done;
 			}
 
@@ -3362,6 +3600,7 @@ sna_pixmap_move_area_to_gpu(PixmapPtr pixmap, const BoxRec *box, unsigned int fl
 
 	if (priv->cow) {
 		unsigned cow = flags & (MOVE_READ | MOVE_WRITE | __MOVE_FORCE);
+		const BoxRec *write = NULL;
 
 		assert(cow);
 
@@ -3369,8 +3608,10 @@ sna_pixmap_move_area_to_gpu(PixmapPtr pixmap, const BoxRec *box, unsigned int fl
 			if (priv->gpu_damage) {
 				r.extents = *box;
 				r.data = NULL;
-				if (!region_subsumes_damage(&r, priv->gpu_damage))
+				if (!region_subsumes_damage(&r, priv->gpu_damage)) {
 					cow |= MOVE_READ | __MOVE_FORCE;
+					write = box;
+				}
 			}
 		} else {
 			if (priv->cpu_damage) {
@@ -3381,7 +3622,7 @@ sna_pixmap_move_area_to_gpu(PixmapPtr pixmap, const BoxRec *box, unsigned int fl
 			}
 		}
 
-		if (!sna_pixmap_undo_cow(sna, priv, cow))
+		if (!__sna_pixmap_undo_cow(sna, priv, cow, write))
 			return NULL;
 
 		if (priv->gpu_bo == NULL)
@@ -3439,11 +3680,15 @@ sna_pixmap_move_area_to_gpu(PixmapPtr pixmap, const BoxRec *box, unsigned int fl
 	assert(priv->cpu_damage);
 	region_set(&r, box);
 	if (MIGRATE_ALL || region_subsumes_damage(&r, priv->cpu_damage)) {
+		BoxRec stack[64];
+		const BoxRec *orig;
 		bool ok = false;
 		int n;
 
 		n = sna_damage_get_boxes(priv->cpu_damage, &box);
 		assert(n);
+		orig = box;
+		n = upload_coalesce(sna, priv, &box, n, stack, ARRAY_SIZE(stack));
 		if (use_cpu_bo_for_upload(sna, priv, 0)) {
 			DBG(("%s: using CPU bo for upload to GPU\n", __FUNCTION__));
 			ok = sna->render.copy_boxes(sna, GXcopy,
@@ -3451,30 +3696,31 @@ sna_pixmap_move_area_to_gpu(PixmapPtr pixmap, const BoxRec *box, unsigned int fl
 						    &pixmap->drawable, priv->gpu_bo, 0, 0,
 						    box, n, 0);
 		}
+		trace_migrate(sna, SNA_TRACE_UPLOAD, ok, pixmap, box, n);
 		if (!ok) {
 			sna_pixmap_unmap(pixmap, priv);
-			if (pixmap->devPrivate.ptr == NULL)
-				return NULL;
-
-			assert(pixmap->devKind);
-			if (n == 1 && !priv->pinned &&
-			    box->x1 <= 0 && box->y1 <= 0 &&
-			    box->x2 >= pixmap->drawable.width &&
-			    box->y2 >= pixmap->drawable.height) {
-				ok = sna_replace(sna, pixmap,
-						 pixmap->devPrivate.ptr,
-						 pixmap->devKind);
-			} else {
-				ok = sna_write_boxes(sna, pixmap,
-						     priv->gpu_bo, 0, 0,
-						     pixmap->devPrivate.ptr,
-						     pixmap->devKind,
-						     0, 0,
-						     box, n);
+			if (pixmap->devPrivate.ptr != NULL) {
+				assert(pixmap->devKind);
+				if (n == 1 && !priv->pinned &&
+				    box->x1 <= 0 && box->y1 <= 0 &&
+				    box->x2 >= pixmap->drawable.width &&
+				    box->y2 >= pixmap->drawable.height) {
+					ok = sna_replace(sna, pixmap,
+							 pixmap->devPrivate.ptr,
+							 pixmap->devKind);
+				} else {
+					ok = sna_write_boxes(sna, pixmap,
+							     priv->gpu_bo, 0, 0,
+							     pixmap->devPrivate.ptr,
+							     pixmap->devKind,
+							     0, 0,
+							     box, n);
+				}
 			}
-			if (!ok)
-				return NULL;
 		}
+		upload_coalesce_fini(box, orig, stack);
+		if (!ok)
+			return NULL;
 
 		sna_damage_destroy(&priv->cpu_damage);
 	} else if (DAMAGE_IS_ALL(priv->cpu_damage) ||
@@ -3491,6 +3737,7 @@ sna_pixmap_move_area_to_gpu(PixmapPtr pixmap, const BoxRec *box, unsigned int fl
 						    &pixmap->drawable, priv->gpu_bo, 0, 0,
 						    box, 1, 0);
 		}
+		trace_migrate(sna, SNA_TRACE_UPLOAD, ok, pixmap, box, 1);
 		if (!ok) {
 			sna_pixmap_unmap(pixmap, priv);
 			if (pixmap->devPrivate.ptr != NULL) {
@@ -3509,9 +3756,11 @@ sna_pixmap_move_area_to_gpu(PixmapPtr pixmap, const BoxRec *box, unsigned int fl
 		sna_damage_subtract(&priv->cpu_damage, &r);
 	} else if (sna_damage_intersect(priv->cpu_damage, &r, &i)) {
 		int n = region_num_rects(&i);
+		BoxRec stack[64];
 		bool ok;
 
 		box = region_rects(&i);
+		n = upload_coalesce(sna, priv, &box, n, stack, ARRAY_SIZE(stack));
 		ok = false;
 		if (use_cpu_bo_for_upload(sna, priv, 0)) {
 			DBG(("%s: using CPU bo for upload to GPU, %d boxes\n", __FUNCTION__, n));
@@ -3520,6 +3769,7 @@ sna_pixmap_move_area_to_gpu(PixmapPtr pixmap, const BoxRec *box, unsigned int fl
 						    &pixmap->drawable, priv->gpu_bo, 0, 0,
 						    box, n, 0);
 		}
+		trace_migrate(sna, SNA_TRACE_UPLOAD, ok, pixmap, box, n);
 		if (!ok) {
 			sna_pixmap_unmap(pixmap, priv);
 			if (pixmap->devPrivate.ptr != NULL) {
@@ -3532,6 +3782,7 @@ sna_pixmap_move_area_to_gpu(PixmapPtr pixmap, const BoxRec *box, unsigned int fl
 						box, n);
 			}
 		}
+		upload_coalesce_fini(box, region_rects(&i), stack);
 		if (!ok)
 			return NULL;
 
@@ -3570,9 +3821,9 @@ done:
 	return sna_pixmap_mark_active(sna, priv);
 }
 
-struct kgem_bo *
-sna_drawable_use_bo(DrawablePtr drawable, unsigned flags, const BoxRec *box,
-		    struct sna_damage ***damage)
+static struct kgem_bo *
+__sna_drawable_use_bo(DrawablePtr drawable, unsigned flags, const BoxRec *box,
+		      struct sna_damage ***damage, unsigned *reason)
 {
 	PixmapPtr pixmap = get_drawable_pixmap(drawable);
 	struct sna_pixmap *priv = sna_pixmap(pixmap);
@@ -3594,11 +3845,13 @@ sna_drawable_use_bo(DrawablePtr drawable, unsigned flags, const BoxRec *box,
 
 	if (priv == NULL) {
 		DBG(("%s: not attached\n", __FUNCTION__));
+		*reason = SNA_TRACE_UNATTACHED;
 		return NULL;
 	}
 
 	if (priv->cow) {
 		unsigned cow = MOVE_WRITE | MOVE_READ | __MOVE_FORCE;
+		const BoxRec *write = NULL;
 		assert(cow);
 
 		if (flags & IGNORE_DAMAGE) {
@@ -3614,11 +3867,13 @@ sna_drawable_use_bo(DrawablePtr drawable, unsigned flags, const BoxRec *box,
 				if (region_subsumes_damage(&region,
 							   priv->gpu_damage))
 					cow &= ~MOVE_READ;
+				else
+					write = &region.extents;
 			} else
 				cow &= ~MOVE_READ;
 		}
 
-		if (!sna_pixmap_undo_cow(to_sna_from_pixmap(pixmap), priv, cow))
+		if (!__sna_pixmap_undo_cow(to_sna_from_pixmap(pixmap), priv, cow, write))
 			return NULL;
 
 		if (priv->gpu_bo == NULL)
@@ -3654,6 +3909,20 @@ sna_drawable_use_bo(DrawablePtr drawable, unsigned flags, const BoxRec *box,
 		DBG(("%s: last on cpu and needs damage, discard PREFER_GPU\n", __FUNCTION__));
 		flags &= ~PREFER_GPU;
 	}
+	if (!priv->shm) {
+		switch (priv->residency) {
+		case RESIDENCY_GPU:
+			DBG(("%s: history prefers GPU, set PREFER_GPU\n", __FUNCTION__));
+			flags |= PREFER_GPU;
+			break;
+		case RESIDENCY_CPU:
+			if ((flags & FORCE_GPU) == 0) {
+				DBG(("%s: history prefers CPU, discard PREFER_GPU\n", __FUNCTION__));
+				flags &= ~PREFER_GPU;
+			}
+			break;
+		}
+	}
 
 	if ((flags & (PREFER_GPU | IGNORE_DAMAGE)) == IGNORE_DAMAGE) {
 		if (priv->gpu_bo && (box_covers_pixmap(pixmap, box) || box_inplace(pixmap, box))) {
@@ -3668,11 +3937,13 @@ sna_drawable_use_bo(DrawablePtr drawable, unsigned flags, const BoxRec *box,
 	if ((flags & PREFER_GPU) == 0 &&
 	    (flags & (REPLACES | IGNORE_DAMAGE) || !priv->gpu_damage || !kgem_bo_is_busy(priv->gpu_bo))) {
 		DBG(("%s: try cpu as GPU bo is idle\n", __FUNCTION__));
+		*reason = SNA_TRACE_GPU_IDLE;
 		goto use_cpu_bo;
 	}
 
 	if (DAMAGE_IS_ALL(priv->gpu_damage)) {
 		DBG(("%s: use GPU fast path (all-damaged)\n", __FUNCTION__));
+		*reason = SNA_TRACE_GPU_DAMAGE;
 		assert(priv->cpu_damage == NULL);
 		assert(priv->gpu_bo);
 		assert(priv->gpu_bo->proxy == NULL);
@@ -3684,6 +3955,7 @@ sna_drawable_use_bo(DrawablePtr drawable, unsigned flags, const BoxRec *box,
 		if ((flags & FORCE_GPU) == 0 || priv->cpu_bo) {
 			DBG(("%s: use CPU fast path (all-damaged), and not forced-gpu\n",
 			     __FUNCTION__));
+			*reason = SNA_TRACE_CPU_DAMAGE;
 			goto use_cpu_bo;
 		}
 	}
@@ -3694,6 +3966,7 @@ sna_drawable_use_bo(DrawablePtr drawable, unsigned flags, const BoxRec *box,
 	if (priv->gpu_bo == NULL) {
 		unsigned int move;
 
+		*reason = SNA_TRACE_NO_GPU_BO;
 		if ((flags & FORCE_GPU) == 0 &&
 		    (priv->create & KGEM_CAN_CREATE_GPU) == 0) {
 			DBG(("%s: untiled, will not force allocation\n",
@@ -3757,10 +4030,13 @@ create_gpu_bo:
 		move = MOVE_WRITE | MOVE_READ | MOVE_ASYNC_HINT;
 		if (flags & FORCE_GPU)
 			move |= __MOVE_FORCE;
-		if (!sna_pixmap_move_to_gpu(pixmap, move))
+		if (!sna_pixmap_move_to_gpu(pixmap, move)) {
+			*reason = SNA_TRACE_MIGRATE_FAILED;
 			goto use_cpu_bo;
+		}
 
 		DBG(("%s: allocated GPU bo for operation\n", __FUNCTION__));
+		*reason = SNA_TRACE_NONE;
 		goto done;
 	}
 
@@ -3801,6 +4077,7 @@ create_gpu_bo:
 							       &region.extents)) {
 				DBG(("%s: region wholly contained within GPU damage\n",
 				     __FUNCTION__));
+				*reason = SNA_TRACE_GPU_DAMAGE;
 				assert(sna_damage_contains_box(&priv->gpu_damage, &region.extents) == PIXMAN_REGION_IN);
 				assert(sna_damage_contains_box(&priv->cpu_damage, &region.extents) == PIXMAN_REGION_OUT);
 				goto use_gpu_bo;
@@ -3815,6 +4092,7 @@ create_gpu_bo:
 		if (ret == PIXMAN_REGION_IN) {
 			DBG(("%s: region wholly contained within GPU damage\n",
 			     __FUNCTION__));
+			*reason = SNA_TRACE_GPU_DAMAGE;
 			goto use_gpu_bo;
 		}
 
@@ -3830,6 +4108,7 @@ create_gpu_bo:
 		if (ret == PIXMAN_REGION_IN) {
 			DBG(("%s: region wholly contained within CPU damage\n",
 			     __FUNCTION__));
+			*reason = SNA_TRACE_CPU_DAMAGE;
 			goto use_cpu_bo;
 		}
 
@@ -3841,6 +4120,7 @@ create_gpu_bo:
 		if (ret != PIXMAN_REGION_OUT) {
 			DBG(("%s: region partially contained within CPU damage\n",
 			     __FUNCTION__));
+			*reason = SNA_TRACE_PARTIAL_DAMAGE;
 			goto use_cpu_bo;
 		}
 	}
@@ -3850,6 +4130,7 @@ move_to_gpu:
 					 flags & IGNORE_DAMAGE ? MOVE_WRITE : MOVE_READ | MOVE_WRITE)) {
 		DBG(("%s: failed to move-to-gpu, fallback\n", __FUNCTION__));
 		assert(priv->gpu_bo == NULL);
+		*reason = SNA_TRACE_MIGRATE_FAILED;
 		goto use_cpu_bo;
 	}
 
@@ -3923,6 +4204,8 @@ use_cpu_bo:
 	if (!USE_CPU_BO || priv->cpu_bo == NULL) {
 		if ((flags & FORCE_GPU) == 0) {
 			DBG(("%s: no CPU bo, and GPU not forced\n", __FUNCTION__));
+			if (*reason == SNA_TRACE_NONE)
+				*reason = SNA_TRACE_NO_CPU_BO;
 			return NULL;
 		}
 
@@ -3956,6 +4239,7 @@ cpu_fail:
 	    !__kgem_bo_is_busy(&sna->kgem, priv->cpu_bo)) {
 		DBG(("%s: has CPU bo, but is idle and acceleration not forced\n",
 		     __FUNCTION__));
+		*reason = SNA_TRACE_CPU_BO_IDLE;
 		return NULL;
 	}
 
@@ -3971,6 +4255,7 @@ cpu_fail:
 	if (priv->gpu_bo && kgem_bo_is_busy(priv->gpu_bo)) {
 		DBG(("%s: both CPU and GPU are busy, prefer to use the GPU\n",
 		     __FUNCTION__));
+		*reason = SNA_TRACE_CPU_BO_BUSY;
 		goto move_to_gpu;
 	}
 
@@ -4040,6 +4325,7 @@ prefer_gpu_bo:
 	if (!sna_drawable_move_region_to_cpu(&pixmap->drawable, &region,
 					     (flags & IGNORE_DAMAGE ? 0 : MOVE_READ) | MOVE_WRITE | MOVE_ASYNC_HINT)) {
 		DBG(("%s: failed to move-to-cpu, fallback\n", __FUNCTION__));
+		*reason = SNA_TRACE_MIGRATE_FAILED;
 		goto cpu_fail;
 	}
 
@@ -4079,6 +4365,39 @@ prefer_gpu_bo:
 	return priv->cpu_bo;
 }
 
+struct kgem_bo *
+sna_drawable_use_bo(DrawablePtr drawable, unsigned flags, const BoxRec *box,
+		    struct sna_damage ***damage)
+{
+	unsigned reason = SNA_TRACE_NONE;
+	struct kgem_bo *bo;
+	struct sna *sna;
+
+	bo = __sna_drawable_use_bo(drawable, flags, box, damage, &reason);
+
+	sna = to_sna_from_drawable(drawable);
+	if (bo)
+		sna_pixmap_access(sna, sna_pixmap_from_drawable(drawable),
+				  ACCESS_GPU, true, box);
+
+	if (sna_trace_enabled(sna)) {
+		PixmapPtr pixmap = get_drawable_pixmap(drawable);
+		struct sna_pixmap *priv = sna_pixmap(pixmap);
+		unsigned path;
+
+		if (bo == NULL)
+			path = SNA_TRACE_CPU;
+		else if (bo == priv->gpu_bo)
+			path = SNA_TRACE_GPU;
+		else
+			path = SNA_TRACE_CPU_BO;
+
+		__sna_trace(sna, SNA_TRACE_DRAW, path, reason, pixmap, box, 0);
+	}
+
+	return bo;
+}
+
 PixmapPtr
 sna_pixmap_create_upload(ScreenPtr screen,
 			 int width, int height, int depth,
@@ -4356,11 +4675,14 @@ sna_pixmap_move_to_gpu(PixmapPtr pixmap, unsigned flags)
 	n = sna_damage_get_boxes(priv->cpu_damage, &box);
 	assert(n);
 	if (n) {
+		BoxRec stack[64];
+		const BoxRec *orig = box;
 		bool ok;
 
 		assert_pixmap_contains_damage(pixmap, priv->cpu_damage);
 		DBG(("%s: uploading %d damage boxes\n", __FUNCTION__, n));
 
+		n = upload_coalesce(sna, priv, &box, n, stack, ARRAY_SIZE(stack));
 		ok = false;
 		if (use_cpu_bo_for_upload(sna, priv, flags)) {
 			DBG(("%s: using CPU bo for upload to GPU\n", __FUNCTION__));
@@ -4369,36 +4691,40 @@ sna_pixmap_move_to_gpu(PixmapPtr pixmap, unsigned flags)
 						    &pixmap->drawable, priv->gpu_bo, 0, 0,
 						    box, n, 0);
 		}
+		trace_migrate(sna, SNA_TRACE_UPLOAD, ok, pixmap, box, n);
 		if (!ok) {
 			sna_pixmap_unmap(pixmap, priv);
-			if (pixmap->devPrivate.ptr == NULL)
-				return NULL;
-
-			assert(pixmap->devKind);
-			if (n == 1 && !priv->pinned &&
-			    (box->x2 - box->x1) >= pixmap->drawable.width &&
-			    (box->y2 - box->y1) >= pixmap->drawable.height) {
-				ok = sna_replace(sna, pixmap,
-						 pixmap->devPrivate.ptr,
-						 pixmap->devKind);
-			} else {
-				ok = sna_write_boxes(sna, pixmap,
-						     priv->gpu_bo, 0, 0,
-						     pixmap->devPrivate.ptr,
-						     pixmap->devKind,
-						     0, 0,
-						     box, n);
+			if (pixmap->devPrivate.ptr != NULL) {
+				assert(pixmap->devKind);
+				if (n == 1 && !priv->pinned &&
+				    (box->x2 - box->x1) >= pixmap->drawable.width &&
+				    (box->y2 - box->y1) >= pixmap->drawable.height) {
+					ok = sna_replace(sna, pixmap,
+							 pixmap->devPrivate.ptr,
+							 pixmap->devKind);
+				} else {
+					ok = sna_write_boxes(sna, pixmap,
+							     priv->gpu_bo, 0, 0,
+							     pixmap->devPrivate.ptr,
+							     pixmap->devKind,
+							     0, 0,
+							     box, n);
+				}
 			}
-			if (!ok)
-				return NULL;
 		}
+		upload_coalesce_fini(box, orig, stack);
+		if (!ok)
+			return NULL;
 	}
 
 	__sna_damage_destroy(DAMAGE_PTR(priv->cpu_damage));
 	priv->cpu_damage = NULL;
 
-	/* For large bo, try to keep only a single copy around */
-	if (priv->create & KGEM_CAN_CREATE_LARGE || flags & MOVE_SOURCE_HINT) {
+	/* For large bo, try to keep only a single copy around, unless
+	 * the history says both sides keep coming back to this pixmap.
+	 */
+	if (priv->create & KGEM_CAN_CREATE_LARGE ||
+	    (flags & MOVE_SOURCE_HINT && priv->residency != RESIDENCY_MIRROR)) {
 		DBG(("%s: disposing of system copy for large/source\n",
 		     __FUNCTION__));
 		assert(!priv->shm);
@@ -4686,6 +5012,20 @@ static bool can_upload__tiled_x(struct kgem *kgem, struct kgem_bo *bo)
 	return kgem_bo_can_map__cpu(kgem, bo, true) || kgem->has_wc_mmap;
 }
 
+static uint64_t region_bytes(const RegionRec *region, int bpp)
+{
+	const BoxRec *box = region_rects(region);
+	int n = region_num_rects(region);
+	uint64_t pixels = 0;
+
+	while (n--) {
+		pixels += (box->x2 - box->x1) * (box->y2 - box->y1);
+		box++;
+	}
+
+	return pixels * bpp / 8;
+}
+
 static bool
 try_upload__tiled_x(PixmapPtr pixmap, RegionRec *region,
 		    int x, int y, int w, int  h, char *bits, int stride)
@@ -4988,6 +5328,7 @@ done:
 		add_shm_flush(sna, priv);
 	}
 
+	sna->xfer.put_cpu += region_bytes(region, pixmap->drawable.bitsPerPixel);
 	assert(!priv->clear);
 	return true;
 }
@@ -5018,7 +5359,7 @@ try_upload__blt(PixmapPtr pixmap, RegionRec *region,
 		return false;
 	}
 
-	src_bo = kgem_create_map(&sna->kgem, bits, stride * h, true);
+	src_bo = kgem_create_map__cached(&sna->kgem, bits, stride * h, true);
 	if (src_bo == NULL)
 		return false;
 
@@ -5054,6 +5395,8 @@ try_upload__blt(PixmapPtr pixmap, RegionRec *region,
 		return false;
 	}
 
+	sna->xfer.put_blt += region_bytes(region, pixmap->drawable.bitsPerPixel);
+
 	if (!DAMAGE_IS_ALL(priv->gpu_damage)) {
 		assert(!priv->clear);
 		if (region_subsumes_drawable(region, &pixmap->drawable)) {
@@ -5214,6 +5557,8 @@ sna_put_zpixmap_blt(DrawablePtr drawable, GCPtr gc, RegionPtr region,
 	} while (--n);
 
 	sigtrap_put();
+	to_sna_from_pixmap(pixmap)->xfer.put_cpu +=
+		region_bytes(region, pixmap->drawable.bitsPerPixel);
 	assert_pixmap_damage(pixmap);
 	return true;
 }
@@ -5725,6 +6070,10 @@ move_to_gpu(PixmapPtr pixmap, struct sna_pixmap *priv,
 	int count;
 
 	assert_pixmap_map(pixmap, priv);
+	if (dst_is_gpu)
+		sna_pixmap_access(to_sna_from_pixmap(pixmap), priv,
+				  ACCESS_GPU, false, &region->extents);
+
 	if (DAMAGE_IS_ALL(priv->gpu_damage)) {
 		assert(priv->gpu_bo);
 		return true;
@@ -5774,6 +6123,16 @@ move_to_gpu(PixmapPtr pixmap, struct sna_pixmap *priv,
 			return false;
 	}
 
+	switch (priv->residency) {
+	case RESIDENCY_GPU:
+	case RESIDENCY_MIRROR:
+		DBG(("%s: history prefers a GPU copy\n", __FUNCTION__));
+		return true;
+	case RESIDENCY_CPU:
+		DBG(("%s: history prefers the CPU\n", __FUNCTION__));
+		return false;
+	}
+
 	count = priv->source_count++;
 	if (priv->cpu_bo) {
 		if (priv->cpu_bo->flush && count > SOURCE_BIAS)
@@ -6475,6 +6834,12 @@ sna_copy_boxes(DrawablePtr src, DrawablePtr dst, GCPtr gc,
 		goto fallback;
 	}
 
+	if (replaces && alu == GXcopy &&
+	    sna_pixmap_share_cow(sna, src_pixmap, dst_pixmap)) {
+		DBG(("%s: sharing src_pixmap copy-on-write\n", __FUNCTION__));
+		return;
+	}
+
 	if (alu == GXcopy &&
 	    src_priv && src_priv->cow &&
 	    COW(src_priv->cow) == COW(dst_priv->cow)) {
@@ -6578,20 +6943,9 @@ discard_cow:
 			if (replaces && UNDO)
 				kgem_bo_pair_undo(&sna->kgem, dst_priv->gpu_bo, dst_priv->cpu_bo);
 
-			if (replaces &&
-			    src_pixmap->drawable.width == dst_pixmap->drawable.width &&
-			    src_pixmap->drawable.height == dst_pixmap->drawable.height) {
-				assert(src_pixmap->drawable.depth == dst_pixmap->drawable.depth);
-				assert(src_pixmap->drawable.bitsPerPixel == dst_pixmap->drawable.bitsPerPixel);
-				if (sna_pixmap_make_cow(sna, src_priv, dst_priv)) {
-					assert(dst_priv->gpu_bo == src_priv->gpu_bo);
-					sna_damage_all(&dst_priv->gpu_damage, dst_pixmap);
-					sna_damage_destroy(&dst_priv->cpu_damage);
-					list_del(&dst_priv->flush_list);
-					add_shm_flush(sna, dst_priv);
-					return;
-				}
-			}
+			if (replaces && alu == GXcopy &&
+			    sna_pixmap_share_cow(sna, src_pixmap, dst_pixmap))
+				return;
 			if (!sna->render.copy_boxes(sna, alu,
 						    &src_pixmap->drawable, src_priv->gpu_bo, src_dx, src_dy,
 						    &dst_pixmap->drawable, bo, 0, 0,
@@ -6713,10 +7067,10 @@ discard_cow:
 			     __FUNCTION__));
 
 			assert(src_pixmap->devKind);
-			src_bo = kgem_create_map(&sna->kgem,
-						 src_pixmap->devPrivate.ptr,
-						 src_pixmap->devKind * src_pixmap->drawable.height,
-						 true);
+			src_bo = kgem_create_map__cached(&sna->kgem,
+							 src_pixmap->devPrivate.ptr,
+							 src_pixmap->devKind * src_pixmap->drawable.height,
+							 true);
 			if (src_bo) {
 				src_bo->pitch = src_pixmap->devKind;
 				kgem_bo_mark_unreusable(src_bo);
@@ -7692,6 +8046,146 @@ sna_fill_spans__dash_clip_boxes(DrawablePtr drawable,
 		sna_fill_spans__fill_clip_boxes(drawable, gc, n, pt, width, sorted);
 }
 
+static void
+sna_poly_fill_rect__fill_clip_extents(DrawablePtr drawable,
+				      GCPtr gc, int n, xRectangle *r)
+{
+	struct sna_fill_spans *data = sna_gc(gc)->priv;
+	struct sna_fill_op *op = data->op;
+	const BoxRec *extents = &data->region.extents;
+	BoxRec box[512], *b = box, *const last_box = box + ARRAY_SIZE(box);
+
+	DBG(("%s: alu=%d, fg=%08lx, count=%d, extents=(%d, %d), (%d, %d)\n",
+	     __FUNCTION__, gc->alu, gc->fgPixel, n,
+	     extents->x1, extents->y1,
+	     extents->x2, extents->y2));
+
+	while (n--) {
+		int x1 = r->x + drawable->x;
+		int y1 = r->y + drawable->y;
+		int x2 = x1 + r->width;
+		int y2 = y1 + r->height;
+
+		r++;
+
+		if (x1 < extents->x1)
+			x1 = extents->x1;
+		if (x2 > extents->x2)
+			x2 = extents->x2;
+		if (x1 >= x2)
+			continue;
+
+		if (y1 < extents->y1)
+			y1 = extents->y1;
+		if (y2 > extents->y2)
+			y2 = extents->y2;
+		if (y1 >= y2)
+			continue;
+
+		b->x1 = x1 + data->dx;
+		b->x2 = x2 + data->dx;
+		b->y1 = y1 + data->dy;
+		b->y2 = y2 + data->dy;
+		if (++b == last_box) {
+			op->boxes(data->sna, op, box, last_box - box);
+			b = box;
+		}
+	}
+	if (b != box)
+		op->boxes(data->sna, op, box, b - box);
+}
+
+static void
+sna_poly_fill_rect__fill_clip_boxes(DrawablePtr drawable,
+				    GCPtr gc, int n, xRectangle *r)
+{
+	struct sna_fill_spans *data = sna_gc(gc)->priv;
+	struct sna_fill_op *op = data->op;
+	const BoxRec *extents = &data->region.extents;
+	BoxRec box[512], *b = box, *const last_box = box + ARRAY_SIZE(box);
+	const BoxRec * const clip_start = RegionBoxptr(&data->region);
+	const BoxRec * const clip_end = clip_start + data->region.data->numRects;
+
+	DBG(("%s: alu=%d, fg=%08lx, count=%d, extents=(%d, %d), (%d, %d)\n",
+	     __FUNCTION__, gc->alu, gc->fgPixel, n,
+	     extents->x1, extents->y1,
+	     extents->x2, extents->y2));
+
+	while (n--) {
+		int x1 = r->x + drawable->x;
+		int y1 = r->y + drawable->y;
+		int x2 = x1 + r->width;
+		int y2 = y1 + r->height;
+		const BoxRec *c;
+
+		r++;
+
+		if (x1 < extents->x1)
+			x1 = extents->x1;
+		if (x2 > extents->x2)
+			x2 = extents->x2;
+		if (x1 >= x2)
+			continue;
+
+		if (y1 < extents->y1)
+			y1 = extents->y1;
+		if (y2 > extents->y2)
+			y2 = extents->y2;
+		if (y1 >= y2)
+			continue;
+
+		for (c = find_clip_box_for_y(clip_start, clip_end, y1);
+		     c != clip_end && c->y1 < y2;
+		     c++) {
+			if (x2 <= c->x1 || x1 >= c->x2)
+				continue;
+
+			b->x1 = (x1 > c->x1 ? x1 : c->x1) + data->dx;
+			b->x2 = (x2 < c->x2 ? x2 : c->x2) + data->dx;
+			b->y1 = (y1 > c->y1 ? y1 : c->y1) + data->dy;
+			b->y2 = (y2 < c->y2 ? y2 : c->y2) + data->dy;
+			if (++b == last_box) {
+				op->boxes(data->sna, op, box, last_box - box);
+				b = box;
+			}
+		}
+	}
+	if (b != box)
+		op->boxes(data->sna, op, box, b - box);
+}
+
+/* Wide lines, and on-off dashes, are only ever filled with the
+ * foreground pixel. So rather than setting up a fresh fill for each
+ * span and rectangle that mi emits (as the __gpu callbacks must), we
+ * can keep the one fill op open across the whole request. The spans
+ * are not guaranteed to lie within the extents we computed, so we
+ * always run them through the clipper.
+ */
+static bool
+sna_wide_line_fill_init(struct sna_fill_spans *data,
+			struct sna_fill_op *fill,
+			GCPtr gc, uint32_t color)
+{
+	if (!sna_fill_init_blt(fill,
+			       data->sna, data->pixmap,
+			       data->bo, gc->alu, color,
+			       FILL_BOXES | FILL_SPANS))
+		return false;
+
+	if (region_is_singular(&data->region)) {
+		sna_gc_ops__tmp.FillSpans = sna_fill_spans__fill_clip_extents;
+		sna_gc_ops__tmp.PolyFillRect = sna_poly_fill_rect__fill_clip_extents;
+		sna_gc_ops__tmp.PolyPoint = sna_poly_point__fill_clip_extents;
+	} else {
+		sna_gc_ops__tmp.FillSpans = sna_fill_spans__fill_clip_boxes;
+		sna_gc_ops__tmp.PolyFillRect = sna_poly_fill_rect__fill_clip_boxes;
+		sna_gc_ops__tmp.PolyPoint = sna_poly_point__fill_clip_boxes;
+	}
+
+	data->op = fill;
+	return true;
+}
+
 static bool
 sna_fill_spans_blt(DrawablePtr drawable,
 		   struct kgem_bo *bo, struct sna_damage **damage,
@@ -9665,6 +10159,7 @@ sna_poly_line_extents(DrawablePtr drawable, GCPtr gc,
 {
 	BoxRec box;
 	bool clip, blt = true;
+	int count = n;
 
 	if (n == 0)
 		return 0;
@@ -9700,7 +10195,8 @@ sna_poly_line_extents(DrawablePtr drawable, GCPtr gc,
 
 	if (gc->lineWidth) {
 		int extra = gc->lineWidth >> 1;
-		if (n > 1) {
+		/* n has been consumed by the loops above */
+		if (count > 1) {
 			if (gc->joinStyle == JoinMiter)
 				extra = 6 * gc->lineWidth;
 			else if (gc->capStyle == CapProjecting)
@@ -10010,6 +10506,28 @@ spans_fallback:
 					fill.done(data.sna, &fill);
 				}
 			}
+		} else if (gc->lineStyle != LineDoubleDash &&
+			   gc_is_solid(gc, &color)) {
+			struct sna_fill_op fill;
+
+			if (data.flags & IS_CLIPPED &&
+			    !region_maybe_clip(&data.region,
+					       gc->pCompositeClip))
+				return;
+
+			if (!sna_wide_line_fill_init(&data, &fill, gc, color))
+				goto fallback;
+
+			assert(gc->miTranslate);
+			gc->ops = &sna_gc_ops__tmp;
+			if (gc->lineStyle == LineSolid) {
+				DBG(("%s: miWideLine (solid fill)\n", __FUNCTION__));
+				miWideLine(drawable, gc, mode, n, pt);
+			} else {
+				DBG(("%s: miWideDash (solid fill)\n", __FUNCTION__));
+				miWideDash(drawable, gc, mode, n, pt);
+			}
+			fill.done(data.sna, &fill);
 		} else {
 			/* Note that the WideDash functions alternate
 			 * between filling using fgPixel and bgPixel
@@ -10904,6 +11422,26 @@ spans_fallback:
 				line(drawable, gc, CoordModeOrigin, 2,
 				     (DDXPointPtr)&seg[i]);
 
+			fill.done(data.sna, &fill);
+		} else if (gc->lineWidth &&
+			   gc->lineStyle != LineDoubleDash &&
+			   gc_is_solid(gc, &color)) {
+			struct sna_fill_op fill;
+
+			if (data.flags & IS_CLIPPED &&
+			    !region_maybe_clip(&data.region,
+					       gc->pCompositeClip))
+				return;
+
+			if (!sna_wide_line_fill_init(&data, &fill, gc, color))
+				goto fallback;
+
+			assert(gc->miTranslate);
+			gc->ops = &sna_gc_ops__tmp;
+			for (i = 0; i < n; i++)
+				line(drawable, gc, CoordModeOrigin, 2,
+				     (DDXPointPtr)&seg[i]);
+
 			fill.done(data.sna, &fill);
 		} else {
 			sna_gc_ops__tmp.FillSpans = sna_fill_spans__gpu;
@@ -11620,6 +12158,227 @@ sna_poly_arc_extents(DrawablePtr drawable, GCPtr gc,
 	return 1 | clipped << 1;
 }
 
+/* Zero-width and filled arcs are rasterised here rather than by mi, using
+ * the same setup and stepping macros so that the pixels are identical, but
+ * without the per-arc allocations and with the output of consecutive arcs
+ * batched into a single call to PolyPoint or FillSpans.
+ */
+struct sna_arc_points {
+	DrawablePtr draw;
+	GCPtr gc;
+	int n;
+	DDXPointRec pt[512];
+};
+
+static void
+sna_arc_points_flush(struct sna_arc_points *p)
+{
+	if (p->n) {
+		DBG(("%s: %d points\n", __FUNCTION__, p->n));
+		p->gc->ops->PolyPoint(p->draw, p->gc, CoordModeOrigin,
+				      p->n, p->pt);
+		p->n = 0;
+	}
+}
+
+static inline void
+sna_arc_point(struct sna_arc_points *p, int x, int y)
+{
+	p->pt[p->n].x = x;
+	p->pt[p->n].y = y;
+	if (++p->n == ARRAY_SIZE(p->pt))
+		sna_arc_points_flush(p);
+}
+
+/* Follows fb/fbarcbits.h, but emitting points relative to the drawable */
+static void
+sna_zero_arc(struct sna_arc_points *p, xArc *arc)
+{
+	miZeroArcRec info;
+	Bool do360;
+	int x, y, a, b, d, mask;
+	int k1, k3, dx, dy;
+	int yoffset, dyoffset;
+
+	do360 = miZeroArcSetup(arc, &info, TRUE);
+	MIARCSETUP();
+	yoffset = y ? 1 : 0;
+	dyoffset = 0;
+	mask = info.initialMask;
+
+	if (!(arc->width & 1)) {
+		if (mask & 2)
+			sna_arc_point(p, info.xorgo, info.yorg);
+		if (mask & 8)
+			sna_arc_point(p, info.xorgo, info.yorgo);
+	}
+	if (!info.end.x || !info.end.y) {
+		mask = info.end.mask;
+		info.end = info.altend;
+	}
+	if (do360 && (arc->width == arc->height) && !(arc->width & 1)) {
+		int xoffset = 1;
+
+		while (1) {
+			sna_arc_point(p, info.xorg + x, info.yorg + yoffset);
+			sna_arc_point(p, info.xorg - x, info.yorg + yoffset);
+			sna_arc_point(p, info.xorg - x, info.yorgo - yoffset);
+			sna_arc_point(p, info.xorg + x, info.yorgo - yoffset);
+			if (a < 0)
+				break;
+			sna_arc_point(p, info.xorg + info.h - y, info.yorg + info.h - xoffset);
+			sna_arc_point(p, info.xorg - info.h + y, info.yorg + info.h - xoffset);
+			sna_arc_point(p, info.xorg - info.h + y, info.yorg + info.h + xoffset);
+			sna_arc_point(p, info.xorg + info.h - y, info.yorg + info.h + xoffset);
+			xoffset++;
+			MIARCCIRCLESTEP(yoffset++;);
+		}
+		x = info.w;
+		yoffset = info.h;
+	} else if (do360) {
+		while (y < info.h || x < info.w) {
+			MIARCOCTANTSHIFT(dyoffset = 1;);
+			sna_arc_point(p, info.xorg + x, info.yorg + yoffset);
+			sna_arc_point(p, info.xorgo - x, info.yorg + yoffset);
+			sna_arc_point(p, info.xorgo - x, info.yorgo - yoffset);
+			sna_arc_point(p, info.xorg + x, info.yorgo - yoffset);
+			MIARCSTEP(yoffset += dyoffset;, yoffset++;);
+		}
+	} else {
+		while (y < info.h || x < info.w) {
+			MIARCOCTANTSHIFT(dyoffset = 1;);
+			if ((x == info.start.x) || (y == info.start.y)) {
+				mask = info.start.mask;
+				info.start = info.altstart;
+			}
+			if (mask & 1)
+				sna_arc_point(p, info.xorg + x, info.yorg + yoffset);
+			if (mask & 2)
+				sna_arc_point(p, info.xorgo - x, info.yorg + yoffset);
+			if (mask & 4)
+				sna_arc_point(p, info.xorgo - x, info.yorgo - yoffset);
+			if (mask & 8)
+				sna_arc_point(p, info.xorg + x, info.yorgo - yoffset);
+			if ((x == info.end.x) || (y == info.end.y)) {
+				mask = info.end.mask;
+				info.end = info.altend;
+			}
+			MIARCSTEP(yoffset += dyoffset;, yoffset++;);
+		}
+	}
+	if ((x == info.start.x) || (y == info.start.y))
+		mask = info.start.mask;
+	if (mask & 1)
+		sna_arc_point(p, info.xorg + x, info.yorg + yoffset);
+	if (mask & 4)
+		sna_arc_point(p, info.xorgo - x, info.yorgo - yoffset);
+	if (arc->height & 1) {
+		if (mask & 2)
+			sna_arc_point(p, info.xorgo - x, info.yorg + yoffset);
+		if (mask & 8)
+			sna_arc_point(p, info.xorg + x, info.yorgo - yoffset);
+	}
+}
+
+static void
+sna_zero_poly_arc(DrawablePtr drawable, GCPtr gc, int n, xArc *arc)
+{
+	struct sna_arc_points p;
+
+	assert(gc->lineWidth == 0 && gc->lineStyle == LineSolid);
+
+	p.draw = drawable;
+	p.gc = gc;
+	p.n = 0;
+
+	for (; n--; arc++) {
+		if (miCanZeroArc(arc)) {
+			sna_zero_arc(&p, arc);
+		} else {
+			sna_arc_points_flush(&p);
+			miZeroPolyArc(drawable, gc, 1, arc);
+		}
+	}
+	sna_arc_points_flush(&p);
+}
+
+struct sna_arc_spans {
+	DrawablePtr draw;
+	GCPtr gc;
+	int n;
+	DDXPointRec pt[512];
+	int width[512];
+};
+
+static void
+sna_arc_spans_flush(struct sna_arc_spans *s)
+{
+	if (s->n) {
+		DBG(("%s: %d spans\n", __FUNCTION__, s->n));
+		s->gc->ops->FillSpans(s->draw, s->gc, s->n,
+				      s->pt, s->width, FALSE);
+		s->n = 0;
+	}
+}
+
+static inline void
+sna_arc_span(struct sna_arc_spans *s, int x, int y, int w)
+{
+	s->pt[s->n].x = x;
+	s->pt[s->n].y = y;
+	s->width[s->n] = w;
+	if (++s->n == ARRAY_SIZE(s->pt))
+		sna_arc_spans_flush(s);
+}
+
+/* As miFillEllipseI, but in screen coordinates as FillSpans expects */
+static void
+sna_fill_ellipse(struct sna_arc_spans *s, xArc *arc)
+{
+	miFillArcRec info;
+	int x, y, e;
+	int yk, xk, ym, xm, dx, dy, xorg, yorg;
+	int slw;
+
+	miFillArcSetup(arc, &info);
+	MIFILLARCSETUP();
+	xorg += s->draw->x;
+	yorg += s->draw->y;
+
+	while (y > 0) {
+		MIFILLARCSTEP(slw);
+		sna_arc_span(s, xorg - x, yorg - y, slw);
+		if (miFillArcLower(slw))
+			sna_arc_span(s, xorg - x, yorg + y + dy, slw);
+	}
+}
+
+static void
+sna_poly_fill_ellipses(DrawablePtr draw, GCPtr gc, int n, xArc *arc)
+{
+	struct sna_arc_spans s;
+
+	assert(gc->miTranslate);
+
+	s.draw = draw;
+	s.gc = gc;
+	s.n = 0;
+
+	for (; n--; arc++) {
+		if (miFillArcEmpty(arc))
+			continue;
+
+		if ((arc->angle2 >= FULLCIRCLE || arc->angle2 <= -FULLCIRCLE) &&
+		    miCanFillArc(arc)) {
+			sna_fill_ellipse(&s, arc);
+		} else {
+			sna_arc_spans_flush(&s);
+			miPolyFillArc(draw, gc, 1, arc);
+		}
+	}
+	sna_arc_spans_flush(&s);
+}
+
 static void
 sna_poly_arc(DrawablePtr drawable, GCPtr gc, int n, xArc *arc)
 {
@@ -11705,7 +12464,7 @@ sna_poly_arc(DrawablePtr drawable, GCPtr gc, int n, xArc *arc)
 				data.op = &fill;
 				gc->ops = &sna_gc_ops__tmp;
 				if (gc->lineWidth == 0)
-					miZeroPolyArc(drawable, gc, n, arc);
+					sna_zero_poly_arc(drawable, gc, n, arc);
 				else
 					miPolyArc(drawable, gc, n, arc);
 				gc->ops = (GCOps *)&sna_gc_ops;
@@ -15223,13 +15982,13 @@ sna_poly_fill_arc(DrawablePtr draw, GCPtr gc, int n, xArc *arc)
 			assert(gc->miTranslate);
 			gc->ops = &sna_gc_ops__tmp;
 
-			miPolyFillArc(draw, gc, n, arc);
+			sna_poly_fill_ellipses(draw, gc, n, arc);
 			fill.done(data.sna, &fill);
 		} else {
 			sna_gc_ops__tmp.FillSpans = sna_fill_spans__gpu;
 			gc->ops = &sna_gc_ops__tmp;
 
-			miPolyFillArc(draw, gc, n, arc);
+			sna_poly_fill_ellipses(draw, gc, n, arc);
 		}
 
 		gc->ops = (GCOps *)&sna_gc_ops;
@@ -17037,9 +17796,9 @@ sna_get_image__blt(PixmapPtr pixmap,
 
 	pitch = PixmapBytePad(region->extents.x2 - region->extents.x1,
 			      pixmap->drawable.depth);
-	dst_bo = kgem_create_map(&sna->kgem, dst,
-				 pitch * (region->extents.y2 - region->extents.y1),
-				 false);
+	dst_bo = kgem_create_map__cached(&sna->kgem, dst,
+					 pitch * (region->extents.y2 - region->extents.y1),
+					 false);
 	if (dst_bo) {
 		dst_bo->pitch = pitch;
 		kgem_bo_mark_unreusable(dst_bo);
@@ -17057,6 +17816,8 @@ sna_get_image__blt(PixmapPtr pixmap,
 		kgem_bo_destroy(&sna->kgem, dst_bo);
 	}
 
+	if (ok)
+		sna->xfer.get_blt += region_bytes(region, pixmap->drawable.bitsPerPixel);
 	return ok;
 }
 
@@ -17109,15 +17870,20 @@ sna_get_image__fast(PixmapPtr pixmap,
 		return false;
 
 	if (sna_get_image__inplace(pixmap, region, dst, flags, true))
-		return true;
+		goto cpu;
 
 	if (sna_get_image__blt(pixmap, region, dst, flags))
 		return true;
 
 	if (sna_get_image__inplace(pixmap, region, dst, flags, false))
-		return true;
+		goto cpu;
 
 	return false;
+
+cpu:
+	to_sna_from_pixmap(pixmap)->xfer.get_cpu +=
+		region_bytes(region, pixmap->drawable.bitsPerPixel);
+	return true;
 }
 
 static void
@@ -17157,6 +17923,10 @@ sna_get_image(DrawablePtr drawable,
 		region.extents.y2 = region.extents.y1 + h;
 		region.data = NULL;
 
+		if (sna_readback_get_image(to_sna_from_pixmap(pixmap), pixmap,
+					   &region.extents, dst))
+			goto apply_planemask;
+
 		if (sna_get_image__fast(pixmap, &region, dst, flags))
 			goto apply_planemask;
 
@@ -17176,6 +17946,8 @@ sna_get_image(DrawablePtr drawable,
 				   region.extents.x1, region.extents.y1, 0, 0, w, h);
 			sigtrap_put();
 		}
+		to_sna_from_pixmap(pixmap)->xfer.get_cpu +=
+			region_bytes(&region, drawable->bitsPerPixel);
 
 apply_planemask:
 		if (!PM_IS_SOLID(drawable, mask)) {
@@ -17521,7 +18293,8 @@ static bool sna_scanout_do_flush(struct sna *sna)
 		}
 	} else {
 		if (start_flush(sna))
-			timer_enable(sna, FLUSH_TIMER, interval/2);
+			timer_enable(sna, FLUSH_TIMER,
+				     sna_mode_flush_delay(sna, interval/2));
 	}
 
 	return false;
@@ -17750,6 +18523,91 @@ static void sna_accel_expire(struct sna *sna)
 		sna_accel_disarm_timer(sna, EXPIRE_TIMER);
 }
 
+static void sna_accel_upload(struct sna *sna)
+{
+	/* Push the CPU writes to pixmaps we keep mirrored across to the
+	 * GPU now, all at once and coalesced, before the GPU asks for
+	 * them one by one.
+	 */
+	while (!list_is_empty(&sna->upload_pixmaps)) {
+		struct sna_pixmap *priv =
+			list_first_entry(&sna->upload_pixmaps,
+					 struct sna_pixmap, upload_list);
+
+		list_del(&priv->upload_list);
+
+		if (priv->cpu_damage == NULL ||
+		    priv->residency != RESIDENCY_MIRROR ||
+		    priv->gpu_bo == NULL || priv->gpu_bo->proxy)
+			continue;
+
+		DBG(("%s: pixmap=%ld\n", __FUNCTION__,
+		     priv->pixmap->drawable.serialNumber));
+		if (sna_pixmap_move_to_gpu(priv->pixmap,
+					   MOVE_READ | MOVE_ASYNC_HINT))
+			sna->xfer.upload_batched++;
+	}
+}
+
+/*
+ * The bytes moved between the CPU and the GPU, and the TearFree and cursor
+ * work, since the last report: logged at close, and every 10s with
+ * DEBUG_MEMORY.
+ */
+static void sna_accel_report_xfer(struct sna *sna)
+{
+	int scrn = sna->scrn->scrnIndex;
+
+	xf86DrvMsgVerb(scrn, X_INFO, 3,
+		       "PutImage: %llu bytes by BLT, %llu bytes by CPU; GetImage: %llu bytes by BLT, %llu bytes by CPU\n",
+		       (unsigned long long)sna->xfer.put_blt,
+		       (unsigned long long)sna->xfer.put_cpu,
+		       (unsigned long long)sna->xfer.get_blt,
+		       (unsigned long long)sna->xfer.get_cpu);
+	if (sna->xfer.video_frames)
+		xf86DrvMsgVerb(scrn, X_INFO, 3,
+			       "Xv: %u frames, %llu bytes copied by CPU (%llu per frame), %llu bytes sampled in place\n",
+			       sna->xfer.video_frames,
+			       (unsigned long long)sna->xfer.video_cpu,
+			       (unsigned long long)(sna->xfer.video_cpu / sna->xfer.video_frames),
+			       (unsigned long long)sna->xfer.video_zero);
+	xf86DrvMsgVerb(scrn, X_INFO, 3,
+		       "Migrations: %u uploads, %llu bytes; %u downloads, %llu bytes\n",
+		       sna->xfer.uploads,
+		       (unsigned long long)sna->xfer.upload_bytes,
+		       sna->xfer.downloads,
+		       (unsigned long long)sna->xfer.download_bytes);
+	xf86DrvMsgVerb(scrn, X_INFO, 3,
+		       "Uploads: %u boxes saved by coalescing, %u pixmaps batched in the block handler\n",
+		       sna->xfer.upload_boxes_saved,
+		       sna->xfer.upload_batched);
+	xf86DrvMsgVerb(scrn, X_INFO, 3,
+		       "COW: %u copies shared, %llu bytes; %llu bytes copied on write\n",
+		       sna->xfer.cow_shared,
+		       (unsigned long long)sna->xfer.cow_shared_bytes,
+		       (unsigned long long)sna->xfer.cow_copied_bytes);
+	xf86DrvMsgVerb(scrn, X_INFO, 3,
+		       "GetImage prefetch: %u copies, %llu bytes; %llu bytes served\n",
+		       sna->xfer.prefetch,
+		       (unsigned long long)sna->xfer.prefetch_bytes,
+		       (unsigned long long)sna->xfer.get_prefetch);
+	memset(&sna->xfer, 0, sizeof(sna->xfer));
+
+	if (sna->mode.redisplay.frames)
+		xf86DrvMsgVerb(scrn, X_INFO, 3,
+			       "TearFree: %u frames, %llu pixels repainted (%llu per frame)\n",
+			       sna->mode.redisplay.frames,
+			       (unsigned long long)sna->mode.redisplay.pixels,
+			       (unsigned long long)(sna->mode.redisplay.pixels / sna->mode.redisplay.frames));
+	memset(&sna->mode.redisplay, 0, sizeof(sna->mode.redisplay));
+
+	if (sna->cursor.converted + sna->cursor.reused)
+		xf86DrvMsgVerb(scrn, X_INFO, 3,
+			       "Cursor: %u images converted, %u reused from the cache\n",
+			       sna->cursor.converted, sna->cursor.reused);
+	sna->cursor.converted = sna->cursor.reused = 0;
+}
+
 #ifdef DEBUG_MEMORY
 static bool sna_accel_do_debug_memory(struct sna *sna)
 {
@@ -17771,6 +18629,8 @@ static void sna_accel_debug_memory(struct sna *sna)
 	       (unsigned long)sna->kgem.debug_memory.bo_bytes,
 	       sna->debug_memory.cpu_bo_allocs,
 	       (unsigned long)sna->debug_memory.cpu_bo_bytes);
+	sna_accel_report_xfer(sna);
+	sna_mode_report_pacing(sna);
 
 #ifdef VALGRIND_DO_ADDED_LEAK_CHECK
 	VG(VALGRIND_DO_ADDED_LEAK_CHECK);
@@ -17782,7 +18642,105 @@ static void sna_accel_debug_memory(struct sna *sna)
 static void sna_accel_debug_memory(struct sna *sna) { }
 #endif
 
-static ShmFuncs shm_funcs = { sna_pixmap_create_shm, NULL };
+static void
+sna_shm_put_image(DrawablePtr drawable, GCPtr gc, int depth,
+		  unsigned int format, int w, int h,
+		  int sx, int sy, int sw, int sh, int dx, int dy,
+		  char *data)
+{
+	PixmapPtr pixmap = get_drawable_pixmap(drawable);
+
+	DBG(("%s: (%d, %d)x(%d, %d) of %dx%d to (%d, %d), depth=%d, format=%d\n",
+	     __FUNCTION__, sx, sy, sw, sh, w, h, dx, dy, depth, format));
+
+	/* Upload the sub-image straight out of the segment, rather than
+	 * wrapping the segment in a scratch pixmap to feed into CopyArea.
+	 */
+	if (ACCEL_PUT_IMAGE && !FORCE_FALLBACK &&
+	    format == ZPixmap && depth == drawable->depth &&
+	    PM_IS_SOLID(drawable, gc->planemask) &&
+	    sna_pixmap(pixmap) != NULL &&
+	    !wedged(to_sna_from_pixmap(pixmap))) {
+		RegionRec region;
+		int16_t tx, ty;
+		bool ok;
+
+		region.extents.x1 = dx + drawable->x;
+		region.extents.y1 = dy + drawable->y;
+		region.extents.x2 = region.extents.x1 + sw;
+		region.extents.y2 = region.extents.y1 + sh;
+		region.data = NULL;
+
+		if (!RegionIntersect(&region, &region, gc->pCompositeClip) ||
+		    box_empty(&region.extents)) {
+			RegionUninit(&region);
+			return;
+		}
+
+		get_drawable_deltas(drawable, pixmap, &tx, &ty);
+		RegionTranslate(&region, tx, ty);
+
+		ok = sna_put_zpixmap_blt(drawable, gc, &region,
+					 dx - sx, dy - sy, w, h,
+					 data, PixmapBytePad(w, depth));
+		if (ok) {
+			/* Bypassing gc->ops also bypasses the Damage wrappers,
+			 * so report the update ourselves, to clients and to
+			 * our own watchers of the front buffer alike.
+			 */
+			RegionTranslate(&region, -tx, -ty);
+			DamageDamageRegion(drawable, &region);
+		}
+		RegionUninit(&region);
+		if (ok)
+			return;
+	}
+
+	/* Otherwise, exactly as the core ShmPutImage would have done */
+	if (format == ZPixmap || (format == XYPixmap && depth == 1)) {
+		pixmap = GetScratchPixmapHeader(drawable->pScreen, w, h, depth,
+						bits_per_pixel(depth),
+						PixmapBytePad(w, depth),
+						data);
+		if (pixmap == NullPixmap)
+			return;
+
+		gc->ops->CopyArea(&pixmap->drawable, drawable, gc,
+				  sx, sy, sw, sh, dx, dy);
+		FreeScratchPixmapHeader(pixmap);
+	} else {
+		GCPtr put;
+
+		put = GetScratchGC(depth, drawable->pScreen);
+		if (put == NULL)
+			return;
+
+		pixmap = drawable->pScreen->CreatePixmap(drawable->pScreen,
+							 sw, sh, depth,
+							 CREATE_PIXMAP_USAGE_SCRATCH);
+		if (pixmap == NullPixmap) {
+			FreeScratchGC(put);
+			return;
+		}
+
+		ValidateGC(&pixmap->drawable, put);
+		put->ops->PutImage(&pixmap->drawable, put, depth,
+				   -sx, -sy, w, h, 0,
+				   format == XYPixmap ? XYPixmap : ZPixmap,
+				   data);
+		FreeScratchGC(put);
+
+		if (format == XYBitmap)
+			gc->ops->CopyPlane(&pixmap->drawable, drawable, gc,
+					   0, 0, sw, sh, dx, dy, 1);
+		else
+			gc->ops->CopyArea(&pixmap->drawable, drawable, gc,
+					  0, 0, sw, sh, dx, dy);
+		drawable->pScreen->DestroyPixmap(pixmap);
+	}
+}
+
+static ShmFuncs shm_funcs = { sna_pixmap_create_shm, sna_shm_put_image };
 
 static PixmapPtr
 sna_get_window_pixmap(WindowPtr window)
@@ -17892,8 +18850,10 @@ sna_set_screen_pixmap(PixmapPtr pixmap)
 	screen->devPrivate = pixmap;
 	pixmap->refcnt++;
 
-	if (old_front)
+	if (old_front) {
+		sna_readback_reset(to_sna_from_pixmap(pixmap));
 		dixDestroyPixmap(old_front, 0);
+	}
 }
 
 static Bool
@@ -18045,6 +19005,7 @@ bool sna_accel_init(ScreenPtr screen, struct sna *sna)
 
 	list_init(&sna->flush_pixmaps);
 	list_init(&sna->active_pixmaps);
+	list_init(&sna->upload_pixmaps);
 
 	SetNotifyFd(sna->kgem.fd, sna_accel_notify, X_NOTIFY_READ, sna);
 
@@ -18111,6 +19072,11 @@ bool sna_accel_init(ScreenPtr screen, struct sna *sna)
 	if (!sna_picture_init(screen))
 		return false;
 
+	fbSimdInit((sna->cpu_features & AVX2 ? FB_SIMD_AVX2 : 0) |
+		   (sna->cpu_features & SSE2 ? FB_SIMD_SSE2 : 0));
+	DBG(("%s: using %s fb fallbacks\n", __FUNCTION__, fbSimdName()));
+	rotate_blt_init(sna->cpu_features & SSE2 ? ROTATE_SSE2 : 0);
+
 	backend = no_render_init(sna);
 	if (sna_option_accel_none(sna)) {
 		backend = "disabled";
@@ -18147,6 +19113,8 @@ bool sna_accel_init(ScreenPtr screen, struct sna *sna)
 		   "SNA initialized with %s backend\n",
 		   backend);
 
+	sna_trace_init(sna);
+	sna_readback_init(sna);
 	return true;
 }
 
@@ -18257,11 +19225,15 @@ void sna_accel_close(struct sna *sna)
 {
 	DBG(("%s\n", __FUNCTION__));
 
+	sna_accel_report_xfer(sna);
+
 	sna_composite_close(sna);
 	sna_gradients_close(sna);
 	sna_glyphs_close(sna);
 
 	sna_pixmap_expire(sna);
+	sna_readback_fini(sna);
+	sna_trace_fini(sna);
 
 	DeleteCallback(&FlushCallback, sna_shm_flush_callback, sna);
 	DeleteCallback(&FlushCallback, sna_flush_callback, sna);
@@ -18292,6 +19264,12 @@ void sna_accel_block(struct sna *sna, struct timeval **tv)
 	if (sna->mode.dirty)
 		sna_crtc_config_notify(sna->scrn->pScreen);
 
+	if (!list_is_empty(&sna->upload_pixmaps))
+		sna_accel_upload(sna);
+
+	if (sna->readback.damage)
+		sna_readback_prefetch(sna);
+
 restart:
 	if (sna_scanout_do_flush(sna))
 		sna_scanout_flush(sna);
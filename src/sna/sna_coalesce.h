@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef SNA_COALESCE_H
+#define SNA_COALESCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pixman.h>
+
+/*
+ * Merge the boxes of a damage region into fewer, larger boxes before
+ * uploading them. CPU damage from text and small core drawing decomposes
+ * into a great many tiny boxes, each costing a separate copy (and a
+ * separate blit) to upload, when a handful of rectangles would have done.
+ *
+ * Boxes are merged greedily in the order given, which for a region is
+ * y-x banded, into the few boxes most recently started, so that the
+ * glyphs along a line of text, and then the bands of that line, collapse
+ * into a single box. A merge is accepted only if it wastes little, i.e. the
+ * merged box is not much larger than the pixels it was asked to cover,
+ * and only if the caller allows it: the extra pixels swept up are copied
+ * as well, which is only safe where both copies are already in agreement.
+ * The merged boxes may overlap.
+ */
+
+#define COALESCE_SLACK 256 /* pixels we may waste for free per merge */
+#define COALESCE_OPEN 8 /* boxes still growing, e.g. the bands of a line */
+
+struct coalesce_box {
+	pixman_box16_t box;
+	int64_t covered; /* pixels asked for, excluding the waste */
+};
+
+static inline int64_t __coalesce_area(const pixman_box16_t *b)
+{
+	return (int64_t)(b->x2 - b->x1) * (b->y2 - b->y1);
+}
+
+static inline bool
+__coalesce_merge(struct coalesce_box *dst, const pixman_box16_t *box,
+		 int64_t covered,
+		 bool (*allow)(void *closure, const pixman_box16_t *box),
+		 void *closure)
+{
+	pixman_box16_t u;
+	int64_t want;
+
+	u.x1 = dst->box.x1 < box->x1 ? dst->box.x1 : box->x1;
+	u.y1 = dst->box.y1 < box->y1 ? dst->box.y1 : box->y1;
+	u.x2 = dst->box.x2 > box->x2 ? dst->box.x2 : box->x2;
+	u.y2 = dst->box.y2 > box->y2 ? dst->box.y2 : box->y2;
+
+	want = dst->covered + covered;
+	if (__coalesce_area(&u) > want + want / 2 + COALESCE_SLACK)
+		return false;
+
+	if (allow && !allow(closure, &u))
+		return false;
+
+	dst->box = u;
+	dst->covered = want;
+	return true;
+}
+
+/* Returns the number of boxes written to out[], which has room for n */
+static inline int
+box_coalesce(const pixman_box16_t *box, int n, pixman_box16_t *out,
+	     bool (*allow)(void *closure, const pixman_box16_t *box),
+	     void *closure)
+{
+	struct coalesce_box open[COALESCE_OPEN];
+	int count = 0, num_open = 0, i, j;
+
+	while (n--) {
+		for (i = num_open; i--; ) {
+			if (__coalesce_merge(&open[i], box,
+					     __coalesce_area(box),
+					     allow, closure))
+				break;
+		}
+
+		if (i < 0) {
+			if (num_open == COALESCE_OPEN) {
+				out[count++] = open[0].box;
+				for (j = 1; j < num_open; j++)
+					open[j-1] = open[j];
+				num_open--;
+			}
+			open[num_open].box = *box;
+			open[num_open].covered = __coalesce_area(box);
+			num_open++;
+		} else {
+			/* Having grown, it may now swallow its neighbours */
+			for (j = num_open; j--; ) {
+				if (j == i)
+					continue;
+
+				if (__coalesce_merge(&open[i], &open[j].box,
+						     open[j].covered,
+						     allow, closure)) {
+					open[j] = open[--num_open];
+					if (i == num_open)
+						i = j;
+					j = num_open;
+				}
+			}
+		}
+		box++;
+	}
+
+	for (i = 0; i < num_open; i++)
+		out[count++] = open[i].box;
+
+	return count;
+}
+
+#endif /* SNA_COALESCE_H */
@@ -467,6 +467,61 @@ static inline bool use_cpu(PixmapPtr pixmap, struct sna_pixmap *priv,
 	return (priv->create & KGEM_CAN_CREATE_GPU) == 0;
 }
 
+/* A copy of one whole pixmap over another of the same format can be
+ * replaced by sharing the source bo copy-on-write.
+ */
+static bool share_cow(struct sna *sna, CARD8 op,
+		      PicturePtr src, PicturePtr mask, PicturePtr dst,
+		      const RegionRec *region,
+		      INT16 src_x, INT16 src_y,
+		      INT16 dst_x, INT16 dst_y)
+{
+	PixmapPtr src_pixmap, dst_pixmap;
+	int16_t sx, sy, dx, dy;
+
+	if (mask || src == NULL || src->pDrawable == NULL)
+		return false;
+
+	if (op != PictOpSrc &&
+	    !(op == PictOpOver && !PICT_FORMAT_A(src->format)))
+		return false;
+
+	if (src->format != dst->format ||
+	    src->transform || src->alphaMap || dst->alphaMap)
+		return false;
+
+	/* pixman applies a convolution even without a transform */
+	if (src->filter == PictFilterConvolution)
+		return false;
+
+	if (region->data)
+		return false;
+
+	src_pixmap = get_drawable_pixmap(src->pDrawable);
+	dst_pixmap = get_drawable_pixmap(dst->pDrawable);
+	if (src_pixmap == dst_pixmap)
+		return false;
+
+	get_drawable_deltas(dst->pDrawable, dst_pixmap, &dx, &dy);
+	if (region->extents.x1 + dx > 0 ||
+	    region->extents.y1 + dy > 0 ||
+	    region->extents.x2 + dx < dst_pixmap->drawable.width ||
+	    region->extents.y2 + dy < dst_pixmap->drawable.height)
+		return false;
+
+	/* and the source lands on it pixel for pixel */
+	get_drawable_deltas(src->pDrawable, src_pixmap, &sx, &sy);
+	if (src_x + src->pDrawable->x + sx != dst_x + dst->pDrawable->x + dx ||
+	    src_y + src->pDrawable->y + sy != dst_y + dst->pDrawable->y + dy)
+		return false;
+
+	DBG(("%s: sharing src pixmap=%ld with dst pixmap=%ld\n",
+	     __FUNCTION__,
+	     src_pixmap->drawable.serialNumber,
+	     dst_pixmap->drawable.serialNumber));
+	return sna_pixmap_share_cow(sna, src_pixmap, dst_pixmap);
+}
+
 static void validate_source(PicturePtr picture)
 {
 	miCompositeSourceValidate(picture);
@@ -639,6 +694,7 @@ sna_composite(CARD8 op,
 	struct sna_composite_op tmp;
 	RegionRec region;
 	struct sna *sna;
+	unsigned reason = SNA_TRACE_NONE;
 	int dx, dy;
 
 	DBG(("%s(pixmap=%ld, op=%d, src=%ld+(%d, %d), mask=%ld+(%d, %d), dst=%ld+(%d, %d)+(%d, %d), size=(%d, %d)\n",
@@ -681,6 +737,7 @@ sna_composite(CARD8 op,
 
 	if (!can_render_to_picture(dst)) {
 		DBG(("%s: fallback due to unhandled picture\n", __FUNCTION__));
+		reason = SNA_TRACE_PICTURE;
 		goto fallback;
 	}
 
@@ -688,23 +745,30 @@ sna_composite(CARD8 op,
 	if (priv == NULL) {
 		DBG(("%s: fallback as destination pixmap=%ld is unattached\n",
 		     __FUNCTION__, pixmap->drawable.serialNumber));
+		reason = SNA_TRACE_UNATTACHED;
 		goto fallback;
 	}
 
 	sna = to_sna_from_pixmap(pixmap);
 	if (wedged(sna)) {
 		DBG(("%s: fallback -- wedged\n", __FUNCTION__));
+		reason = SNA_TRACE_WEDGED;
 		goto fallback;
 	}
 
 	if (op == PictOpClear)
 		src = sna->clear;
 
+	if (share_cow(sna, op, src, mask, dst, &region,
+		      src_x, src_y, dst_x, dst_y))
+		goto out;
+
 	if (use_cpu(pixmap, priv, op, width, height) &&
 	    !picture_is_gpu(sna, src, PREFER_GPU_RENDER) &&
 	    !picture_is_gpu(sna, mask, PREFER_GPU_RENDER)) {
 		DBG(("%s: fallback, dst pixmap=%ld is too small (or completely damaged)\n",
 		     __FUNCTION__, pixmap->drawable.serialNumber));
+		reason = SNA_TRACE_SMALL;
 		goto fallback;
 	}
 
@@ -746,6 +810,7 @@ sna_composite(CARD8 op,
 				   region.data ? COMPOSITE_PARTIAL : 0,
 				   memset(&tmp, 0, sizeof(tmp)))) {
 		DBG(("%s: fallback due unhandled composite op\n", __FUNCTION__));
+		reason = SNA_TRACE_UNSUPPORTED;
 		goto fallback;
 	}
 	assert(!tmp.damage || !DAMAGE_IS_ALL(*tmp.damage));
@@ -759,10 +824,15 @@ sna_composite(CARD8 op,
 	apply_damage(&tmp, &region);
 	tmp.done(sna, &tmp);
 
+	sna_trace(sna, SNA_TRACE_COMPOSITE,
+		  tmp.dst.bo == priv->cpu_bo ? SNA_TRACE_CPU_BO : sna_trace_engine(sna),
+		  SNA_TRACE_NONE, pixmap, &region.extents, 0);
 	goto out;
 
 fallback:
 	DBG(("%s: fallback -- fbComposite\n", __FUNCTION__));
+	sna_trace(to_sna_from_drawable(dst->pDrawable), SNA_TRACE_COMPOSITE,
+		  SNA_TRACE_CPU, reason, pixmap, &region.extents, 0);
 	sna_composite_fb(op, src, mask, dst, &region,
 			 src_x,  src_y,
 			 mask_x, mask_y,
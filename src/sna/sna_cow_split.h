@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#ifndef SNA_COW_SPLIT_H
+#define SNA_COW_SPLIT_H
+
+#include <pixman.h>
+
+/*
+ * When a pixmap sharing its bo copy-on-write is written to, it has to be
+ * given its own bo, and everything it does not overwrite copied across.
+ * Rather than copy the whole pixmap only to then draw over part of it,
+ * we copy just the pixmap outside the area about to be overwritten.
+ *
+ * That area is shrunk to whole tiles, so that the copy stays aligned to
+ * the tiling of the new bo; copying a little too much is harmless, as it
+ * is overwritten in turn. The remainder is returned as at most 4 boxes,
+ * full width above and below, and either side of the overwritten band.
+ */
+
+static inline int __cow_round_up(int v, int align)
+{
+	return (v + align - 1) / align * align;
+}
+
+static inline int __cow_round_down(int v, int align)
+{
+	return v / align * align;
+}
+
+/* Returns the number of boxes (at most 4) written to out[] */
+static inline int
+cow_split(const pixman_box16_t *write, int width, int height,
+	  int tile_width, int tile_height, pixman_box16_t *out)
+{
+	int x1, y1, x2, y2;
+	int n = 0;
+
+	x1 = write->x1 <= 0 ? 0 : __cow_round_up(write->x1, tile_width);
+	y1 = write->y1 <= 0 ? 0 : __cow_round_up(write->y1, tile_height);
+	x2 = write->x2 >= width ? width : __cow_round_down(write->x2, tile_width);
+	y2 = write->y2 >= height ? height : __cow_round_down(write->y2, tile_height);
+
+	if (x1 >= x2 || y1 >= y2) {
+		out[0].x1 = out[0].y1 = 0;
+		out[0].x2 = width;
+		out[0].y2 = height;
+		return 1;
+	}
+
+	if (y1 > 0) {
+		out[n].x1 = 0;
+		out[n].y1 = 0;
+		out[n].x2 = width;
+		out[n].y2 = y1;
+		n++;
+	}
+	if (x1 > 0) {
+		out[n].x1 = 0;
+		out[n].y1 = y1;
+		out[n].x2 = x1;
+		out[n].y2 = y2;
+		n++;
+	}
+	if (x2 < width) {
+		out[n].x1 = x2;
+		out[n].y1 = y1;
+		out[n].x2 = width;
+		out[n].y2 = y2;
+		n++;
+	}
+	if (y2 < height) {
+		out[n].x1 = 0;
+		out[n].y1 = y2;
+		out[n].x2 = width;
+		out[n].y2 = height;
+		n++;
+	}
+
+	return n;
+}
+
+#endif /* SNA_COW_SPLIT_H */
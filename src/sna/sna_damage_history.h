@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef SNA_DAMAGE_HISTORY_H
+#define SNA_DAMAGE_HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pixman.h>
+
+/*
+ * A short ring of the damage that went into each of the last few frames
+ * presented on a scanout, so that when we reuse an old scanout buffer we
+ * only need to repaint what has changed since that buffer was last
+ * shown, i.e. buffer-age. Frames are numbered from 1, and a buffer
+ * tagged with frame 0 has unknown contents and must be fully repainted.
+ */
+
+#define DAMAGE_HISTORY 4
+
+struct damage_history {
+	pixman_region16_t frame[DAMAGE_HISTORY];
+	uint32_t serial;
+};
+
+static inline void damage_history_init(struct damage_history *h)
+{
+	int n;
+
+	for (n = 0; n < DAMAGE_HISTORY; n++)
+		pixman_region_init(&h->frame[n]);
+	h->serial = 0;
+}
+
+static inline void damage_history_fini(struct damage_history *h)
+{
+	int n;
+
+	for (n = 0; n < DAMAGE_HISTORY; n++)
+		pixman_region_fini(&h->frame[n]);
+}
+
+/* Forget all history, every old buffer now requires a full repaint */
+static inline void damage_history_reset(struct damage_history *h)
+{
+	int n;
+
+	for (n = 0; n < DAMAGE_HISTORY; n++) {
+		pixman_region_fini(&h->frame[n]);
+		pixman_region_init(&h->frame[n]);
+	}
+	h->serial += DAMAGE_HISTORY + 1;
+}
+
+/*
+ * Accumulate into region the damage of every frame presented since a
+ * buffer holding frame 'since'. Returns false if that reaches further
+ * back than we remember, in which case the buffer needs repainting.
+ */
+static inline bool damage_history_since(const struct damage_history *h,
+					pixman_region16_t *region,
+					uint32_t since)
+{
+	uint32_t n;
+
+	if (since == 0 || h->serial - since >= DAMAGE_HISTORY + 1u)
+		return false;
+
+	for (n = since + 1; (int32_t)(h->serial - n) >= 0; n++)
+		pixman_region_union(region, region,
+				    (pixman_region16_t *)&h->frame[n % DAMAGE_HISTORY]);
+
+	return true;
+}
+
+/* Record the damage of the next frame, returning its serial */
+static inline uint32_t damage_history_push(struct damage_history *h,
+					   pixman_region16_t *region)
+{
+	if (++h->serial == 0)
+		damage_history_reset(h);
+
+	pixman_region_copy(&h->frame[h->serial % DAMAGE_HISTORY], region);
+	return h->serial;
+}
+
+#endif /* SNA_DAMAGE_HISTORY_H */
@@ -55,6 +55,8 @@ void *alloca(size_t);
 
 #include "sna.h"
 #include "sna_reg.h"
+#include "sna_damage_history.h"
+#include "sna_frame_pacing.h"
 #include "fb/fbpict.h"
 #include "intel_options.h"
 #include "backlight.h"
@@ -101,6 +103,12 @@ union compat_mode_get_connector{
 
 #define OUTPUT_STATUS_CACHE_MS 15000
 
+/* Number of buffers (2-4) a transformed CRTC may cycle through with TearFree */
+#define TEAR_FREE_DEPTH 3
+
+/* Number of converted cursor images kept for reuse, e.g. animation frames */
+#define CURSOR_CACHE_SIZE 16
+
 #define DRM_MODE_PAGE_FLIP_ASYNC 0x02
 
 #define DRM_CLIENT_CAP_UNIVERSAL_PLANES 2
@@ -169,6 +177,7 @@ extern XF86ConfigPtr xf86configptr;
 struct sna_cursor {
 	struct sna_cursor *next;
 	uint32_t *image;
+	uint64_t hash;
 	bool transformed;
 	Rotation rotation;
 	int ref;
@@ -187,7 +196,7 @@ struct sna_crtc {
 	struct drm_mode_modeinfo kmode;
 	PixmapPtr slave_pixmap;
 	DamagePtr slave_damage;
-	struct kgem_bo *bo, *shadow_bo, *client_bo, *cache_bo;
+	struct kgem_bo *bo, *shadow_bo, *client_bo;
 	struct sna_cursor *cursor;
 	unsigned int last_cursor_size;
 	uint32_t offset;
@@ -200,7 +209,12 @@ struct sna_crtc {
 
 	struct pixman_f_transform cursor_to_fb, fb_to_cursor;
 
-	RegionRec crtc_damage;
+	/* TearFree buffers for a transformed CRTC, tagged by frame */
+	struct sna_crtc_scanout {
+		struct kgem_bo *bo;
+		uint32_t frame;
+	} scanout[TEAR_FREE_DEPTH];
+	struct damage_history history;
 	uint16_t shadow_bo_width, shadow_bo_height;
 
 	uint32_t rotation;
@@ -229,6 +243,7 @@ struct sna_crtc {
 
 	uint32_t last_seq, wrap_seq;
 	struct ust_msc swap;
+	struct frame_pacing pacing;
 
 	sna_flip_handler_t flip_handler;
 	struct kgem_bo *flip_bo;
@@ -532,6 +547,9 @@ uint64_t sna_crtc_record_swap(xf86CrtcPtr crtc,
 		sna_crtc->swap.tv_sec = tv_sec;
 		sna_crtc->swap.tv_usec = tv_usec;
 		sna_crtc->swap.msc = msc;
+		frame_pacing_vblank(&sna_crtc->pacing, ust64(tv_sec, tv_usec), msc);
+		vblank_clock_sync(&sna_crtc->public.fake_vblank,
+				  msc, ust64(tv_sec, tv_usec));
 	} else {
 		DBG(("%s: swap event on crtc=%d, frame %d [msc=%08lld], time %d.%06d\n",
 		     __FUNCTION__, __sna_crtc_index(sna_crtc), seq, (long long)msc,
@@ -1497,6 +1515,15 @@ static void kmsg_open(struct kmsg *k) {}
 static void kmsg_close(struct kmsg *k, int dump) {}
 #endif
 
+/* The refresh period in microseconds, from the mode timings */
+static uint32_t mode_period(const struct drm_mode_modeinfo *mode)
+{
+	if (mode->clock == 0)
+		return 0;
+
+	return (uint64_t)mode->htotal * mode->vtotal * 1000 / mode->clock;
+}
+
 static int
 sna_crtc_apply(xf86CrtcPtr crtc)
 {
@@ -1618,6 +1645,11 @@ sna_crtc_apply(xf86CrtcPtr crtc)
 	}
 
 	sna_crtc->mode_serial++;
+	frame_pacing_reset(&sna_crtc->pacing, mode_period(&arg.mode));
+	vblank_clock_set_mode(&sna_crtc->public.fake_vblank,
+			      vblank_clock_now(),
+			      arg.mode.htotal, arg.mode.vtotal,
+			      arg.mode.clock);
 	sna_crtc_force_outputs_on(crtc);
 
 unblock:
@@ -2114,6 +2146,23 @@ static void sna_crtc_disable_shadow(struct sna *sna, struct sna_crtc *crtc)
 	crtc->shadow = false;
 }
 
+static void sna_crtc_release_scanouts(struct sna *sna, struct sna_crtc *crtc)
+{
+	int n;
+
+	for (n = 0; n < TEAR_FREE_DEPTH; n++) {
+		if (crtc->scanout[n].bo == NULL)
+			continue;
+
+		DBG(("%s: releasing TearFree buffer handle=%d from CRTC:%d\n",
+		     __FUNCTION__, crtc->scanout[n].bo->handle, __sna_crtc_id(crtc)));
+		kgem_bo_destroy(&sna->kgem, crtc->scanout[n].bo);
+		crtc->scanout[n].bo = NULL;
+	}
+
+	damage_history_reset(&crtc->history);
+}
+
 static void
 __sna_crtc_disable(struct sna *sna, struct sna_crtc *sna_crtc)
 {
@@ -2149,6 +2198,7 @@ __sna_crtc_disable(struct sna *sna, struct sna_crtc *sna_crtc)
 		kgem_bo_destroy(&sna->kgem, sna_crtc->shadow_bo);
 		sna_crtc->shadow_bo = NULL;
 	}
+	sna_crtc_release_scanouts(sna, sna_crtc);
 	if (sna_crtc->transform) {
 		assert(sna->mode.rr_active);
 		sna->mode.rr_active--;
@@ -2575,10 +2625,7 @@ static struct kgem_bo *sna_crtc_attach(xf86CrtcPtr crtc)
 	}
 	sna_crtc->rotation = RR_Rotate_0;
 
-	if (sna_crtc->cache_bo) {
-		kgem_bo_destroy(&sna->kgem, sna_crtc->cache_bo);
-		sna_crtc->cache_bo = NULL;
-	}
+	sna_crtc_release_scanouts(sna, sna_crtc);
 
 	if (use_shadow(sna, crtc)) {
 		PixmapPtr front;
@@ -2689,6 +2736,11 @@ force_shadow:
 		sna_crtc->shadow_bo_height = crtc->mode.VDisplay;
 		sna_crtc->shadow_bo = bo;
 out_shadow:
+		/* The shadow is also the first of the TearFree buffers */
+		assert(sna_crtc->scanout[0].bo == NULL);
+		sna_crtc->scanout[0].bo = kgem_bo_reference(bo);
+		sna_crtc->scanout[0].frame = 0;
+
 		sna_crtc->transform = true;
 		sna->mode.rr_active++;
 		return kgem_bo_reference(bo);
@@ -2948,7 +3000,7 @@ sna_crtc_damage(xf86CrtcPtr crtc)
 	assert(sna->mode.shadow_damage && sna->mode.shadow_active);
 	damage = DamageRegion(sna->mode.shadow_damage);
 	RegionUnion(damage, damage, &region);
-	to_sna_crtc(crtc)->crtc_damage = region;
+	damage_history_reset(&to_sna_crtc(crtc)->history);
 
 	DBG(("%s: damage now %dx[(%d, %d), (%d, %d)]\n",
 	     __FUNCTION__,
@@ -3250,6 +3302,7 @@ sna_crtc_destroy(xf86CrtcPtr crtc)
 		return;
 
 	free(sna_crtc->gamma_lut);
+	damage_history_fini(&sna_crtc->history);
 
 	list_for_each_entry_safe(sprite, sn, &sna_crtc->sprites, link)
 		free(sprite);
@@ -3769,7 +3822,10 @@ sna_crtc_add(ScrnInfoPtr scrn, unsigned id, int index)
 	if (sna_crtc == NULL)
 		return false;
 
-	list_init(&sna_crtc->public.vblank_queue);
+	vblank_wheel_init(&sna_crtc->public.vblank_queue);
+	damage_history_init(&sna_crtc->history);
+	frame_pacing_reset(&sna_crtc->pacing, 0);
+	vblank_clock_init(&sna_crtc->public.fake_vblank, vblank_clock_now());
 	sna_crtc->id = id;
 
 	VG_CLEAR(get_pipe);
@@ -6070,14 +6126,23 @@ rotate_coord(Rotation rotation, int size,
 
 static struct sna_cursor *__sna_create_cursor(struct sna *sna, int size)
 {
-	struct sna_cursor *c;
+	struct sna_cursor *c, *lru = NULL;
 
+	/* Keep the idle images around for when the cursor returns to them
+	 * (as the frames of an animated cursor do), and only recycle the
+	 * least recently used once the cache is full.
+	 */
 	for (c = sna->cursor.cursors; c; c = c->next) {
-		if (c->ref == 0 && c->alloc >= size) {
-			__DBG(("%s: stealing handle=%d, serial=%d, rotation=%d, alloc=%d\n",
-			       __FUNCTION__, c->handle, c->serial, c->rotation, c->alloc));
-			return c;
-		}
+		if (c->ref == 0 && c->alloc >= size &&
+		    (lru == NULL || (int)(c->serial - lru->serial) < 0))
+			lru = c;
+	}
+	if (lru &&
+	    (sna->cursor.num_cursors >= CURSOR_CACHE_SIZE ||
+	     sna->cursor.stash == NULL)) {
+		__DBG(("%s: stealing handle=%d, serial=%d, rotation=%d, alloc=%d\n",
+		       __FUNCTION__, lru->handle, lru->serial, lru->rotation, lru->alloc));
+		return lru;
 	}
 
 	__DBG(("%s(size=%d, num_stash=%d)\n", __FUNCTION__, size, sna->cursor.num_stash));
@@ -6115,6 +6180,7 @@ static struct sna_cursor *__sna_create_cursor(struct sna *sna, int size)
 
 	c->next = sna->cursor.cursors;
 	sna->cursor.cursors = c;
+	sna->cursor.num_cursors++;
 
 	return c;
 }
@@ -6128,6 +6194,40 @@ static uint32_t *get_cursor_argb(CursorPtr c)
 #endif
 }
 
+/* Identifies the image, so that a cursor reappearing (or another cursor
+ * with identical contents) can reuse an earlier conversion.
+ */
+static uint64_t cursor_hash(struct sna *sna, CursorPtr c)
+{
+	const uint32_t *argb = get_cursor_argb(c);
+	uint64_t hash = 0xcbf29ce484222325ull; /* FNV-1a */
+	const uint8_t *p;
+	int n;
+
+#define HASH(v) hash = (hash ^ (v)) * 0x100000001b3ull
+	HASH(c->bits->width);
+	HASH(c->bits->height);
+	if (argb) {
+		n = c->bits->width * c->bits->height;
+		while (n--)
+			HASH(*argb++);
+	} else {
+		HASH(sna->cursor.fg);
+		HASH(sna->cursor.bg);
+
+		n = BitmapBytePad(c->bits->width) * c->bits->height;
+		for (p = c->bits->source; n--; p++)
+			HASH(*p);
+
+		n = BitmapBytePad(c->bits->width) * c->bits->height;
+		for (p = c->bits->mask; n--; p++)
+			HASH(*p);
+	}
+#undef HASH
+
+	return hash;
+}
+
 static int __cursor_size(int width, int height)
 {
 	int i, size;
@@ -6234,19 +6334,28 @@ static struct sna_cursor *__sna_get_cursor(struct sna *sna, xf86CrtcPtr crtc)
 	/* Don't allow phys cursor sharing */
 	if (sna->cursor.use_gtt && !transformed) {
 		for (cursor = sna->cursor.cursors; cursor; cursor = cursor->next) {
-			if (cursor->serial == sna->cursor.serial &&
+			if (cursor->hash == sna->cursor.hash &&
+			    cursor->size == sna->cursor.size &&
 			    cursor->rotation == rotation &&
 			    !cursor->transformed) {
 				__DBG(("%s: reusing handle=%d, serial=%d, rotation=%d, size=%d\n",
 				       __FUNCTION__, cursor->handle, cursor->serial, cursor->rotation, cursor->size));
-				assert(cursor->size == sna->cursor.size);
+				if (cursor->serial != sna->cursor.serial) {
+					cursor->serial = sna->cursor.serial;
+					sna->cursor.reused++;
+				}
 				return cursor;
 			}
 		}
 	}
 
+	/* Rather than overwrite the image on display, which may be wanted
+	 * again shortly, convert into a spare and keep the old one cached.
+	 */
 	cursor = to_sna_crtc(crtc)->cursor;
-	if (cursor && cursor->alloc < 4*size*size)
+	if (cursor &&
+	    (cursor->alloc < 4*size*size ||
+	     (sna->cursor.use_gtt && !transformed)))
 		cursor = NULL;
 
 	if (cursor == NULL) {
@@ -6317,6 +6426,24 @@ static struct sna_cursor *__sna_get_cursor(struct sna *sna, xf86CrtcPtr crtc)
 				   0, 0,
 				   0, 0,
 				   width, height);
+	} else if (argb) {
+		int src_x, src_y, dst_x = 0, dst_y = 0, w = size, h = size;
+		int step[4];
+
+		/* rotate_coord() is affine, so walk it in tiles instead */
+		rotate_coord(rotation, size, 0, 0, &src_x, &src_y);
+		rotate_coord(rotation, size, 1, 0, &x, &y);
+		step[0] = x - src_x;
+		step[1] = y - src_y;
+		rotate_coord(rotation, size, 0, 1, &x, &y);
+		step[2] = x - src_x;
+		step[3] = y - src_y;
+
+		/* everything outside the source was cleared above */
+		if (rotate_blt_clip(width, height, &src_x, &src_y, step,
+				    &dst_x, &dst_y, &w, &h))
+			rotate_blt(argb, image, 32, width * 4, size * 4,
+				   src_x, src_y, dst_x, dst_y, w, h, step);
 	} else {
 		for (y = 0; y < size; y++)
 			for (x = 0; x < size; x++) {
@@ -6324,20 +6451,17 @@ static struct sna_cursor *__sna_get_cursor(struct sna *sna, xf86CrtcPtr crtc)
 				int xin, yin;
 
 				rotate_coord(rotation, size, x, y, &xin, &yin);
-				if (xin < width && yin < height)
-					if (argb == NULL) {
-						int byte = xin / 8;
-						int bit = xin & 7;
-						if (mask[yin*pitch + byte] & (1 << bit)) {
-							if (source[yin*pitch + byte] & (1 << bit))
-								pixel = sna->cursor.fg;
-							else
-								pixel = sna->cursor.bg;
-						} else
-							pixel = 0;
+				if (xin < width && yin < height) {
+					int byte = xin / 8;
+					int bit = xin & 7;
+					if (mask[yin*pitch + byte] & (1 << bit)) {
+						if (source[yin*pitch + byte] & (1 << bit))
+							pixel = sna->cursor.fg;
+						else
+							pixel = sna->cursor.bg;
 					} else
-						pixel = argb[yin * width + xin];
-				else
+						pixel = 0;
+				} else
 					pixel = 0;
 				image[y * size + x] = pixel;
 			}
@@ -6359,6 +6483,8 @@ static struct sna_cursor *__sna_get_cursor(struct sna *sna, xf86CrtcPtr crtc)
 	cursor->rotation = rotation;
 	cursor->transformed = transformed;
 	cursor->serial = sna->cursor.serial;
+	cursor->hash = sna->cursor.hash;
+	sna->cursor.converted++;
 	if (transformed) {
 		/* mark the transformed rectangle as dirty, not input */
 		cursor->last_width = size;
@@ -6497,6 +6623,7 @@ sna_set_cursor_colors(ScrnInfoPtr scrn, int _bg, int _fg)
 	if (get_cursor_argb(sna->cursor.ref))
 		return;
 
+	sna->cursor.hash = cursor_hash(sna, sna->cursor.ref);
 	sna->cursor.serial++;
 	__DBG(("%s: serial->%d\n", __FUNCTION__, sna->cursor.serial));
 
@@ -6577,6 +6704,7 @@ sna_hide_cursors(ScrnInfoPtr scrn)
 		if (cursor->image)
 			munmap(cursor->image, cursor->alloc);
 		gem_close(sna->kgem.fd, cursor->handle);
+		sna->cursor.num_cursors--;
 
 		cursor->next = sna->cursor.stash;
 		sna->cursor.stash = cursor;
@@ -6835,6 +6963,7 @@ sna_use_hw_cursor(ScreenPtr screen, CursorPtr cursor)
 
 	sna->cursor.ref = cursor;
 	cursor->refcnt++;
+	sna->cursor.hash = cursor_hash(sna, cursor);
 	sna->cursor.serial++;
 
 	DBG(("%s(%dx%d): ARGB?=%d, serial->%d, size->%d\n", __FUNCTION__,
@@ -7266,6 +7395,9 @@ error:
 			crtc->flip_pending = true;
 			sna->mode.flip_active++;
 
+			if (!async)
+				frame_pacing_flip(&crtc->pacing, frame_pacing_now(), 0);
+
 			DBG(("%s: recording flip on CRTC:%d handle=%d, active_scanout=%d, serial=%d\n",
 			     __FUNCTION__, __sna_crtc_id(crtc), crtc->flip_bo->handle, crtc->flip_bo->active_scanout, crtc->flip_serial));
 		} else
@@ -7793,9 +7925,13 @@ sna_crtc_config_notify(ScreenPtr screen)
 
 	/* Allow TearFree to come back on when everything is off */
 	if (!sna->mode.front_active && sna->flags & SNA_WANT_TEAR_FREE) {
-		if ((sna->flags & SNA_TEAR_FREE) == 0)
+		if ((sna->flags & SNA_TEAR_FREE) == 0) {
 			DBG(("%s: enable TearFree next modeset\n",
 			     __FUNCTION__));
+			if (sna->flags & SNA_LATE_LATCH)
+				xf86DrvMsg(sna->scrn->scrnIndex, X_INFO,
+					   "Re-enabling TearFree and late latching\n");
+		}
 
 		sna->flags |= SNA_TEAR_FREE;
 	}
@@ -8017,6 +8153,8 @@ sna_mode_close(struct sna *sna)
 	if (sna->flags & SNA_IS_HOSTED)
 		return;
 
+	sna_mode_report_pacing(sna);
+
 	sna_mode_reset(sna);
 
 	sna_cursor_close(sna);
@@ -8734,6 +8872,75 @@ inline static DrawablePtr crtc_source(xf86CrtcPtr crtc, int16_t *sx, int16_t *sy
 	}
 }
 
+/*
+ * Plain rotations and reflections are just a reordering of the pixels, so
+ * rather than sample through the transform, copy them directly in tiles.
+ */
+static bool
+sna_crtc_redisplay__rotate(xf86CrtcPtr crtc, DrawablePtr draw,
+			   int16_t sx, int16_t sy,
+			   RegionPtr region, struct kgem_bo *bo, void *ptr)
+{
+	PixmapPtr pixmap = get_drawable_pixmap(draw);
+	struct pixman_f_transform T;
+	const BoxRec *b;
+	bool ret = true;
+	int n;
+
+	if (crtc->filter || draw->bitsPerPixel < 8)
+		return false;
+
+	pixman_f_transform_init_translate(&T, sx, sy);
+	pixman_f_transform_multiply(&T, &T, &crtc->f_crtc_to_framebuffer);
+
+	kgem_bo_sync__gtt(&to_sna(crtc->scrn)->kgem, bo);
+
+	if (sigtrap_get())
+		return false;
+
+	b = region_rects(region);
+	n = region_num_rects(region);
+	do {
+		BoxRec box = *b++;
+		int x, y, w, h, src_x, src_y, step[4];
+
+		transformed_box(&box, crtc);
+		if (box.x1 < 0)
+			box.x1 = 0;
+		if (box.y1 < 0)
+			box.y1 = 0;
+		if (box.x2 > crtc->mode.HDisplay)
+			box.x2 = crtc->mode.HDisplay;
+		if (box.y2 > crtc->mode.VDisplay)
+			box.y2 = crtc->mode.VDisplay;
+		if (box_empty(&box))
+			continue;
+
+		x = box.x1;
+		y = box.y1;
+		w = box.x2 - box.x1;
+		h = box.y2 - box.y1;
+		if (!rotate_blt_transform(T.m, x, y, &src_x, &src_y, step) ||
+		    !rotate_blt_clip(pixmap->drawable.width, pixmap->drawable.height,
+				     &src_x, &src_y, step, &x, &y, &w, &h) ||
+		    w != box.x2 - box.x1 || h != box.y2 - box.y1) {
+			ret = false;
+			break;
+		}
+
+		DBG(("%s: (%d, %d)x(%d, %d) <- (%d, %d), step=[%d, %d, %d, %d]\n",
+		     __FUNCTION__, x, y, w, h, src_x, src_y,
+		     step[0], step[1], step[2], step[3]));
+
+		sna_rotate_blt(pixmap->devPrivate.ptr, ptr, draw->bitsPerPixel,
+			       pixmap->devKind, bo->pitch,
+			       src_x, src_y, x, y, w, h, step);
+	} while (--n);
+	sigtrap_put();
+
+	return ret;
+}
+
 static void
 sna_crtc_redisplay__fallback(xf86CrtcPtr crtc, RegionPtr region, struct kgem_bo *bo)
 {
@@ -8775,6 +8982,9 @@ sna_crtc_redisplay__fallback(xf86CrtcPtr crtc, RegionPtr region, struct kgem_bo
 	if (ptr == NULL)
 		return;
 
+	if (sna_crtc_redisplay__rotate(crtc, draw, sx, sy, region, bo, ptr))
+		return;
+
 	pixmap = sna_pixmap_create_unattached(screen, 0, 0, depth);
 	if (pixmap == NullPixmap)
 		return;
@@ -9042,15 +9252,128 @@ fallback:
 	sna_crtc_redisplay__fallback(crtc, region, bo);
 }
 
+/*
+ * LateLatching only paces TearFree, which we lose if a flip fails and
+ * may regain on the next modeset, so check for both as we go.
+ */
+static inline bool late_latch(struct sna *sna)
+{
+	const unsigned flags = SNA_LATE_LATCH | SNA_TEAR_FREE;
+	return (sna->flags & flags) == flags;
+}
+
+static void disable_tear_free(struct sna *sna, const char *reason)
+{
+	xf86DrvMsg(sna->scrn->scrnIndex, X_ERROR,
+		   "%s, disabling TearFree%s\n", reason,
+		   sna->flags & SNA_LATE_LATCH ? " and late latching" : "");
+	sna->flags &= ~SNA_TEAR_FREE;
+}
+
+static void pace_shadow_flip(struct sna_crtc *crtc, uint64_t start)
+{
+	uint64_t now = frame_pacing_now();
+
+	frame_pacing_flip(&crtc->pacing, now, now > start ? now - start : 0);
+}
+
+/*
+ * The time (in ms, as TIME) by which we must start the next TearFree
+ * update so that its flips catch the next vblank on every CRTC. Until
+ * we have seen a recent vblank on each, we cannot predict it.
+ */
+static bool latch_deadline(struct sna *sna, uint32_t *expire)
+{
+	xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(sna->scrn);
+	uint64_t now = frame_pacing_now();
+	uint64_t deadline = 0;
+	int i;
+
+	for (i = 0; i < sna->mode.num_real_crtc; i++) {
+		struct sna_crtc *crtc = to_sna_crtc(config->crtc[i]);
+		uint64_t d;
+
+		if (crtc->bo == NULL)
+			continue;
+
+		d = frame_pacing_deadline(&crtc->pacing, now);
+		if (d == 0)
+			return false;
+
+		if (deadline == 0 || d < deadline)
+			deadline = d;
+	}
+
+	if (deadline == 0)
+		return false;
+
+	DBG(("%s: next update in %dus\n",
+	     __FUNCTION__, (int)(deadline - now)));
+	*expire = deadline / 1000;
+	return true;
+}
+
+int sna_mode_flush_delay(struct sna *sna, int delay)
+{
+	uint32_t expire;
+
+	if (late_latch(sna) &&
+	    sna->mode.shadow_enabled &&
+	    latch_deadline(sna, &expire)) {
+		int32_t d = expire - GetTimeInMillis();
+		delay = d > 0 ? d : 0;
+	}
+
+	return delay;
+}
+
+void sna_mode_report_pacing(struct sna *sna)
+{
+	xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(sna->scrn);
+	int i;
+
+	for (i = 0; i < sna->mode.num_real_crtc; i++) {
+		struct sna_crtc *crtc = to_sna_crtc(config->crtc[i]);
+		const struct frame_pacing *p = &crtc->pacing;
+
+		if (p->frames == 0)
+			continue;
+
+		xf86DrvMsg(sna->scrn->scrnIndex, X_INFO,
+			   "CRTC:%d: %llu flips, %llu missed their vblank (by %llums in total); refresh %uus, client render %uus, latch lead %uus\n",
+			   __sna_crtc_id(crtc),
+			   (unsigned long long)p->frames,
+			   (unsigned long long)p->missed,
+			   (unsigned long long)(p->late / 1000),
+			   frame_pacing_period(p),
+			   frame_pacing_render(p),
+			   frame_pacing_lead(p));
+	}
+}
+
+void sna_crtc_record_request(xf86CrtcPtr crtc)
+{
+	struct sna_crtc *sna_crtc = to_sna_crtc(crtc);
+
+	assert(sna_crtc);
+	frame_pacing_request(&sna_crtc->pacing, frame_pacing_now());
+}
+
 static void shadow_flip_handler(struct drm_event_vblank *e,
 				void *data)
 {
 	struct sna *sna = data;
+	uint32_t expire;
+
+	/* Late latching waits for the predicted deadline of the next
+	 * vblank, otherwise we update halfway through the frame.
+	 */
+	if (!late_latch(sna) || !latch_deadline(sna, &expire))
+		expire = e->tv_sec * 1000 + e->tv_usec / 1000 +
+			sna->vblank_interval / 2;
 
 	sna->timer_active |= 1 << FLUSH_TIMER;
-	sna->timer_expire[FLUSH_TIMER] =
-		e->tv_sec * 1000 + e->tv_usec / 1000 +
-		sna->vblank_interval / 2;
+	sna->timer_expire[FLUSH_TIMER] = expire;
 }
 
 void sna_shadow_set_crtc(struct sna *sna,
@@ -9176,10 +9499,107 @@ static bool move_crtc_to_gpu(struct sna *sna)
 	return true;
 }
 
+static uint64_t region_pixels(const RegionRec *region)
+{
+	const BoxRec *box = region_rects(region);
+	int n = region_num_rects(region);
+	uint64_t pixels = 0;
+
+	while (n--) {
+		pixels += (box->x2 - box->x1) * (box->y2 - box->y1);
+		box++;
+	}
+
+	return pixels;
+}
+
+/*
+ * Choose the next TearFree buffer for a transformed CRTC and extend the
+ * damage to cover everything that buffer has missed since it was last
+ * on the CRTC. We prefer the most recent idle buffer, and only allocate
+ * another (up to TEAR_FREE_DEPTH) rather than wait upon a busy one.
+ */
+static int sna_crtc_get_scanout(struct sna *sna, xf86CrtcPtr crtc,
+				RegionPtr damage)
+{
+	struct sna_crtc *sna_crtc = to_sna_crtc(crtc);
+	struct kgem_bo *bo;
+	uint32_t frame;
+	int n, best = -1, empty = -1;
+
+	for (n = 0; n < TEAR_FREE_DEPTH; n++) {
+		bo = sna_crtc->scanout[n].bo;
+		if (bo == NULL) {
+			if (empty < 0)
+				empty = n;
+			continue;
+		}
+
+		if (bo == sna_crtc->bo || bo == sna_crtc->flip_bo)
+			continue;
+
+		if (best < 0 ||
+		    (int32_t)(sna_crtc->scanout[n].frame - sna_crtc->scanout[best].frame) > 0)
+			best = n;
+	}
+
+	if (best >= 0 && empty >= 0 &&
+	    kgem_bo_is_busy(sna_crtc->scanout[best].bo)) {
+		DBG(("%s: buffer handle=%d still busy, allocating another\n",
+		     __FUNCTION__, sna_crtc->scanout[best].bo->handle));
+		best = -1;
+	}
+
+	if (best < 0) {
+		if (empty < 0)
+			return -1;
+
+		bo = kgem_create_2d(&sna->kgem,
+				    crtc->mode.HDisplay,
+				    crtc->mode.VDisplay,
+				    crtc->scrn->bitsPerPixel,
+				    sna_crtc->bo->tiling,
+				    CREATE_SCANOUT);
+		if (bo == NULL)
+			return -1;
+
+		sna_crtc->scanout[empty].bo = bo;
+		sna_crtc->scanout[empty].frame = 0;
+		best = empty;
+	}
+
+	frame = sna_crtc->scanout[best].frame;
+	sna_crtc->scanout[best].frame =
+		damage_history_push(&sna_crtc->history, damage);
+	if (!damage_history_since(&sna_crtc->history, damage, frame)) {
+		RegionUninit(damage);
+		damage->extents = crtc->bounds;
+		damage->data = NULL;
+	}
+
+	DBG(("%s: CRTC:%d using handle=%d, age=%d, repainting %lld pixels\n",
+	     __FUNCTION__, __sna_crtc_id(sna_crtc),
+	     sna_crtc->scanout[best].bo->handle,
+	     frame ? (int)(sna_crtc->scanout[best].frame - frame) : 0,
+	     (long long)region_pixels(damage)));
+	sna->mode.redisplay.pixels += region_pixels(damage);
+	sna->mode.redisplay.frames++;
+
+	return best;
+}
+
+static void sna_crtc_drop_scanout(struct sna *sna, struct sna_crtc *crtc, int n)
+{
+	assert(crtc->scanout[n].bo);
+	kgem_bo_destroy(&sna->kgem, crtc->scanout[n].bo);
+	crtc->scanout[n].bo = NULL;
+}
+
 void sna_mode_redisplay(struct sna *sna)
 {
 	xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(sna->scrn);
 	RegionPtr region;
+	uint64_t start;
 	int i;
 
 	if (sna->mode.hidden) {
@@ -9213,6 +9633,8 @@ void sna_mode_redisplay(struct sna *sna)
 	if (RegionNil(region))
 		return;
 
+	start = frame_pacing_now();
+
 	DBG(("%s: damage: %dx(%d, %d), (%d, %d)\n",
 	     __FUNCTION__, region_num_rects(region),
 	     region->extents.x1, region->extents.y1,
@@ -9312,28 +9734,14 @@ void sna_mode_redisplay(struct sna *sna)
 		sigio = sigio_block();
 		if (!box_empty(&damage.extents)) {
 			if (sna->flags & SNA_TEAR_FREE) {
-				RegionRec new_damage;
 				struct drm_mode_crtc_page_flip arg;
 				struct kgem_bo *bo;
+				int n;
 
-				RegionNull(&new_damage);
-				RegionCopy(&new_damage, &damage);
-
-				bo = sna_crtc->cache_bo;
-				if (bo == NULL) {
-					damage.extents = crtc->bounds;
-					damage.data = NULL;
-					bo = kgem_create_2d(&sna->kgem,
-							    crtc->mode.HDisplay,
-							    crtc->mode.VDisplay,
-							    crtc->scrn->bitsPerPixel,
-							    sna_crtc->bo->tiling,
-							    CREATE_SCANOUT);
-					if (bo == NULL)
-						continue;
-				} else
-					RegionUnion(&damage, &damage, &sna_crtc->crtc_damage);
-				sna_crtc->crtc_damage = new_damage;
+				n = sna_crtc_get_scanout(sna, crtc, &damage);
+				if (n < 0)
+					goto skip;
+				bo = sna_crtc->scanout[n].bo;
 
 				sna_crtc_redisplay(crtc, &damage, bo);
 				kgem_bo_submit(&sna->kgem, bo);
@@ -9369,9 +9777,7 @@ void sna_mode_redisplay(struct sna *sna)
 
 						DBG(("%s: flip [fb=%d] on crtc %d [%d, crtc=%d] failed - %d\n",
 						     __FUNCTION__, arg.fb_id, i, __sna_crtc_id(sna_crtc), __sna_crtc_index(sna_crtc), errno));
-						xf86DrvMsg(sna->scrn->scrnIndex, X_ERROR,
-							   "Page flipping failed, disabling TearFree\n");
-						sna->flags &= ~SNA_TEAR_FREE;
+						disable_tear_free(sna, "Page flipping failed");
 
 disable1:
 						box.x1 = 0;
@@ -9392,25 +9798,20 @@ disable1:
 						}
 					}
 
-					kgem_bo_destroy(&sna->kgem, bo);
-					sna_crtc->cache_bo = NULL;
-					continue;
+					sna_crtc_drop_scanout(sna, sna_crtc, n);
+					goto skip;
 				}
 				sna->mode.flip_active++;
 
 				assert(sna_crtc->flip_bo == NULL);
 				sna_crtc->flip_handler = shadow_flip_handler;
 				sna_crtc->flip_data = sna;
-				sna_crtc->flip_bo = bo;
+				sna_crtc->flip_bo = kgem_bo_reference(bo);
 				sna_crtc->flip_bo->active_scanout++;
 				sna_crtc->flip_serial = sna_crtc->mode_serial;
 				sna_crtc->flip_pending = true;
+				pace_shadow_flip(sna_crtc, start);
 
-				if (sna_crtc->bo != sna->mode.shadow) {
-					assert_scanout(&sna->kgem, sna_crtc->bo,
-						       crtc->mode.HDisplay, crtc->mode.VDisplay);
-					sna_crtc->cache_bo = kgem_bo_reference(sna_crtc->bo);
-				}
 				DBG(("%s: recording flip on CRTC:%d handle=%d, active_scanout=%d, serial=%d\n",
 				     __FUNCTION__, __sna_crtc_id(sna_crtc), sna_crtc->flip_bo->handle, sna_crtc->flip_bo->active_scanout, sna_crtc->flip_serial));
 			} else {
@@ -9418,6 +9819,7 @@ disable1:
 				kgem_scanout_flush(&sna->kgem, sna_crtc->bo);
 			}
 		}
+skip:
 		RegionUninit(&damage);
 		sigio_unblock(sigio);
 
@@ -9536,11 +9938,8 @@ fixup_flip:
 					crtc->bo = kgem_bo_reference(flip_bo);
 					crtc->bo->active_scanout++;
 				} else {
-					if (sna->flags & SNA_TEAR_FREE) {
-						xf86DrvMsg(sna->scrn->scrnIndex, X_ERROR,
-								"Failed to prepare CRTC for page flipping, disabling TearFree\n");
-						sna->flags &= ~SNA_TEAR_FREE;
-					}
+					if (sna->flags & SNA_TEAR_FREE)
+						disable_tear_free(sna, "Failed to prepare CRTC for page flipping");
 
 					if (sna->mode.flip_active == 0) {
 						DBG(("%s: abandoning flip attempt\n", __FUNCTION__));
@@ -9570,6 +9969,7 @@ fixup_flip:
 			crtc->flip_bo->active_scanout++;
 			crtc->flip_serial = crtc->mode_serial;
 			crtc->flip_pending = true;
+			pace_shadow_flip(crtc, start);
 
 			DBG(("%s: recording flip on CRTC:%d handle=%d, active_scanout=%d, serial=%d\n",
 			     __FUNCTION__, __sna_crtc_id(crtc), crtc->flip_bo->handle, crtc->flip_bo->active_scanout, crtc->flip_serial));
@@ -9664,6 +10064,13 @@ again:
 					crtc->swap.tv_sec = vbl->tv_sec;
 					crtc->swap.tv_usec = vbl->tv_usec;
 					crtc->swap.msc = msc;
+
+					if (frame_pacing_flip_complete(&crtc->pacing,
+								       ust64(vbl->tv_sec, vbl->tv_usec),
+								       msc))
+						DBG(("%s: flip on crtc=%d missed its vblank, now %lld, expected %lld\n",
+						     __FUNCTION__, __sna_crtc_index(crtc),
+						     (long long)msc, (long long)crtc->pacing.flip_msc));
 				}
 				assert(crtc->flip_pending);
 				crtc->flip_pending = false;
@@ -1612,23 +1612,32 @@ static void fake_swap_complete(struct sna *sna, ClientPtr client,
 			       DrawablePtr draw, xf86CrtcPtr crtc,
 			       int type, DRI2SwapEventPtr func, void *data)
 {
-	const struct ust_msc *swap;
+	struct ust_msc swap;
 
 	assert(draw);
 
 	if (crtc == NULL)
 		crtc = sna_primary_crtc(sna);
 
-	swap = sna_crtc_last_swap(crtc);
+	/* Report the vblank we are in, not the last one the CRTC gave us */
+	if (crtc) {
+		uint64_t ust;
+
+		swap.msc = sna_crtc_fake_msc(crtc, &ust);
+		swap.tv_sec = ust / 1000000;
+		swap.tv_usec = ust % 1000000;
+	} else
+		swap = *sna_crtc_last_swap(crtc);
+
 	DBG(("%s(type=%d): draw=%ld, crtc=%d, frame=%lld [msc %lld], tv=%d.%06d\n",
 	     __FUNCTION__, type, (long)draw->id, crtc ? sna_crtc_index(crtc) : -1,
-	     (long long)swap->msc,
-	     (long long)draw_current_msc(draw, crtc, swap->msc),
-	     swap->tv_sec, swap->tv_usec));
+	     (long long)swap.msc,
+	     (long long)draw_current_msc(draw, crtc, swap.msc),
+	     swap.tv_sec, swap.tv_usec));
 
 	DRI2SwapComplete(client, draw,
-			 draw_current_msc(draw, crtc, swap->msc),
-			 swap->tv_sec, swap->tv_usec,
+			 draw_current_msc(draw, crtc, swap.msc),
+			 swap.tv_sec, swap.tv_usec,
 			 type, func, data);
 }
 
@@ -2992,12 +3001,12 @@ static uint64_t
 get_current_msc(struct sna *sna, DrawablePtr draw, xf86CrtcPtr crtc)
 {
 	union drm_wait_vblank vbl;
-	uint64_t ret;
+	uint64_t ret, ust;
 
 	if (sna_query_vblank(sna, crtc, &vbl) == 0)
 		ret = sna_crtc_record_vblank(crtc, &vbl);
 	else
-		ret = sna_crtc_last_swap(crtc)->msc;
+		ret = sna_crtc_fake_msc(crtc, &ust);
 
 	return draw_current_msc(draw, crtc, ret);
 }
@@ -3369,6 +3378,7 @@ sna_dri2_schedule_swap(ClientPtr client, DrawablePtr draw, DRI2BufferPtr front,
 	}
 
 	assert(draw->type != DRAWABLE_PIXMAP);
+	sna_crtc_record_request(crtc);
 
 	while (dri2_chain(draw) && has_pending_events(sna)) {
 		DBG(("%s: flushing pending events\n", __FUNCTION__));
@@ -3493,8 +3503,8 @@ sna_dri2_get_msc(DrawablePtr draw, CARD64 *ust, CARD64 *msc)
 {
 	struct sna *sna = to_sna_from_drawable(draw);
 	xf86CrtcPtr crtc = sna_dri2_get_crtc(draw);
-	const struct ust_msc *swap;
 	union drm_wait_vblank vbl;
+	uint64_t raw, time;
 
 	DBG(("%s(draw=%ld, crtc=%d)\n", __FUNCTION__, draw->id,
 	     crtc ? sna_crtc_index(crtc) : -1));
@@ -3505,14 +3515,21 @@ sna_dri2_get_msc(DrawablePtr draw, CARD64 *ust, CARD64 *msc)
 	if (crtc == NULL)
 		return FALSE;
 
-	if (sna_query_vblank(sna, crtc, &vbl) == 0)
+	if (sna_query_vblank(sna, crtc, &vbl) == 0) {
+		const struct ust_msc *swap;
+
 		sna_crtc_record_vblank(crtc, &vbl);
 
-	swap = sna_crtc_last_swap(crtc);
-	*msc = draw_current_msc(draw, crtc, swap->msc);
-	*ust = ust64(swap->tv_sec, swap->tv_usec);
+		swap = sna_crtc_last_swap(crtc);
+		raw = swap->msc;
+		time = ust64(swap->tv_sec, swap->tv_usec);
+	} else
+		raw = sna_crtc_fake_msc(crtc, &time);
+
+	*msc = draw_current_msc(draw, crtc, raw);
+	*ust = time;
 	DBG(("%s: msc=%llu [raw=%llu], ust=%llu\n", __FUNCTION__,
-	     (long long)*msc, swap->msc, (long long)*ust));
+	     (long long)*msc, (long long)raw, (long long)*ust));
 	return TRUE;
 }
 
@@ -486,6 +486,17 @@ static bool setup_tear_free(struct sna *sna)
 done:
 	xf86DrvMsg(sna->scrn->scrnIndex, from, "TearFree %sabled\n",
 		   sna->flags & SNA_TEAR_FREE ? "en" : "dis");
+
+	if (xf86ReturnOptValBool(sna->Options, OPTION_LATE_LATCH, FALSE)) {
+		if (sna->flags & SNA_TEAR_FREE) {
+			sna->flags |= SNA_LATE_LATCH;
+			xf86DrvMsg(sna->scrn->scrnIndex, X_CONFIG,
+				   "Late latching of TearFree updates enabled\n");
+		} else
+			xf86DrvMsg(sna->scrn->scrnIndex, X_CONFIG,
+				   "Late latching requires TearFree, disabled\n");
+	}
+
 	return sna->flags & SNA_TEAR_FREE;
 }
 
@@ -648,6 +659,14 @@ static Bool sna_pre_init(ScrnInfoPtr scrn, int probe)
 		sna->flags |= SNA_FORCE_SHADOW;
 	}
 
+	if (xf86ReturnOptValBool(sna->Options, OPTION_ADAPTIVE_PLACEMENT, TRUE))
+		sna->flags |= SNA_ADAPTIVE;
+	DBG(("%s: adaptive placement? %s\n", __FUNCTION__, sna->flags & SNA_ADAPTIVE ? "enabled" : "disabled"));
+
+	if (xf86ReturnOptValBool(sna->Options, OPTION_READBACK_PREFETCH, TRUE))
+		sna->flags |= SNA_READBACK;
+	DBG(("%s: readback prefetch? %s\n", __FUNCTION__, sna->flags & SNA_READBACK ? "enabled" : "disabled"));
+
 	if (!sna_mode_pre_init(scrn, sna)) {
 		xf86DrvMsg(scrn->scrnIndex, X_ERROR,
 			   "No outputs and no modes.\n");
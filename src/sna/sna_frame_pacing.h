@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef SNA_FRAME_PACING_H
+#define SNA_FRAME_PACING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * A short history of each CRTC's vblanks and flips, from which we predict
+ * when its next vblank will arrive and how long before it we must submit
+ * a flip to still catch it. Late latching uses the prediction to hold
+ * back the TearFree update until just before that deadline, so that the
+ * frame includes as much of the latest rendering as possible.
+ *
+ * The time to submit is measured on every flip, but the time the GPU
+ * then needs to complete the rendering is not visible to us, only
+ * whether the flip caught its vblank. So on top of the worst recent
+ * submission time, we keep a safety margin that doubles on every missed
+ * vblank and slowly decays whilst we keep hitting them. (Nor does the
+ * time from queuing a flip to its completion tell us more, as the kernel
+ * stamps the completion with the vblank and not with when the flip was
+ * ready.)
+ *
+ * Clients that swap in time with the display, such as through DRI2 or
+ * Present, do most of their rendering in the frame after a vblank, and
+ * we record when the first of them asks for its next frame. Once the
+ * slowest of those recent frames has arrived, there is no more rendering
+ * to wait for and we latch straight away, further from the vblank.
+ *
+ * All times are in microseconds of CLOCK_MONOTONIC, as the vblank
+ * timestamps from the kernel.
+ */
+
+#define FRAME_PACING_HISTORY 16
+
+#define FRAME_PACING_MIN_MARGIN 500
+#define FRAME_PACING_MARGIN 2000
+
+struct frame_pacing {
+	/* Recent samples, the last FRAME_PACING_HISTORY of each */
+	uint32_t period[FRAME_PACING_HISTORY]; /* between vblanks */
+	uint32_t submit[FRAME_PACING_HISTORY]; /* preparing and queuing a flip */
+	uint32_t render[FRAME_PACING_HISTORY]; /* vblank to a client's next swap */
+	unsigned n_period, n_submit, n_render;
+
+	uint32_t nominal; /* period from the mode timings */
+	uint32_t margin;
+
+	uint64_t vblank_ust, vblank_msc;
+	uint64_t render_msc;
+
+	uint64_t flip_msc; /* the vblank targeted by the pending flip */
+	bool flip_pending;
+
+	/* Statistics since the CRTC was created */
+	uint64_t frames, missed;
+	uint64_t late; /* total time by which flips missed their vblank */
+};
+
+static inline uint64_t frame_pacing_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline void __frame_pacing_sample(uint32_t *ring, unsigned *n, uint64_t v)
+{
+	ring[(*n)++ % FRAME_PACING_HISTORY] = v > UINT32_MAX ? UINT32_MAX : v;
+}
+
+static inline unsigned __frame_pacing_count(unsigned n)
+{
+	return n < FRAME_PACING_HISTORY ? n : FRAME_PACING_HISTORY;
+}
+
+static inline uint32_t __frame_pacing_max(const uint32_t *ring, unsigned n)
+{
+	uint32_t v = 0;
+
+	n = __frame_pacing_count(n);
+	while (n--)
+		if (ring[n] > v)
+			v = ring[n];
+
+	return v;
+}
+
+static inline uint32_t __frame_pacing_mean(const uint32_t *ring, unsigned n)
+{
+	uint64_t sum = 0;
+	unsigned i;
+
+	n = __frame_pacing_count(n);
+	if (n == 0)
+		return 0;
+
+	for (i = 0; i < n; i++)
+		sum += ring[i];
+
+	return sum / n;
+}
+
+/* Forget the history of the previous mode, but keep the statistics */
+static inline void frame_pacing_reset(struct frame_pacing *p, uint32_t nominal)
+{
+	uint64_t frames = p->frames, missed = p->missed, late = p->late;
+
+	memset(p, 0, sizeof(*p));
+	p->nominal = nominal;
+	p->margin = FRAME_PACING_MARGIN;
+
+	p->frames = frames;
+	p->missed = missed;
+	p->late = late;
+}
+
+/* The median of the recent intervals, so that a late event or two does not skew it */
+static inline uint32_t frame_pacing_period(const struct frame_pacing *p)
+{
+	uint32_t v[FRAME_PACING_HISTORY];
+	unsigned n = __frame_pacing_count(p->n_period);
+	unsigned i, j;
+
+	if (n < 4)
+		return p->nominal;
+
+	for (i = 0; i < n; i++) {
+		uint32_t x = p->period[i];
+
+		for (j = i; j && v[j - 1] > x; j--)
+			v[j] = v[j - 1];
+		v[j] = x;
+	}
+
+	return v[n / 2];
+}
+
+/* How long before a vblank we need to start preparing its flip */
+static inline uint32_t frame_pacing_lead(const struct frame_pacing *p)
+{
+	return __frame_pacing_max(p->submit, p->n_submit) + p->margin;
+}
+
+static inline void frame_pacing_vblank(struct frame_pacing *p,
+				       uint64_t ust, uint64_t msc)
+{
+	if (p->vblank_ust &&
+	    ust > p->vblank_ust &&
+	    msc - p->vblank_msc - 1 < 8)
+		__frame_pacing_sample(p->period, &p->n_period,
+				      (ust - p->vblank_ust) / (msc - p->vblank_msc));
+
+	if (p->vblank_ust == 0 || (int64_t)(msc - p->vblank_msc) > 0) {
+		p->vblank_ust = ust;
+		p->vblank_msc = msc;
+	}
+}
+
+/* The number of vblanks after the last one seen that the next is at or after now */
+static inline uint64_t __frame_pacing_frames(const struct frame_pacing *p,
+					     uint32_t period, uint64_t now)
+{
+	if (now <= p->vblank_ust)
+		return 1;
+
+	return (now - p->vblank_ust + period - 1) / period;
+}
+
+/*
+ * Whether we can extrapolate from the last vblank seen, the error in the
+ * period accumulating over an idle spell.
+ */
+static inline bool __frame_pacing_valid(const struct frame_pacing *p,
+					uint32_t period, uint64_t now)
+{
+	if (p->vblank_ust == 0 || period == 0)
+		return false;
+
+	return __frame_pacing_frames(p, period, now) <= FRAME_PACING_HISTORY;
+}
+
+/*
+ * When to start preparing a flip, choosing the first vblank whose latest
+ * time to do so and still expect to catch it has not yet passed. That is
+ * brought forward to when the clients' frames for that vblank are due,
+ * if earlier, but not before now. Returns 0 if we have not seen a vblank
+ * recently enough to predict from.
+ */
+static inline uint64_t frame_pacing_deadline(const struct frame_pacing *p,
+					     uint64_t now)
+{
+	uint32_t period = frame_pacing_period(p);
+	uint32_t lead = frame_pacing_lead(p);
+	uint32_t render = __frame_pacing_max(p->render, p->n_render);
+	uint64_t vblank;
+
+	if (!__frame_pacing_valid(p, period, now))
+		return 0;
+
+	if (lead > period)
+		lead = period;
+
+	vblank = p->vblank_ust + __frame_pacing_frames(p, period, now) * period;
+	if (vblank - lead < now)
+		vblank += period;
+
+	if (render && render < period - lead) {
+		uint64_t ready = vblank - period + render;
+
+		return ready > now ? ready : now;
+	}
+
+	return vblank - lead;
+}
+
+/*
+ * A flip has just been queued, taking submit microseconds to prepare (or
+ * 0 if unknown), which we expect to complete on the next vblank.
+ */
+static inline void frame_pacing_flip(struct frame_pacing *p,
+				     uint64_t now, uint32_t submit)
+{
+	uint32_t period = frame_pacing_period(p);
+
+	if (submit)
+		__frame_pacing_sample(p->submit, &p->n_submit, submit);
+
+	if (!__frame_pacing_valid(p, period, now))
+		return;
+
+	p->flip_msc = p->vblank_msc + __frame_pacing_frames(p, period, now);
+	p->flip_pending = true;
+}
+
+/* Returns true if the flip missed the vblank it was queued for */
+static inline bool frame_pacing_flip_complete(struct frame_pacing *p,
+					      uint64_t ust, uint64_t msc)
+{
+	bool missed = false;
+
+	frame_pacing_vblank(p, ust, msc);
+	if (!p->flip_pending)
+		return false;
+
+	p->flip_pending = false;
+	p->frames++;
+
+	if ((int64_t)(msc - p->flip_msc) > 0) {
+		uint32_t period = frame_pacing_period(p);
+
+		p->missed++;
+		p->late += (msc - p->flip_msc) * period;
+
+		p->margin = 2 * p->margin;
+		if (p->margin > period)
+			p->margin = period;
+		missed = true;
+	} else {
+		p->margin -= p->margin / 256;
+		if (p->margin < FRAME_PACING_MIN_MARGIN)
+			p->margin = FRAME_PACING_MIN_MARGIN;
+	}
+
+	return missed;
+}
+
+/* A client has asked for its next frame, record how long it spent rendering */
+static inline void frame_pacing_request(struct frame_pacing *p, uint64_t now)
+{
+	uint32_t period = frame_pacing_period(p);
+
+	if (p->vblank_ust == 0 || now <= p->vblank_ust)
+		return;
+
+	/* Only the first request after each vblank, and not after idling */
+	if (p->render_msc == p->vblank_msc + 1)
+		return;
+	if (now - p->vblank_ust > 4 * (uint64_t)period)
+		return;
+
+	__frame_pacing_sample(p->render, &p->n_render, now - p->vblank_ust);
+	p->render_msc = p->vblank_msc + 1;
+}
+
+static inline uint32_t frame_pacing_render(const struct frame_pacing *p)
+{
+	return __frame_pacing_mean(p->render, p->n_render);
+}
+
+#endif /* SNA_FRAME_PACING_H */
@@ -27,6 +27,9 @@
 #include <sys/poll.h>
 #include <errno.h>
 #include <xf86drm.h>
+#if HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
 
 #include "sna.h"
 
@@ -38,9 +41,11 @@ static present_screen_info_rec present_info;
 struct sna_present_event {
 	xf86CrtcPtr crtc;
 	struct sna *sna;
+	struct vblank_node node;
 	struct list link;
 	uint64_t *event_id;
 	uint64_t target_msc;
+	uint64_t wake;
 	int n_event_id;
 	bool queued:1;
 	bool active:1;
@@ -49,6 +54,7 @@ struct sna_present_event {
 static void sna_present_unflip(ScreenPtr screen, uint64_t event_id);
 static bool sna_present_queue(struct sna_present_event *info,
 			      uint64_t last_msc);
+static CARD32 fake_vblank_timer(OsTimerPtr timer, CARD32 now, void *data);
 
 static inline struct sna_present_event *
 to_present_event(uintptr_t  data)
@@ -81,7 +87,14 @@ static void info_free(struct sna_present_event *info)
 
 static inline bool msc_before(uint64_t msc, uint64_t target)
 {
-	return (int64_t)(msc - target) < 0;
+	return vblank_msc_before(msc, target);
+}
+
+static inline struct sna_present_event *
+queue_top(struct vblank_wheel *q)
+{
+	struct vblank_node *node = vblank_wheel_top(q);
+	return node ? container_of(node, struct sna_present_event, node) : NULL;
 }
 
 #define MARK_PRESENT(x) ((void *)((uintptr_t)(x) | 2))
@@ -135,14 +148,20 @@ static uint64_t gettime_ust64(void)
 	return ust64(tv.tv_sec, tv.tv_nsec / 1000);
 }
 
+/*
+ * Complete the event whose vblank has arrived, along with every other
+ * event due by then up to the next one already waiting on its own vblank,
+ * and queue the earliest of the remainder.
+ */
 static void vblank_complete(struct sna_present_event *info,
 			    uint64_t ust, uint64_t msc)
 {
-	struct list * const q = sna_crtc_vblank_queue(info->crtc);
+	struct vblank_wheel * const q = sna_crtc_vblank_queue(info->crtc);
 	int n;
 
 	do {
 		assert(sna_crtc_vblank_queue(info->crtc) == q);
+		assert(!vblank_wheel_empty(q));
 
 		if (msc_before(msc, info->target_msc)) {
 			DBG(("%s: event=%d too early, now %lld, expected %lld\n",
@@ -163,44 +182,14 @@ static void vblank_complete(struct sna_present_event *info,
 			     info->target_msc && msc == (uint32_t)info->target_msc ? "" : ": MISS"));
 			present_event_notify(info->event_id[n], ust, msc);
 		}
+
 		if (info->n_event_id > 1)
 			free(info->event_id);
-
-		_list_del(&info->link);
+		vblank_wheel_remove(q, &info->node);
 		info_free(info);
 
-		info = list_entry(info->link.next, typeof(*info), link);
-	} while (q != &info->link && !info->queued);
-}
-
-static uint32_t msc_to_delay(xf86CrtcPtr crtc, uint64_t target)
-{
-	const DisplayModeRec *mode = &crtc->desiredMode;
-	const struct ust_msc *swap = sna_crtc_last_swap(crtc);
-	int64_t delay, subframe;
-
-	assert(mode->Clock);
-
-	delay = target - swap->msc;
-	assert(delay >= 0);
-	if (delay > 1) { /* try to use the hw vblank for the last frame */
-		delay--;
-		subframe = 0;
-	} else {
-		subframe = gettime_ust64() - swap_ust(swap);
-		subframe += 500;
-		subframe /= 1000;
-	}
-	delay *= mode->VTotal * mode->HTotal / mode->Clock;
-	if (subframe < delay)
-		delay -= subframe;
-	else
-		delay = 0;
-
-	DBG(("%s: sleep %d frames, %llu ms\n", __FUNCTION__,
-	     (int)(target - swap->msc), (long long)delay));
-	assert(delay >= 0);
-	return MIN(delay, INT32_MAX);
+		info = queue_top(q);
+	} while (info && !info->queued);
 }
 
 static void add_to_crtc_vblank(struct sna_present_event *info,
@@ -213,13 +202,75 @@ static void add_to_crtc_vblank(struct sna_present_event *info,
 	}
 }
 
-static CARD32 sna_fake_vblank_handler(OsTimerPtr timer, CARD32 now, void *data)
+/*
+ * Fake vblanks, for when the kernel cannot give us the vblank event we
+ * need (the query fails, or the target is too far ahead to be worth a
+ * kernel event), are timed against the vblank clock of the CRTC. All the
+ * pending fakes share one timer, a timerfd armed for the earliest of
+ * their deadlines to the nanosecond (or, without one, an OsTimer rounded
+ * up to the millisecond), and all that are due complete on the same
+ * wakeup.
+ */
+static bool fake_vblank_arm(struct sna *sna)
 {
-	struct sna_present_event *info = data;
+	struct sna_present_event *info;
+	uint64_t wake = 0, now;
+
+	list_for_each_entry(info, &sna->present.fake, link)
+		if (wake == 0 || info->wake < wake)
+			wake = info->wake;
+
+	DBG(("%s: next fake vblank at %lld.%09lld\n", __FUNCTION__,
+	     (long long)(wake / 1000000000), (long long)(wake % 1000000000)));
+
+#if HAVE_SYS_TIMERFD_H
+	if (sna->present.fake_fd != -1) {
+		struct itimerspec its;
+
+		memset(&its, 0, sizeof(its));
+		its.it_value.tv_sec = wake / 1000000000;
+		its.it_value.tv_nsec = wake % 1000000000;
+		return timerfd_settime(sna->present.fake_fd,
+				       TFD_TIMER_ABSTIME, &its, NULL) == 0;
+	}
+#endif
+
+	if (wake == 0) {
+		TimerCancel(sna->present.fake_timer);
+		return true;
+	}
+
+	now = vblank_clock_now();
+	sna->present.fake_timer =
+		TimerSet(sna->present.fake_timer, 0,
+			 wake > now ? (wake - now + 999999) / 1000000 : 1,
+			 fake_vblank_timer, sna);
+	return sna->present.fake_timer != NULL;
+}
+
+static bool fake_vblank_queue(struct sna_present_event *info, uint64_t wake)
+{
+	DBG(("%s(event=%lldx%d, target_msc=%lld, wake=%lld.%09lld)\n",
+	     __FUNCTION__, (long long)info->event_id[0], info->n_event_id,
+	     (long long)info->target_msc,
+	     (long long)(wake / 1000000000), (long long)(wake % 1000000000)));
+
+	info->wake = wake;
+	list_add_tail(&info->link, &info->sna->present.fake);
+	if (fake_vblank_arm(info->sna))
+		return true;
+
+	list_del(&info->link);
+	return false;
+}
+
+static void fake_vblank_complete(struct sna_present_event *info)
+{
+	const struct vblank_clock *clock = sna_crtc_fake_vblank(info->crtc);
 	union drm_wait_vblank vbl;
-	uint64_t msc, ust;
+	uint64_t msc, ust, wake;
 
-	DBG(("%s(event=%lldx%d, now=%d)\n", __FUNCTION__, (long long)info->event_id[0], info->n_event_id, now));
+	DBG(("%s(event=%lldx%d)\n", __FUNCTION__, (long long)info->event_id[0], info->n_event_id));
 	assert(info->queued);
 
 	VG_CLEAR(vbl);
@@ -232,7 +283,6 @@ static CARD32 sna_fake_vblank_handler(OsTimerPtr timer, CARD32 now, void *data)
 		     __FUNCTION__, (long long)info->event_id[0], (long long)info->target_msc, (long long)msc));
 		if (msc_before(msc, info->target_msc)) {
 			int delta = info->target_msc - msc;
-			uint32_t delay;
 
 			DBG(("%s: too early, requeuing delta=%d\n", __FUNCTION__, delta));
 			assert(info->target_msc - msc < 1ull<<31);
@@ -243,75 +293,104 @@ static CARD32 sna_fake_vblank_handler(OsTimerPtr timer, CARD32 now, void *data)
 				if (sna_wait_vblank(info->sna, &vbl, sna_crtc_index(info->crtc)) == 0) {
 					DBG(("%s: scheduled new vblank event for %lld\n", __FUNCTION__, (long long)info->target_msc));
 					add_to_crtc_vblank(info, delta);
-					free(timer);
-					return 0;
+					return;
 				}
 			}
 
-			delay = msc_to_delay(info->crtc, info->target_msc);
-			if (delay) {
-				DBG(("%s: requeueing timer for %dms delay\n", __FUNCTION__, delay));
-				return delay;
-			}
+			/* The clock has just been synced to that vblank */
+			wake = vblank_clock_time(clock, info->target_msc - (delta > 1));
+			if (wake > vblank_clock_now() &&
+			    fake_vblank_queue(info, wake))
+				return;
 
-			/* As a last resort use a blocking wait.
-			 * Less than a millisecond for (hopefully) a rare case.
-			 */
-			DBG(("%s: blocking wait!\n", __FUNCTION__));
-			vbl.request.type = (uint32_t)DRM_VBLANK_ABSOLUTE;
-			vbl.request.sequence = info->target_msc;
-			if (sna_wait_vblank(info->sna, &vbl, sna_crtc_index(info->crtc)) == 0) {
-				ust = ust64(vbl.reply.tval_sec, vbl.reply.tval_usec);
-				msc = sna_crtc_record_vblank(info->crtc, &vbl);
-			} else {
-				DBG(("%s: blocking wait failed, fudging\n",
-				     __FUNCTION__));
-				goto fixup;
-			}
+			DBG(("%s: vblank counter stalled, fudging\n",
+			     __FUNCTION__));
+			goto fixup;
 		}
 	} else {
+		msc = vblank_clock_msc(clock, vblank_clock_now());
+		if (msc_before(msc, info->target_msc) &&
+		    fake_vblank_queue(info,
+				      vblank_clock_time(clock, info->target_msc)))
+			return;
+
 fixup:
-		ust = gettime_ust64();
-		msc = info->target_msc;
+		msc = sna_crtc_fake_msc(info->crtc, &ust);
+		if (msc_before(msc, info->target_msc)) {
+			msc = info->target_msc;
+			ust = gettime_ust64();
+		}
 		DBG(("%s: event=%lld, CRTC OFF, target msc=%lld, was %lld (off)\n",
 		     __FUNCTION__, (long long)info->event_id[0], (long long)info->target_msc, (long long)sna_crtc_last_swap(info->crtc)->msc));
 	}
 
 	vblank_complete(info, ust, msc);
-	free(timer);
+}
+
+static void fake_vblank_expire(struct sna *sna)
+{
+	struct sna_present_event *info, *next;
+	struct list due;
+	uint64_t now;
+
+	now = vblank_clock_now();
+	list_init(&due);
+	list_for_each_entry_safe(info, next, &sna->present.fake, link) {
+		if (info->wake <= now)
+			list_move_tail(&info->link, &due);
+	}
+
+	while (!list_is_empty(&due)) {
+		info = list_first_entry(&due, struct sna_present_event, link);
+		list_del(&info->link);
+		fake_vblank_complete(info);
+	}
+
+	fake_vblank_arm(sna);
+}
+
+static CARD32 fake_vblank_timer(OsTimerPtr timer, CARD32 now, void *data)
+{
+	fake_vblank_expire(data);
 	return 0;
 }
 
+#if HAVE_SYS_TIMERFD_H
+static void fake_vblank_notify(int fd, int ready, void *data)
+{
+	uint64_t expirations;
+
+	if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+		return;
+
+	fake_vblank_expire(data);
+}
+#endif
+
 static bool sna_fake_vblank(struct sna_present_event *info)
 {
+	const struct vblank_clock *clock = sna_crtc_fake_vblank(info->crtc);
 	const struct ust_msc *swap = sna_crtc_last_swap(info->crtc);
-	uint32_t delay;
+	uint64_t ust, msc;
 
-	if (msc_before(swap->msc, info->target_msc))
-		delay = msc_to_delay(info->crtc, info->target_msc);
-	else
-		delay = 0;
+	if (!msc_before(swap->msc, info->target_msc)) {
+		msc = swap->msc;
+		ust = swap_ust(swap);
+	} else
+		msc = sna_crtc_fake_msc(info->crtc, &ust);
 
-	DBG(("%s(event=%lldx%d, target_msc=%lld, msc=%lld, delay=%ums)\n",
+	DBG(("%s(event=%lldx%d, target_msc=%lld, msc=%lld)\n",
 	     __FUNCTION__, (long long)info->event_id[0], info->n_event_id,
-	     (long long)info->target_msc, (long long)swap->msc, delay));
-	if (delay == 0) {
-		uint64_t ust, msc;
-
-		if (msc_before(swap->msc, info->target_msc)) {
-			/* Fixup and pretend it completed immediately */
-			msc = info->target_msc;
-			ust = gettime_ust64();
-		} else {
-			msc = swap->msc;
-			ust = swap_ust(swap);
-		}
-
+	     (long long)info->target_msc, (long long)msc));
+	if (!msc_before(msc, info->target_msc)) {
 		vblank_complete(info, ust, msc);
 		return true;
 	}
 
-	return TimerSet(NULL, 0, delay, sna_fake_vblank_handler, info);
+	/* try to use the hw vblank for the last frame */
+	return fake_vblank_queue(info,
+				 vblank_clock_time(clock,
+						   info->target_msc - (info->target_msc - msc > 1)));
 }
 
 static bool sna_present_queue(struct sna_present_event *info,
@@ -372,19 +451,20 @@ sna_present_get_crtc(WindowPtr window)
 
 static void add_keepalive(struct sna *sna, xf86CrtcPtr crtc, uint64_t msc)
 {
-	struct list *q = sna_crtc_vblank_queue(crtc);
-	struct sna_present_event *info, *tmp;
+	struct vblank_wheel *q = sna_crtc_vblank_queue(crtc);
+	struct sna_present_event *info;
+	struct vblank_node *node;
 	union drm_wait_vblank vbl;
 
-	list_for_each_entry(tmp, q, link) {
-		if (tmp->target_msc == msc) {
-			DBG(("%s: vblank already queued for target_msc=%lld\n",
-			     __FUNCTION__, (long long)msc));
-			return;
-		}
-
-		if ((int64_t)(tmp->target_msc - msc) > 0)
-			break;
+	/* Any event already waiting for msc keeps the CRTC ticking: if it
+	 * is not the one waiting on the kernel, vblank_complete() queues
+	 * it once those before it are done.
+	 */
+	node = vblank_wheel_find(q, msc);
+	if (node) {
+		DBG(("%s: vblank already queued for target_msc=%lld\n",
+		     __FUNCTION__, (long long)msc));
+		return;
 	}
 
 	DBG(("%s: adding keepalive for target_msc=%lld\n",
@@ -400,17 +480,20 @@ static void add_keepalive(struct sna *sna, xf86CrtcPtr crtc, uint64_t msc)
 	info->event_id = (uint64_t *)(info + 1);
 	info->n_event_id = 0;
 
+	vblank_wheel_push(q, &info->node, msc);
+
 	VG_CLEAR(vbl);
 	vbl.request.type = DRM_VBLANK_ABSOLUTE | DRM_VBLANK_EVENT;
 	vbl.request.sequence = msc;
 	vbl.request.signal = (uintptr_t)MARK_PRESENT(info);
 
 	if (sna_wait_vblank(info->sna, &vbl, sna_crtc_index(crtc)) == 0) {
-		list_add_tail(&info->link, &tmp->link);
 		add_to_crtc_vblank(info, 1);
 		info->queued = true;
-	} else
+	} else {
+		vblank_wheel_remove(q, &info->node);
 		info_free(info);
+	}
 }
 
 static int
@@ -421,9 +504,14 @@ sna_present_get_ust_msc(RRCrtcPtr crtc, CARD64 *ust, CARD64 *msc)
 
 	DBG(("%s(crtc=%d)\n", __FUNCTION__, sna_crtc_index(crtc->devPrivate)));
 	if (sna_crtc_has_vblank(crtc->devPrivate)) {
+		const struct ust_msc *swap;
+
 		DBG(("%s: vblank active, reusing last swap msc/ust\n",
 		     __FUNCTION__));
-		goto last;
+		swap = sna_crtc_last_swap(crtc->devPrivate);
+		*ust = swap_ust(swap);
+		*msc = swap->msc;
+		return Success;
 	}
 
 	VG_CLEAR(vbl);
@@ -435,11 +523,11 @@ sna_present_get_ust_msc(RRCrtcPtr crtc, CARD64 *ust, CARD64 *msc)
 
 		add_keepalive(sna, crtc->devPrivate, *msc + 1);
 	} else {
-		const struct ust_msc *swap;
-last:
-		swap = sna_crtc_last_swap(crtc->devPrivate);
-		*ust = swap_ust(swap);
-		*msc = swap->msc;
+		uint64_t time;
+
+		/* No vblank from the kernel, so count them ourselves */
+		*msc = sna_crtc_fake_msc(crtc->devPrivate, &time);
+		*ust = time;
 	}
 
 	DBG(("%s: crtc=%d, tv=%d.%06d seq=%d msc=%lld\n", __FUNCTION__,
@@ -477,13 +565,16 @@ static int
 sna_present_queue_vblank(RRCrtcPtr crtc, uint64_t event_id, uint64_t msc)
 {
 	struct sna *sna = to_sna_from_screen(crtc->pScreen);
-	struct sna_present_event *info, *tmp;
+	struct sna_present_event *info;
 	const struct ust_msc *swap;
-	struct list *q;
+	struct vblank_wheel *q;
+	struct vblank_node *node;
 
 	if (!sna_crtc_is_on(crtc->devPrivate))
 		return BadAlloc;
 
+	sna_crtc_record_request(crtc->devPrivate);
+
 	swap = sna_crtc_last_swap(crtc->devPrivate);
 	DBG(("%s(crtc=%d, event=%lld, msc=%lld, last swap=%lld)\n",
 	     __FUNCTION__, sna_crtc_index(crtc->devPrivate),
@@ -502,34 +593,30 @@ sna_present_queue_vblank(RRCrtcPtr crtc, uint64_t event_id, uint64_t msc)
 		return BadValue;
 
 	q = sna_crtc_vblank_queue(crtc->devPrivate);
-	list_for_each_entry(tmp, q, link) {
-		if (tmp->target_msc == msc) {
-			uint64_t *events = tmp->event_id;
-
-			if (tmp->n_event_id &&
-			    is_power_of_two(tmp->n_event_id)) {
-				events = malloc(2*sizeof(uint64_t)*tmp->n_event_id);
-				if (events == NULL)
-					return BadAlloc;
-
-				memcpy(events,
-				       tmp->event_id,
-				       tmp->n_event_id*sizeof(uint64_t));
-				if (tmp->n_event_id != 1)
-					free(tmp->event_id);
-				tmp->event_id = events;
-			}
-
-			DBG(("%s: appending event=%lld to vblank %lld x %d\n",
-			     __FUNCTION__, (long long)event_id, (long long)msc, tmp->n_event_id+1));
-			events[tmp->n_event_id++] = event_id;
-			return Success;
-		}
-		if ((int64_t)(tmp->target_msc - msc) > 0) {
-			DBG(("%s: previous target_msc=%lld invalid for coalescing\n",
-			     __FUNCTION__, (long long)tmp->target_msc));
-			break;
+	node = vblank_wheel_find(q, msc);
+	if (node) {
+		struct sna_present_event *tmp =
+			container_of(node, struct sna_present_event, node);
+		uint64_t *events = tmp->event_id;
+
+		if (tmp->n_event_id &&
+		    is_power_of_two(tmp->n_event_id)) {
+			events = malloc(2*sizeof(uint64_t)*tmp->n_event_id);
+			if (events == NULL)
+				return BadAlloc;
+
+			memcpy(events,
+			       tmp->event_id,
+			       tmp->n_event_id*sizeof(uint64_t));
+			if (tmp->n_event_id != 1)
+				free(tmp->event_id);
+			tmp->event_id = events;
 		}
+
+		DBG(("%s: appending event=%lld to vblank %lld x %d\n",
+		     __FUNCTION__, (long long)event_id, (long long)msc, tmp->n_event_id+1));
+		events[tmp->n_event_id++] = event_id;
+		return Success;
 	}
 
 	info = info_alloc(sna);
@@ -542,16 +629,22 @@ sna_present_queue_vblank(RRCrtcPtr crtc, uint64_t event_id, uint64_t msc)
 	info->event_id = (uint64_t *)(info + 1);
 	info->event_id[0] = event_id;
 	info->n_event_id = 1;
-	list_add_tail(&info->link, &tmp->link);
 	info->queued = false;
 	info->active = false;
 
-	if (info->link.prev == q && !sna_present_queue(info, swap->msc)) {
-		list_del(&info->link);
+	/* Only the earliest event needs a vblank of its own, the rest
+	 * complete alongside it or are queued after it.
+	 */
+	vblank_wheel_push(q, &info->node, msc);
+
+	if (queue_top(q) == info && !sna_present_queue(info, swap->msc)) {
+		vblank_wheel_remove(q, &info->node);
 		info_free(info);
 		return BadAlloc;
 	}
 
+	DBG(("%s: %d events pending on crtc=%d\n", __FUNCTION__,
+	     q->count, sna_crtc_index(crtc->devPrivate)));
 	return Success;
 }
 
@@ -1000,7 +1093,23 @@ bool sna_present_open(struct sna *sna, ScreenPtr screen)
 	sna_present_update(sna);
 	list_init(&sna->present.vblank_queue);
 
-	return present_screen_init(screen, &present_info);
+	if (!present_screen_init(screen, &present_info))
+		return false;
+
+	list_init(&sna->present.fake);
+	sna->present.fake_timer = NULL;
+	sna->present.fake_fd = -1;
+#if HAVE_SYS_TIMERFD_H
+	sna->present.fake_fd =
+		timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (sna->present.fake_fd != -1)
+		SetNotifyFd(sna->present.fake_fd, fake_vblank_notify,
+			    X_NOTIFY_READ, sna);
+#endif
+	DBG(("%s: fake vblanks using %s\n", __FUNCTION__,
+	     sna->present.fake_fd != -1 ? "timerfd" : "OsTimer"));
+
+	return true;
 }
 
 void sna_present_update(struct sna *sna)
@@ -1017,4 +1126,13 @@ void sna_present_update(struct sna *sna)
 void sna_present_close(struct sna *sna, ScreenPtr screen)
 {
 	DBG(("%s()\n", __FUNCTION__));
+
+	if (sna->present.fake_fd != -1) {
+		RemoveNotifyFd(sna->present.fake_fd);
+		close(sna->present.fake_fd);
+		sna->present.fake_fd = -1;
+	}
+
+	TimerFree(sna->present.fake_timer);
+	sna->present.fake_timer = NULL;
 }
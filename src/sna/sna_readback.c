@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "config.h"
+
+#include "sna.h"
+
+/*
+ * Screenshot tools, screen recorders and VNC servers poll GetImage on the
+ * root window over and over. Each poll would have to copy the front
+ * buffer into memory the CPU can read and then wait for the GPU to finish
+ * all the rendering queued before it, and the copy, before returning.
+ *
+ * Instead, once the root has been polled, we watch it for damage and from
+ * the block handler copy the polled area into one of a small ring of
+ * snooped (or on LLC, cacheable) buffers as soon as it changes, so that
+ * by the time the next poll arrives the copy has long completed and the
+ * GetImage is reduced to a memcpy. The damage since each copy was taken
+ * is kept by a damage_history, as for TearFree, so that we never serve
+ * pixels that have since been drawn over; those requests take the usual
+ * path. We take at most one copy per poll, so that a client polling now
+ * and then beside a video or a blinking cursor does not have us copying
+ * the area on every pass through the block handler, and once the polling
+ * stops, so do we.
+ */
+
+#define READBACK_IDLE 1000 /* ms without a GetImage before we stop */
+
+static bool box_contains(const BoxRec *a, const BoxRec *b)
+{
+	if (b->x1 < a->x1 || b->x2 > a->x2)
+		return false;
+
+	if (b->y1 < a->y1 || b->y2 > a->y2)
+		return false;
+
+	return true;
+}
+
+static void readback_damage_destroy(DamagePtr damage, void *closure)
+{
+	struct sna *sna = closure;
+
+	DBG(("%s\n", __FUNCTION__));
+	sna->readback.damage = NULL;
+}
+
+static void readback_release(struct sna *sna)
+{
+	unsigned n;
+
+	for (n = 0; n < ARRAY_SIZE(sna->readback.ring); n++) {
+		if (sna->readback.ring[n].bo) {
+			kgem_bo_destroy(&sna->kgem, sna->readback.ring[n].bo);
+			sna->readback.ring[n].bo = NULL;
+		}
+	}
+	sna->readback.next = 0;
+}
+
+static bool readback_arm(struct sna *sna, const BoxRec *box)
+{
+	ScreenPtr screen = to_screen_from_sna(sna);
+
+	DBG(("%s: (%d, %d), (%d, %d)\n", __FUNCTION__,
+	     box->x1, box->y1, box->x2, box->y2));
+
+	sna->readback.damage = DamageCreate(NULL, readback_damage_destroy,
+					    DamageReportNone,
+					    TRUE, screen, sna);
+	if (sna->readback.damage == NULL)
+		return false;
+
+	DamageRegister(&sna->front->drawable, sna->readback.damage);
+
+	/* forget whatever the front was before we started watching */
+	damage_history_reset(&sna->readback.history);
+	sna->readback.area = *box;
+	return true;
+}
+
+static void readback_disarm(struct sna *sna)
+{
+	DBG(("%s\n", __FUNCTION__));
+
+	if (sna->readback.damage) {
+		DamageUnregister(sna->readback.damage);
+		DamageDestroy(sna->readback.damage);
+		assert(sna->readback.damage == NULL);
+	}
+
+	readback_release(sna);
+}
+
+/*
+ * Move the damage since we last looked into the history. Only damage to
+ * the polled area matters, and anything else would only use up the few
+ * entries of history we have, so leave it out.
+ */
+static void readback_collect(struct sna *sna)
+{
+	RegionPtr damage = DamageRegion(sna->readback.damage);
+	RegionRec region;
+
+	if (!RegionNotEmpty(damage))
+		return;
+
+	region.extents = sna->readback.area;
+	region.data = NULL;
+	RegionIntersect(&region, &region, damage);
+	DamageEmpty(sna->readback.damage);
+
+	if (RegionNotEmpty(&region)) {
+		DBG(("%s: (%d, %d), (%d, %d) x %d\n", __FUNCTION__,
+		     region.extents.x1, region.extents.y1,
+		     region.extents.x2, region.extents.y2,
+		     region_num_rects(&region)));
+		damage_history_push(&sna->readback.history, &region);
+	}
+	RegionUninit(&region);
+}
+
+/* Does the copy in slot n still hold what the front has within box? */
+static bool readback_fresh(struct sna *sna, unsigned n, const BoxRec *box)
+{
+	struct sna_pixmap *priv = sna_pixmap(sna->front);
+	BoxRec tmp = *box;
+	RegionRec stale;
+	bool fresh;
+
+	if (sna->readback.ring[n].bo == NULL)
+		return false;
+
+	if (!box_contains(&sna->readback.ring[n].box, box))
+		return false;
+
+	/* replaced beneath us, e.g. by a flip */
+	if (priv == NULL || priv->gpu_bo == NULL ||
+	    priv->gpu_bo->unique_id != sna->readback.ring[n].source)
+		return false;
+
+	RegionNull(&stale);
+	fresh = damage_history_since(&sna->readback.history, &stale,
+				     sna->readback.ring[n].serial) &&
+		RegionContainsRect(&stale, &tmp) == rgnOUT;
+	RegionUninit(&stale);
+
+	return fresh;
+}
+
+bool sna_readback_get_image(struct sna *sna, PixmapPtr pixmap,
+			    const BoxRec *box, char *dst)
+{
+	unsigned ring = ARRAY_SIZE(sna->readback.ring);
+	unsigned n;
+
+	if ((sna->flags & SNA_READBACK) == 0 || pixmap != sna->front)
+		return false;
+
+	sna->readback.last_poll = GetTimeInMillis();
+	sna->readback.wanted = true;
+
+	if (sna->readback.damage == NULL) {
+		readback_arm(sna, box);
+		return false;
+	}
+
+	if (!box_contains(&sna->readback.area, box)) {
+		BoxRec *area = &sna->readback.area;
+
+		if (box->x1 < area->x1)
+			area->x1 = box->x1;
+		if (box->y1 < area->y1)
+			area->y1 = box->y1;
+		if (box->x2 > area->x2)
+			area->x2 = box->x2;
+		if (box->y2 > area->y2)
+			area->y2 = box->y2;
+		DBG(("%s: polled area grown to (%d, %d), (%d, %d)\n",
+		     __FUNCTION__, area->x1, area->y1, area->x2, area->y2));
+	}
+
+	readback_collect(sna);
+
+	/* Newest first, but never wait for one still in flight */
+	for (n = 1; n <= ring; n++) {
+		unsigned i = (sna->readback.next + ring - n) % ring;
+		struct kgem_bo *bo = sna->readback.ring[i].bo;
+		int w = box->x2 - box->x1;
+		int h = box->y2 - box->y1;
+		char *src;
+
+		if (!readback_fresh(sna, i, box))
+			continue;
+
+		if (__kgem_bo_is_busy(&sna->kgem, bo)) {
+			DBG(("%s: slot %d is fresh, but still busy\n",
+			     __FUNCTION__, i));
+			continue;
+		}
+
+		src = kgem_bo_map__cpu(&sna->kgem, bo);
+		if (src == NULL)
+			continue;
+
+		kgem_bo_sync__cpu(&sna->kgem, bo);
+
+		if (sigtrap_get())
+			return false;
+
+		DBG(("%s: serving (%d, %d), (%d, %d) from slot %d\n",
+		     __FUNCTION__, box->x1, box->y1, box->x2, box->y2, i));
+		memcpy_blt(src, dst, pixmap->drawable.bitsPerPixel,
+			   bo->pitch, PixmapBytePad(w, pixmap->drawable.depth),
+			   box->x1 - sna->readback.ring[i].box.x1,
+			   box->y1 - sna->readback.ring[i].box.y1,
+			   0, 0, w, h);
+		sigtrap_put();
+
+		sna->xfer.get_prefetch +=
+			(uint64_t)w * h * pixmap->drawable.bitsPerPixel >> 3;
+		return true;
+	}
+
+	return false;
+}
+
+void sna_readback_prefetch(struct sna *sna)
+{
+	unsigned ring = ARRAY_SIZE(sna->readback.ring);
+	const BoxRec *area = &sna->readback.area;
+	int w = area->x2 - area->x1;
+	int h = area->y2 - area->y1;
+	struct sna_pixmap *priv;
+	PixmapPtr front;
+	DrawableRec tmp;
+	unsigned n;
+
+	if (sna->readback.damage == NULL)
+		return;
+
+	if ((int32_t)(GetTimeInMillis() - sna->readback.last_poll) > READBACK_IDLE) {
+		DBG(("%s: no longer polled\n", __FUNCTION__));
+		readback_disarm(sna);
+		return;
+	}
+
+	readback_collect(sna);
+
+	if (!sna->readback.wanted)
+		return;
+
+	n = (sna->readback.next + ring - 1) % ring;
+	if (readback_fresh(sna, n, area))
+		return;
+
+	front = sna->front;
+	priv = sna_pixmap(front);
+	if (priv == NULL || priv->gpu_bo == NULL || priv->move_to_gpu)
+		return;
+
+	if (!sna->kgem.can_blt_cpu || wedged(sna))
+		return;
+
+	/* Only the GPU copy needs reading back */
+	if (priv->cpu_damage &&
+	    sna_damage_contains_box(&priv->cpu_damage, area) != PIXMAN_REGION_OUT)
+		return;
+
+	/* Too small to be worth it */
+	if ((uint64_t)w * h * front->drawable.bitsPerPixel >> 3 < PAGE_SIZE)
+		return;
+
+	n = sna->readback.next;
+	if (sna->readback.ring[n].bo) {
+		const BoxRec *box = &sna->readback.ring[n].box;
+
+		if (__kgem_bo_is_busy(&sna->kgem, sna->readback.ring[n].bo))
+			return;
+
+		if (box->x2 - box->x1 != w || box->y2 - box->y1 != h) {
+			kgem_bo_destroy(&sna->kgem, sna->readback.ring[n].bo);
+			sna->readback.ring[n].bo = NULL;
+		}
+	}
+	if (sna->readback.ring[n].bo == NULL) {
+		sna->readback.ring[n].bo =
+			kgem_create_cpu_2d(&sna->kgem, w, h,
+					   front->drawable.bitsPerPixel, 0);
+		if (sna->readback.ring[n].bo == NULL)
+			return;
+	}
+
+	DBG(("%s: reading back (%d, %d), (%d, %d) into slot %d\n",
+	     __FUNCTION__, area->x1, area->y1, area->x2, area->y2, n));
+
+	tmp.width  = w;
+	tmp.height = h;
+	tmp.depth  = front->drawable.depth;
+	tmp.bitsPerPixel = front->drawable.bitsPerPixel;
+
+	if (!sna->render.copy_boxes(sna, GXcopy,
+				    &front->drawable, priv->gpu_bo, 0, 0,
+				    &tmp, sna->readback.ring[n].bo,
+				    -area->x1, -area->y1,
+				    area, 1, COPY_LAST)) {
+		kgem_bo_destroy(&sna->kgem, sna->readback.ring[n].bo);
+		sna->readback.ring[n].bo = NULL;
+		return;
+	}
+
+	sna->readback.ring[n].box = *area;
+	sna->readback.ring[n].serial = sna->readback.history.serial;
+	sna->readback.ring[n].source = priv->gpu_bo->unique_id;
+	sna->readback.next = (n + 1) % ring;
+	sna->readback.wanted = false;
+
+	sna->xfer.prefetch++;
+	sna->xfer.prefetch_bytes +=
+		(uint64_t)w * h * front->drawable.bitsPerPixel >> 3;
+
+	/* and start it now, so it is complete by the next poll */
+	kgem_submit(&sna->kgem);
+}
+
+void sna_readback_init(struct sna *sna)
+{
+	damage_history_init(&sna->readback.history);
+}
+
+/* The front is being replaced, forget everything */
+void sna_readback_reset(struct sna *sna)
+{
+	readback_disarm(sna);
+}
+
+void sna_readback_fini(struct sna *sna)
+{
+	readback_disarm(sna);
+	damage_history_fini(&sna->readback.history);
+}
@@ -447,6 +447,18 @@ move_to_gpu(PixmapPtr pixmap, const BoxRec *box, bool blt)
 		return priv->gpu_bo;
 	}
 
+	switch (priv->residency) {
+	case RESIDENCY_GPU:
+	case RESIDENCY_MIRROR:
+		DBG(("%s: migrating pixmap=%ld, history prefers a GPU copy\n",
+		     __FUNCTION__, pixmap->drawable.serialNumber));
+		goto upload;
+	case RESIDENCY_CPU:
+		DBG(("%s: not migrating pixmap=%ld, history prefers the CPU\n",
+		     __FUNCTION__, pixmap->drawable.serialNumber));
+		return NULL;
+	}
+
 	w = box->x2 - box->x1;
 	h = box->y2 - box->y1;
 	if (priv->cpu_bo && !priv->cpu_bo->flush) {
@@ -553,11 +565,11 @@ static struct kgem_bo *upload(struct sna *sna,
 	return bo;
 }
 
-struct kgem_bo *
-__sna_render_pixmap_bo(struct sna *sna,
-		       PixmapPtr pixmap,
-		       const BoxRec *box,
-		       bool blt)
+static struct kgem_bo *
+render_pixmap_bo(struct sna *sna,
+		 PixmapPtr pixmap,
+		 const BoxRec *box,
+		 bool blt)
 {
 	struct kgem_bo *bo;
 
@@ -571,6 +583,21 @@ __sna_render_pixmap_bo(struct sna *sna,
 	return bo;
 }
 
+struct kgem_bo *
+__sna_render_pixmap_bo(struct sna *sna,
+		       PixmapPtr pixmap,
+		       const BoxRec *box,
+		       bool blt)
+{
+	struct sna_pixmap *priv;
+
+	priv = sna_pixmap(pixmap);
+	if (priv)
+		sna_pixmap_access(sna, priv, ACCESS_GPU, false, box);
+
+	return render_pixmap_bo(sna, pixmap, box, blt);
+}
+
 int
 sna_render_pixmap_bo(struct sna *sna,
 		     struct sna_composite_channel *channel,
@@ -593,6 +620,11 @@ sna_render_pixmap_bo(struct sna *sna,
 
 	priv = sna_pixmap(pixmap);
 	if (priv) {
+		box.x1 = box.y1 = 0;
+		box.x2 = w ? w : pixmap->drawable.width;
+		box.y2 = h ? h : pixmap->drawable.height;
+		sna_pixmap_access(sna, priv, ACCESS_GPU, false, &box);
+
 		if (priv->gpu_bo &&
 		    (DAMAGE_IS_ALL(priv->gpu_damage) || !priv->cpu_damage ||
 		     priv->gpu_bo->proxy)) {
@@ -655,7 +687,7 @@ sna_render_pixmap_bo(struct sna *sna,
 	     channel->offset[0], channel->offset[1],
 	     pixmap->drawable.width, pixmap->drawable.height));
 
-	channel->bo = __sna_render_pixmap_bo(sna, pixmap, &box, false);
+	channel->bo = render_pixmap_bo(sna, pixmap, &box, false);
 	if (channel->bo == NULL) {
 		DBG(("%s: uploading CPU box (%d, %d), (%d, %d)\n",
 		     __FUNCTION__, box.x1, box.y1, box.x2, box.y2));
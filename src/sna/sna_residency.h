@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef SNA_RESIDENCY_H
+#define SNA_RESIDENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A short, decaying history of who touched a pixmap, the CPU or the GPU,
+ * whether they read or wrote and how many pixels, from which we pick
+ * where the pixmap should live. The static heuristics elsewhere look at
+ * the current operation and at most the last one (priv->cpu and
+ * source_count); this weighs the recent past instead.
+ *
+ * The choice is the cheapest of three placements, costing every access
+ * that finds its pixels on the wrong side at the price of moving them:
+ *
+ *   CPU:    the GPU work falls back or uploads what it touches;
+ *   GPU:    the CPU work downloads what it touches, and for a partial
+ *           write downloads it first, so reads and writes alike;
+ *   MIRROR: both copies kept, so only writes need to be propagated,
+ *           uploads for the CPU and downloads for the GPU.
+ *
+ * Readback is slower than upload (uncached, and we wait for the GPU),
+ * hence the heavier weight on downloads. A placement is only replaced
+ * by one that is clearly cheaper, so that a pixmap does not flip back
+ * and forth on every other operation, and until we have seen a few
+ * accesses we express no preference at all.
+ */
+
+enum {
+	RESIDENCY_ANY, /* no opinion, use the static heuristics */
+	RESIDENCY_CPU,
+	RESIDENCY_GPU,
+	RESIDENCY_MIRROR,
+};
+
+#define ACCESS_CPU 0
+#define ACCESS_GPU 1
+
+#define RESIDENCY_DECAY 3 /* forget 1/8th of the history per access */
+#define RESIDENCY_WARMUP 4 /* accesses seen before forming an opinion */
+#define RESIDENCY_UPLOAD_COST 1
+#define RESIDENCY_DOWNLOAD_COST 4
+
+struct sna_access {
+	uint32_t read[2], write[2]; /* pixels, indexed by ACCESS_CPU/GPU */
+	uint8_t seen;
+};
+
+static inline uint32_t __access_add(uint32_t v, uint32_t pixels)
+{
+	v -= v >> RESIDENCY_DECAY;
+	return v + pixels < v ? UINT32_MAX : v + pixels;
+}
+
+static inline void
+sna_access_record(struct sna_access *a, unsigned side, bool writing,
+		  uint32_t pixels)
+{
+	unsigned n;
+
+	if (a->seen < RESIDENCY_WARMUP)
+		a->seen++;
+
+	for (n = 0; n < 2; n++) {
+		a->read[n] = __access_add(a->read[n],
+					  !writing && n == side ? pixels : 0);
+		a->write[n] = __access_add(a->write[n],
+					   writing && n == side ? pixels : 0);
+	}
+}
+
+static inline unsigned
+sna_access_residency(const struct sna_access *a, unsigned current,
+		     bool allow_mirror)
+{
+	uint64_t cost[4];
+	unsigned best;
+
+	if (current == RESIDENCY_MIRROR && !allow_mirror)
+		current = RESIDENCY_ANY;
+
+	if (a->seen < RESIDENCY_WARMUP)
+		return current;
+
+	cost[RESIDENCY_CPU] = RESIDENCY_UPLOAD_COST *
+		((uint64_t)a->read[ACCESS_GPU] + a->write[ACCESS_GPU]);
+	cost[RESIDENCY_GPU] = RESIDENCY_DOWNLOAD_COST *
+		((uint64_t)a->read[ACCESS_CPU] + a->write[ACCESS_CPU]);
+	cost[RESIDENCY_MIRROR] =
+		RESIDENCY_UPLOAD_COST * (uint64_t)a->write[ACCESS_CPU] +
+		RESIDENCY_DOWNLOAD_COST * (uint64_t)a->write[ACCESS_GPU];
+
+	/* On a tie, prefer a single copy, and of those the GPU */
+	best = RESIDENCY_GPU;
+	if (cost[RESIDENCY_CPU] < cost[best])
+		best = RESIDENCY_CPU;
+	if (allow_mirror && cost[RESIDENCY_MIRROR] < cost[best])
+		best = RESIDENCY_MIRROR;
+
+	/* Hysteresis: only move for a saving of more than a quarter */
+	if (current != RESIDENCY_ANY && current != best &&
+	    cost[best] * 4 >= cost[current] * 3)
+		return current;
+
+	return best;
+}
+
+#endif /* SNA_RESIDENCY_H */
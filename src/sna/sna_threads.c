@@ -370,3 +370,172 @@ void sna_image_composite(pixman_op_t        op,
 			sna_threads_kill();
 	}
 }
+
+struct thread_rotate {
+	const void *src;
+	void *dst;
+	int bpp;
+	int32_t src_stride, dst_stride;
+	int16_t src_x, src_y;
+	int16_t dst_x, dst_y;
+	uint16_t width, height;
+	const int *step;
+};
+
+static void thread_rotate(void *arg)
+{
+	struct thread_rotate *t = arg;
+	rotate_blt(t->src, t->dst, t->bpp,
+		   t->src_stride, t->dst_stride,
+		   t->src_x, t->src_y,
+		   t->dst_x, t->dst_y,
+		   t->width, t->height,
+		   t->step);
+}
+
+void sna_rotate_blt(const void *src, void *dst, int bpp,
+		    int32_t src_stride, int32_t dst_stride,
+		    int16_t src_x, int16_t src_y,
+		    int16_t dst_x, int16_t dst_y,
+		    uint16_t width, uint16_t height,
+		    const int step[4])
+{
+	int num_threads;
+
+	num_threads = sna_use_threads(width, height, ROTATE_TILE);
+	if (num_threads <= 1) {
+		if (sigtrap_get() == 0) {
+			rotate_blt(src, dst, bpp,
+				   src_stride, dst_stride,
+				   src_x, src_y,
+				   dst_x, dst_y,
+				   width, height,
+				   step);
+			sigtrap_put();
+		}
+	} else {
+		struct thread_rotate data[num_threads];
+		int y, dy, n;
+
+		DBG(("%s: using %d threads for rotating %dx%d\n",
+		     __FUNCTION__, num_threads, width, height));
+
+		/* Keep each band a whole number of tiles */
+		dy = (height + num_threads - 1) / num_threads;
+		dy = (dy + ROTATE_TILE - 1) & -ROTATE_TILE;
+		num_threads = (height + dy - 1) / dy;
+
+		data[0].src = src;
+		data[0].dst = dst;
+		data[0].bpp = bpp;
+		data[0].src_stride = src_stride;
+		data[0].dst_stride = dst_stride;
+		data[0].dst_x = dst_x;
+		data[0].width = width;
+		data[0].height = dy;
+		data[0].step = step;
+
+		y = 0;
+		if (sigtrap_get() == 0) {
+			for (n = 1; n < num_threads; n++) {
+				data[n] = data[0];
+				data[n].src_x = src_x + step[2] * y;
+				data[n].src_y = src_y + step[3] * y;
+				data[n].dst_y = dst_y + y;
+				y += dy;
+
+				sna_threads_run(n, thread_rotate, &data[n]);
+			}
+
+			assert(y < height);
+			data[0].src_x = src_x + step[2] * y;
+			data[0].src_y = src_y + step[3] * y;
+			data[0].dst_y = dst_y + y;
+			data[0].height = height - y;
+
+			thread_rotate(&data[0]);
+
+			sna_threads_wait();
+			sigtrap_put();
+		} else
+			sna_threads_kill();
+	}
+}
+
+struct thread_rotate_yuy2 {
+	const uint8_t *src;
+	uint8_t *dst;
+	int32_t src_stride, dst_stride;
+	uint16_t width, height;
+	int angle;
+};
+
+static void thread_rotate_yuy2(void *arg)
+{
+	struct thread_rotate_yuy2 *t = arg;
+	rotate_yuy2(t->src, t->dst,
+		    t->src_stride, t->dst_stride,
+		    t->width, t->height,
+		    t->angle);
+}
+
+void sna_rotate_yuy2(const void *src, void *dst,
+		     int32_t src_stride, int32_t dst_stride,
+		     uint16_t width, uint16_t height, int angle)
+{
+	int num_threads;
+
+	assert((width & 1) == 0 && (height & 1) == 0);
+	assert(angle == 90 || angle == 270);
+
+	/* Split by source columns, each band becomes a band of dst rows */
+	num_threads = sna_use_threads(height, width, ROTATE_TILE);
+	if (num_threads <= 1) {
+		if (sigtrap_get() == 0) {
+			rotate_yuy2(src, dst,
+				    src_stride, dst_stride,
+				    width, height,
+				    angle);
+			sigtrap_put();
+		}
+	} else {
+		struct thread_rotate_yuy2 data[num_threads];
+		int x, dx, n;
+
+		DBG(("%s: using %d threads for rotating %dx%d\n",
+		     __FUNCTION__, num_threads, width, height));
+
+		dx = (width + num_threads - 1) / num_threads;
+		dx = (dx + 2*ROTATE_TILE - 1) & -(2*ROTATE_TILE);
+		num_threads = (width + dx - 1) / dx;
+
+		x = 0;
+		if (sigtrap_get() == 0) {
+			for (n = 0; n < num_threads; n++) {
+				int w = MIN(dx, width - x);
+
+				data[n].src = (const uint8_t *)src + 2 * x;
+				if (angle == 90)
+					data[n].dst = (uint8_t *)dst + (width - x - w) * dst_stride;
+				else
+					data[n].dst = (uint8_t *)dst + x * dst_stride;
+				data[n].src_stride = src_stride;
+				data[n].dst_stride = dst_stride;
+				data[n].width = w;
+				data[n].height = height;
+				data[n].angle = angle;
+				x += w;
+
+				if (n)
+					sna_threads_run(n, thread_rotate_yuy2, &data[n]);
+			}
+			assert(x == width);
+
+			thread_rotate_yuy2(&data[0]);
+
+			sna_threads_wait();
+			sigtrap_put();
+		} else
+			sna_threads_kill();
+	}
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "config.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "sna.h"
+
+#define RING_BYTES (sizeof(struct sna_trace_ring) + \
+		    SNA_TRACE_SIZE * sizeof(struct sna_trace_event))
+
+static void trace_name(struct sna *sna, char *buf, int len)
+{
+	snprintf(buf, len, SNA_TRACE_NAME, (int)getpid(), sna->scrn->scrnIndex);
+}
+
+void sna_trace_init(struct sna *sna)
+{
+	struct sna_trace_ring *ring;
+	char name[64];
+	int fd;
+
+	trace_name(sna, name, sizeof(name));
+	DBG(("%s: %s\n", __FUNCTION__, name));
+
+	/* Left behind by a previous server that happened to share our pid */
+	shm_unlink(name);
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+		return;
+
+	if (ftruncate(fd, RING_BYTES)) {
+		close(fd);
+		shm_unlink(name);
+		return;
+	}
+
+	ring = mmap(NULL, RING_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED) {
+		shm_unlink(name);
+		return;
+	}
+
+	ring->size = SNA_TRACE_SIZE;
+	ring->version = SNA_TRACE_VERSION;
+	ring->magic = SNA_TRACE_MAGIC;
+	sna->trace = ring;
+
+	xf86DrvMsgVerb(sna->scrn->scrnIndex, X_INFO, 3,
+		       "Tracing of acceleration fallbacks available through %s\n",
+		       name);
+}
+
+void __sna_trace(struct sna *sna, unsigned op, unsigned path, unsigned reason,
+		 PixmapPtr pixmap, const BoxRec *box, uint64_t bytes)
+{
+	struct sna_trace_ring *ring = sna->trace;
+	struct sna_trace_event *e;
+	struct timespec ts;
+	uint64_t head;
+
+	/* The reader may scribble over the ring, so trust none of it */
+	head = ring->head;
+	e = &ring->event[head & (SNA_TRACE_SIZE - 1)];
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	e->time = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+	/* Stop tracing for a reader that no longer polls, it probably died */
+	if ((int64_t)(e->time - ring->alive) > (int64_t)SNA_TRACE_TIMEOUT) {
+		DBG(("%s: reader gone, disabling\n", __FUNCTION__));
+		ring->enabled = 0;
+	}
+	e->op = op;
+	e->path = path;
+	e->reason = reason;
+	e->bytes = bytes > UINT32_MAX ? UINT32_MAX : bytes;
+	if (pixmap) {
+		e->pixmap = pixmap->drawable.serialNumber;
+		e->pixmap_width = pixmap->drawable.width;
+		e->pixmap_height = pixmap->drawable.height;
+		e->bpp = pixmap->drawable.bitsPerPixel;
+	} else {
+		e->pixmap = 0;
+		e->pixmap_width = e->pixmap_height = 0;
+		e->bpp = 0;
+	}
+	if (box) {
+		e->width = box->x2 - box->x1;
+		e->height = box->y2 - box->y1;
+	} else
+		e->width = e->height = 0;
+
+	__sync_synchronize();
+	ring->head = head + 1;
+}
+
+void sna_trace_fini(struct sna *sna)
+{
+	char name[64];
+
+	if (sna->trace == NULL)
+		return;
+
+	trace_name(sna, name, sizeof(name));
+	DBG(("%s: %s\n", __FUNCTION__, name));
+
+	munmap(sna->trace, RING_BYTES);
+	sna->trace = NULL;
+	shm_unlink(name);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef SNA_TRACE_H
+#define SNA_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Where each operation ended up (GPU, blitter or CPU), why, and how many
+ * bytes were migrated between the CPU and GPU copies of a pixmap for it.
+ *
+ * Every screen exports a ring of these events in a shared memory object,
+ * SNA_TRACE_NAME, which only its owner (normally root) can open. Nothing
+ * is written until a reader sets enabled, so when nobody is looking the
+ * cost is a single load and branch per trace point. A reader stamps alive
+ * each time it polls, and once it has not done so for SNA_TRACE_TIMEOUT
+ * the server assumes it died and clears enabled again. The reader is
+ * tools/intel-sna-trace (see sna_trace_reader.h); the driver side lives
+ * in sna_trace.c.
+ *
+ * There is a single writer, the server thread. It fills in the event at
+ * head, overwriting event head - SNA_TRACE_SIZE, and only then advances
+ * head. So a reader copies out everything between its last position and
+ * head, and afterwards discards whatever is within SNA_TRACE_SIZE of the
+ * new head, as that may be torn.
+ */
+
+#define SNA_TRACE_NAME "/intel-sna-trace-%d.%d" /* server pid, screen */
+#define SNA_TRACE_MAGIC 0x54414e53 /* "SNAT" */
+#define SNA_TRACE_VERSION 2
+#define SNA_TRACE_SIZE (1 << 16) /* events, a power of two */
+#define SNA_TRACE_TIMEOUT (5 * 1000000000ull) /* ns without the reader polling */
+
+enum sna_trace_op {
+	SNA_TRACE_DRAW, /* core drawing, sna_drawable_use_bo() */
+	SNA_TRACE_COMPOSITE,
+	SNA_TRACE_SPANS, /* spans declined, to be drawn via a mask instead */
+	SNA_TRACE_UPLOAD, /* CPU -> GPU migration */
+	SNA_TRACE_DOWNLOAD, /* GPU -> CPU migration */
+	SNA_TRACE_NUM_OPS
+};
+
+enum sna_trace_path {
+	SNA_TRACE_GPU, /* into the GPU bo, engine chosen later */
+	SNA_TRACE_RENDER,
+	SNA_TRACE_BLT,
+	SNA_TRACE_CPU_BO, /* by the GPU, into the snooped CPU bo */
+	SNA_TRACE_CPU, /* by pixman, or a CPU copy for a migration */
+	SNA_TRACE_NUM_PATHS
+};
+
+enum sna_trace_reason {
+	SNA_TRACE_NONE,
+	SNA_TRACE_UNATTACHED,
+	SNA_TRACE_WEDGED,
+	SNA_TRACE_GPU_IDLE,
+	SNA_TRACE_GPU_DAMAGE,
+	SNA_TRACE_CPU_DAMAGE,
+	SNA_TRACE_PARTIAL_DAMAGE,
+	SNA_TRACE_NO_GPU_BO,
+	SNA_TRACE_NO_CPU_BO,
+	SNA_TRACE_CPU_BO_IDLE,
+	SNA_TRACE_CPU_BO_BUSY,
+	SNA_TRACE_MIGRATE_FAILED,
+	SNA_TRACE_SMALL,
+	SNA_TRACE_PICTURE,
+	SNA_TRACE_UNSUPPORTED,
+	SNA_TRACE_NUM_REASONS
+};
+
+static inline const char *sna_trace_op_name(unsigned op)
+{
+	static const char * const names[] = {
+		[SNA_TRACE_DRAW] = "draw",
+		[SNA_TRACE_COMPOSITE] = "composite",
+		[SNA_TRACE_SPANS] = "spans",
+		[SNA_TRACE_UPLOAD] = "upload",
+		[SNA_TRACE_DOWNLOAD] = "download",
+	};
+	return op < SNA_TRACE_NUM_OPS ? names[op] : "?";
+}
+
+static inline const char *sna_trace_path_name(unsigned path)
+{
+	static const char * const names[] = {
+		[SNA_TRACE_GPU] = "gpu",
+		[SNA_TRACE_RENDER] = "render",
+		[SNA_TRACE_BLT] = "blt",
+		[SNA_TRACE_CPU_BO] = "cpu-bo",
+		[SNA_TRACE_CPU] = "cpu",
+	};
+	return path < SNA_TRACE_NUM_PATHS ? names[path] : "?";
+}
+
+static inline const char *sna_trace_reason_name(unsigned reason)
+{
+	static const char * const names[] = {
+		[SNA_TRACE_NONE] = "",
+		[SNA_TRACE_UNATTACHED] = "pixmap not attached",
+		[SNA_TRACE_WEDGED] = "GPU wedged",
+		[SNA_TRACE_GPU_IDLE] = "GPU bo idle, prefer CPU",
+		[SNA_TRACE_GPU_DAMAGE] = "within GPU damage",
+		[SNA_TRACE_CPU_DAMAGE] = "within CPU damage",
+		[SNA_TRACE_PARTIAL_DAMAGE] = "straddles CPU and GPU damage",
+		[SNA_TRACE_NO_GPU_BO] = "will not allocate GPU bo",
+		[SNA_TRACE_NO_CPU_BO] = "no CPU bo",
+		[SNA_TRACE_CPU_BO_IDLE] = "CPU bo idle, not forced",
+		[SNA_TRACE_CPU_BO_BUSY] = "CPU bo busy",
+		[SNA_TRACE_MIGRATE_FAILED] = "migration failed",
+		[SNA_TRACE_SMALL] = "small or CPU damaged target",
+		[SNA_TRACE_PICTURE] = "unhandled picture",
+		[SNA_TRACE_UNSUPPORTED] = "unsupported by renderer",
+	};
+	return reason < SNA_TRACE_NUM_REASONS ? names[reason] : "?";
+}
+
+struct sna_trace_event {
+	uint64_t time; /* ns, CLOCK_MONOTONIC */
+	uint32_t pixmap; /* its serial number */
+	uint32_t bytes; /* migrated, by uploads and downloads */
+	uint16_t width, height; /* of the operation */
+	uint16_t pixmap_width, pixmap_height;
+	uint8_t op, path, reason, bpp;
+	uint32_t pad;
+};
+
+struct sna_trace_ring {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; /* of event[] */
+	volatile uint32_t enabled; /* set by the reader */
+	volatile uint64_t head; /* events ever written */
+	volatile uint64_t alive; /* ns, CLOCK_MONOTONIC, of the last poll */
+	uint64_t pad[4];
+	struct sna_trace_event event[];
+};
+
+#endif /* SNA_TRACE_H */
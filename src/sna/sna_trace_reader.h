@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef SNA_TRACE_READER_H
+#define SNA_TRACE_READER_H
+
+#include <sys/mman.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sna_trace.h"
+
+/*
+ * The reading side of the trace ring (sna_trace.h), shared by
+ * tools/intel-sna-trace and the tests.
+ *
+ * The server stops tracing once a reader has not polled for
+ * SNA_TRACE_TIMEOUT, so a reader must call sna_trace_read() at least
+ * that often to keep it going, even if it has nothing to collect.
+ */
+
+#define SNA_TRACE_RING_BYTES (sizeof(struct sna_trace_ring) + \
+			      SNA_TRACE_SIZE * sizeof(struct sna_trace_event))
+
+struct sna_trace_reader {
+	struct sna_trace_ring *ring;
+	uint64_t tail; /* the next event to read */
+	uint64_t lost; /* overwritten before we could read them */
+};
+
+static inline uint64_t sna_trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Look for the servers exporting a trace, naming the first found. If
+ * more than one is found, they are all listed on list (unless NULL).
+ * Returns how many were found, or -1 if we cannot search.
+ */
+static inline int sna_trace_find(char *name, int len, FILE *list)
+{
+	const char *prefix = "intel-sna-trace-";
+	struct dirent *de;
+	int found = 0;
+	DIR *dir;
+
+	dir = opendir("/dev/shm");
+	if (dir == NULL)
+		return -1;
+
+	while ((de = readdir(dir))) {
+		if (strncmp(de->d_name, prefix, strlen(prefix)))
+			continue;
+
+		if (found++ == 0) {
+			snprintf(name, len, "/%.200s", de->d_name);
+			continue;
+		}
+
+		if (list == NULL)
+			continue;
+
+		if (found == 2)
+			fprintf(list, "%s\n", name);
+		fprintf(list, "/%s\n", de->d_name);
+	}
+	closedir(dir);
+
+	return found;
+}
+
+/*
+ * Map the named trace and start tracing. On failure errno is left
+ * describing why, EPROTO for a trace we do not understand.
+ */
+static inline bool sna_trace_attach(struct sna_trace_reader *r,
+				    const char *name)
+{
+	struct sna_trace_ring *ring;
+	int fd;
+
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0)
+		return false;
+
+	ring = mmap(NULL, SNA_TRACE_RING_BYTES,
+		    PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED)
+		return false;
+
+	if (ring->magic != SNA_TRACE_MAGIC ||
+	    ring->version != SNA_TRACE_VERSION ||
+	    ring->size != SNA_TRACE_SIZE) {
+		munmap(ring, SNA_TRACE_RING_BYTES);
+		errno = EPROTO;
+		return false;
+	}
+
+	r->ring = ring;
+	r->tail = ring->head;
+	r->lost = 0;
+
+	ring->alive = sna_trace_now();
+	__sync_synchronize();
+	ring->enabled = 1;
+	return true;
+}
+
+static inline void sna_trace_detach(struct sna_trace_reader *r)
+{
+	if (r->ring == NULL)
+		return;
+
+	r->ring->enabled = 0;
+	munmap(r->ring, SNA_TRACE_RING_BYTES);
+	r->ring = NULL;
+}
+
+/* Skip over the events at the head of our window that the server has
+ * reused, or may be overwriting right now: the writer fills in event
+ * head at the slot of head - SNA_TRACE_SIZE before advancing head.
+ */
+static inline uint64_t __sna_trace_lapped(struct sna_trace_reader *r,
+					  uint64_t head)
+{
+	uint64_t n = 0;
+
+	if (head - r->tail >= SNA_TRACE_SIZE) {
+		n = head - r->tail - SNA_TRACE_SIZE + 1;
+		r->tail += n;
+		r->lost += n;
+	}
+
+	return n;
+}
+
+/*
+ * Copy the events written since the last read into buf, which must hold
+ * SNA_TRACE_SIZE, and keep the server tracing. Returns the first event
+ * copied and their number in count, oldest first.
+ */
+static inline const struct sna_trace_event *
+sna_trace_read(struct sna_trace_reader *r,
+	       struct sna_trace_event *buf,
+	       unsigned *count)
+{
+	struct sna_trace_ring *ring = r->ring;
+	uint64_t head, start, i;
+
+	ring->alive = sna_trace_now();
+	ring->enabled = 1;
+
+	head = ring->head;
+	__sync_synchronize();
+	__sna_trace_lapped(r, head);
+	start = r->tail;
+	for (i = start; i < head; i++)
+		buf[i - start] = ring->event[i & (SNA_TRACE_SIZE - 1)];
+	__sync_synchronize();
+
+	/* Anything the server has since lapped was torn as we copied */
+	__sna_trace_lapped(r, ring->head);
+	if (r->tail >= head) {
+		*count = 0;
+		return buf;
+	}
+
+	*count = head - r->tail;
+	buf += r->tail - start;
+	r->tail = head;
+	return buf;
+}
+
+#endif /* SNA_TRACE_READER_H */
@@ -119,6 +119,25 @@ static inline bool is_precise(PicturePtr dst, PictFormatPtr mask)
 	return dst->polyMode == PolyModePrecise && !is_mono(dst, mask);
 }
 
+/* Declining spans sends us to a mask or pixman, so say why we went there */
+static inline bool
+check_composite_spans(struct sna *sna, uint8_t op,
+		      PicturePtr src, PicturePtr dst,
+		      int width, int height, unsigned flags)
+{
+	if (sna->render.check_composite_spans(sna, op, src, dst,
+					      width, height, flags))
+		return true;
+
+	if (sna_trace_enabled(sna)) {
+		BoxRec box = { 0, 0, width, height };
+		__sna_trace(sna, SNA_TRACE_SPANS, SNA_TRACE_CPU,
+			    SNA_TRACE_UNSUPPORTED,
+			    get_drawable_pixmap(dst->pDrawable), &box, 0);
+	}
+	return false;
+}
+
 static inline bool
 trapezoid_span_inplace(struct sna *sna,
 		       CARD8 op, PicturePtr src, PicturePtr dst,
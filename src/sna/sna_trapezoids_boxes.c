@@ -1369,8 +1369,8 @@ composite_unaligned_boxes(struct sna *sna,
 		return false;
 
 	if (force_fallback ||
-	    !sna->render.check_composite_spans(sna, op, src, dst, 0, 0,
-					       COMPOSITE_SPANS_RECTILINEAR)) {
+	    !check_composite_spans(sna, op, src, dst, 0, 0,
+				   COMPOSITE_SPANS_RECTILINEAR)) {
 fallback:
 		return composite_unaligned_boxes_fallback(sna, op, src, dst,
 							  src_x, src_y,
@@ -1420,10 +1420,10 @@ fallback:
 		return true;
 	}
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst,
-					       clip.extents.x2 - clip.extents.x1,
-					       clip.extents.y2 - clip.extents.y1,
-					       COMPOSITE_SPANS_RECTILINEAR)) {
+	if (!check_composite_spans(sna, op, src, dst,
+				   clip.extents.x2 - clip.extents.x1,
+				   clip.extents.y2 - clip.extents.y1,
+				   COMPOSITE_SPANS_RECTILINEAR)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		goto fallback;
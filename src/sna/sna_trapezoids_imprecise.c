@@ -32,6 +32,7 @@
 #include "sna_render.h"
 #include "sna_render_inline.h"
 #include "sna_trapezoids.h"
+#include "sna_trapezoids_tor.h"
 #include "fb/fbpict.h"
 
 #include <mipict.h>
@@ -110,885 +111,6 @@ inline static void apply_damage_box(struct sna_composite_op *op, const BoxRec *b
 		_apply_damage_box(op, box);
 }
 
-#define FAST_SAMPLES_X_TO_INT_FRAC(x, i, f) \
-	_GRID_TO_INT_FRAC_shift(x, i, f, FAST_SAMPLES_shift)
-
-#define FAST_SAMPLES_INT(x) ((x) >> (FAST_SAMPLES_shift))
-#define FAST_SAMPLES_FRAC(x) ((x) & (FAST_SAMPLES_mask))
-
-#define _GRID_TO_INT_FRAC_shift(t, i, f, b) do {	\
-    (f) = FAST_SAMPLES_FRAC(t);				\
-    (i) = FAST_SAMPLES_INT(t);				\
-} while (0)
-
-#define FAST_SAMPLES_XY (FAST_SAMPLES_X*FAST_SAMPLES_Y) /* Unit area on the grid. */
-#define AREA_TO_ALPHA(c)  ((c) / (float)FAST_SAMPLES_XY)
-
-struct quorem {
-	int32_t quo;
-	int64_t rem;
-};
-
-struct edge {
-	struct edge *next, *prev;
-
-	int dir;
-	int cell;
-	int height_left;
-
-	struct quorem x;
-
-	/* Advance of the current x when moving down a subsample line. */
-	struct quorem dxdy;
-	int64_t dy;
-
-	/* The clipped y of the top of the edge. */
-	int ytop;
-
-	/* y2-y1 after orienting the edge downwards.  */
-};
-
-/* Number of subsample rows per y-bucket. Must be SAMPLES_Y. */
-#define EDGE_Y_BUCKET_HEIGHT FAST_SAMPLES_Y
-#define EDGE_Y_BUCKET_INDEX(y, ymin) (((y) - (ymin))/EDGE_Y_BUCKET_HEIGHT)
-
-/* A collection of sorted and vertically clipped edges of the polygon.
- * Edges are moved from the polygon to an active list while scan
- * converting. */
-struct polygon {
-	/* The vertical clip extents. */
-	int ymin, ymax;
-
-	/* Array of edges all starting in the same bucket.	An edge is put
-	 * into bucket EDGE_BUCKET_INDEX(edge->ytop, polygon->ymin) when
-	 * it is added to the polygon. */
-	struct edge **y_buckets;
-	struct edge *y_buckets_embedded[64];
-
-	struct edge edges_embedded[32];
-	struct edge *edges;
-	int num_edges;
-};
-
-/* A cell records the effect on pixel coverage of polygon edges
- * passing through a pixel.  It contains two accumulators of pixel
- * coverage.
- *
- * Consider the effects of a polygon edge on the coverage of a pixel
- * it intersects and that of the following one.  The coverage of the
- * following pixel is the height of the edge multiplied by the width
- * of the pixel, and the coverage of the pixel itself is the area of
- * the trapezoid formed by the edge and the right side of the pixel.
- *
- * +-----------------------+-----------------------+
- * |                       |                       |
- * |                       |                       |
- * |_______________________|_______________________|
- * |   \...................|.......................|\
- * |    \..................|.......................| |
- * |     \.................|.......................| |
- * |      \....covered.....|.......................| |
- * |       \....area.......|.......................| } covered height
- * |        \..............|.......................| |
- * |uncovered\.............|.......................| |
- * |  area    \............|.......................| |
- * |___________\...........|.......................|/
- * |                       |                       |
- * |                       |                       |
- * |                       |                       |
- * +-----------------------+-----------------------+
- *
- * Since the coverage of the following pixel will always be a multiple
- * of the width of the pixel, we can store the height of the covered
- * area instead.  The coverage of the pixel itself is the total
- * coverage minus the area of the uncovered area to the left of the
- * edge.  As it's faster to compute the uncovered area we only store
- * that and subtract it from the total coverage later when forming
- * spans to blit.
- *
- * The heights and areas are signed, with left edges of the polygon
- * having positive sign and right edges having negative sign.  When
- * two edges intersect they swap their left/rightness so their
- * contribution above and below the intersection point must be
- * computed separately. */
-struct cell {
-	struct cell *next;
-	int x;
-	int16_t uncovered_area;
-	int16_t covered_height;
-};
-
-/* A cell list represents the scan line sparsely as cells ordered by
- * ascending x.  It is geared towards scanning the cells in order
- * using an internal cursor. */
-struct cell_list {
-	struct cell *cursor;
-
-	/* Points to the left-most cell in the scan line. */
-	struct cell head, tail;
-
-	int16_t x1, x2;
-	int16_t count, size;
-	struct cell *cells;
-	struct cell embedded[256];
-};
-
-/* The active list contains edges in the current scan line ordered by
- * the x-coordinate of the intercept of the edge and the scan line. */
-struct active_list {
-	/* Leftmost edge on the current scan line. */
-	struct edge head, tail;
-};
-
-struct tor {
-    struct polygon	polygon[1];
-    struct active_list	active[1];
-    struct cell_list	coverages[1];
-
-    BoxRec extents;
-};
-
-/* Compute the floored division a/b. Assumes / and % perform symmetric
- * division. */
-/* Rewinds the cell list's cursor to the beginning.  After rewinding
- * we're good to cell_list_find() the cell any x coordinate. */
-inline static void
-cell_list_rewind(struct cell_list *cells)
-{
-	cells->cursor = &cells->head;
-}
-
-static bool
-cell_list_init(struct cell_list *cells, int x1, int x2)
-{
-	cells->tail.next = NULL;
-	cells->tail.x = INT_MAX;
-	cells->head.x = INT_MIN;
-	cells->head.next = &cells->tail;
-	cells->head.covered_height = 0;
-	cell_list_rewind(cells);
-	cells->count = 0;
-	cells->x1 = x1;
-	cells->x2 = x2;
-	cells->size = x2 - x1 + 1;
-	cells->cells = cells->embedded;
-	if (cells->size > ARRAY_SIZE(cells->embedded))
-		cells->cells = malloc(cells->size * sizeof(struct cell));
-	return cells->cells != NULL;
-}
-
-static void
-cell_list_fini(struct cell_list *cells)
-{
-	if (cells->cells != cells->embedded)
-		free(cells->cells);
-}
-
-inline static void
-cell_list_reset(struct cell_list *cells)
-{
-	cell_list_rewind(cells);
-	cells->head.next = &cells->tail;
-	cells->head.covered_height = 0;
-	cells->count = 0;
-}
-
-inline static struct cell *
-cell_list_alloc(struct cell_list *cells,
-		struct cell *tail,
-		int x)
-{
-	struct cell *cell;
-
-	assert(cells->count < cells->size);
-	cell = cells->cells + cells->count++;
-	cell->next = tail->next;
-	tail->next = cell;
-
-	cell->x = x;
-	cell->covered_height = 0;
-	cell->uncovered_area = 0;
-	return cell;
-}
-
-/* Find a cell at the given x-coordinate.  Returns %NULL if a new cell
- * needed to be allocated but couldn't be.  Cells must be found with
- * non-decreasing x-coordinate until the cell list is rewound using
- * cell_list_rewind(). Ownership of the returned cell is retained by
- * the cell list. */
-inline static struct cell *
-cell_list_find(struct cell_list *cells, int x)
-{
-	struct cell *tail;
-
-	if (x >= cells->x2)
-		return &cells->tail;
-
-	if (x < cells->x1)
-		return &cells->head;
-
-	tail = cells->cursor;
-	if (tail->x == x)
-		return tail;
-
-	do {
-		if (tail->next->x > x)
-			break;
-
-		tail = tail->next;
-		if (tail->next->x > x)
-			break;
-
-		tail = tail->next;
-		if (tail->next->x > x)
-			break;
-
-		tail = tail->next;
-	} while (1);
-
-	if (tail->x != x)
-		tail = cell_list_alloc(cells, tail, x);
-
-	return cells->cursor = tail;
-}
-
-/* Add a subpixel span covering [x1, x2) to the coverage cells. */
-inline static void
-cell_list_add_subspan(struct cell_list *cells, int x1, int x2)
-{
-	struct cell *cell;
-	int ix1, fx1;
-	int ix2, fx2;
-
-	if (x1 == x2)
-		return;
-
-	FAST_SAMPLES_X_TO_INT_FRAC(x1, ix1, fx1);
-	FAST_SAMPLES_X_TO_INT_FRAC(x2, ix2, fx2);
-
-	__DBG(("%s: x1=%d (%d+%d), x2=%d (%d+%d)\n", __FUNCTION__,
-	       x1, ix1, fx1, x2, ix2, fx2));
-
-	cell = cell_list_find(cells, ix1);
-	if (ix1 != ix2) {
-		cell->uncovered_area += fx1;
-		++cell->covered_height;
-
-		cell = cell_list_find(cells, ix2);
-		cell->uncovered_area -= fx2;
-		--cell->covered_height;
-	} else
-		cell->uncovered_area += (fx1-fx2);
-}
-
-inline static void
-cell_list_add_span(struct cell_list *cells, int x1, int x2)
-{
-	struct cell *cell;
-	int ix1, fx1;
-	int ix2, fx2;
-
-	FAST_SAMPLES_X_TO_INT_FRAC(x1, ix1, fx1);
-	FAST_SAMPLES_X_TO_INT_FRAC(x2, ix2, fx2);
-
-	__DBG(("%s: x1=%d (%d+%d), x2=%d (%d+%d)\n", __FUNCTION__,
-	       x1, ix1, fx1, x2, ix2, fx2));
-
-	cell = cell_list_find(cells, ix1);
-	if (ix1 != ix2) {
-		cell->uncovered_area += fx1*FAST_SAMPLES_Y;
-		cell->covered_height += FAST_SAMPLES_Y;
-
-		cell = cell_list_find(cells, ix2);
-		cell->uncovered_area -= fx2*FAST_SAMPLES_Y;
-		cell->covered_height -= FAST_SAMPLES_Y;
-	} else
-		cell->uncovered_area += (fx1-fx2)*FAST_SAMPLES_Y;
-}
-
-static void
-polygon_fini(struct polygon *polygon)
-{
-	if (polygon->y_buckets != polygon->y_buckets_embedded)
-		free(polygon->y_buckets);
-
-	if (polygon->edges != polygon->edges_embedded)
-		free(polygon->edges);
-}
-
-static bool
-polygon_init(struct polygon *polygon, int num_edges, int ymin, int ymax)
-{
-	unsigned num_buckets = EDGE_Y_BUCKET_INDEX(ymax-1, ymin) + 1;
-
-	if (unlikely(ymax - ymin > 0x7FFFFFFFU - EDGE_Y_BUCKET_HEIGHT))
-		return false;
-
-	polygon->edges = polygon->edges_embedded;
-	polygon->y_buckets = polygon->y_buckets_embedded;
-
-	polygon->num_edges = 0;
-	if (num_edges > (int)ARRAY_SIZE(polygon->edges_embedded)) {
-		polygon->edges = malloc(sizeof(struct edge)*num_edges);
-		if (unlikely(NULL == polygon->edges))
-			goto bail_no_mem;
-	}
-
-	if (num_buckets >= ARRAY_SIZE(polygon->y_buckets_embedded)) {
-		polygon->y_buckets = malloc((1+num_buckets)*sizeof(struct edge *));
-		if (unlikely(NULL == polygon->y_buckets))
-			goto bail_no_mem;
-	}
-	memset(polygon->y_buckets, 0, num_buckets * sizeof(struct edge *));
-	polygon->y_buckets[num_buckets] = (void *)-1;
-
-	polygon->ymin = ymin;
-	polygon->ymax = ymax;
-	return true;
-
-bail_no_mem:
-	polygon_fini(polygon);
-	return false;
-}
-
-static void
-_polygon_insert_edge_into_its_y_bucket(struct polygon *polygon, struct edge *e)
-{
-	unsigned ix = EDGE_Y_BUCKET_INDEX(e->ytop, polygon->ymin);
-	struct edge **ptail = &polygon->y_buckets[ix];
-	assert(e->ytop < polygon->ymax);
-	e->next = *ptail;
-	*ptail = e;
-}
-
-inline static void
-polygon_add_edge(struct polygon *polygon,
-		 const xTrapezoid *t,
-		 const xLineFixed *edge,
-		 int dir, int dx, int dy)
-{
-	struct edge *e = &polygon->edges[polygon->num_edges];
-	int ytop, ybot;
-
-	assert(t->bottom > t->top);
-	assert(edge->p2.y > edge->p1.y);
-
-	e->dir = dir;
-
-	ytop = pixman_fixed_to_fast(t->top) + dy;
-	if (ytop < polygon->ymin)
-		ytop = polygon->ymin;
-
-	ybot = pixman_fixed_to_fast(t->bottom) + dy;
-	if (ybot > polygon->ymax)
-		ybot = polygon->ymax;
-
-	e->ytop = ytop;
-	e->height_left = ybot - ytop;
-	if (e->height_left <= 0)
-		return;
-
-	if (pixman_fixed_to_fast(edge->p1.x) == pixman_fixed_to_fast(edge->p2.x)) {
-		e->cell = e->x.quo = pixman_fixed_to_fast(edge->p1.x) + dx;
-		e->x.rem = 0;
-		e->dxdy.quo = 0;
-		e->dxdy.rem = 0;
-		e->dy = 0;
-	} else {
-		int64_t Ex, Ey, tmp;
-
-		Ex = ((int64_t)edge->p2.x - edge->p1.x) * FAST_SAMPLES_X;
-		Ey = ((int64_t)edge->p2.y - edge->p1.y) * FAST_SAMPLES_Y * (2 << 16);
-		assert(Ey > 0);
-
-		e->dxdy.quo = Ex * (2 << 16) / Ey;
-		e->dxdy.rem = Ex * (2 << 16) % Ey;
-
-		tmp = (int64_t)(2 * (ytop - dy) + 1) << 16;
-		tmp -= (int64_t)edge->p1.y * FAST_SAMPLES_Y * 2;
-		tmp *= Ex;
-		e->x.quo = tmp / Ey;
-		e->x.rem = tmp % Ey;
-
-		tmp = (int64_t)edge->p1.x * FAST_SAMPLES_X;
-		e->x.quo += tmp / (1 << 16) + dx;
-		tmp &= (1 << 16) - 1;
-		if (tmp) {
-			if (Ey < INT64_MAX >> 16)
-				tmp = (tmp * Ey) / (1 << 16);
-			else /* Handle overflow by losing precision */
-				tmp = tmp * (Ey / (1 << 16));
-			e->x.rem += tmp;
-		}
-
-		if (e->x.rem < 0) {
-			--e->x.quo;
-			e->x.rem += Ey;
-		} else if (e->x.rem >= Ey) {
-			++e->x.quo;
-			e->x.rem -= Ey;
-		}
-		assert(e->x.rem >= 0 && e->x.rem < Ey);
-
-		e->cell = e->x.quo + (e->x.rem >= Ey/2);
-		e->dy = Ey;
-	}
-
-	_polygon_insert_edge_into_its_y_bucket(polygon, e);
-	polygon->num_edges++;
-}
-
-inline static void
-polygon_add_line(struct polygon *polygon,
-		 const xPointFixed *p1,
-		 const xPointFixed *p2,
-		 int dx, int dy)
-{
-	struct edge *e = &polygon->edges[polygon->num_edges];
-	int top, bot;
-
-	if (p1->y == p2->y)
-		return;
-
-	__DBG(("%s: line=(%d, %d), (%d, %d)\n",
-	       __FUNCTION__, (int)p1->x, (int)p1->y, (int)p2->x, (int)p2->y));
-
-	e->dir = 1;
-	if (p2->y < p1->y) {
-		const xPointFixed *t;
-
-		e->dir = -1;
-
-		t = p1;
-		p1 = p2;
-		p2 = t;
-	}
-
-	top = pixman_fixed_to_fast(p1->y) + dy;
-	if (top < polygon->ymin)
-		top = polygon->ymin;
-
-	bot = pixman_fixed_to_fast(p2->y) + dy;
-	if (bot > polygon->ymax)
-		bot = polygon->ymax;
-
-	if (bot <= top)
-		return;
-
-	e->ytop = top;
-	e->height_left = bot - top;
-	if (e->height_left <= 0)
-		return;
-
-	__DBG(("%s: edge height=%d\n", __FUNCTION__, e->dir * e->height_left));
-
-	if (pixman_fixed_to_fast(p1->x) == pixman_fixed_to_fast(p2->x)) {
-		e->cell = e->x.quo = pixman_fixed_to_fast(p1->x) + dx;
-		e->x.rem = 0;
-		e->dxdy.quo = 0;
-		e->dxdy.rem = 0;
-		e->dy = 0;
-	} else {
-		int64_t Ex, Ey, tmp;
-
-		Ex = ((int64_t)p2->x - p1->x) * FAST_SAMPLES_X;
-		Ey = ((int64_t)p2->y - p1->y) * FAST_SAMPLES_Y * (2 << 16);
-
-		e->dxdy.quo = Ex * (2 << 16) / Ey;
-		e->dxdy.rem = Ex * (2 << 16) % Ey;
-
-		tmp = (int64_t)(2 * (top - dy) + 1) << 16;
-		tmp -= (int64_t)p1->y * FAST_SAMPLES_Y * 2;
-		tmp *= Ex;
-		e->x.quo = tmp / Ey;
-		e->x.rem = tmp % Ey;
-
-		tmp = (int64_t)p1->x * FAST_SAMPLES_X;
-		e->x.quo += tmp / (1 << 16) + dx;
-		e->x.rem += ((tmp & ((1 << 16) - 1)) * Ey) / (1 << 16);
-
-		if (e->x.rem < 0) {
-			--e->x.quo;
-			e->x.rem += Ey;
-		} else if (e->x.rem >= Ey) {
-			++e->x.quo;
-			e->x.rem -= Ey;
-		}
-
-		e->cell = e->x.quo + (e->x.rem >= Ey/2);
-		e->dy = Ey;
-	}
-
-	if (polygon->num_edges > 0) {
-		struct edge *prev = &polygon->edges[polygon->num_edges-1];
-		/* detect degenerate triangles inserted into tristrips */
-		if (e->dir == -prev->dir &&
-		    e->ytop == prev->ytop &&
-		    e->height_left == prev->height_left &&
-		    e->x.quo == prev->x.quo &&
-		    e->x.rem == prev->x.rem &&
-		    e->dxdy.quo == prev->dxdy.quo &&
-		    e->dxdy.rem == prev->dxdy.rem) {
-			unsigned ix = EDGE_Y_BUCKET_INDEX(e->ytop,
-							  polygon->ymin);
-			polygon->y_buckets[ix] = prev->next;
-			polygon->num_edges--;
-			return;
-		}
-	}
-
-	_polygon_insert_edge_into_its_y_bucket(polygon, e);
-	polygon->num_edges++;
-}
-
-static void
-active_list_reset(struct active_list *active)
-{
-	active->head.height_left = INT_MAX;
-	active->head.cell = INT_MIN;
-	active->head.dy = 0;
-	active->head.prev = NULL;
-	active->head.next = &active->tail;
-	active->tail.prev = &active->head;
-	active->tail.next = NULL;
-	active->tail.cell = INT_MAX;
-	active->tail.height_left = INT_MAX;
-	active->tail.dy = 0;
-}
-
-static struct edge *
-merge_sorted_edges(struct edge *head_a, struct edge *head_b)
-{
-	struct edge *head, **next, *prev;
-	int32_t x;
-
-	if (head_b == NULL)
-		return head_a;
-
-	prev = head_a->prev;
-	next = &head;
-	if (head_a->cell <= head_b->cell) {
-		head = head_a;
-	} else {
-		head = head_b;
-		head_b->prev = prev;
-		goto start_with_b;
-	}
-
-	do {
-		x = head_b->cell;
-		while (head_a != NULL && head_a->cell <= x) {
-			prev = head_a;
-			next = &head_a->next;
-			head_a = head_a->next;
-		}
-
-		head_b->prev = prev;
-		*next = head_b;
-		if (head_a == NULL)
-			return head;
-
-start_with_b:
-		x = head_a->cell;
-		while (head_b != NULL && head_b->cell <= x) {
-			prev = head_b;
-			next = &head_b->next;
-			head_b = head_b->next;
-		}
-
-		head_a->prev = prev;
-		*next = head_a;
-		if (head_b == NULL)
-			return head;
-	} while (1);
-}
-
-static struct edge *
-sort_edges(struct edge  *list,
-	   unsigned int  level,
-	   struct edge **head_out)
-{
-	struct edge *head_other, *remaining;
-	unsigned int i;
-
-	head_other = list->next;
-	if (head_other == NULL) {
-		*head_out = list;
-		return NULL;
-	}
-
-	remaining = head_other->next;
-	if (list->cell <= head_other->cell) {
-		*head_out = list;
-		head_other->next = NULL;
-	} else {
-		*head_out = head_other;
-		head_other->prev = list->prev;
-		head_other->next = list;
-		list->prev = head_other;
-		list->next = NULL;
-	}
-
-	for (i = 0; i < level && remaining; i++) {
-		remaining = sort_edges(remaining, i, &head_other);
-		*head_out = merge_sorted_edges(*head_out, head_other);
-	}
-
-	return remaining;
-}
-
-static struct edge *filter(struct edge *edges)
-{
-	struct edge *e;
-
-	e = edges;
-	while (e->next) {
-		struct edge *n = e->next;
-		if (e->dir == -n->dir &&
-		    e->height_left == n->height_left &&
-		    &e->x.quo == &n->x.quo &&
-		    &e->x.rem == &n->x.rem &&
-		    &e->dxdy.quo == &n->dxdy.quo &&
-		    &e->dxdy.rem == &n->dxdy.rem) {
-			if (e->prev)
-				e->prev->next = n->next;
-			else
-				edges = n->next;
-			if (n->next)
-				n->next->prev = e->prev;
-			else
-				break;
-			e = n->next;
-		} else
-			e = n;
-	}
-
-	return edges;
-}
-
-static struct edge *
-merge_unsorted_edges(struct edge *head, struct edge *unsorted)
-{
-	sort_edges(unsorted, UINT_MAX, &unsorted);
-	return merge_sorted_edges(head, filter(unsorted));
-}
-
-/* Test if the edges on the active list can be safely advanced by a
- * full row without intersections or any edges ending. */
-inline static int
-can_full_step(struct active_list *active)
-{
-	const struct edge *e;
-	int min_height = INT_MAX;
-
-	assert(active->head.next != &active->tail);
-	for (e = active->head.next; &active->tail != e; e = e->next) {
-		assert(e->height_left > 0);
-
-		if (e->dy != 0)
-			return 0;
-
-		if (e->height_left < min_height) {
-			min_height = e->height_left;
-			if (min_height < FAST_SAMPLES_Y)
-				return 0;
-		}
-	}
-
-	return min_height;
-}
-
-inline static void
-merge_edges(struct active_list *active, struct edge *edges)
-{
-	active->head.next = merge_unsorted_edges(active->head.next, edges);
-}
-
-inline static int
-fill_buckets(struct active_list *active,
-	     struct edge *edge,
-	     struct edge **buckets)
-{
-	int ymax = 0;
-
-	while (edge) {
-		int y = edge->ytop & (FAST_SAMPLES_Y-1);
-		struct edge *next = edge->next;
-		struct edge **b = &buckets[y];
-		__DBG(("%s: ytop %d -> bucket %d\n", __FUNCTION__,
-		       edge->ytop, y));
-		if (*b)
-			(*b)->prev = edge;
-		edge->next = *b;
-		edge->prev = NULL;
-		*b = edge;
-		edge = next;
-		if (y > ymax)
-			ymax = y;
-	}
-
-	return ymax;
-}
-
-inline static void
-nonzero_subrow(struct active_list *active, struct cell_list *coverages)
-{
-	struct edge *edge = active->head.next;
-	int prev_x = INT_MIN;
-	int winding = 0, xstart = edge->cell;
-
-	cell_list_rewind(coverages);
-
-	while (&active->tail != edge) {
-		struct edge *next = edge->next;
-
-		winding += edge->dir;
-		if (0 == winding && edge->next->cell != edge->cell) {
-			cell_list_add_subspan(coverages, xstart, edge->cell);
-			xstart = edge->next->cell;
-		}
-
-		assert(edge->height_left > 0);
-		if (--edge->height_left) {
-			if (edge->dy) {
-				edge->x.quo += edge->dxdy.quo;
-				edge->x.rem += edge->dxdy.rem;
-				if (edge->x.rem < 0) {
-					--edge->x.quo;
-					edge->x.rem += edge->dy;
-				} else if (edge->x.rem >= edge->dy) {
-					++edge->x.quo;
-					edge->x.rem -= edge->dy;
-				}
-				edge->cell = edge->x.quo + (edge->x.rem >= edge->dy/2);
-			}
-
-			if (edge->cell < prev_x) {
-				struct edge *pos = edge->prev;
-				pos->next = next;
-				next->prev = pos;
-				do
-					pos = pos->prev;
-				while (edge->cell < pos->cell);
-				pos->next->prev = edge;
-				edge->next = pos->next;
-				edge->prev = pos;
-				pos->next = edge;
-			} else
-				prev_x = edge->cell;
-		} else {
-			edge->prev->next = next;
-			next->prev = edge->prev;
-		}
-
-		edge = next;
-	}
-}
-
-static void
-nonzero_row(struct active_list *active, struct cell_list *coverages)
-{
-	struct edge *left = active->head.next;
-
-	while (&active->tail != left) {
-		struct edge *right;
-		int winding = left->dir;
-
-		left->height_left -= FAST_SAMPLES_Y;
-		assert(left->height_left >= 0);
-		if (!left->height_left) {
-			left->prev->next = left->next;
-			left->next->prev = left->prev;
-		}
-
-		right = left->next;
-		do {
-			right->height_left -= FAST_SAMPLES_Y;
-			assert(right->height_left >= 0);
-			if (!right->height_left) {
-				right->prev->next = right->next;
-				right->next->prev = right->prev;
-			}
-
-			winding += right->dir;
-			if (0 == winding)
-				break;
-
-			right = right->next;
-		} while (1);
-
-		cell_list_add_span(coverages, left->cell, right->cell);
-		left = right->next;
-	}
-}
-
-static void
-tor_fini(struct tor *converter)
-{
-	polygon_fini(converter->polygon);
-	cell_list_fini(converter->coverages);
-}
-
-static bool
-tor_init(struct tor *converter, const BoxRec *box, int num_edges)
-{
-	__DBG(("%s: (%d, %d),(%d, %d) x (%d, %d), num_edges=%d\n",
-	       __FUNCTION__,
-	       box->x1, box->y1, box->x2, box->y2,
-	       FAST_SAMPLES_X, FAST_SAMPLES_Y,
-	       num_edges));
-
-	converter->extents = *box;
-
-	if (!cell_list_init(converter->coverages, box->x1, box->x2))
-		return false;
-
-	active_list_reset(converter->active);
-	if (!polygon_init(converter->polygon, num_edges,
-			  (int)box->y1 * FAST_SAMPLES_Y,
-			  (int)box->y2 * FAST_SAMPLES_Y)) {
-		cell_list_fini(converter->coverages);
-		return false;
-	}
-
-	return true;
-}
-
-static void
-tor_add_trapezoid(struct tor *tor,
-		  const xTrapezoid *t,
-		  int dx, int dy)
-{
-	if (!xTrapezoidValid(t)) {
-		__DBG(("%s: skipping invalid trapezoid: top=%d, bottom=%d, left=(%d, %d), (%d, %d), right=(%d, %d), (%d, %d)\n",
-		       __FUNCTION__,
-		       t->top, t->bottom,
-		       t->left.p1.x, t->left.p1.y,
-		       t->left.p2.x, t->left.p2.y,
-		       t->right.p1.x, t->right.p1.y,
-		       t->right.p2.x, t->right.p2.y));
-		return;
-	}
-	polygon_add_edge(tor->polygon, t, &t->left, 1, dx, dy);
-	polygon_add_edge(tor->polygon, t, &t->right, -1, dx, dy);
-}
-
-static void
-step_edges(struct active_list *active, int count)
-{
-	struct edge *edge;
-
-	count *= FAST_SAMPLES_Y;
-	for (edge = active->head.next; edge != &active->tail; edge = edge->next) {
-		edge->height_left -= count;
-		assert(edge->height_left >= 0);
-		if (!edge->height_left) {
-			edge->prev->next = edge->next;
-			edge->next->prev = edge->prev;
-		}
-	}
-}
-
 static void
 tor_blt_span(struct sna *sna,
 	     struct sna_composite_spans_op *op,
@@ -1087,548 +209,6 @@ tor_blt_span_mono_unbounded_clipped(struct sna *sna,
 			     coverage < FAST_SAMPLES_XY/2 ? 0 : FAST_SAMPLES_XY);
 }
 
-static void
-tor_blt(struct sna *sna,
-	struct tor *converter,
-	struct sna_composite_spans_op *op,
-	pixman_region16_t *clip,
-	void (*span)(struct sna *sna,
-		     struct sna_composite_spans_op *op,
-		     pixman_region16_t *clip,
-		     const BoxRec *box,
-		     int coverage),
-	int y, int height,
-	int unbounded)
-{
-	struct cell_list *cells = converter->coverages;
-	struct cell *cell;
-	BoxRec box;
-	int cover;
-
-	box.y1 = y + converter->extents.y1;
-	box.y2 = box.y1 + height;
-	assert(box.y2 <= converter->extents.y2);
-	box.x1 = converter->extents.x1;
-
-	/* Form the spans from the coverages and areas. */
-	cover = cells->head.covered_height*FAST_SAMPLES_X;
-	assert(cover >= 0);
-	for (cell = cells->head.next; cell != &cells->tail; cell = cell->next) {
-		int x = cell->x;
-
-		assert(x >= converter->extents.x1);
-		assert(x < converter->extents.x2);
-		__DBG(("%s: cell=(%d, %d, %d), cover=%d\n", __FUNCTION__,
-		       cell->x, cell->covered_height, cell->uncovered_area,
-		       cover));
-
-		if (cell->covered_height || cell->uncovered_area) {
-			box.x2 = x;
-			if (box.x2 > box.x1 && (unbounded || cover)) {
-				__DBG(("%s: span (%d, %d)x(%d, %d) @ %d\n", __FUNCTION__,
-				       box.x1, box.y1,
-				       box.x2 - box.x1,
-				       box.y2 - box.y1,
-				       cover));
-				span(sna, op, clip, &box, cover);
-			}
-			box.x1 = box.x2;
-			cover += cell->covered_height*FAST_SAMPLES_X;
-		}
-
-		if (cell->uncovered_area) {
-			int area = cover - cell->uncovered_area;
-			box.x2 = x + 1;
-			if (unbounded || area) {
-				__DBG(("%s: span (%d, %d)x(%d, %d) @ %d\n", __FUNCTION__,
-				       box.x1, box.y1,
-				       box.x2 - box.x1,
-				       box.y2 - box.y1,
-				       area));
-				span(sna, op, clip, &box, area);
-			}
-			box.x1 = box.x2;
-		}
-	}
-
-	box.x2 = converter->extents.x2;
-	if (box.x2 > box.x1 && (unbounded || cover)) {
-		__DBG(("%s: span (%d, %d)x(%d, %d) @ %d\n", __FUNCTION__,
-		       box.x1, box.y1,
-		       box.x2 - box.x1,
-		       box.y2 - box.y1,
-		       cover));
-		span(sna, op, clip, &box, cover);
-	}
-}
-
-flatten static void
-tor_render(struct sna *sna,
-	   struct tor *converter,
-	   struct sna_composite_spans_op *op,
-	   pixman_region16_t *clip,
-	   void (*span)(struct sna *sna,
-			struct sna_composite_spans_op *op,
-			pixman_region16_t *clip,
-			const BoxRec *box,
-			int coverage),
-	   int unbounded)
-{
-	struct polygon *polygon = converter->polygon;
-	struct cell_list *coverages = converter->coverages;
-	struct active_list *active = converter->active;
-	struct edge *buckets[FAST_SAMPLES_Y] = { 0 };
-	int16_t i, j, h = converter->extents.y2 - converter->extents.y1;
-
-	__DBG(("%s: unbounded=%d\n", __FUNCTION__, unbounded));
-
-	/* Render each pixel row. */
-	for (i = 0; i < h; i = j) {
-		int do_full_step = 0;
-
-		j = i + 1;
-
-		/* Determine if we can ignore this row or use the full pixel
-		 * stepper. */
-		if (fill_buckets(active, polygon->y_buckets[i], buckets) == 0) {
-			if (buckets[0]) {
-				merge_edges(active, buckets[0]);
-				buckets[0] = NULL;
-			}
-			if (active->head.next == &active->tail) {
-				for (; polygon->y_buckets[j] == NULL; j++)
-					;
-				__DBG(("%s: no new edges and no exisiting edges, skipping, %d -> %d\n",
-				       __FUNCTION__, i, j));
-
-				assert(j <= h);
-				if (unbounded) {
-					BoxRec box;
-
-					box = converter->extents;
-					box.y1 += i;
-					box.y2 = converter->extents.y1 + j;
-
-					span(sna, op, clip, &box, 0);
-				}
-				continue;
-			}
-
-			do_full_step = can_full_step(active);
-		}
-
-		__DBG(("%s: y=%d-%d, do_full_step=%d, new edges=%d\n",
-		       __FUNCTION__,
-		       i, j, do_full_step,
-		       polygon->y_buckets[i] != NULL));
-		if (do_full_step) {
-			nonzero_row(active, coverages);
-
-			while (polygon->y_buckets[j] == NULL &&
-			       do_full_step >= 2*FAST_SAMPLES_Y) {
-				do_full_step -= FAST_SAMPLES_Y;
-				j++;
-			}
-			assert(j >= i + 1 && j <= h);
-			if (j != i + 1)
-				step_edges(active, j - (i + 1));
-
-			__DBG(("%s: vertical edges, full step (%d, %d)\n",
-			       __FUNCTION__,  i, j));
-		} else {
-			int suby;
-
-			/* Subsample this row. */
-			for (suby = 0; suby < FAST_SAMPLES_Y; suby++) {
-				if (buckets[suby]) {
-					merge_edges(active, buckets[suby]);
-					buckets[suby] = NULL;
-				}
-
-				nonzero_subrow(active, coverages);
-			}
-		}
-
-		assert(j > i);
-		tor_blt(sna, converter, op, clip, span, i, j-i, unbounded);
-		cell_list_reset(coverages);
-	}
-}
-
-static void
-inplace_row(struct active_list *active, uint8_t *row, int width)
-{
-	struct edge *left = active->head.next;
-
-	while (&active->tail != left) {
-		struct edge *right;
-		int winding = left->dir;
-		int lfx, rfx;
-		int lix, rix;
-
-		left->height_left -= FAST_SAMPLES_Y;
-		assert(left->height_left >= 0);
-		if (!left->height_left) {
-			left->prev->next = left->next;
-			left->next->prev = left->prev;
-		}
-
-		right = left->next;
-		do {
-			right->height_left -= FAST_SAMPLES_Y;
-			assert(right->height_left >= 0);
-			if (!right->height_left) {
-				right->prev->next = right->next;
-				right->next->prev = right->prev;
-			}
-
-			winding += right->dir;
-			if (0 == winding && right->cell != right->next->cell)
-				break;
-
-			right = right->next;
-		} while (1);
-
-		if (left->cell < 0) {
-			lix = lfx = 0;
-		} else if (left->cell >= width * FAST_SAMPLES_X) {
-			lix = width;
-			lfx = 0;
-		} else
-			FAST_SAMPLES_X_TO_INT_FRAC(left->cell, lix, lfx);
-
-		if (right->cell < 0) {
-			rix = rfx = 0;
-		} else if (right->cell >= width * FAST_SAMPLES_X) {
-			rix = width;
-			rfx = 0;
-		} else
-			FAST_SAMPLES_X_TO_INT_FRAC(right->cell, rix, rfx);
-		if (lix == rix) {
-			if (rfx != lfx) {
-				assert(lix < width);
-				row[lix] += (rfx-lfx) * 256 / FAST_SAMPLES_X;
-			}
-		} else {
-			assert(lix < width);
-			if (lfx == 0)
-				row[lix] = 0xff;
-			else
-				row[lix] += 256 - lfx * 256 / FAST_SAMPLES_X;
-
-			assert(rix <= width);
-			if (rfx) {
-				assert(rix < width);
-				row[rix] += rfx * 256 / FAST_SAMPLES_X;
-			}
-
-			if (rix > ++lix) {
-				uint8_t *r = row + lix;
-				rix -= lix;
-				if ((uintptr_t)r & 1 && rix) {
-					*r++ = 0xff;
-					rix--;
-				}
-				if ((uintptr_t)r & 2 && rix >= 2) {
-					*(uint16_t *)r = 0xffff;
-					r += 2;
-					rix -= 2;
-				}
-				if ((uintptr_t)r & 4 && rix >= 4) {
-					*(uint32_t *)r = 0xffffffff;
-					r += 4;
-					rix -= 4;
-				}
-				while (rix >= 8) {
-					*(uint64_t *)r = 0xffffffffffffffff;
-					r += 8;
-					rix -= 8;
-				}
-				if (rix & 4) {
-					*(uint32_t *)r = 0xffffffff;
-					r += 4;
-				}
-				if (rix & 2) {
-					*(uint16_t *)r = 0xffff;
-					r += 2;
-				}
-				if (rix & 1)
-					*r = 0xff;
-			}
-		}
-
-		left = right->next;
-	}
-}
-
-inline static void
-inplace_subrow(struct active_list *active, int8_t *row,
-	       int width, int *min, int *max)
-{
-	struct edge *edge = active->head.next;
-	int prev_x = INT_MIN;
-	int winding = 0, xstart = INT_MIN;
-
-	while (&active->tail != edge) {
-		struct edge *next = edge->next;
-
-		winding += edge->dir;
-		if (0 == winding) {
-			if (edge->next->cell != edge->cell) {
-				if (edge->cell <= xstart) {
-					xstart = INT_MIN;
-				} else  {
-					int fx;
-					int ix;
-
-					if (xstart < FAST_SAMPLES_X * width) {
-						FAST_SAMPLES_X_TO_INT_FRAC(xstart, ix, fx);
-						if (ix < *min)
-							*min = ix;
-
-						row[ix++] += FAST_SAMPLES_X - fx;
-						if (fx && ix < width)
-							row[ix] += fx;
-					}
-
-					xstart = edge->cell;
-					if (xstart < FAST_SAMPLES_X * width) {
-						FAST_SAMPLES_X_TO_INT_FRAC(xstart, ix, fx);
-						row[ix] -= FAST_SAMPLES_X - fx;
-						if (fx && ix + 1 < width)
-							row[++ix] -= fx;
-
-						if (ix >= *max)
-							*max = ix + 1;
-
-						xstart = INT_MIN;
-					} else
-						*max = width;
-				}
-			}
-		} else if (xstart < 0) {
-			xstart = MAX(edge->cell, 0);
-		}
-
-		assert(edge->height_left > 0);
-		if (--edge->height_left) {
-			if (edge->dy) {
-				edge->x.quo += edge->dxdy.quo;
-				edge->x.rem += edge->dxdy.rem;
-				if (edge->x.rem < 0) {
-					--edge->x.quo;
-					edge->x.rem += edge->dy;
-				} else if (edge->x.rem >= 0) {
-					++edge->x.quo;
-					edge->x.rem -= edge->dy;
-				}
-				edge->cell = edge->x.quo + (edge->x.rem >= edge->dy/2);
-			}
-
-			if (edge->cell < prev_x) {
-				struct edge *pos = edge->prev;
-				pos->next = next;
-				next->prev = pos;
-				do
-					pos = pos->prev;
-				while (edge->cell < pos->cell);
-				pos->next->prev = edge;
-				edge->next = pos->next;
-				edge->prev = pos;
-				pos->next = edge;
-			} else
-				prev_x = edge->cell;
-		} else {
-			edge->prev->next = next;
-			next->prev = edge->prev;
-		}
-
-		edge = next;
-	}
-}
-
-inline static void
-inplace_end_subrows(struct active_list *active, uint8_t *row,
-		    int8_t *buf, int width)
-{
-	int cover = 0;
-
-	while (width >= 4) {
-		uint32_t dw;
-		int v;
-
-		dw = *(uint32_t *)buf;
-		buf += 4;
-
-		if (dw == 0) {
-			v = cover * 256 / FAST_SAMPLES_XY;
-			v -= v >> 8;
-			v |= v << 8;
-			dw = v | v << 16;
-		} else {
-			cover += (int8_t)(dw & 0xff);
-			if (cover) {
-				assert(cover > 0);
-				v = cover * 256 / FAST_SAMPLES_XY;
-				v -= v >> 8;
-				dw >>= 8;
-				dw |= v << 24;
-			} else
-				dw >>= 8;
-
-			cover += (int8_t)(dw & 0xff);
-			if (cover) {
-				assert(cover > 0);
-				v = cover * 256 / FAST_SAMPLES_XY;
-				v -= v >> 8;
-				dw >>= 8;
-				dw |= v << 24;
-			} else
-				dw >>= 8;
-
-			cover += (int8_t)(dw & 0xff);
-			if (cover) {
-				assert(cover > 0);
-				v = cover * 256 / FAST_SAMPLES_XY;
-				v -= v >> 8;
-				dw >>= 8;
-				dw |= v << 24;
-			} else
-				dw >>= 8;
-
-			cover += (int8_t)(dw & 0xff);
-			if (cover) {
-				assert(cover > 0);
-				v = cover * 256 / FAST_SAMPLES_XY;
-				v -= v >> 8;
-				dw >>= 8;
-				dw |= v << 24;
-			} else
-				dw >>= 8;
-		}
-
-		*(uint32_t *)row = dw;
-		row += 4;
-		width -= 4;
-	}
-
-	while (width--) {
-		int v;
-
-		cover += *buf++;
-		assert(cover >= 0);
-
-		v = cover * 256 / FAST_SAMPLES_XY;
-		v -= v >> 8;
-		*row++ = v;
-	}
-}
-
-static void
-convert_mono(uint8_t *ptr, int w)
-{
-	while (w--) {
-		*ptr = 0xff * (*ptr >= 0xf0);
-		ptr++;
-	}
-}
-
-static void
-tor_inplace(struct tor *converter, PixmapPtr scratch, int mono, uint8_t *buf)
-{
-	int i, j, h = converter->extents.y2;
-	struct polygon *polygon = converter->polygon;
-	struct active_list *active = converter->active;
-	struct edge *buckets[FAST_SAMPLES_Y] = { 0 };
-	uint8_t *row = scratch->devPrivate.ptr;
-	int stride = scratch->devKind;
-	int width = scratch->drawable.width;
-
-	__DBG(("%s: mono=%d, buf?=%d\n", __FUNCTION__, mono, buf != NULL));
-	assert(converter->extents.y1 == 0);
-	assert(converter->extents.x1 == 0);
-	assert(scratch->drawable.depth == 8);
-
-	/* Render each pixel row. */
-	for (i = 0; i < h; i = j) {
-		int do_full_step = 0;
-		void *ptr = buf ?: row;
-
-		j = i + 1;
-
-		/* Determine if we can ignore this row or use the full pixel
-		 * stepper. */
-		if (fill_buckets(active, polygon->y_buckets[i], buckets) == 0) {
-			if (buckets[0]) {
-				merge_edges(active, buckets[0]);
-				buckets[0] = NULL;
-			}
-			if (active->head.next == &active->tail) {
-				for (; !polygon->y_buckets[j]; j++)
-					;
-				__DBG(("%s: no new edges and no exisiting edges, skipping, %d -> %d\n",
-				       __FUNCTION__, i, j));
-
-				memset(row, 0, stride*(j-i));
-				row += stride*(j-i);
-				continue;
-			}
-
-			do_full_step = can_full_step(active);
-		}
-
-		__DBG(("%s: y=%d, do_full_step=%d, new edges=%d, min_height=%d, vertical=%d\n",
-		       __FUNCTION__,
-		       i, do_full_step,
-		       polygon->y_buckets[i] != NULL));
-		if (do_full_step) {
-			memset(ptr, 0, width);
-			inplace_row(active, ptr, width);
-			if (mono)
-				convert_mono(ptr, width);
-			if (row != ptr)
-				memcpy(row, ptr, width);
-
-			while (polygon->y_buckets[j] == NULL &&
-			       do_full_step >= 2*FAST_SAMPLES_Y) {
-				do_full_step -= FAST_SAMPLES_Y;
-				row += stride;
-				memcpy(row, ptr, width);
-				j++;
-			}
-			if (j != i + 1)
-				step_edges(active, j - (i + 1));
-
-			__DBG(("%s: vertical edges, full step (%d, %d)\n",
-			       __FUNCTION__,  i, j));
-		} else {
-			int min = width, max = 0, suby;
-
-			/* Subsample this row. */
-			memset(ptr, 0, width);
-			for (suby = 0; suby < FAST_SAMPLES_Y; suby++) {
-				if (buckets[suby]) {
-					merge_edges(active, buckets[suby]);
-					buckets[suby] = NULL;
-				}
-
-				inplace_subrow(active, ptr, width, &min, &max);
-			}
-			assert(min >= 0 && max <= width);
-			memset(row, 0, min);
-			if (max > min) {
-				inplace_end_subrows(active, row+min, (int8_t*)ptr+min, max-min);
-				if (mono)
-					convert_mono(row+min, max-min);
-			}
-			if (max < width)
-				memset(row+max, 0, width-max);
-		}
-
-		row += stride;
-	}
-}
-
 static int operator_is_bounded(uint8_t op)
 {
 	switch (op) {
@@ -1860,7 +440,7 @@ imprecise_trapezoid_span_converter(struct sna *sna,
 	if (NO_IMPRECISE)
 		return false;
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst, 0, 0, flags)) {
+	if (!check_composite_spans(sna, op, src, dst, 0, 0, flags)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -1889,10 +469,10 @@ imprecise_trapezoid_span_converter(struct sna *sna,
 		return true;
 	}
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst,
-					       clip.extents.x2 - clip.extents.x1,
-					       clip.extents.y2 - clip.extents.y1,
-					       flags)) {
+	if (!check_composite_spans(sna, op, src, dst,
+				   clip.extents.x2 - clip.extents.x1,
+				   clip.extents.y2 - clip.extents.y1,
+				   flags)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -2012,37 +592,6 @@ skip:
 	return true;
 }
 
-static void
-tor_blt_mask(struct sna *sna,
-	     struct sna_composite_spans_op *op,
-	     pixman_region16_t *clip,
-	     const BoxRec *box,
-	     int coverage)
-{
-	uint8_t *ptr = (uint8_t *)op;
-	int stride = (intptr_t)clip;
-	int h, w;
-
-	coverage = 256 * coverage / FAST_SAMPLES_XY;
-	coverage -= coverage >> 8;
-
-	ptr += box->y1 * stride + box->x1;
-
-	h = box->y2 - box->y1;
-	w = box->x2 - box->x1;
-	if ((w | h) == 1) {
-		*ptr = coverage;
-	} else if (w == 1) {
-		do {
-			*ptr = coverage;
-			ptr += stride;
-		} while (--h);
-	} else do {
-		memset(ptr, coverage, w);
-		ptr += stride;
-	} while (--h);
-}
-
 static void
 tor_blt_mask_mono(struct sna *sna,
 		  struct sna_composite_spans_op *op,
@@ -3187,10 +1736,10 @@ imprecise_trap_span_converter(struct sna *sna,
 	if (dst->pDrawable->depth < 8)
 		return false;
 
-	if (!sna->render.check_composite_spans(sna, PictOpAdd, sna->render.white_picture, dst,
-					       dst->pCompositeClip->extents.x2 - dst->pCompositeClip->extents.x1,
-					       dst->pCompositeClip->extents.y2 - dst->pCompositeClip->extents.y1,
-					       0)) {
+	if (!check_composite_spans(sna, PictOpAdd, sna->render.white_picture, dst,
+				   dst->pCompositeClip->extents.x2 - dst->pCompositeClip->extents.x1,
+				   dst->pCompositeClip->extents.y2 - dst->pCompositeClip->extents.y1,
+				   0)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -3414,7 +1963,7 @@ triangles_span_converter(struct sna *sna,
 		return false;
 	}
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst, 0, 0, 0)) {
+	if (!check_composite_spans(sna, op, src, dst, 0, 0, 0)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -3443,10 +1992,10 @@ triangles_span_converter(struct sna *sna,
 		return true;
 	}
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst,
-					       clip.extents.x2 - clip.extents.x1,
-					       clip.extents.y2 - clip.extents.y1,
-					       0)) {
+	if (!check_composite_spans(sna, op, src, dst,
+				   clip.extents.x2 - clip.extents.x1,
+				   clip.extents.y2 - clip.extents.y1,
+				   0)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -3693,7 +2242,7 @@ imprecise_tristrip_span_converter(struct sna *sna,
 	int dx, dy, num_threads;
 	bool was_clear;
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst, 0, 0, 0)) {
+	if (!check_composite_spans(sna, op, src, dst, 0, 0, 0)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -3722,10 +2271,10 @@ imprecise_tristrip_span_converter(struct sna *sna,
 		return true;
 	}
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst,
-					       clip.extents.x2 - clip.extents.x1,
-					       clip.extents.y2 - clip.extents.y1,
-					       0)) {
+	if (!check_composite_spans(sna, op, src, dst,
+				   clip.extents.x2 - clip.extents.x1,
+				   clip.extents.y2 - clip.extents.y1,
+				   0)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -1805,7 +1805,7 @@ precise_trapezoid_span_converter(struct sna *sna,
 	if (NO_PRECISE)
 		return false;
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst, 0, 0, flags)) {
+	if (!check_composite_spans(sna, op, src, dst, 0, 0, flags)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -1843,10 +1843,10 @@ precise_trapezoid_span_converter(struct sna *sna,
 		return true;
 	}
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst,
-					       clip.extents.x2 - clip.extents.x1,
-					       clip.extents.y2 - clip.extents.y1,
-					       flags)) {
+	if (!check_composite_spans(sna, op, src, dst,
+				   clip.extents.x2 - clip.extents.x1,
+				   clip.extents.y2 - clip.extents.y1,
+				   flags)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -3315,7 +3315,7 @@ precise_tristrip_span_converter(struct sna *sna,
 	int dx, dy, num_threads;
 	bool was_clear;
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst, 0, 0, 0)) {
+	if (!check_composite_spans(sna, op, src, dst, 0, 0, 0)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -3344,10 +3344,10 @@ precise_tristrip_span_converter(struct sna *sna,
 		return true;
 	}
 
-	if (!sna->render.check_composite_spans(sna, op, src, dst,
-					       clip.extents.x2 - clip.extents.x1,
-					       clip.extents.y2 - clip.extents.y1,
-					       0)) {
+	if (!check_composite_spans(sna, op, src, dst,
+				   clip.extents.x2 - clip.extents.x1,
+				   clip.extents.y2 - clip.extents.y1,
+				   0)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -3490,10 +3490,10 @@ precise_trap_span_converter(struct sna *sna,
 	if (dst->pDrawable->depth < 8)
 		return false;
 
-	if (!sna->render.check_composite_spans(sna, PictOpAdd, sna->render.white_picture, dst,
-					       dst->pCompositeClip->extents.x2 - dst->pCompositeClip->extents.x1,
-					       dst->pCompositeClip->extents.y2 - dst->pCompositeClip->extents.y1,
-					       0)) {
+	if (!check_composite_spans(sna, PictOpAdd, sna->render.white_picture, dst,
+				   dst->pCompositeClip->extents.x2 - dst->pCompositeClip->extents.x1,
+				   dst->pCompositeClip->extents.y2 - dst->pCompositeClip->extents.y1,
+				   0)) {
 		DBG(("%s: fallback -- composite spans not supported\n",
 		     __FUNCTION__));
 		return false;
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef SNA_VBLANK_CLOCK_H
+#define SNA_VBLANK_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * A software vblank counter for when the CRTC cannot give us one, i.e.
+ * it is in DPMS off or the kernel refuses the vblank query. The MSC is
+ * extrapolated from the last vblank we saw at the exact refresh of the
+ * mode, htotal * vtotal / pixel clock, kept as a fraction of nanoseconds
+ * so that no rounding accumulates no matter how long it free runs. Every
+ * real vblank re-anchors it, so it follows the hardware as well.
+ */
+
+struct vblank_clock {
+	uint64_t base_ns; /* CLOCK_MONOTONIC of base_msc */
+	uint64_t base_msc;
+	uint64_t num, den; /* period in ns = num / den */
+};
+
+static inline uint64_t vblank_clock_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* x * num / den, rounded up, without overflowing the intermediate */
+static inline uint64_t __vblank_clock_scale(uint64_t x,
+					    uint64_t num, uint64_t den)
+{
+#ifdef __SIZEOF_INT128__
+	return ((unsigned __int128)x * num + den - 1) / den;
+#else
+	return x / den * num + (uint64_t)((double)(x % den) * num / den + .999999);
+#endif
+}
+
+static inline uint64_t __vblank_clock_gcd(uint64_t a, uint64_t b)
+{
+	while (b) {
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* The MSC whose vblank is the last at or before now */
+static inline uint64_t vblank_clock_msc(const struct vblank_clock *c,
+					uint64_t now)
+{
+	uint64_t frames;
+
+	if (now <= c->base_ns)
+		return c->base_msc;
+
+	/* the inverse of vblank_clock_time(), so rounded down */
+	frames = now - c->base_ns;
+#ifdef __SIZEOF_INT128__
+	frames = (unsigned __int128)frames * c->den / c->num;
+#else
+	frames = frames / c->num * c->den +
+		(uint64_t)((double)(frames % c->num) * c->den / c->num);
+#endif
+	return c->base_msc + frames;
+}
+
+/* The time (in ns) of the vblank that begins msc */
+static inline uint64_t vblank_clock_time(const struct vblank_clock *c,
+					 uint64_t msc)
+{
+	if ((int64_t)(msc - c->base_msc) < 0) {
+		uint64_t t = __vblank_clock_scale(c->base_msc - msc,
+						  c->num, c->den);
+		return c->base_ns > t ? c->base_ns - t : 0;
+	}
+
+	return c->base_ns + __vblank_clock_scale(msc - c->base_msc,
+						 c->num, c->den);
+}
+
+/* Re-anchor to a vblank reported by the hardware, ust in microseconds */
+static inline void vblank_clock_sync(struct vblank_clock *c,
+				     uint64_t msc, uint64_t ust)
+{
+	c->base_ns = ust * 1000;
+	c->base_msc = msc;
+}
+
+/*
+ * Adopt the refresh of a new mode, htotal x vtotal at a pixel clock of
+ * clock kHz (as the DRM modeinfo), from now on. Without a mode we tick
+ * at 60Hz.
+ */
+static inline void vblank_clock_set_mode(struct vblank_clock *c,
+					 uint64_t now,
+					 unsigned htotal, unsigned vtotal,
+					 unsigned clock)
+{
+	uint64_t num, den, gcd;
+
+	/* the current frame carries on and the new timings start now */
+	c->base_msc = c->num ? vblank_clock_msc(c, now) : 0;
+	c->base_ns = now;
+
+	if (htotal && vtotal && clock) {
+		num = (uint64_t)htotal * vtotal * 1000000;
+		den = clock;
+	} else {
+		num = 1000000000;
+		den = 60;
+	}
+
+	gcd = __vblank_clock_gcd(num, den);
+	c->num = num / gcd;
+	c->den = den / gcd;
+}
+
+static inline void vblank_clock_init(struct vblank_clock *c, uint64_t now)
+{
+	c->num = 0;
+	vblank_clock_set_mode(c, now, 0, 0, 0);
+}
+
+#endif /* SNA_VBLANK_CLOCK_H */
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef SNA_VBLANK_WHEEL_H
+#define SNA_VBLANK_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * The events waiting on a CRTC, hashed by their target MSC into a wheel
+ * of one slot per frame. Each slot is a FIFO of the events for that MSC,
+ * so finding the event for an MSC already waited upon, to coalesce
+ * another client into it, is O(1), and a bitmask of the occupied slots
+ * finds the earliest event without walking the queue. Only that event needs to be
+ * waiting in the kernel: when its vblank arrives we complete every other
+ * event due by then as a batch, and queue the next.
+ *
+ * The slots cover VBLANK_WHEEL_SIZE frames from the earliest event; the
+ * rare event queued further ahead than that waits in a sorted overflow
+ * list until the wheel turns to it. MSC are compared modulo 2^64 so that
+ * the ordering survives the counter wrapping.
+ *
+ * The nodes are embedded in the caller's events, and the wheel must not
+ * be moved once initialised.
+ */
+
+#define VBLANK_WHEEL_SIZE 64
+
+struct vblank_link {
+	struct vblank_link *next, *prev;
+};
+struct vblank_node {
+	struct vblank_link link;
+	uint64_t msc;
+};
+
+/*
+ * The slots hold the events for base .. base + VBLANK_WHEEL_SIZE - 1,
+ * each in the slot of its MSC modulo the size, and the overflow those
+ * from base + VBLANK_WHEEL_SIZE onwards.
+ */
+struct vblank_wheel {
+	uint64_t base;
+	uint64_t occupied; /* a bit for each non-empty slot */
+	unsigned count;
+	struct vblank_link overflow;
+	struct vblank_link slot[VBLANK_WHEEL_SIZE];
+};
+
+static inline bool vblank_msc_before(uint64_t msc, uint64_t target)
+{
+	return (int64_t)(msc - target) < 0;
+}
+
+static inline void __vblank_link_init(struct vblank_link *l)
+{
+	l->next = l->prev = l;
+}
+
+static inline bool __vblank_link_empty(const struct vblank_link *l)
+{
+	return l->next == l;
+}
+
+static inline void __vblank_link_add_before(struct vblank_link *l,
+					    struct vblank_link *pos)
+{
+	l->next = pos;
+	l->prev = pos->prev;
+	pos->prev->next = l;
+	pos->prev = l;
+}
+
+static inline void __vblank_link_del(struct vblank_link *l)
+{
+	l->prev->next = l->next;
+	l->next->prev = l->prev;
+}
+
+/* Move all of list onto the front of head */
+static inline void __vblank_link_splice(struct vblank_link *list,
+					struct vblank_link *head)
+{
+	list->next->prev = head;
+	list->prev->next = head->next;
+	head->next->prev = list->prev;
+	head->next = list->next;
+	__vblank_link_init(list);
+}
+
+static inline struct vblank_node *__vblank_node(struct vblank_link *l)
+{
+	return (struct vblank_node *)((char *)l - offsetof(struct vblank_node, link));
+}
+
+static inline void vblank_wheel_init(struct vblank_wheel *w)
+{
+	int i;
+
+	w->base = 0;
+	w->occupied = 0;
+	w->count = 0;
+	__vblank_link_init(&w->overflow);
+	for (i = 0; i < VBLANK_WHEEL_SIZE; i++)
+		__vblank_link_init(&w->slot[i]);
+}
+
+static inline bool vblank_wheel_empty(const struct vblank_wheel *w)
+{
+	return w->count == 0;
+}
+
+/* The first occupied slot at or after base, going round the wheel */
+static inline unsigned __vblank_wheel_first(const struct vblank_wheel *w)
+{
+	unsigned r = w->base % VBLANK_WHEEL_SIZE;
+	uint64_t bits;
+
+	bits = w->occupied >> r | w->occupied << ((VBLANK_WHEEL_SIZE - r) % VBLANK_WHEEL_SIZE);
+	return (r + __builtin_ctzll(bits)) % VBLANK_WHEEL_SIZE;
+}
+
+static inline struct vblank_node *vblank_wheel_top(const struct vblank_wheel *w)
+{
+	if (w->occupied)
+		return __vblank_node(w->slot[__vblank_wheel_first(w)].next);
+
+	if (!__vblank_link_empty(&w->overflow))
+		return __vblank_node(w->overflow.next);
+
+	return NULL;
+}
+
+static inline void __vblank_wheel_add(struct vblank_wheel *w,
+				      struct vblank_node *n)
+{
+	unsigned i = n->msc % VBLANK_WHEEL_SIZE;
+
+	__vblank_link_add_before(&n->link, &w->slot[i]);
+	w->occupied |= 1ull << i;
+}
+
+/* Turn the wheel forward to msc, but no further than its earliest event */
+static inline void __vblank_wheel_advance(struct vblank_wheel *w, uint64_t msc)
+{
+	struct vblank_node *top = vblank_wheel_top(w);
+
+	if (top && vblank_msc_before(top->msc, msc))
+		msc = top->msc;
+	w->base = msc;
+
+	while (!__vblank_link_empty(&w->overflow)) {
+		struct vblank_node *n = __vblank_node(w->overflow.next);
+
+		if (!vblank_msc_before(n->msc, w->base + VBLANK_WHEEL_SIZE))
+			break;
+
+		__vblank_link_del(&n->link);
+		__vblank_wheel_add(w, n);
+	}
+}
+
+/* Turn the wheel back to msc, spilling the slots that drop off its end */
+static inline void __vblank_wheel_rewind(struct vblank_wheel *w, uint64_t msc)
+{
+	uint64_t delta = w->base - msc;
+	int j, last;
+
+	last = delta < VBLANK_WHEEL_SIZE ? VBLANK_WHEEL_SIZE - delta : 0;
+	for (j = VBLANK_WHEEL_SIZE - 1; j >= last; j--) {
+		unsigned i = (w->base + j) % VBLANK_WHEEL_SIZE;
+
+		if (w->occupied & (1ull << i)) {
+			__vblank_link_splice(&w->slot[i], &w->overflow);
+			w->occupied &= ~(1ull << i);
+		}
+	}
+
+	w->base = msc;
+}
+
+static inline void vblank_wheel_push(struct vblank_wheel *w,
+				     struct vblank_node *n,
+				     uint64_t msc)
+{
+	n->msc = msc;
+
+	if (w->count++ == 0)
+		w->base = msc;
+	else if (vblank_msc_before(msc, w->base))
+		__vblank_wheel_rewind(w, msc);
+
+	if (vblank_msc_before(msc, w->base + VBLANK_WHEEL_SIZE)) {
+		__vblank_wheel_add(w, n);
+	} else {
+		struct vblank_link *pos;
+
+		/* Later events are more likely to be queued last */
+		for (pos = w->overflow.prev; pos != &w->overflow; pos = pos->prev)
+			if (!vblank_msc_before(msc, __vblank_node(pos)->msc))
+				break;
+
+		__vblank_link_add_before(&n->link, pos->next);
+	}
+}
+
+/*
+ * The last node queued for msc, or NULL. A slot only ever holds the
+ * events for a single MSC, so only the overflow needs searching.
+ */
+static inline struct vblank_node *vblank_wheel_find(struct vblank_wheel *w,
+						    uint64_t msc)
+{
+	struct vblank_link *pos;
+
+	if (w->count == 0 || vblank_msc_before(msc, w->base))
+		return NULL;
+
+	if (vblank_msc_before(msc, w->base + VBLANK_WHEEL_SIZE)) {
+		unsigned i = msc % VBLANK_WHEEL_SIZE;
+
+		if ((w->occupied & (1ull << i)) == 0)
+			return NULL;
+
+		return __vblank_node(w->slot[i].prev);
+	}
+
+	for (pos = w->overflow.prev; pos != &w->overflow; pos = pos->prev) {
+		struct vblank_node *n = __vblank_node(pos);
+
+		if (n->msc == msc)
+			return n;
+		if (vblank_msc_before(n->msc, msc))
+			break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Remove any node, not just the top, e.g. to complete it early. Nothing
+ * is expected to be queued before it afterwards, so we turn the wheel on.
+ */
+static inline void vblank_wheel_remove(struct vblank_wheel *w,
+				       struct vblank_node *n)
+{
+	unsigned i = n->msc % VBLANK_WHEEL_SIZE;
+	bool overflow;
+
+	overflow = !vblank_msc_before(n->msc, w->base + VBLANK_WHEEL_SIZE);
+	__vblank_link_del(&n->link);
+	w->count--;
+
+	if (!overflow) {
+		if (!__vblank_link_empty(&w->slot[i]))
+			return;
+
+		w->occupied &= ~(1ull << i);
+	}
+
+	__vblank_wheel_advance(w, n->msc + 1);
+}
+
+#endif /* SNA_VBLANK_WHEEL_H */
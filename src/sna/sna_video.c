@@ -72,6 +72,8 @@
 #include "misc.h"
 #endif
 
+#define USE_ZERO_COPY 1
+
 #ifdef SNA_XVMC
 #define _SNA_XVMC_SERVER_
 #include "sna_video_hwmc.h"
@@ -245,17 +247,19 @@ sna_video_frame_set_rotation(struct sna_video *video,
 	/* Determine the desired destination pitch (representing the
 	 * chroma's pitch in the planar case).
 	 */
-	if (is_nv12_fourcc(frame->id)) {
+	if (is_nv12_fourcc(frame->id) || is_p010_fourcc(frame->id)) {
+		unsigned cpp = is_p010_fourcc(frame->id) ? 2 : 1;
+
 		assert((width & 1) == 0);
 		assert((height & 1) == 0);
 		if (rotation & (RR_Rotate_90 | RR_Rotate_270)) {
-			frame->pitch[0] = ALIGN(height, align);
-			frame->pitch[1] = ALIGN(height, align);
+			frame->pitch[0] = ALIGN(height * cpp, align);
+			frame->pitch[1] = ALIGN(height * cpp, align);
 			frame->size = width * frame->pitch[1] +
 				width / 2 * frame->pitch[0];
 		} else {
-			frame->pitch[0] = ALIGN(width, align);
-			frame->pitch[1] = ALIGN(width, align);
+			frame->pitch[0] = ALIGN(width * cpp, align);
+			frame->pitch[1] = ALIGN(width * cpp, align);
 			frame->size = height * frame->pitch[1] +
 				height / 2 * frame->pitch[0];
 		}
@@ -346,13 +350,41 @@ static void plane_dims(const struct sna_video_frame *frame, int sub,
 	}
 }
 
+static int rotation_angle(Rotation rotation)
+{
+	switch (rotation & 0xf) {
+	default:
+	case RR_Rotate_0: return 0;
+	case RR_Rotate_90: return 90;
+	case RR_Rotate_180: return 180;
+	case RR_Rotate_270: return 270;
+	}
+}
+
+/* The copied image is always placed at the origin of the frame */
+static void sna_rotate_plane(const void *src, void *dst, int bpp,
+			     int src_pitch, int dst_pitch,
+			     int w, int h, Rotation rotation)
+{
+	int angle = rotation_angle(rotation);
+	int sx, sy, step[4];
+
+	rotate_blt_angle(angle, w, h, &sx, &sy, step);
+	if (angle == 90 || angle == 270) {
+		int t = w;
+		w = h;
+		h = t;
+	}
+
+	sna_rotate_blt(src, dst, bpp, src_pitch, dst_pitch,
+		       sx, sy, 0, 0, w, h, step);
+}
+
 static void sna_memcpy_cbcr_plane(struct sna_video *video,
 				  uint16_t *dst, const uint16_t *src,
 				  const struct sna_video_frame *frame)
 {
 	int dstPitch = frame->pitch[0] >> 1, srcPitch;
-	const uint16_t *s;
-	int i, j = 0;
 	int x, y, w, h;
 
 	plane_dims(frame, 1, &x, &y, &w, &h);
@@ -360,12 +392,8 @@ static void sna_memcpy_cbcr_plane(struct sna_video *video,
 	srcPitch = ALIGN((frame->width >> 1), 2);
 
 	src += y * srcPitch + x;
-	if (!video->textured)
-		x = y = 0;
 
-	switch (frame->rotation) {
-	case RR_Rotate_0:
-		dst += y * dstPitch + x;
+	if (frame->rotation == RR_Rotate_0) {
 		if (srcPitch == dstPitch && srcPitch == w)
 			memcpy(dst, src, (srcPitch * h) << 1);
 		else while (h--) {
@@ -373,35 +401,10 @@ static void sna_memcpy_cbcr_plane(struct sna_video *video,
 			src += srcPitch;
 			dst += dstPitch;
 		}
-		break;
-	case RR_Rotate_90:
-		for (i = 0; i < h; i++) {
-			s = src;
-			for (j = 0; j < w; j++)
-				dst[i + ((x + w - j - 1) * dstPitch)] = *s++;
-			src += srcPitch;
-		}
-		break;
-	case RR_Rotate_180:
-		for (i = 0; i < h; i++) {
-			s = src;
-			for (j = 0; j < w; j++) {
-				dst[(x + w - j - 1) +
-				    ((h - i - 1) * dstPitch)] = *s++;
-			}
-			src += srcPitch;
-		}
-		break;
-	case RR_Rotate_270:
-		for (i = 0; i < h; i++) {
-			s = src;
-			for (j = 0; j < w; j++) {
-				dst[(h - i - 1) + (x + j * dstPitch)] = *s++;
-			}
-			src += srcPitch;
-		}
-		break;
-	}
+	} else
+		sna_rotate_plane(src, dst, 16,
+				 srcPitch << 1, dstPitch << 1,
+				 w, h, frame->rotation);
 }
 
 static void sna_memcpy_plane(struct sna_video *video,
@@ -409,8 +412,6 @@ static void sna_memcpy_plane(struct sna_video *video,
 			     const struct sna_video_frame *frame, int sub)
 {
 	int dstPitch = frame->pitch[!sub], srcPitch;
-	const uint8_t *s;
-	int i, j = 0;
 	int x, y, w, h;
 
 	plane_dims(frame, sub, &x, &y, &w, &h);
@@ -421,12 +422,8 @@ static void sna_memcpy_plane(struct sna_video *video,
 		srcPitch = ALIGN(frame->width, 4);
 
 	src += y * srcPitch + x;
-	if (!video->textured)
-		x = y = 0;
 
-	switch (frame->rotation) {
-	case RR_Rotate_0:
-		dst += y * dstPitch + x;
+	if (frame->rotation == RR_Rotate_0) {
 		if (srcPitch == dstPitch && srcPitch == w)
 			memcpy(dst, src, srcPitch * h);
 		else while (h--) {
@@ -434,35 +431,10 @@ static void sna_memcpy_plane(struct sna_video *video,
 			src += srcPitch;
 			dst += dstPitch;
 		}
-		break;
-	case RR_Rotate_90:
-		for (i = 0; i < h; i++) {
-			s = src;
-			for (j = 0; j < w; j++)
-				dst[i + ((x + w - j - 1) * dstPitch)] = *s++;
-			src += srcPitch;
-		}
-		break;
-	case RR_Rotate_180:
-		for (i = 0; i < h; i++) {
-			s = src;
-			for (j = 0; j < w; j++) {
-				dst[(x + w - j - 1) +
-				    ((h - i - 1) * dstPitch)] = *s++;
-			}
-			src += srcPitch;
-		}
-		break;
-	case RR_Rotate_270:
-		for (i = 0; i < h; i++) {
-			s = src;
-			for (j = 0; j < w; j++) {
-				dst[(h - i - 1) + (x + j * dstPitch)] = *s++;
-			}
-			src += srcPitch;
-		}
-		break;
-	}
+	} else
+		sna_rotate_plane(src, dst, 8,
+				 srcPitch, dstPitch,
+				 w, h, frame->rotation);
 }
 
 static void
@@ -476,6 +448,40 @@ sna_copy_nv12_data(struct sna_video *video,
 	sna_memcpy_cbcr_plane(video, (void*)dst, (void*)src, frame);
 }
 
+static void sna_memcpy_rect(uint8_t *dst, const uint8_t *src, int bpp,
+			    int src_pitch, int dst_pitch,
+			    int w, int h, Rotation rotation)
+{
+	if (rotation == RR_Rotate_0) {
+		while (h--) {
+			memcpy(dst, src, w * bpp / 8);
+			src += src_pitch;
+			dst += dst_pitch;
+		}
+	} else
+		sna_rotate_plane(src, dst, bpp, src_pitch, dst_pitch,
+				 w, h, rotation);
+}
+
+static void
+sna_copy_p010_data(struct sna_video *video,
+		   const struct sna_video_frame *frame,
+		   const uint8_t *src, uint8_t *dst)
+{
+	int pitch = ALIGN(frame->width, 4) << 1;
+	int x, y, w, h;
+
+	plane_dims(frame, 0, &x, &y, &w, &h);
+	sna_memcpy_rect(dst, src + y * pitch + 2 * x, 16,
+			pitch, frame->pitch[1], w, h, frame->rotation);
+
+	/* interleaved CbCr, one 32-bit pair for each 2x2 block */
+	src += frame->height * pitch;
+	plane_dims(frame, 1, &x, &y, &w, &h);
+	sna_memcpy_rect(dst + frame->UBufOffset, src + y * pitch + 4 * x, 32,
+			pitch, frame->pitch[0], w, h, frame->rotation);
+}
+
 static void
 sna_copy_planar_data(struct sna_video *video,
 		     const struct sna_video_frame *frame,
@@ -507,21 +513,14 @@ sna_copy_packed_data(struct sna_video *video,
 		     uint8_t *dst)
 {
 	int pitch = frame->width << 1;
-	const uint8_t *src, *s;
+	const uint8_t *src;
 	int x, y, w, h;
-	int i, j;
+	int i;
 
-	if (video->textured) {
-		/* XXX support copying cropped extents */
-		x = y = 0;
-		w = frame->width;
-		h = frame->height;
-	} else {
-		x = frame->image.x1;
-		y = frame->image.y1;
-		w = frame->image.x2 - frame->image.x1;
-		h = frame->image.y2 - frame->image.y1;
-	}
+	x = frame->image.x1;
+	y = frame->image.y1;
+	w = frame->image.x2 - frame->image.x1;
+	h = frame->image.y2 - frame->image.y1;
 
 	src = buf + (y * pitch) + (x << 1);
 
@@ -535,64 +534,19 @@ sna_copy_packed_data(struct sna_video *video,
 		}
 		break;
 	case RR_Rotate_90:
-		h <<= 1;
-		for (i = 0; i < h; i += 2) {
-			s = src;
-			for (j = 0; j < w; j++) {
-				/* Copy Y */
-				dst[(i + 0) + ((w - j - 1) * frame->pitch[0])] = *s;
-				s += 2;
-			}
-			src += pitch;
-		}
-		h >>= 1;
-		src = buf + (y * pitch) + (x << 1);
-		for (i = 0; i < h; i += 2) {
-			for (j = 0; j < w; j += 2) {
-				/* Copy U */
-				dst[((i * 2) + 1) + ((w - j - 1) * frame->pitch[0])] = src[(j * 2) + 1 + (i * pitch)];
-				dst[((i * 2) + 1) + ((w - j - 2) * frame->pitch[0])] = src[(j * 2) + 1 + ((i + 1) * pitch)];
-				/* Copy V */ dst[((i * 2) + 3) + ((w - j - 1) * frame->pitch[0])] = src[(j * 2) + 3 + (i * pitch)];
-				dst[((i * 2) + 3) + ((w - j - 2) * frame->pitch[0])] = src[(j * 2) + 3 + ((i + 1) * pitch)];
-			}
-		}
+	case RR_Rotate_270:
+		/* the chroma of a macropixel becomes shared by a pair of
+		 * rows, so we can only rotate whole 2x2 blocks */
+		w &= ~1;
+		h &= ~1;
+		if (w && h)
+			sna_rotate_yuy2(src, dst, pitch, frame->pitch[0], w, h,
+					rotation_angle(frame->rotation));
 		break;
 	case RR_Rotate_180:
-		w <<= 1;
-		for (i = 0; i < h; i++) {
-			s = src;
-			for (j = 0; j < w; j += 4) {
-				dst[(w - j - 4) + ((h - i - 1) * frame->pitch[0])] = *s++;
-				dst[(w - j - 3) + ((h - i - 1) * frame->pitch[0])] = *s++;
-				dst[(w - j - 2) + ((h - i - 1) * frame->pitch[0])] = *s++;
-				dst[(w - j - 1) + ((h - i - 1) * frame->pitch[0])] = *s++;
-			}
-			src += pitch;
-		}
-		break;
-	case RR_Rotate_270:
-		h <<= 1;
-		for (i = 0; i < h; i += 2) {
-			s = src;
-			for (j = 0; j < w; j++) {
-				/* Copy Y */
-				dst[(h - i - 2) + (j * frame->pitch[0])] = *s;
-				s += 2;
-			}
-			src += pitch;
-		}
-		h >>= 1;
-		src = buf + (y * pitch) + (x << 1);
-		for (i = 0; i < h; i += 2) {
-			for (j = 0; j < w; j += 2) {
-				/* Copy U */
-				dst[(((h - i) * 2) - 3) + (j * frame->pitch[0])] = src[(j * 2) + 1 + (i * pitch)];
-				dst[(((h - i) * 2) - 3) + ((j + 1) * frame->pitch[0])] = src[(j * 2) + 1 + ((i + 1) * pitch)];
-				/* Copy V */
-				dst[(((h - i) * 2) - 1) + (j * frame->pitch[0])] = src[(j * 2) + 3 + (i * pitch)];
-				dst[(((h - i) * 2) - 1) + ((j + 1) * frame->pitch[0])] = src[(j * 2) + 3 + ((i + 1) * pitch)];
-			}
-		}
+		/* whole macropixels are reversed, their luma is not swapped */
+		sna_rotate_plane(src, dst, 32, pitch, frame->pitch[0],
+				 (w + 1) >> 1, h, frame->rotation);
 		break;
 	}
 }
@@ -610,17 +564,10 @@ sna_copy_ayuv_data(struct sna_video *video,
 	int x, y, w, h;
 	int i, j;
 
-	if (video->textured) {
-		/* XXX support copying cropped extents */
-		x = y = 0;
-		w = frame->width;
-		h = frame->height;
-	} else {
-		x = frame->image.x1;
-		y = frame->image.y1;
-		w = frame->image.x2 - frame->image.x1;
-		h = frame->image.y2 - frame->image.y1;
-	}
+	x = frame->image.x1;
+	y = frame->image.y1;
+	w = frame->image.x2 - frame->image.x1;
+	h = frame->image.y2 - frame->image.y1;
 
 	src = buf + (y * pitch) + (x << 2);
 	src_dw = (uint32_t *)src;
@@ -635,8 +582,10 @@ sna_copy_ayuv_data(struct sna_video *video,
 				 * Gstreamer and it supports in bad way, even though
 				 * spec says MSB:AYUV, we get the bytes opposite way.
 				 */
-				dst_dw[i * w + j] = bswap_32(src_dw[i * w + j]);
+				dst_dw[j] = bswap_32(src_dw[j]);
 			}
+			src_dw += frame->width;
+			dst_dw += frame->pitch[0] >> 2;
 		}
 		break;
 	case RR_Rotate_90:
@@ -663,10 +612,75 @@ sna_copy_ayuv_data(struct sna_video *video,
 	}
 }
 
-bool
-sna_video_copy_data(struct sna_video *video,
-		    struct sna_video_frame *frame,
-		    const uint8_t *buf)
+static bool frame_is_whole(const struct sna_video_frame *frame)
+{
+	return (frame->image.x1 == 0 && frame->image.x2 >= frame->width &&
+		frame->image.y1 == 0 && frame->image.y2 >= frame->height);
+}
+
+/*
+ * Textured video only samples frame->src, so there is no need to upload
+ * the rest of the client's image. Shrink the layout of the frame to just
+ * the image extents, grown by a couple of pixels (keeping the chroma
+ * aligned) so that the bilinear filter still sees the neighbouring
+ * pixels at the edges. The copy places the image at the origin, and
+ * afterwards sna_video_frame_rebase() makes the frame describe only the
+ * uploaded rectangle, so that the backends compute the texture
+ * coordinates relative to it.
+ */
+static void
+sna_video_frame_crop(struct sna_video *video,
+		     struct sna_video_frame *frame)
+{
+	struct sna_video_frame crop;
+
+	frame->image.x1 = MAX(frame->image.x1 - 2, 0);
+	frame->image.y1 = MAX(frame->image.y1 - 2, 0);
+	frame->image.x2 = MIN(frame->image.x2 + 2, ALIGN(frame->width, 2));
+	if (is_planar_fourcc(frame->id))
+		frame->image.y2 = MIN(frame->image.y2 + 2, ALIGN(frame->height, 2));
+	else
+		frame->image.y2 = MIN(frame->image.y2 + 2, frame->height);
+	if (frame_is_whole(frame))
+		return;
+
+	crop = *frame;
+	crop.width = frame->image.x2 - frame->image.x1;
+	crop.height = frame->image.y2 - frame->image.y1;
+	sna_video_frame_set_rotation(video, &crop, frame->rotation);
+
+	DBG(("%s: uploading (%d, %d)x(%d, %d) of %dx%d, size %d -> %d\n",
+	     __FUNCTION__,
+	     frame->image.x1, frame->image.y1, crop.width, crop.height,
+	     frame->width, frame->height, frame->size, crop.size));
+
+	frame->size = crop.size;
+	frame->pitch[0] = crop.pitch[0];
+	frame->pitch[1] = crop.pitch[1];
+	frame->UBufOffset = crop.UBufOffset;
+	frame->VBufOffset = crop.VBufOffset;
+}
+
+static void
+sna_video_frame_rebase(struct sna_video_frame *frame)
+{
+	int16_t dx = frame->image.x1, dy = frame->image.y1;
+
+	frame->width = frame->image.x2 - frame->image.x1;
+	frame->height = frame->image.y2 - frame->image.y1;
+
+	frame->src.x1 -= dx; frame->src.x2 -= dx;
+	frame->src.y1 -= dy; frame->src.y2 -= dy;
+
+	frame->image.x1 = frame->image.y1 = 0;
+	frame->image.x2 = frame->width;
+	frame->image.y2 = frame->height;
+}
+
+static bool
+__sna_video_copy_data(struct sna_video *video,
+		      struct sna_video_frame *frame,
+		      const uint8_t *buf)
 {
 	uint8_t *dst;
 
@@ -686,12 +700,14 @@ sna_video_copy_data(struct sna_video *video,
 	if (frame->rotation == RR_Rotate_0 && !video->tiled && !is_ayuv_fourcc(frame->id)) {
 		DBG(("%s: unrotated, untiled fast paths: is-planar?=%d\n",
 		     __FUNCTION__, is_planar_fourcc(frame->id)));
-		if (is_nv12_fourcc(frame->id)) {
+		if (is_nv12_fourcc(frame->id) || is_p010_fourcc(frame->id)) {
+			int cpp = is_p010_fourcc(frame->id) ? 2 : 1;
 			int w = frame->image.x2 - frame->image.x1;
 			int h = frame->image.y2 - frame->image.y1;
-			if (ALIGN(h, 2) == frame->height &&
-			    ALIGN(w, 4) == frame->pitch[0] &&
-			    ALIGN(w, 4) == frame->pitch[1]) {
+			if (frame_is_whole(frame) &&
+			    ALIGN(h, 2) == frame->height &&
+			    ALIGN(w, 4) * cpp == frame->pitch[0] &&
+			    ALIGN(w, 4) * cpp == frame->pitch[1]) {
 				if (frame->bo) {
 					if (!kgem_bo_write(&video->sna->kgem, frame->bo,
 							   buf, frame->size))
@@ -710,7 +726,8 @@ sna_video_copy_data(struct sna_video *video,
 		} else if (is_planar_fourcc(frame->id)) {
 			int w = frame->image.x2 - frame->image.x1;
 			int h = frame->image.y2 - frame->image.y1;
-			if (ALIGN(h, 2) == frame->height &&
+			if (frame_is_whole(frame) &&
+			    ALIGN(h, 2) == frame->height &&
 			    ALIGN(w >> 1, 4) == frame->pitch[0] &&
 			    ALIGN(w, 4) == frame->pitch[1]) {
 				if (frame->bo) {
@@ -735,21 +752,13 @@ sna_video_copy_data(struct sna_video *video,
 				return true;
 			}
 		} else {
-			int x, y, w, h;
-
-			if (video->textured) {
-				/* XXX support copying cropped extents */
-				x = y = 0;
-				w = frame->width;
-				h = frame->height;
-			} else {
-				x = frame->image.x1;
-				y = frame->image.y1;
-				w = frame->image.x2 - frame->image.x1;
-				h = frame->image.y2 - frame->image.y1;
-			}
+			int x = frame->image.x1;
+			int y = frame->image.y1;
+			int w = frame->image.x2 - frame->image.x1;
+			int h = frame->image.y2 - frame->image.y1;
 
-			if (w*2 == frame->pitch[0]) {
+			/* whole rows can still be copied in one */
+			if (x == 0 && w == frame->width && w*2 == frame->pitch[0]) {
 				buf += (2U*y * frame->width) + (x << 1);
 				if (frame->bo) {
 					if (!kgem_bo_write(&video->sna->kgem, frame->bo,
@@ -786,6 +795,8 @@ use_gtt: /* copy data, must use GTT so that we keep the overlay uncached */
 
 	if (is_nv12_fourcc(frame->id))
 		sna_copy_nv12_data(video, frame, buf, dst);
+	else if (is_p010_fourcc(frame->id))
+		sna_copy_p010_data(video, frame, buf, dst);
 	else if (is_planar_fourcc(frame->id))
 		sna_copy_planar_data(video, frame, buf, dst);
 	else if (is_ayuv_fourcc(frame->id))
@@ -796,6 +807,121 @@ use_gtt: /* copy data, must use GTT so that we keep the overlay uncached */
 	return true;
 }
 
+static uint32_t image_bytes(const struct sna_video_frame *frame)
+{
+	uint32_t pixels = (frame->image.x2 - frame->image.x1) *
+		(frame->image.y2 - frame->image.y1);
+
+	if (is_planar_fourcc(frame->id))
+		return pixels * 3 / 2;
+	else if (is_p010_fourcc(frame->id))
+		return pixels * 3;
+	else if (is_ayuv_fourcc(frame->id))
+		return pixels * 4;
+	else
+		return pixels * 2;
+}
+
+bool
+sna_video_copy_data(struct sna_video *video,
+		    struct sna_video_frame *frame,
+		    const uint8_t *buf)
+{
+	struct sna *sna = video->sna;
+
+	if (!video->textured) {
+		if (!__sna_video_copy_data(video, frame, buf))
+			return false;
+
+		sna->xfer.video_cpu += image_bytes(frame);
+		sna->xfer.video_frames++;
+		return true;
+	}
+
+	assert(frame->rotation == RR_Rotate_0);
+	sna_video_frame_crop(video, frame);
+	if (!__sna_video_copy_data(video, frame, buf))
+		return false;
+
+	sna->xfer.video_cpu += image_bytes(frame);
+	sna->xfer.video_frames++;
+
+	sna_video_frame_rebase(frame);
+	return true;
+}
+
+/*
+ * Rather than copy the frame, wrap the client's memory in a userptr and
+ * let the textured video shaders sample it in place. A page-aligned
+ * frame is usually the start of an XvShmPutImage segment, and kgem keeps
+ * the userptr for the segment cached between frames. This is only worth
+ * it if the GPU snoops the CPU cache, and the client's layout must be the
+ * one we would have copied into. As the client is free to reuse its
+ * buffer once we return, the caller must wait for the GPU to finish
+ * reading the frame before then.
+ */
+bool
+sna_video_map_data(struct sna_video *video,
+		   struct sna_video_frame *frame,
+		   const uint8_t *buf)
+{
+	struct sna *sna = video->sna;
+
+	if (!USE_ZERO_COPY || !sna->kgem.has_userptr || !sna->kgem.has_llc)
+		return false;
+
+	if (!video->textured || video->tiled || frame->rotation != RR_Rotate_0)
+		return false;
+
+	if ((uintptr_t)buf & (PAGE_SIZE - 1)) {
+		DBG(("%s: frame is not page-aligned\n", __FUNCTION__));
+		return false;
+	}
+
+	if (is_nv12_fourcc(frame->id)) {
+		if (frame->pitch[0] != ALIGN(frame->width, 4) ||
+		    frame->pitch[1] != ALIGN(frame->width, 4) ||
+		    frame->UBufOffset != frame->pitch[1] * frame->height)
+			return false;
+	} else if (is_planar_fourcc(frame->id)) {
+		if (frame->pitch[0] != ALIGN(frame->width >> 1, 4) ||
+		    frame->pitch[1] != ALIGN(frame->width, 4) ||
+		    frame->UBufOffset != frame->pitch[1] * frame->height)
+			return false;
+	} else if (is_ayuv_fourcc(frame->id)) {
+		/* needs byte-swapping */
+		return false;
+	} else {
+		if (frame->pitch[0] != 2 * frame->width)
+			return false;
+	}
+
+	assert(frame->bo == NULL);
+	frame->bo = kgem_create_map__cached(&sna->kgem, (void *)buf,
+					    frame->size, true);
+	if (frame->bo == NULL)
+		return false;
+
+	kgem_bo_mark_unreusable(frame->bo);
+
+	DBG(("%s: sampling %dx%d frame in place, handle=%d\n",
+	     __FUNCTION__, frame->width, frame->height, frame->bo->handle));
+
+	/* the client's planes are ordered Y, V, U for YV12 */
+	if (is_planar_fourcc(frame->id) &&
+	    !is_nv12_fourcc(frame->id) &&
+	    frame->id != FOURCC_I420) {
+		uint32_t tmp;
+		tmp = frame->VBufOffset;
+		frame->VBufOffset = frame->UBufOffset;
+		frame->UBufOffset = tmp;
+	}
+
+	sna->xfer.video_zero += image_bytes(frame);
+	sna->xfer.video_frames++;
+	return true;
+}
+
 void sna_video_fill_colorkey(struct sna_video *video,
 			     const RegionRec *clip)
 {
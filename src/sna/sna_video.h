@@ -42,6 +42,9 @@ THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define FOURCC_NV12 (('2' << 24) + ('1' << 16) + ('V' << 8) + 'N')
 #endif
 #define FOURCC_AYUV (('V' << 24) + ('U' << 16) + ('Y' << 8) + 'A')
+#ifndef FOURCC_P010
+#define FOURCC_P010 (('0' << 24) + ('1' << 16) + ('0' << 8) + 'P')
+#endif
 
 /*
  * Below, a dummy picture type that is used in XvPutImage
@@ -83,6 +86,17 @@ THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 }
 #endif
 
+/* As NV12, but with 16-bit samples holding 10 bits in the high bits */
+#ifndef XVIMAGE_P010
+#define XVIMAGE_P010 { \
+	FOURCC_P010, XvYUV, LSBFirst,				\
+	{'P','0','1','0', 0x00,0x00,0x00,0x10,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71}, \
+	24, XvPlanar, 2, 0, 0, 0, 0, 10, 10, 10, 1, 2, 2, 1, 2, 2, \
+	{'Y','U','V', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, \
+	XvTopToBottom \
+}
+#endif
+
 #define XVIMAGE_AYUV { \
 	FOURCC_AYUV, XvYUV, LSBFirst, \
 	{'A', 'Y', 'U', 'V', 0x00, 0x00, 0x00, 0x10, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}, \
@@ -129,6 +143,11 @@ struct sna_video {
 
 	int SyncToVblank;	/* -1: auto, 0: off, 1: on */
 	int AlwaysOnTop;
+
+	/* sprite: running average of the interval between frames (1/16 ms) */
+	uint32_t frame_time;
+	unsigned frame_interval;
+	bool gpu_scaling;
 };
 
 struct sna_video_frame {
@@ -201,6 +220,17 @@ static inline int is_nv12_fourcc(int id)
 	}
 }
 
+/* Only the sprites can scan out P010, the render paths cannot sample it */
+static inline int is_p010_fourcc(int id)
+{
+	switch (id) {
+	case FOURCC_P010:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
 static inline int is_ayuv_fourcc(int id)
 {
 	switch (id) {
@@ -240,6 +270,10 @@ bool
 sna_video_copy_data(struct sna_video *video,
 		    struct sna_video_frame *frame,
 		    const uint8_t *buf);
+bool
+sna_video_map_data(struct sna_video *video,
+		   struct sna_video_frame *frame,
+		   const uint8_t *buf);
 void
 sna_video_fill_colorkey(struct sna_video *video,
 			const RegionRec *clip);
@@ -44,6 +44,7 @@
 #define DRM_FORMAT_YUYV         fourcc_code('Y', 'U', 'Y', 'V') /* [31:0] Cr0:Y1:Cb0:Y0 8:8:8:8 little endian */
 #define DRM_FORMAT_UYVY         fourcc_code('U', 'Y', 'V', 'Y') /* [31:0] Y1:Cr0:Y0:Cb0 8:8:8:8 little endian */
 #define DRM_FORMAT_NV12         fourcc_code('N', 'V', '1', '2') /* 2x2 subsampled Cr:Cb plane */
+#define DRM_FORMAT_P010         fourcc_code('P', '0', '1', '0') /* 2x2 subsampled Cr:Cb plane 10 bits per channel */
 #define DRM_FORMAT_XYUV8888     fourcc_code('X', 'Y', 'U', 'V') /* [31:0] x:Y:U:V 8:8:8:8 little endian */
 
 #define has_hw_scaling(sna, video) ((sna)->kgem.gen < 071 || \
@@ -82,8 +83,14 @@ static const XvImageRec images_rgb565[] = { XVIMAGE_YUY2, XVIMAGE_UYVY,
 					    XVMC_RGB888, XVMC_RGB565 };
 static const XvImageRec images_nv12[] = { XVIMAGE_YUY2, XVIMAGE_UYVY,
 					  XVIMAGE_NV12, XVMC_RGB888, XVMC_RGB565 };
+static const XvImageRec images_nv12_p010[] = { XVIMAGE_YUY2, XVIMAGE_UYVY,
+					       XVIMAGE_NV12, XVIMAGE_P010,
+					       XVMC_RGB888, XVMC_RGB565 };
 static const XvImageRec images_ayuv[] = { XVIMAGE_AYUV, XVIMAGE_YUY2, XVIMAGE_UYVY,
 					  XVIMAGE_NV12, XVMC_RGB888, XVMC_RGB565 };
+static const XvImageRec images_ayuv_p010[] = { XVIMAGE_AYUV, XVIMAGE_YUY2, XVIMAGE_UYVY,
+					       XVIMAGE_NV12, XVIMAGE_P010,
+					       XVMC_RGB888, XVMC_RGB565 };
 static const XvAttributeRec attribs[] = {
 	{ XvSettable | XvGettable, 0, 1, (char *)"XV_COLORSPACE" }, /* BT.601, BT.709 */
 	{ XvSettable | XvGettable, 0, 0xffffff, (char *)"XV_COLORKEY" },
@@ -395,7 +402,7 @@ sna_video_sprite_show(struct sna *sna,
 			break;
 		}
 
-		if (is_nv12_fourcc(frame->id)) {
+		if (is_nv12_fourcc(frame->id) || is_p010_fourcc(frame->id)) {
 			f.handles[0] = frame->bo->handle;
 			f.handles[1] = frame->bo->handle;
 			f.pitches[0] = frame->pitch[1];
@@ -419,6 +426,9 @@ sna_video_sprite_show(struct sna *sna,
 		case FOURCC_NV12:
 			f.pixel_format = DRM_FORMAT_NV12;
 			break;
+		case FOURCC_P010:
+			f.pixel_format = DRM_FORMAT_P010;
+			break;
 		case FOURCC_UYVY:
 			f.pixel_format = DRM_FORMAT_UYVY;
 			break;
@@ -485,12 +495,110 @@ sna_video_sprite_show(struct sna *sna,
 static bool need_scaling(const struct sna_video_frame *frame,
 			 const BoxRec *dst)
 {
-	/* SKL+ need the plane scaler even for unscaled NV12 */
-	return frame->id == FOURCC_NV12 ||
+	/* SKL+ need the plane scaler even for unscaled NV12/P010 */
+	return frame->id == FOURCC_NV12 || frame->id == FOURCC_P010 ||
 		frame->src.x2 - frame->src.x1 != dst->x2 - dst->x1 ||
 		frame->src.y2 - frame->src.y1 != dst->y2 - dst->y1;
 }
 
+static void update_frame_interval(struct sna_video *video)
+{
+	uint32_t now = GetTimeInMillis();
+	uint32_t delta = now - video->frame_time;
+
+	video->frame_time = now;
+
+	/* ignore the first frame after a pause */
+	if (delta == 0 || delta > 1000)
+		return;
+
+	if (video->frame_interval == 0)
+		video->frame_interval = delta << 4;
+	else
+		video->frame_interval += ((int)(delta << 4) - (int)video->frame_interval) >> 3;
+
+	DBG(("%s: delta=%dms, average interval=%d.%02dms\n", __FUNCTION__,
+	     delta, video->frame_interval >> 4, 100 * (video->frame_interval & 15) >> 4));
+}
+
+static unsigned frame_bits_per_pixel(uint32_t id)
+{
+	switch (id) {
+	case FOURCC_NV12:
+		return 12;
+	case FOURCC_P010:
+		return 24;
+	case FOURCC_AYUV:
+	case FOURCC_RGB888:
+		return 32;
+	default:
+		return 16;
+	}
+}
+
+/*
+ * With the plane scaler, the display engine fetches the whole source on
+ * every refresh. Prescaling on the GPU instead costs a read of the source
+ * and a write of the scaled image for every new frame, after which the
+ * plane only fetches the (smaller) scaled image. So shrinking a large
+ * video into a small window is cheaper on the render ring, more so the
+ * lower the frame rate is compared to the refresh. Pick whichever moves
+ * fewer bytes, with some hysteresis so that we do not flip between the
+ * two as the estimated frame rate wobbles.
+ */
+static bool prefer_gpu_scaling(struct sna *sna,
+			       struct sna_video *video,
+			       const struct sna_video_frame *frame,
+			       const BoxRec *dst,
+			       xf86CrtcPtr crtc)
+{
+	int src_w = frame->src.x2 - frame->src.x1;
+	int src_h = frame->src.y2 - frame->src.y1;
+	int dst_w = dst->x2 - dst->x1;
+	int dst_h = dst->y2 - dst->y1;
+	uint64_t src_bits, dst_bits, plane, gpu;
+	unsigned refresh, rate;
+
+	if (sna->render.video == NULL ||
+	    xvmc_passthrough(frame->id) ||
+	    is_p010_fourcc(frame->id))
+		return false;
+
+	/* the plane is fetching no more than it displays */
+	if (src_w <= dst_w && src_h <= dst_h)
+		return video->gpu_scaling = false;
+
+	/* beyond what the plane scalers can downscale */
+	if (src_w >= 3 * dst_w || src_h >= 3 * dst_h)
+		return video->gpu_scaling = true;
+
+	refresh = xf86ModeVRefresh(&crtc->mode);
+	if (refresh == 0)
+		refresh = 60;
+
+	rate = refresh;
+	if (video->frame_interval)
+		rate = MIN(16000 / video->frame_interval + 1, refresh);
+
+	src_bits = (uint64_t)src_w * src_h * frame_bits_per_pixel(frame->id);
+	dst_bits = (uint64_t)dst_w * dst_h * 32;
+
+	plane = src_bits * refresh;
+	gpu = (src_bits + dst_bits) * rate + dst_bits * refresh;
+
+	if (video->gpu_scaling)
+		video->gpu_scaling = gpu < plane + plane / 8;
+	else
+		video->gpu_scaling = gpu + gpu / 8 < plane;
+
+	DBG(("%s: %dx%d -> %dx%d at %d/%dHz, plane=%lldMB/s, gpu=%lldMB/s, using %s\n",
+	     __FUNCTION__, src_w, src_h, dst_w, dst_h, rate, refresh,
+	     (long long)(plane >> 23), (long long)(gpu >> 23),
+	     video->gpu_scaling ? "gpu" : "plane"));
+
+	return video->gpu_scaling;
+}
+
 static int sna_video_sprite_put_image(ddPutImage_ARGS)
 {
 	struct sna_video *video = port->devPriv.ptr;
@@ -525,6 +633,8 @@ static int sna_video_sprite_put_image(ddPutImage_ARGS)
 		goto err;
 	}
 
+	update_frame_interval(video);
+
 	for (i = 0; i < video->sna->mode.num_real_crtc; i++) {
 		xf86CrtcPtr crtc = config->crtc[i];
 		struct sna_video_frame frame;
@@ -572,7 +682,7 @@ off:
 
 		frame.image.x1 = frame.src.x1 & ~1;
 		frame.image.x2 = ALIGN(frame.src.x2, 2);
-		if (is_planar_fourcc(frame.id)) {
+		if (is_planar_fourcc(frame.id) || is_p010_fourcc(frame.id)) {
 			frame.image.y1 = frame.src.y1 & ~1;
 			frame.image.y2 = ALIGN(frame.src.y2, 2);
 		} else {
@@ -588,6 +698,10 @@ off:
 		}
 		sna_video_frame_set_rotation(video, &frame, rotation);
 
+		if (hw_scaling && need_scaling(&frame, &dst) &&
+		    prefer_gpu_scaling(sna, video, &frame, &dst, crtc))
+			hw_scaling = false;
+
 		if (xvmc_passthrough(format->id)) {
 			DBG(("%s: using passthough, name=%d\n",
 			     __FUNCTION__, *(uint32_t *)buf));
@@ -696,7 +810,7 @@ off:
 
 		if (ret != Success) {
 			/* retry with GPU scaling */
-			if (hw_scaling) {
+			if (hw_scaling && !is_p010_fourcc(format->id)) {
 				hw_scaling = false;
 				goto retry;
 			}
@@ -753,6 +867,21 @@ static int sna_video_sprite_query(ddQueryImageAttributes_ARGS)
 		tmp *= (*h >> 1);
 		size += tmp;
 		break;
+	case FOURCC_P010:
+		*w = (*w + 1) & ~1;
+		*h = (*h + 1) & ~1;
+		size = ((*w + 3) & ~3) << 1;
+		if (pitches)
+			pitches[0] = size;
+		size *= *h;
+		if (offsets)
+			offsets[1] = size;
+		tmp = ((*w + 3) & ~3) << 1;
+		if (pitches)
+			pitches[1] = tmp;
+		tmp *= (*h >> 1);
+		size += tmp;
+		break;
 	case FOURCC_AYUV:
 		tmp = *w << 2;
 		if (pitches)
@@ -859,11 +988,21 @@ void sna_video_sprite_setup(struct sna *sna, ScreenPtr screen)
 	adaptor->pAttributes = (XvAttributeRec *)attribs;
 
 	if (sna_has_sprite_format(sna, DRM_FORMAT_XYUV8888)) {
-		adaptor->pImages = (XvImageRec *)images_ayuv;
-		adaptor->nImages = ARRAY_SIZE(images_ayuv);
+		if (sna_has_sprite_format(sna, DRM_FORMAT_P010)) {
+			adaptor->pImages = (XvImageRec *)images_ayuv_p010;
+			adaptor->nImages = ARRAY_SIZE(images_ayuv_p010);
+		} else {
+			adaptor->pImages = (XvImageRec *)images_ayuv;
+			adaptor->nImages = ARRAY_SIZE(images_ayuv);
+		}
 	} else if (sna_has_sprite_format(sna, DRM_FORMAT_NV12)) {
-		adaptor->pImages = (XvImageRec *)images_nv12;
-		adaptor->nImages = ARRAY_SIZE(images_nv12);
+		if (sna_has_sprite_format(sna, DRM_FORMAT_P010)) {
+			adaptor->pImages = (XvImageRec *)images_nv12_p010;
+			adaptor->nImages = ARRAY_SIZE(images_nv12_p010);
+		} else {
+			adaptor->pImages = (XvImageRec *)images_nv12;
+			adaptor->nImages = ARRAY_SIZE(images_nv12);
+		}
 	} else if (sna_has_sprite_format(sna, DRM_FORMAT_RGB565)) {
 		adaptor->pImages = (XvImageRec *)images_rgb565;
 		adaptor->nImages = ARRAY_SIZE(images_rgb565);
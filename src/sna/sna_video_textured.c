@@ -184,6 +184,7 @@ sna_video_textured_put_image(ddPutImage_ARGS)
 	xf86CrtcPtr crtc;
 	int16_t dx, dy;
 	bool flush = false;
+	bool vsync, mapped = false;
 	bool ret;
 
 	if (wedged(sna))
@@ -230,6 +231,9 @@ sna_video_textured_put_image(ddPutImage_ARGS)
 
 	sna_video_frame_set_rotation(video, &frame, RR_Rotate_0);
 
+	vsync = (crtc && video->SyncToVblank != 0 &&
+		 sna_pixmap_is_scanout(sna, pixmap));
+
 	if (xvmc_passthrough(format->id)) {
 		DBG(("%s: using passthough, name=%d\n",
 		     __FUNCTION__, *(uint32_t *)buf));
@@ -252,15 +256,19 @@ sna_video_textured_put_image(ddPutImage_ARGS)
 		frame.image.x2 = frame.width;
 		frame.image.y2 = frame.height;
 	} else {
-		if (!sna_video_copy_data(video, &frame, buf)) {
+		/* Sampling the client's memory means waiting for the GPU
+		 * before we return, so not if that includes a vblank.
+		 */
+		if (!vsync)
+			mapped = sna_video_map_data(video, &frame, buf);
+		if (!mapped && !sna_video_copy_data(video, &frame, buf)) {
 			DBG(("%s: failed to copy frame\n", __FUNCTION__));
 			kgem_bo_destroy(&sna->kgem, frame.bo);
 			return BadAlloc;
 		}
 	}
 
-	if (crtc && video->SyncToVblank != 0 &&
-	    sna_pixmap_is_scanout(sna, pixmap)) {
+	if (vsync) {
 		kgem_set_mode(&sna->kgem, KGEM_RENDER, sna_pixmap(pixmap)->gpu_bo);
 		flush = sna_wait_for_scanline(sna, pixmap, crtc,
 					      &clip.extents);
@@ -273,6 +281,10 @@ sna_video_textured_put_image(ddPutImage_ARGS)
 	} else
 		DamageDamageRegion(&pixmap->drawable, &clip);
 
+	/* The client may reuse its buffer as soon as we reply */
+	if (mapped)
+		kgem_bo_sync__cpu(&sna->kgem, frame.bo);
+
 	kgem_bo_destroy(&sna->kgem, frame.bo);
 
 	/* Push the frame to the GPU as soon as possible so
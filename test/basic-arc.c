@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test.h"
+
+#define MAX_ARCS 64
+
+static void clear(struct test_display *dpy, struct test_target *tt)
+{
+	XRenderColor render_color = {0};
+	XRenderFillRectangle(dpy->dpy, PictOpClear, tt->picture, &render_color,
+			     0, 0, tt->width, tt->height);
+}
+
+static void random_arcs(XArc *arc, int n, int w, int h, int full)
+{
+	while (n--) {
+		arc->width = rand() % (w / 2);
+		arc->height = rand() % 2 ? arc->width : rand() % (h / 2);
+		arc->x = rand() % w - arc->width / 2;
+		arc->y = rand() % h - arc->height / 2;
+		if (full) {
+			arc->angle1 = 0;
+			arc->angle2 = 360 * 64;
+		} else {
+			arc->angle1 = rand() % (720 * 64) - 360 * 64;
+			arc->angle2 = rand() % (720 * 64) - 360 * 64;
+		}
+		arc++;
+	}
+}
+
+static void draw_arcs(struct test_display *dpy, struct test_target *tt,
+		      int fill, int alu, int width, int clip,
+		      XArc *arc, int n)
+{
+	XGCValues val;
+	GC gc;
+
+	val.function = alu;
+	val.foreground = WhitePixel(dpy->dpy, 0);
+	val.line_width = width;
+
+	gc = XCreateGC(dpy->dpy, tt->draw,
+		       GCForeground | GCFunction | GCLineWidth,
+		       &val);
+	if (clip) {
+		XRectangle r[2] = {
+			{ 0, 0, tt->width / 2, tt->height / 2 },
+			{ tt->width / 2, tt->height / 2, tt->width / 3, tt->height / 3 },
+		};
+		XSetClipRectangles(dpy->dpy, gc, 0, 0, r, clip, Unsorted);
+	}
+	if (fill)
+		XFillArcs(dpy->dpy, tt->draw, gc, arc, n);
+	else
+		XDrawArcs(dpy->dpy, tt->draw, gc, arc, n);
+	XFreeGC(dpy->dpy, gc);
+}
+
+static void arc_tests(struct test *t, int reps, enum target target)
+{
+	static const int alus[] = { GXcopy, GXxor };
+	char buf[1024];
+	struct test_target out, ref;
+	XArc arc[MAX_ARCS];
+	int r, fill, full, alu, lw, clip;
+
+	printf("Testing drawing of arcs (%s): ", test_target_name(target));
+	fflush(stdout);
+
+	test_target_create_render(&t->out, target, &out);
+	test_target_create_render(&t->ref, target, &ref);
+
+	for (r = 0; r < reps; r++) {
+		for (fill = 0; fill <= 1; fill++)
+		for (full = 0; full <= 1; full++)
+		for (alu = 0; alu < 2; alu++)
+		for (lw = 0; lw <= (fill ? 0 : 3); lw++)
+		for (clip = 0; clip <= 2; clip++) {
+			int n = 1 + rand() % MAX_ARCS;
+
+			random_arcs(arc, n, out.width, out.height, full);
+
+			sprintf(buf,
+				"%s %d %s arcs, width=%d, alu=%d, clip=%d",
+				fill ? "filling" : "drawing", n,
+				full ? "full" : "partial",
+				lw, alus[alu], clip);
+
+			clear(&t->out, &out);
+			clear(&t->ref, &ref);
+
+			draw_arcs(&t->out, &out, fill, alus[alu], lw, clip, arc, n);
+			draw_arcs(&t->ref, &ref, fill, alus[alu], lw, clip, arc, n);
+
+			test_compare(t,
+				     out.draw, out.format,
+				     ref.draw, ref.format,
+				     0, 0, out.width, out.height,
+				     buf);
+		}
+	}
+
+	test_target_destroy_render(&t->out, &out);
+	test_target_destroy_render(&t->ref, &ref);
+
+	printf("passed [%d iterations]\n", reps);
+}
+
+int main(int argc, char **argv)
+{
+	struct test test;
+	enum target t;
+
+	test_init(&test, argc, argv);
+
+	for (t = TARGET_FIRST; t <= TARGET_LAST; t++)
+		arc_tests(&test, 16, t);
+
+	return 0;
+}
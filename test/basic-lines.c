@@ -48,6 +48,8 @@ static const XPoint points[]= {
 };
 #define NUM_POINTS (sizeof(points)/sizeof(points[0]))
 
+static const char dashes[] = { 7, 3, 1, 5 };
+
 static void clear(struct test_display *dpy, struct test_target *tt)
 {
 	XRenderColor render_color = {0};
@@ -133,6 +135,201 @@ static void line_tests(struct test *t, enum target target)
 	printf("\n");
 }
 
+static void draw_polyline(struct test_display *dpy, struct test_target *tt,
+			  int alu, int width, int style, int join,
+			  const XPoint *pt, int n)
+{
+	XGCValues val;
+	GC gc;
+
+	val.function = alu;
+	val.foreground = WhitePixel(dpy->dpy, 0);
+	val.line_width = width;
+	val.line_style = style;
+	val.join_style = join;
+	val.cap_style = CapRound;
+
+	gc = XCreateGC(dpy->dpy, tt->draw,
+		       GCForeground |
+		       GCFunction |
+		       GCLineWidth |
+		       GCLineStyle |
+		       GCJoinStyle |
+		       GCCapStyle,
+		       &val);
+	if (style != LineSolid)
+		XSetDashes(dpy->dpy, gc, 0, dashes, sizeof(dashes));
+	XDrawLines(dpy->dpy, tt->draw, gc, (XPoint *)pt, n, CoordModeOrigin);
+	XFreeGC(dpy->dpy, gc);
+}
+
+static void random_polyline(XPoint *pt, int n, int w, int h)
+{
+	while (n--) {
+		pt->x = rand() % w;
+		pt->y = rand() % h;
+		pt++;
+	}
+}
+
+static void polyline_tests(struct test *t, int reps, enum target target)
+{
+	static const int alus[] = { GXcopy, GXxor };
+	char buf[1024];
+	struct test_target out, ref;
+	XPoint pt[32];
+	int r, alu, lw, style, join;
+
+	printf("Testing drawing of wide and dashed polylines (%s): ",
+	       test_target_name(target));
+	fflush(stdout);
+
+	test_target_create_render(&t->out, target, &out);
+	test_target_create_render(&t->ref, target, &ref);
+
+	for (r = 0; r < reps; r++) {
+		for (alu = 0; alu < 2; alu++)
+		for (style = LineSolid; style <= LineOnOffDash; style++)
+		for (join = JoinMiter; join <= JoinBevel; join++)
+		for (lw = 2; lw <= 8; lw += 3) {
+			int n = 2 + rand() % 30;
+
+			random_polyline(pt, n, out.width, out.height);
+
+			sprintf(buf,
+				"%d points, width=%d, style=%d, join=%d, alu=%d",
+				n, lw, style, join, alus[alu]);
+
+			clear(&t->out, &out);
+			clear(&t->ref, &ref);
+
+			draw_polyline(&t->out, &out, alus[alu], lw, style, join, pt, n);
+			draw_polyline(&t->ref, &ref, alus[alu], lw, style, join, pt, n);
+
+			test_compare(t,
+				     out.draw, out.format,
+				     ref.draw, ref.format,
+				     0, 0, out.width, out.height,
+				     buf);
+		}
+	}
+
+	test_target_destroy_render(&t->out, &out);
+	test_target_destroy_render(&t->ref, &ref);
+
+	printf("passed [%d iterations]\n", reps);
+}
+
+/* The tip of a sharp miter reaches far beyond the points themselves */
+static void miter_tests(struct test *t, enum target target)
+{
+	char buf[1024];
+	struct test_target out, ref;
+	XPoint pt[3];
+	int lw, dx, style;
+
+	printf("Testing drawing of acute mitred joins (%s): ",
+	       test_target_name(target));
+	fflush(stdout);
+
+	test_target_create_render(&t->out, target, &out);
+	test_target_create_render(&t->ref, target, &ref);
+
+	for (style = LineSolid; style <= LineOnOffDash; style++)
+	for (lw = 4; lw <= 24; lw += 10)
+	for (dx = 4; dx <= 16; dx += 4) {
+		/* a narrow V, opening to the left, tip to the right */
+		pt[0].x = out.width / 4;
+		pt[0].y = out.height / 2 - dx;
+		pt[1].x = out.width / 2;
+		pt[1].y = out.height / 2;
+		pt[2].x = out.width / 4;
+		pt[2].y = out.height / 2 + dx;
+
+		sprintf(buf, "miter, width=%d, opening=%d, style=%d",
+			lw, 2*dx, style);
+
+		clear(&t->out, &out);
+		clear(&t->ref, &ref);
+
+		draw_polyline(&t->out, &out, GXcopy, lw, style, JoinMiter, pt, 3);
+		draw_polyline(&t->ref, &ref, GXcopy, lw, style, JoinMiter, pt, 3);
+
+		test_compare(t,
+			     out.draw, out.format,
+			     ref.draw, ref.format,
+			     0, 0, out.width, out.height,
+			     buf);
+	}
+
+	test_target_destroy_render(&t->out, &out);
+	test_target_destroy_render(&t->ref, &ref);
+
+	printf("passed\n");
+}
+
+static double _bench_polyline(struct test_display *t, enum target target_type,
+			      int width, int style, int loops)
+{
+	struct test_target target;
+	struct timespec tv;
+	XGCValues val;
+	XPoint pt[16];
+	double elapsed;
+	GC gc;
+
+	test_target_create_render(t, target_type, &target);
+	clear(t, &target);
+
+	val.function = GXcopy;
+	val.foreground = WhitePixel(t->dpy, 0);
+	val.line_width = width;
+	val.line_style = style;
+	val.join_style = JoinRound;
+	val.cap_style = CapRound;
+	gc = XCreateGC(t->dpy, target.draw,
+		       GCForeground |
+		       GCFunction |
+		       GCLineWidth |
+		       GCLineStyle |
+		       GCJoinStyle |
+		       GCCapStyle,
+		       &val);
+	if (style != LineSolid)
+		XSetDashes(t->dpy, gc, 0, dashes, sizeof(dashes));
+
+	srand(0);
+	test_timer_start(t, &tv);
+	while (loops--) {
+		random_polyline(pt, 16, target.width, target.height);
+		XDrawLines(t->dpy, target.draw, gc, pt, 16, CoordModeOrigin);
+	}
+	elapsed = test_timer_stop(t, &tv);
+
+	XFreeGC(t->dpy, gc);
+	test_target_destroy_render(t, &target);
+
+	return elapsed;
+}
+
+static void bench_polyline(struct test *t, enum target target,
+			   int width, int style)
+{
+	const int loops = 2000;
+	double out, ref;
+
+	printf("Throughput of %s polylines, width=%d (%s): ",
+	       style == LineSolid ? "solid" : "dashed", width,
+	       test_target_name(target));
+	fflush(stdout);
+
+	ref = _bench_polyline(&t->ref, target, width, style, loops);
+	out = _bench_polyline(&t->out, target, width, style, loops);
+
+	printf("ref=%.0f lines/s, out=%.0f lines/s\n",
+	       loops / ref, loops / out);
+}
+
 int main(int argc, char **argv)
 {
 	struct test test;
@@ -143,5 +340,17 @@ int main(int argc, char **argv)
 	for (t = TARGET_FIRST; t <= TARGET_LAST; t++)
 		line_tests(&test, t);
 
+	for (t = TARGET_FIRST; t <= TARGET_LAST; t++)
+		polyline_tests(&test, 8, t);
+
+	for (t = TARGET_FIRST; t <= TARGET_LAST; t++)
+		miter_tests(&test, t);
+
+	for (t = TARGET_FIRST; t <= TARGET_LAST; t++) {
+		bench_polyline(&test, t, 3, LineSolid);
+		bench_polyline(&test, t, 3, LineOnOffDash);
+		bench_polyline(&test, t, 10, LineSolid);
+	}
+
 	return 0;
 }
@@ -217,6 +217,71 @@ static void complex_clip_tests(struct test *t, int reps, int sets, enum target t
 	test_target_destroy_render(&t->ref, &ref);
 }
 
+static double _bench_stipple(struct test_display *t, enum target target_type,
+			     uint8_t stipple, uint8_t opaque, int size, int loops)
+{
+	struct test_target target;
+	struct timespec tv;
+	XGCValues val;
+	double elapsed;
+	GC gc;
+
+	test_target_create_render(t, target_type, &target);
+	clear(&target);
+
+	if (size > target.width)
+		size = target.width;
+	if (size > target.height)
+		size = target.height;
+
+	val.function = GXcopy;
+	val.foreground = 0xffffff;
+	val.background = 0x000000;
+	val.fill_style = opaque ? FillOpaqueStippled : FillStippled;
+	if (stipple == 0)
+		val.stipple = XCreateBitmapFromData(t->dpy, target.draw,
+						    (char *)bitmap4x4, 4, 4);
+	else
+		val.stipple = XCreateBitmapFromData(t->dpy, target.draw,
+						    (char *)bitmap8x8[stipple-1], 8, 8);
+	gc = XCreateGC(t->dpy, target.draw,
+		       GCFillStyle | GCStipple | GCForeground | GCBackground | GCFunction,
+		       &val);
+
+	test_timer_start(t, &tv);
+	while (loops--)
+		XFillRectangle(t->dpy, target.draw, gc,
+			       loops % (target.width - size + 1),
+			       loops % (target.height - size + 1),
+			       size, size);
+	elapsed = test_timer_stop(t, &tv);
+
+	XFreeGC(t->dpy, gc);
+	XFreePixmap(t->dpy, val.stipple);
+	test_target_destroy_render(t, &target);
+
+	return elapsed;
+}
+
+static void bench_stipple(struct test *t, enum target target,
+			  uint8_t opaque, int size)
+{
+	const int loops = 2000;
+	double out, ref;
+
+	printf("Throughput of %s %dx%d fills (%s): ",
+	       opaque ? "opaque stippled" : "stippled",
+	       size, size, test_target_name(target));
+	fflush(stdout);
+
+	ref = _bench_stipple(&t->ref, target, 1, opaque, size, loops);
+	out = _bench_stipple(&t->out, target, 1, opaque, size, loops);
+
+	printf("ref=%.1f Mpixels/s, out=%.1f Mpixels/s\n",
+	       1e-6 * size * size * loops / ref,
+	       1e-6 * size * size * loops / out);
+}
+
 int main(int argc, char **argv)
 {
 	struct test test;
@@ -235,5 +300,12 @@ int main(int argc, char **argv)
 		}
 	}
 
+	for (i = TARGET_FIRST; i <= TARGET_LAST; i++) {
+		bench_stipple(&test, i, 0, 64);
+		bench_stipple(&test, i, 0, 512);
+		bench_stipple(&test, i, 1, 64);
+		bench_stipple(&test, i, 1, 512);
+	}
+
 	return 0;
 }
@@ -78,6 +78,59 @@ static void string_tests(struct test *t, int reps, int sets, enum target target)
 	test_target_destroy_render(&t->ref, &ref);
 }
 
+static double _bench_string(struct test_display *t, enum target target_type,
+			    int fill, int loops)
+{
+	const char *string = "The quick brown fox jumps over the lazy dog";
+	struct test_target target;
+	struct timespec tv;
+	XGCValues val;
+	double elapsed;
+	GC gc;
+
+	test_target_create_render(t, target_type, &target);
+	clear(t, &target);
+
+	val.function = GXcopy;
+	val.foreground = 0xffffff;
+	val.background = 0x000000;
+	gc = XCreateGC(t->dpy, target.draw,
+		       GCForeground | GCBackground | GCFunction, &val);
+
+	test_timer_start(t, &tv);
+	while (loops--) {
+		int y = 16 + loops % (target.height - 16);
+		if (fill)
+			XDrawImageString(t->dpy, target.draw, gc, 0, y,
+					 string, strlen(string));
+		else
+			XDrawString(t->dpy, target.draw, gc, 0, y,
+				    string, strlen(string));
+	}
+	elapsed = test_timer_stop(t, &tv);
+
+	XFreeGC(t->dpy, gc);
+	test_target_destroy_render(t, &target);
+
+	return elapsed;
+}
+
+static void bench_string(struct test *t, enum target target, int fill)
+{
+	const int loops = 20000;
+	double out, ref;
+
+	printf("Throughput of %s (%s): ",
+	       fill ? "ImageText" : "PolyText", test_target_name(target));
+	fflush(stdout);
+
+	ref = _bench_string(&t->ref, target, fill, loops);
+	out = _bench_string(&t->out, target, fill, loops);
+
+	printf("ref=%.0f strings/s, out=%.0f strings/s\n",
+	       loops / ref, loops / out);
+}
+
 int main(int argc, char **argv)
 {
 	struct test test;
@@ -94,5 +147,10 @@ int main(int argc, char **argv)
 		}
 	}
 
+	for (i = TARGET_FIRST; i <= TARGET_LAST; i++) {
+		bench_string(&test, i, 0);
+		bench_string(&test, i, 1);
+	}
+
 	return 0;
 }
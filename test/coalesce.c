@@ -0,0 +1,155 @@
+/*
+ * Checks the merging of damage boxes before upload (src/sna/sna_coalesce.h):
+ * that every damaged pixel is still covered, that a line of glyphs becomes
+ * a few boxes rather than one per glyph, that distant boxes are left alone
+ * and the pixels uploaded needlessly stay within bounds, and that no merge ever strays into
+ * pixels the caller has forbidden, i.e. where the GPU copy is newer.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/sna/sna_coalesce.h"
+
+#define SIZE 512
+
+static uint8_t damage[SIZE][SIZE];
+
+static void mark(const pixman_box16_t *b, int n, uint8_t bit)
+{
+	int x, y;
+
+	while (n--) {
+		for (y = b->y1; y < b->y2; y++)
+			for (x = b->x1; x < b->x2; x++)
+				damage[y][x] |= bit;
+		b++;
+	}
+}
+
+/* Glyphs along lines of text, split into bands as a region would be */
+static int text(pixman_box16_t *box, int lines, int columns)
+{
+	int n = 0, l, c;
+
+	for (l = 0; l < lines; l++) {
+		int y = 4 + 20 * l;
+
+		/* ascenders */
+		for (c = 0; c < columns; c++) {
+			if (c % 3)
+				continue;
+			box[n].x1 = 8 + 9 * c;
+			box[n].x2 = box[n].x1 + 7;
+			box[n].y1 = y;
+			box[n].y2 = y + 4;
+			n++;
+		}
+		/* x-height */
+		for (c = 0; c < columns; c++) {
+			box[n].x1 = 8 + 9 * c;
+			box[n].x2 = box[n].x1 + 7;
+			box[n].y1 = y + 4;
+			box[n].y2 = y + 14;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+static bool forbid(void *closure, const pixman_box16_t *b)
+{
+	const pixman_box16_t *f = closure;
+
+	return b->x2 <= f->x1 || b->x1 >= f->x2 ||
+	       b->y2 <= f->y1 || b->y1 >= f->y2;
+}
+
+static int check(const char *name,
+		 const pixman_box16_t *box, int n,
+		 bool (*allow)(void *, const pixman_box16_t *), void *closure,
+		 int max_out)
+{
+	static pixman_box16_t out[4096];
+	long damaged = 0, uploaded = 0, wasted = 0;
+	int count, x, y, ret = 0;
+
+	memset(damage, 0, sizeof(damage));
+	mark(box, n, 1);
+	if (closure)
+		mark(closure, 1, 4);
+
+	count = box_coalesce(box, n, out, allow, closure);
+	mark(out, count, 2);
+
+	for (y = 0; y < SIZE; y++) {
+		for (x = 0; x < SIZE; x++) {
+			damaged += damage[y][x] & 1;
+			uploaded += (damage[y][x] & 2) >> 1;
+			wasted += (damage[y][x] & 3) == 2;
+			if ((damage[y][x] & 3) == 1) {
+				if (!ret)
+					fprintf(stderr, "%s: (%d, %d) left behind\n",
+						name, x, y);
+				ret = 1;
+			}
+			if ((damage[y][x] & 6) == 6) {
+				if (!ret)
+					fprintf(stderr, "%s: (%d, %d) forbidden, but uploaded\n",
+						name, x, y);
+				ret = 1;
+			}
+		}
+	}
+
+	if (count > max_out) {
+		fprintf(stderr, "%s: %d boxes became %d, expected at most %d\n",
+			name, n, count, max_out);
+		ret = 1;
+	}
+	/* Each merge may sweep up half as much again, and a little for free */
+	if (wasted > damaged / 2 + (long)COALESCE_SLACK * (n - count)) {
+		fprintf(stderr, "%s: uploading %ld pixels for %ld damaged\n",
+			name, uploaded, damaged);
+		ret = 1;
+	}
+
+	printf("%s: %d boxes -> %d, %ld pixels -> %ld\n",
+	       name, n, count, damaged, uploaded);
+	return ret;
+}
+
+int main(void)
+{
+	static pixman_box16_t box[4096];
+	pixman_box16_t far[2] = {
+		{ 0, 0, 16, 16 },
+		{ 400, 400, 416, 416 },
+	};
+	pixman_box16_t hole = { 200, 0, 240, SIZE };
+	int i, j, n, ret = 0;
+
+	n = text(box, 1, 40);
+	ret |= check("line of text", box, n, NULL, NULL, 4);
+
+	n = text(box, 20, 50);
+	ret |= check("page of text", box, n, NULL, NULL, 4 * 20);
+
+	ret |= check("distant boxes", far, 2, NULL, NULL, 2);
+
+	/* The GPU has drawn over a column, and so it has no CPU damage */
+	n = text(box, 20, 50);
+	for (i = j = 0; i < n; i++) {
+		if (forbid(&hole, &box[i]))
+			box[j++] = box[i];
+	}
+	ret |= check("around GPU damage", box, j, forbid, &hole, 4 * 20);
+
+	ret |= check("empty", box, 0, NULL, NULL, 0);
+
+	printf("%s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
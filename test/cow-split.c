@@ -0,0 +1,102 @@
+/*
+ * Checks the splitting of a copy-on-write pixmap about to be partially
+ * overwritten (src/sna/sna_cow_split.h): that every pixel outside the
+ * write is still copied, and only once, that the copy stays tile aligned,
+ * and that a write too small to skip a whole tile falls back to copying
+ * everything.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/sna/sna_cow_split.h"
+
+#define WIDTH 300
+#define HEIGHT 200
+
+static uint8_t copied[HEIGHT][WIDTH];
+
+static int check(const char *name, int x1, int y1, int x2, int y2,
+		 int tw, int th, int expect)
+{
+	pixman_box16_t write, out[4];
+	long skipped = 0;
+	int n, i, x, y, ret = 0;
+
+	write.x1 = x1; write.y1 = y1;
+	write.x2 = x2; write.y2 = y2;
+
+	memset(copied, 0, sizeof(copied));
+	n = cow_split(&write, WIDTH, HEIGHT, tw, th, out);
+	if (n > 4 || (expect >= 0 && n != expect)) {
+		fprintf(stderr, "%s: split into %d boxes, expected %d\n",
+			name, n, expect);
+		ret = 1;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (out[i].x1 < 0 || out[i].y1 < 0 ||
+		    out[i].x2 > WIDTH || out[i].y2 > HEIGHT ||
+		    out[i].x1 >= out[i].x2 || out[i].y1 >= out[i].y2) {
+			fprintf(stderr, "%s: box %d invalid (%d, %d), (%d, %d)\n",
+				name, i, out[i].x1, out[i].y1, out[i].x2, out[i].y2);
+			ret = 1;
+			continue;
+		}
+		if ((out[i].x1 % tw && out[i].x1 != 0) ||
+		    (out[i].x2 % tw && out[i].x2 != WIDTH) ||
+		    (out[i].y1 % th && out[i].y1 != 0) ||
+		    (out[i].y2 % th && out[i].y2 != HEIGHT)) {
+			fprintf(stderr, "%s: box %d not tile aligned (%d, %d), (%d, %d)\n",
+				name, i, out[i].x1, out[i].y1, out[i].x2, out[i].y2);
+			ret = 1;
+		}
+		for (y = out[i].y1; y < out[i].y2; y++)
+			for (x = out[i].x1; x < out[i].x2; x++)
+				copied[y][x]++;
+	}
+
+	for (y = 0; y < HEIGHT; y++) {
+		for (x = 0; x < WIDTH; x++) {
+			int inside = x >= x1 && x < x2 && y >= y1 && y < y2;
+
+			if (copied[y][x] > 1) {
+				if (!ret)
+					fprintf(stderr, "%s: (%d, %d) copied twice\n",
+						name, x, y);
+				ret = 1;
+			}
+			if (!inside && !copied[y][x]) {
+				if (!ret)
+					fprintf(stderr, "%s: (%d, %d) not copied\n",
+						name, x, y);
+				ret = 1;
+			}
+			skipped += !copied[y][x];
+		}
+	}
+
+	printf("%s: %d boxes, %ld of %d pixels not copied\n",
+	       name, n, skipped, WIDTH * HEIGHT);
+	return ret;
+}
+
+int main(void)
+{
+	int ret = 0;
+
+	ret |= check("middle", 37, 21, 250, 170, 16, 8, 4);
+	ret |= check("aligned", 32, 16, 256, 160, 16, 8, 4);
+	ret |= check("left edge", 0, 21, 250, 170, 16, 8, 3);
+	ret |= check("top-left corner", -5, -5, 100, 100, 16, 8, 2);
+	ret |= check("full width band", 0, 50, WIDTH, 150, 16, 8, 2);
+	ret |= check("everything", 0, 0, WIDTH, HEIGHT, 16, 8, 0);
+	ret |= check("within a tile", 3, 3, 14, 7, 16, 8, 1);
+	ret |= check("linear", 37, 21, 250, 170, 1, 1, 4);
+	ret |= check("Y-tiled", 37, 21, 250, 170, 32, 32, 4);
+
+	printf("%s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
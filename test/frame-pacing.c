@@ -0,0 +1,154 @@
+/*
+ * Drives the frame pacing predictor from sna_frame_pacing.h with a
+ * simulated display (a jittery 59.94Hz vblank) and GPU (a render time
+ * hidden from the predictor), queuing each flip at the predicted
+ * deadline as late latching does. Checks that the period is recovered,
+ * that few vblanks are missed, that the margin recovers after the render
+ * time jumps, that we latch later than the fixed half-frame we used
+ * before, and that we latch as soon as the clients' frames are in.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../src/sna/sna_frame_pacing.h"
+
+#define PERIOD 16683 /* 59.94Hz */
+#define JITTER 40
+
+static uint64_t vblank_time(uint64_t msc)
+{
+	return 1000000 + msc * PERIOD + (msc * 2654435761u >> 8) % JITTER;
+}
+
+struct result {
+	int frames, missed;
+	uint64_t latch; /* total time from queuing the flip to its vblank */
+};
+
+/*
+ * Queue a flip at the deadline every frame, submitting takes submit us
+ * and the GPU then needs render us before the flip can be latched.
+ */
+static void run(struct frame_pacing *p, uint64_t *msc, int frames,
+		uint32_t submit, uint32_t render, struct result *r)
+{
+	r->frames = r->missed = 0;
+	r->latch = 0;
+
+	while (frames--) {
+		uint64_t now = vblank_time(*msc) + 100;
+		uint64_t deadline, ready, seq;
+
+		deadline = frame_pacing_deadline(p, now);
+		if (deadline == 0)
+			deadline = now + PERIOD / 2;
+
+		frame_pacing_flip(p, deadline + submit, submit);
+
+		ready = deadline + submit + render;
+		for (seq = *msc + 1; vblank_time(seq) < ready; seq++)
+			;
+		r->latch += vblank_time(seq) - (deadline + submit);
+		if (frame_pacing_flip_complete(p, vblank_time(seq), seq))
+			r->missed++;
+		r->frames++;
+		*msc = seq;
+	}
+}
+
+static int check(int cond, const char *what)
+{
+	if (!cond)
+		fprintf(stderr, "frame-pacing: %s\n", what);
+	return !cond;
+}
+
+int main(void)
+{
+	struct frame_pacing p = { .frames = 0 };
+	struct result r;
+	uint64_t msc;
+	uint32_t period;
+	int failed = 0, i;
+
+	frame_pacing_reset(&p, 16667);
+	failed += check(frame_pacing_deadline(&p, 1000000) == 0,
+			"predicted a deadline without having seen a vblank");
+
+	/* Recover the true period from the vblanks, not the nominal */
+	for (msc = 1; msc < 40; msc++)
+		frame_pacing_vblank(&p, vblank_time(msc), msc);
+	period = frame_pacing_period(&p);
+	failed += check(period > PERIOD - JITTER && period < PERIOD + JITTER,
+			"period not recovered from the vblanks");
+
+	/* A deadline lies between now and the next-but-one vblank */
+	{
+		uint64_t now = vblank_time(msc - 1) + 2000;
+		uint64_t deadline = frame_pacing_deadline(&p, now);
+
+		failed += check(deadline >= now && deadline < now + 2 * PERIOD,
+				"deadline not in the next frame");
+		failed += check(deadline + frame_pacing_lead(&p) - (vblank_time(msc) - JITTER) < 2 * JITTER ||
+				deadline + frame_pacing_lead(&p) - (vblank_time(msc + 1) - JITTER) < 2 * JITTER,
+				"deadline not a lead before a vblank");
+	}
+
+	/* Steady state, a 1ms submission and 3ms of rendering */
+	msc--;
+	run(&p, &msc, 600, 1000, 3000, &r);
+	printf("steady: %d/%d missed, latched %.1fms before the vblank, margin %.1fms\n",
+	       r.missed, r.frames, r.latch / 1000. / r.frames, p.margin / 1000.);
+	failed += check(r.missed * 100 < r.frames * 2, "too many missed vblanks");
+	failed += check(r.latch / r.frames < PERIOD / 2,
+			"latched no later than the fixed half frame");
+
+	/* The rendering suddenly takes longer, we may miss a few */
+	run(&p, &msc, 100, 1000, 7000, &r);
+	printf("slower: %d/%d missed, latched %.1fms before the vblank, margin %.1fms\n",
+	       r.missed, r.frames, r.latch / 1000. / r.frames, p.margin / 1000.);
+	failed += check(r.missed <= 5, "did not adapt to slower rendering");
+
+	run(&p, &msc, 600, 1000, 7000, &r);
+	printf("adapted: %d/%d missed, latched %.1fms before the vblank, margin %.1fms\n",
+	       r.missed, r.frames, r.latch / 1000. / r.frames, p.margin / 1000.);
+	failed += check(r.missed * 100 < r.frames * 2, "too many missed vblanks after adapting");
+
+	/* After idling, we have nothing recent to predict from */
+	failed += check(frame_pacing_deadline(&p, vblank_time(msc + 100)) == 0,
+			"predicted a deadline from a stale vblank");
+
+	/* Only the first request after each vblank counts as a render time */
+	frame_pacing_request(&p, vblank_time(msc) + 5000);
+	frame_pacing_request(&p, vblank_time(msc) + 9000);
+	failed += check(frame_pacing_render(&p) == vblank_time(msc) + 5000 - p.vblank_ust,
+			"render time not taken from the first request");
+
+	failed += check(p.frames == 1300, "flips not all counted");
+
+	/*
+	 * Clients delivering their frames 4ms after each vblank, we need not
+	 * wait any longer before latching, nor can we latch before now.
+	 */
+	for (i = 0; i < 2 * FRAME_PACING_HISTORY; i++) {
+		msc++;
+		frame_pacing_vblank(&p, vblank_time(msc), msc);
+		frame_pacing_request(&p, vblank_time(msc) + 4000 + msc % 3 * 100);
+	}
+	msc++;
+	{
+		uint64_t now = vblank_time(msc - 1) + 1000;
+		uint64_t deadline = frame_pacing_deadline(&p, now);
+
+		printf("clients: latching %.1fms after the vblank, the lead %.1fms before the next\n",
+		       (deadline - p.vblank_ust) / 1000., frame_pacing_lead(&p) / 1000.);
+		failed += check(deadline == p.vblank_ust + 4200,
+				"did not latch once the clients' frames were in");
+		failed += check(frame_pacing_deadline(&p, now + 5000) == now + 5000,
+				"latched before now");
+	}
+
+	printf("%s\n", failed ? "FAIL" : "PASS");
+	return failed ? 1 : 0;
+}
@@ -29,6 +29,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <unistd.h>
 
 #include <X11/X.h>
 #include <X11/Xutil.h> /* for XDestroyImage */
@@ -438,15 +439,527 @@ static void bench_mask(struct test *t, enum target target, int op, int src, int
 	fprintf(stdout, "out=%f\n", out);
 }
 
+/*
+ * The sweep: every source against a range of rectangle sizes, from a
+ * single pixel up to the whole screen, split into 1 or more boxes per
+ * request (as a clip on the destination), with or without a mask and
+ * with the source transformed, onto both a window and a pixmap. Each
+ * line reports the throughput (operations and megapixels per second,
+ * completion forced by a readback) and the latency of a single request
+ * to the XSync round trip that follows it.
+ *
+ * Only the display under test is measured; a run writes CSV (or JSON)
+ * to -o (default stdout) for comparison with a previous run with -c.
+ */
+
+static const char *fields[] = {
+	"op", "src", "mask", "dst", "transform",
+	"width", "height", "count",
+	"ops_per_s", "mpix_per_s", "p50_us", "p99_us",
+};
+#define NKEYS 8
+#define NFIELDS (int)ARRAY_SIZE(fields)
+
+static const struct {
+	Picture (*create)(struct test_display *, struct test_target *);
+	const char *name;
+} sweep_mask[] = {
+	{ NULL, "none" },
+	{ source_a8, "a8 pixmap" },
+	{ source_1x1r, "a8r8g8b8 1x1R pixmap" },
+	{ source_solid, "solid" },
+	{ source_linear_horizontal, "linear (horizontal gradient)" },
+};
+
+static const struct {
+	const char *name;
+	XTransform transform; /* destination to source, 16.16 */
+	const char *filter;
+} sweep_transform[] = {
+	{ "identity", {{{ 1 << 16, 0, 0 }, { 0, 1 << 16, 0 }, { 0, 0, 1 << 16 }}}, NULL },
+	{ "scale 2x bilinear", {{{ 1 << 15, 0, 0 }, { 0, 1 << 15, 0 }, { 0, 0, 1 << 16 }}}, FilterBilinear },
+	{ "rotate 90", {{{ 0, 1 << 16, 0 }, { -(1 << 16), 0, 0 }, { 0, 0, 1 << 16 }}}, NULL },
+};
+
+static const int sweep_op[] = { PictOpSrc, PictOpOver };
+static const int sweep_size[] = { 1, 8, 32, 128, 512, 0 /* screen */ };
+static const int sweep_count[] = { 1, 16, 256 };
+static const enum target sweep_target[] = { ROOT, PIXMAP };
+
+#define MIN_TIME .02 /* seconds */
+#define MAX_SAMPLES 256
+
+struct sweep {
+	FILE *file;
+	int json;
+	int rows;
+	const char *filter;
+};
+
+struct result {
+	const char *op, *src, *mask, *dst, *transform;
+	int width, height, count;
+	double ops, mpix, p50, p99;
+};
+
+static const char *op_name(int op)
+{
+	unsigned n;
+
+	for (n = 0; n < ARRAY_SIZE(ops); n++)
+		if (ops[n].value == op)
+			return ops[n].name;
+
+	return "?";
+}
+
+static void sweep_begin(struct sweep *s)
+{
+	if (s->json) {
+		fprintf(s->file, "[\n");
+	} else {
+		int n;
+
+		for (n = 0; n < NFIELDS; n++)
+			fprintf(s->file, "%s%c", fields[n], n == NFIELDS - 1 ? '\n' : ',');
+	}
+}
+
+static void sweep_end(struct sweep *s)
+{
+	if (s->json)
+		fprintf(s->file, "\n]\n");
+	fflush(s->file);
+}
+
+static void sweep_write(struct sweep *s, const struct result *r)
+{
+	if (s->json)
+		fprintf(s->file,
+			"%s{\"op\": \"%s\", \"src\": \"%s\", \"mask\": \"%s\", \"dst\": \"%s\", \"transform\": \"%s\", "
+			"\"width\": %d, \"height\": %d, \"count\": %d, "
+			"\"ops_per_s\": %.1f, \"mpix_per_s\": %.3f, \"p50_us\": %.1f, \"p99_us\": %.1f}",
+			s->rows ? ",\n" : "",
+			r->op, r->src, r->mask, r->dst, r->transform,
+			r->width, r->height, r->count,
+			r->ops, r->mpix, r->p50, r->p99);
+	else
+		fprintf(s->file, "%s,%s,%s,%s,%s,%d,%d,%d,%.1f,%.3f,%.1f,%.1f\n",
+			r->op, r->src, r->mask, r->dst, r->transform,
+			r->width, r->height, r->count,
+			r->ops, r->mpix, r->p50, r->p99);
+	fflush(s->file);
+	s->rows++;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* Split w x h into count bands, a pixel apart so that they are not coalesced */
+static int clip_bands(XRectangle *rects, int w, int h, int count)
+{
+	int band = (h - (count - 1)) / count;
+	int n;
+
+	if (band < 1)
+		return 0;
+
+	for (n = 0; n < count; n++) {
+		rects[n].x = 0;
+		rects[n].y = n * (band + 1);
+		rects[n].width = w;
+		rects[n].height = band;
+	}
+
+	return w * band * count;
+}
+
+static void sweep_one(struct test_display *t, struct sweep *s,
+		      struct result *r, int op, int src, int mask, int xform,
+		      enum target target_type, int size, int count)
+{
+	XRenderColor render_color = { 0x8000, 0x8000, 0x8000, 0x8000 };
+	XRectangle rects[256];
+	struct test_target target;
+	Picture ps, pm = 0;
+	double samples[MAX_SAMPLES];
+	struct timespec tv;
+	double elapsed, start;
+	int loops, n, pixels;
+	char key[512];
+
+	r->op = op_name(op);
+	r->src = source[src].name;
+	r->mask = sweep_mask[mask].name;
+	r->dst = test_target_name(target_type);
+	r->transform = sweep_transform[xform].name;
+	r->width = size ? MIN(size, t->width) : t->width;
+	r->height = size ? MIN(size, t->height) : t->height;
+	r->count = count;
+
+	snprintf(key, sizeof(key), "%s,%s,%s,%s,%s,%d,%d,%d",
+		 r->op, r->src, r->mask, r->dst, r->transform,
+		 r->width, r->height, r->count);
+	if (s->filter && strstr(key, s->filter) == NULL)
+		return;
+
+	pixels = r->width * r->height;
+	if (count > 1) {
+		pixels = clip_bands(rects, r->width, r->height, count);
+		if (pixels == 0)
+			return;
+	}
+
+	test_target_create_render(t, target_type, &target);
+	XRenderFillRectangle(t->dpy, PictOpClear, target.picture, &render_color,
+			     0, 0, target.width, target.height);
+	if (count > 1)
+		XRenderSetPictureClipRectangles(t->dpy, target.picture,
+						0, 0, rects, count);
+
+	ps = source[src].create(t, &target);
+	if (sweep_mask[mask].create)
+		pm = sweep_mask[mask].create(t, &target);
+	if (ps == 0 || (sweep_mask[mask].create && pm == 0))
+		goto out;
+
+	if (xform) {
+		XTransform transform = sweep_transform[xform].transform;
+
+		/* rotate about the rectangle, keeping it within the source */
+		if (transform.matrix[1][0] < 0)
+			transform.matrix[1][2] = r->width << 16;
+		XRenderSetPictureTransform(t->dpy, ps, &transform);
+		if (sweep_transform[xform].filter)
+			XRenderSetPictureFilter(t->dpy, ps,
+						sweep_transform[xform].filter,
+						NULL, 0);
+	}
+
+	/* warm up, then double until the run is long enough to time */
+	loops = 1;
+	do {
+		loops *= 2;
+		test_timer_start(t, &tv);
+		for (n = 0; n < loops; n++)
+			XRenderComposite(t->dpy, op, ps, pm, target.picture,
+					 0, 0, 0, 0, 0, 0,
+					 r->width, r->height);
+		elapsed = test_timer_stop(t, &tv);
+	} while (elapsed < MIN_TIME && loops < 1 << 20);
+
+	r->ops = loops / elapsed;
+	r->mpix = r->ops * pixels / 1e6;
+
+	/* and each request on its own, to the reply of an XSync */
+	start = now();
+	for (n = 0; n < MAX_SAMPLES; n++) {
+		double then = now();
+
+		XRenderComposite(t->dpy, op, ps, pm, target.picture,
+				 0, 0, 0, 0, 0, 0,
+				 r->width, r->height);
+		XSync(t->dpy, False);
+		samples[n] = 1e6 * (now() - then);
+
+		if (n >= 16 && now() - start > 5 * MIN_TIME) {
+			n++;
+			break;
+		}
+	}
+	qsort(samples, n, sizeof(double), cmp_double);
+	r->p50 = samples[n / 2];
+	r->p99 = samples[n * 99 / 100];
+
+	sweep_write(s, r);
+
+out:
+	if (ps)
+		XRenderFreePicture(t->dpy, ps);
+	if (pm)
+		XRenderFreePicture(t->dpy, pm);
+	test_target_destroy_render(t, &target);
+}
+
+static void sweep(struct test *t, struct sweep *s)
+{
+	unsigned op, src, mask, xform, target, size, count;
+	struct result r;
+
+	sweep_begin(s);
+
+	for (target = 0; target < ARRAY_SIZE(sweep_target); target++)
+	for (op = 0; op < ARRAY_SIZE(sweep_op); op++)
+	for (src = 0; src < ARRAY_SIZE(source); src++)
+	for (size = 0; size < ARRAY_SIZE(sweep_size); size++) {
+		/* boxes per request, unmasked and untransformed */
+		for (count = 0; count < ARRAY_SIZE(sweep_count); count++)
+			sweep_one(&t->out, s, &r, sweep_op[op], src, 0, 0,
+				  sweep_target[target], sweep_size[size],
+				  sweep_count[count]);
+
+		/* masks, only for Over */
+		if (sweep_op[op] == PictOpOver)
+			for (mask = 1; mask < ARRAY_SIZE(sweep_mask); mask++)
+				sweep_one(&t->out, s, &r, sweep_op[op], src, mask, 0,
+					  sweep_target[target], sweep_size[size], 1);
+
+		/* transformed sources, a solid has nothing to transform */
+		if (source[src].create != source_solid)
+			for (xform = 1; xform < ARRAY_SIZE(sweep_transform); xform++)
+				sweep_one(&t->out, s, &r, sweep_op[op], src, 0, xform,
+					  sweep_target[target], sweep_size[size], 1);
+	}
+
+	sweep_end(s);
+}
+
+struct record {
+	char key[512];
+	double value[NFIELDS - NKEYS];
+};
+
+struct results {
+	struct record *records;
+	int count, size;
+};
+
+/* Extract "name": value from one line of our own JSON output */
+static int json_field(const char *line, const char *name, char *buf, int len)
+{
+	char pattern[64];
+	const char *p, *end;
+
+	snprintf(pattern, sizeof(pattern), "\"%s\":", name);
+	p = strstr(line, pattern);
+	if (p == NULL)
+		return 0;
+
+	p += strlen(pattern);
+	while (*p == ' ')
+		p++;
+	if (*p == '"') {
+		end = strchr(++p, '"');
+	} else {
+		end = p + strcspn(p, ",}");
+	}
+	if (end == NULL || end - p >= len)
+		return 0;
+
+	memcpy(buf, p, end - p);
+	buf[end - p] = '\0';
+	return 1;
+}
+
+static int parse_line(char *line, struct record *r)
+{
+	char field[NFIELDS][128];
+	int n, len = 0;
+
+	line[strcspn(line, "\r\n")] = '\0';
+	if (line[0] == '{') {
+		for (n = 0; n < NFIELDS; n++)
+			if (!json_field(line, fields[n], field[n], sizeof(field[n])))
+				return 0;
+	} else {
+		char *p = line;
+
+		for (n = 0; n < NFIELDS; n++) {
+			int l = strcspn(p, ",");
+
+			if (l >= (int)sizeof(field[n]) ||
+			    (p[l] == '\0') != (n == NFIELDS - 1))
+				return 0;
+
+			memcpy(field[n], p, l);
+			field[n][l] = '\0';
+			p += l + 1;
+		}
+		if (strcmp(field[0], fields[0]) == 0)
+			return 0; /* the header */
+	}
+
+	for (n = 0; n < NKEYS; n++)
+		len += snprintf(r->key + len, sizeof(r->key) - len, "%s%s",
+				n ? "," : "", field[n]);
+	for (n = NKEYS; n < NFIELDS; n++)
+		r->value[n - NKEYS] = atof(field[n]);
+
+	return 1;
+}
+
+static void load_results(const char *filename, struct results *results)
+{
+	char line[1024];
+	FILE *file;
+
+	file = fopen(filename, "r");
+	if (file == NULL)
+		die("unable to open %s\n", filename);
+
+	memset(results, 0, sizeof(*results));
+	while (fgets(line, sizeof(line), file)) {
+		if (results->count == results->size) {
+			results->size = results->size ? 2 * results->size : 1024;
+			results->records = realloc(results->records,
+						   results->size * sizeof(struct record));
+			if (results->records == NULL)
+				die("out of memory\n");
+		}
+
+		if (parse_line(line, &results->records[results->count]))
+			results->count++;
+	}
+
+	fclose(file);
+}
+
+/*
+ * Compare a run against a baseline: a loss of throughput or a rise in
+ * p99 latency beyond threshold percent is a regression, and fails.
+ */
+static int compare(const char *baseline, const char *current, double threshold)
+{
+	struct results base, cur;
+	int i, j, regressions = 0, missing = 0;
+
+	load_results(baseline, &base);
+	load_results(current, &cur);
+	if (base.count == 0 || cur.count == 0)
+		die("no results found in %s\n", base.count ? current : baseline);
+
+	printf("%-64s %10s %10s %8s %8s\n",
+	       "", "ops/s", "was", "change", "p99");
+	for (i = 0; i < cur.count; i++) {
+		const struct record *c = &cur.records[i];
+		const struct record *b = NULL;
+		double ops, p99;
+
+		for (j = 0; j < base.count; j++) {
+			if (strcmp(base.records[j].key, c->key) == 0) {
+				b = &base.records[j];
+				break;
+			}
+		}
+		if (b == NULL) {
+			missing++;
+			continue;
+		}
+
+		ops = 100 * (c->value[0] - b->value[0]) / b->value[0];
+		p99 = b->value[3] ? 100 * (c->value[3] - b->value[3]) / b->value[3] : 0;
+		if (ops < -threshold || p99 > threshold) {
+			printf("%-64s %10.0f %10.0f %+7.1f%% %+7.1f%% REGRESSION\n",
+			       c->key, c->value[0], b->value[0], ops, p99);
+			regressions++;
+		}
+	}
+
+	printf("%d of %d results regressed by more than %.1f%%",
+	       regressions, cur.count - missing, threshold);
+	if (missing)
+		printf(", %d not in the baseline", missing);
+	printf("\n");
+
+	free(base.records);
+	free(cur.records);
+	return regressions != 0;
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [-d display] [-f csv|json] [-o file] [-s filter]\n"
+	       "       %s -c [-t threshold] baseline results\n"
+	       "  -f  sweep sizes, boxes per request, sources, masks, transforms\n"
+	       "      and destinations, writing machine-readable results\n"
+	       "  -o  write the results to file rather than stdout\n"
+	       "  -s  only run the results whose line contains filter\n"
+	       "  -c  compare results against a baseline, failing if any regress\n"
+	       "  -t  percentage change counted as a regression (default 5)\n",
+	       name, name);
+}
+
 int main(int argc, char **argv)
 {
 	struct test test;
+	struct sweep s;
 	unsigned op, src, mask;
+	const char *output = NULL, *format = NULL;
+	double threshold = 5;
+	int compare_mode = 0;
+	int i;
+
+	memset(&s, 0, sizeof(s));
+	while ((i = getopt(argc, argv, "cd:f:ho:s:t:")) != -1) {
+		switch (i) {
+		case 'c':
+			compare_mode = 1;
+			break;
+		case 'd': /* for test_init() */
+			break;
+		case 'f':
+			format = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 's':
+			s.filter = optarg;
+			break;
+		case 't':
+			threshold = atof(optarg);
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return i != 'h';
+		}
+	}
+
+	if (compare_mode) {
+		if (argc - optind != 2) {
+			usage(argv[0]);
+			return 1;
+		}
+		return compare(argv[optind], argv[optind + 1], threshold);
+	}
+
+	if (format) {
+		if (strcmp(format, "json") == 0)
+			s.json = 1;
+		else if (strcmp(format, "csv") != 0)
+			die("unknown format '%s'\n", format);
+
+		s.file = stdout;
+		if (output) {
+			s.file = fopen(output, "w");
+			if (s.file == NULL)
+				die("unable to open %s\n", output);
+		}
+	}
 
 	test_init(&test, argc, argv);
 
 	setup_shm(&test);
 
+	if (s.file) {
+		sweep(&test, &s);
+		if (s.file != stdout)
+			fclose(s.file);
+		return 0;
+	}
+
 	for (op = 0; op < sizeof(ops)/sizeof(ops[0]); op++) {
 		for (src = 0; src < sizeof(source)/sizeof(source[0]); src++)
 			bench_source(&test, ROOT, op, src);
@@ -1,11 +1,96 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <X11/Xutil.h> /* for XDestroyImage */
 #include <pixman.h>
 
 #include "test.h"
+#include "../src/sna/sna_trace_reader.h"
+
+/*
+ * If we can attach to the trace of the (only) SNA server, report how
+ * often the pixmaps moved between the CPU and GPU for each run, so that
+ * changes to the placement policy can be compared, e.g. with and without
+ * Option "AdaptivePlacement". Only the owner of the server can attach.
+ */
+static struct migrations {
+	struct sna_trace_reader reader;
+	uint64_t count[2], bytes[2];
+} migrations;
+
+static struct sna_trace_event buf[SNA_TRACE_SIZE];
+
+static void migrations_open(void)
+{
+	char name[256];
+
+	if (sna_trace_find(name, sizeof(name), NULL) != 1)
+		return;
+
+	sna_trace_attach(&migrations.reader, name);
+}
+
+static void migrations_drain(void)
+{
+	const struct sna_trace_event *e;
+	unsigned n;
+
+	for (e = sna_trace_read(&migrations.reader, buf, &n); n--; e++) {
+		int i;
+
+		switch (e->op) {
+		case SNA_TRACE_UPLOAD: i = 0; break;
+		case SNA_TRACE_DOWNLOAD: i = 1; break;
+		default: continue;
+		}
+		migrations.count[i]++;
+		migrations.bytes[i] += e->bytes;
+	}
+}
+
+static void migrations_start(struct test *test)
+{
+	if (migrations.reader.ring == NULL)
+		return;
+
+	XSync(test->out.dpy, 0);
+	migrations_drain();
+	memset(migrations.count, 0, sizeof(migrations.count));
+	memset(migrations.bytes, 0, sizeof(migrations.bytes));
+	migrations.reader.lost = 0;
+}
+
+static void migrations_sync(struct test *test)
+{
+	if (migrations.reader.ring == NULL)
+		return;
+
+	XSync(test->out.dpy, 0);
+	migrations_drain();
+}
+
+static void migrations_report(void)
+{
+	if (migrations.reader.ring == NULL)
+		return;
+
+	printf(" [%llu uploads, %llu KiB; %llu downloads, %llu KiB",
+	       (unsigned long long)migrations.count[0],
+	       (unsigned long long)migrations.bytes[0] >> 10,
+	       (unsigned long long)migrations.count[1],
+	       (unsigned long long)migrations.bytes[1] >> 10);
+	if (migrations.reader.lost)
+		printf("; %llu events lost", (unsigned long long)migrations.reader.lost);
+	printf("]");
+}
+
+static void migrations_close(void)
+{
+	sna_trace_detach(&migrations.reader);
+}
 
 static void _render_copy(struct test_target *tt,
 			 int x, int y, int w, int h,
@@ -156,6 +241,27 @@ static void basic_put(struct test_target *out,
 	_put(ref, x, y, w, h, color, alu);
 }
 
+static void _get(struct test_target *tt, int x, int y, int w, int h)
+{
+	XImage *image;
+
+	image = XGetImage(tt->dpy->dpy, tt->draw, x, y, w, h, AllPlanes, ZPixmap);
+	if (image)
+		XDestroyImage(image);
+}
+
+static void basic_get(struct test_target *out,
+		      struct test_target *ref)
+{
+	int w = 1 + rand() % out->width;
+	int h = 1 + rand() % out->height;
+	int x = rand() % (out->width - w + 1);
+	int y = rand() % (out->height - h + 1);
+
+	_get(out, x, y, w, h);
+	_get(ref, x, y, w, h);
+}
+
 static void rect_tests(struct test *test, int iterations, enum target target)
 {
 	struct test_target out, ref;
@@ -163,6 +269,7 @@ static void rect_tests(struct test *test, int iterations, enum target target)
 		basic_copy,
 		basic_fill,
 		basic_put,
+		basic_get,
 		render_copy,
 	};
 	int n;
@@ -177,8 +284,13 @@ static void rect_tests(struct test *test, int iterations, enum target target)
 	clear(&out);
 	clear(&ref);
 
-	for (n = 0; n < iterations; n++)
+	migrations_start(test);
+	for (n = 0; n < iterations; n++) {
 		ops[rand() % ARRAY_SIZE(ops)](&out, &ref);
+		if ((n & 1023) == 1023)
+			migrations_sync(test);
+	}
+	migrations_sync(test);
 
 	test_compare(test,
 		     out.draw, out.format,
@@ -186,7 +298,9 @@ static void rect_tests(struct test *test, int iterations, enum target target)
 		     0, 0, out.width, out.height,
 		     "");
 
-	printf("passed [%d iterations]\n", n);
+	printf("passed [%d iterations]", n);
+	migrations_report();
+	printf("\n");
 
 	test_target_destroy_render(&test->out, &out);
 	test_target_destroy_render(&test->ref, &ref);
@@ -198,6 +312,7 @@ int main(int argc, char **argv)
 	int i;
 
 	test_init(&test, argc, argv);
+	migrations_open();
 
 	for (i = 0; i <= DEFAULT_ITERATIONS; i++) {
 		int iterations = REPS(i);
@@ -205,5 +320,6 @@ int main(int argc, char **argv)
 		rect_tests(&test, iterations, 1);
 	}
 
+	migrations_close();
 	return 0;
 }
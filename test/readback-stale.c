@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "config.h"
+
+/*
+ * Polls an area of the screen with GetImage, as a screen recorder would,
+ * whilst drawing into it in between, and checks that every GetImage sees
+ * what was last drawn: the driver may answer from a copy it read back
+ * ahead of the request (Option "ReadbackPrefetch"), but never from one
+ * that has since been drawn over. The drawing is done by core fills,
+ * copies, PutImage and ShmPutImage, interleaved with drawing elsewhere
+ * on the screen, and with and without giving the server time to take a
+ * fresh copy between the draw and the poll.
+ */
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#define SIZE 256
+
+enum draw { FILL, COPY, PUT, SHM_PUT, NUM_DRAW };
+static const char *names[] = { "fill", "copy", "put", "shm-put" };
+
+struct ctx {
+	Display *dpy;
+	Window win, other;
+	GC gc;
+	Pixmap src;
+	XImage *image;
+	XShmSegmentInfo shm;
+	XImage *shm_image;
+};
+
+static unsigned long pixel(struct ctx *c, unsigned rgb)
+{
+	XColor col;
+
+	col.red = (rgb >> 16 & 0xff) * 0x101;
+	col.green = (rgb >> 8 & 0xff) * 0x101;
+	col.blue = (rgb & 0xff) * 0x101;
+	col.flags = DoRed | DoGreen | DoBlue;
+	XAllocColor(c->dpy, DefaultColormap(c->dpy, DefaultScreen(c->dpy)), &col);
+
+	return col.pixel;
+}
+
+static void fill_image(XImage *image, unsigned long p, int w, int h)
+{
+	int x, y;
+
+	for (y = 0; y < h; y++)
+		for (x = 0; x < w; x++)
+			XPutPixel(image, x, y, p);
+}
+
+/* Paint the box (x, y)x(w, h) of the window in the pixel p */
+static void draw(struct ctx *c, enum draw how, unsigned long p,
+		 int x, int y, int w, int h)
+{
+	switch (how) {
+	case FILL:
+		XSetForeground(c->dpy, c->gc, p);
+		XFillRectangle(c->dpy, c->win, c->gc, x, y, w, h);
+		break;
+	case COPY:
+		XSetForeground(c->dpy, c->gc, p);
+		XFillRectangle(c->dpy, c->src, c->gc, 0, 0, w, h);
+		XCopyArea(c->dpy, c->src, c->win, c->gc, 0, 0, w, h, x, y);
+		break;
+	case PUT:
+		fill_image(c->image, p, w, h);
+		XPutImage(c->dpy, c->win, c->gc, c->image, 0, 0, x, y, w, h);
+		break;
+	case SHM_PUT:
+		fill_image(c->shm_image, p, w, h);
+		XShmPutImage(c->dpy, c->win, c->gc, c->shm_image,
+			     0, 0, x, y, w, h, False);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Returns the number of pixels of the box that are not p */
+static int check(struct ctx *c, unsigned long p, int x, int y, int w, int h)
+{
+	XImage *image;
+	int i, j, bad = 0;
+
+	image = XGetImage(c->dpy, c->win, 0, 0, SIZE, SIZE, AllPlanes, ZPixmap);
+	if (image == NULL)
+		return w * h;
+
+	for (j = y; j < y + h; j++)
+		for (i = x; i < x + w; i++)
+			bad += XGetPixel(image, i, j) != p;
+
+	XDestroyImage(image);
+	return bad;
+}
+
+static int setup(struct ctx *c)
+{
+	XSetWindowAttributes attr;
+	int depth, major, minor;
+	Bool pixmaps;
+
+	depth = DefaultDepth(c->dpy, DefaultScreen(c->dpy));
+
+	/* Drawn straight onto the front buffer */
+	attr.override_redirect = 1;
+	c->win = XCreateWindow(c->dpy, DefaultRootWindow(c->dpy),
+			       0, 0, SIZE, SIZE, 0,
+			       CopyFromParent, InputOutput, CopyFromParent,
+			       CWOverrideRedirect, &attr);
+	c->other = XCreateWindow(c->dpy, DefaultRootWindow(c->dpy),
+				 SIZE, 0, SIZE, SIZE, 0,
+				 CopyFromParent, InputOutput, CopyFromParent,
+				 CWOverrideRedirect, &attr);
+	XMapWindow(c->dpy, c->win);
+	XMapWindow(c->dpy, c->other);
+
+	c->gc = XCreateGC(c->dpy, c->win, 0, NULL);
+	c->src = XCreatePixmap(c->dpy, c->win, SIZE, SIZE, depth);
+
+	c->image = XCreateImage(c->dpy, DefaultVisual(c->dpy, DefaultScreen(c->dpy)),
+				depth, ZPixmap, 0, NULL, SIZE, SIZE, 32, 0);
+	c->image->data = malloc(c->image->bytes_per_line * SIZE);
+
+	if (!XShmQueryVersion(c->dpy, &major, &minor, &pixmaps))
+		return 0;
+
+	c->shm_image = XShmCreateImage(c->dpy,
+				       DefaultVisual(c->dpy, DefaultScreen(c->dpy)),
+				       depth, ZPixmap, NULL, &c->shm,
+				       SIZE, SIZE);
+	c->shm.shmid = shmget(IPC_PRIVATE,
+			      c->shm_image->bytes_per_line * SIZE,
+			      IPC_CREAT | 0600);
+	if (c->shm.shmid == -1)
+		return 0;
+
+	c->shm.shmaddr = c->shm_image->data = shmat(c->shm.shmid, NULL, 0);
+	c->shm.readOnly = False;
+	XShmAttach(c->dpy, &c->shm);
+	XSync(c->dpy, False);
+	shmctl(c->shm.shmid, IPC_RMID, NULL);
+
+	return 1;
+}
+
+int main(void)
+{
+	static const unsigned colours[] = {
+		0xff0000, 0x00ff00, 0x0000ff, 0xffff00, 0x00ffff, 0xff00ff,
+	};
+	struct ctx c;
+	int iter, how, delay, ret = 0;
+
+	memset(&c, 0, sizeof(c));
+	c.dpy = XOpenDisplay(NULL);
+	if (c.dpy == NULL)
+		return 77;
+
+	if (!setup(&c)) {
+		printf("MIT-SHM unavailable, skipping\n");
+		return 77;
+	}
+
+	for (delay = 0; delay <= 1; delay++)
+	for (how = 0; how < NUM_DRAW; how++) {
+		int bad = 0;
+
+		printf("Testing GetImage after %s%s: ",
+		       names[how], delay ? ", given time to prefetch" : "");
+		fflush(stdout);
+
+		for (iter = 0; iter < 64; iter++) {
+			unsigned long bg = pixel(&c, colours[iter % 6]);
+			unsigned long fg = pixel(&c, colours[(iter + 1) % 6]);
+			int x = rand() % (SIZE / 2), y = rand() % (SIZE / 2);
+			int w = 1 + rand() % (SIZE / 2), h = 1 + rand() % (SIZE / 2);
+			int n;
+
+			/* a frame, polled once it has had time to settle */
+			draw(&c, FILL, bg, 0, 0, SIZE, SIZE);
+			XSync(c.dpy, False);
+			usleep(20000);
+			bad += check(&c, bg, 0, 0, SIZE, SIZE);
+
+			/* elsewhere on the screen, using up the history */
+			for (n = 0; n < 8; n++) {
+				XSetForeground(c.dpy, c.gc, fg);
+				XFillRectangle(c.dpy, c.other, c.gc, n, n, 16, 16);
+				XSync(c.dpy, False);
+			}
+
+			/* then draw into it and poll again */
+			draw(&c, how, fg, x, y, w, h);
+			XSync(c.dpy, False);
+			if (delay)
+				usleep(20000);
+
+			n = check(&c, fg, x, y, w, h);
+			if (n && !bad)
+				fprintf(stderr, "%s: iteration %d, %d pixels stale in (%d, %d)x(%d, %d)\n",
+					names[how], iter, n, x, y, w, h);
+			bad += n;
+		}
+
+		printf("%s\n", bad ? "FAIL" : "passed");
+		ret |= bad != 0;
+	}
+
+	XShmDetach(c.dpy, &c.shm);
+	shmdt(c.shm.shmaddr);
+	XCloseDisplay(c.dpy);
+	return ret;
+}
@@ -0,0 +1,206 @@
+/*
+ * Checks the placement chosen from a pixmap's access history
+ * (src/sna/sna_residency.h) for the usual patterns: drawn and sampled
+ * only by the GPU, painted only by the CPU, uploaded once and sampled
+ * repeatedly, and read back after every frame; that it holds no opinion
+ * until it has seen a few accesses, does not flip on every other access,
+ * never keeps two copies of a pixmap that may not have them and survives
+ * counts that would overflow.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/sna/sna_residency.h"
+
+#define AREA (256*256) /* of the pixmap */
+
+static const char *names[] = { "any", "cpu", "gpu", "mirror" };
+
+struct step {
+	unsigned side;
+	bool write;
+	uint32_t pixels;
+};
+
+struct pattern {
+	const char *name;
+	struct step steps[4];
+	unsigned expect;
+};
+
+static const struct pattern patterns[] = {
+	{ "GPU only",
+		{ { ACCESS_GPU, true, AREA/4 },
+		  { ACCESS_GPU, false, AREA } },
+		RESIDENCY_GPU },
+	{ "CPU only",
+		{ { ACCESS_CPU, true, AREA/16 },
+		  { ACCESS_CPU, false, AREA/16 } },
+		RESIDENCY_CPU },
+	{ "CPU paints, GPU samples",
+		{ { ACCESS_CPU, true, AREA/16 },
+		  { ACCESS_GPU, false, AREA },
+		  { ACCESS_GPU, false, AREA } },
+		RESIDENCY_MIRROR },
+	{ "GPU draws, CPU reads back",
+		{ { ACCESS_GPU, true, AREA },
+		  { ACCESS_CPU, false, AREA } },
+		RESIDENCY_CPU },
+	{ "GPU draws, CPU reads a little",
+		{ { ACCESS_GPU, true, AREA },
+		  { ACCESS_GPU, true, AREA },
+		  { ACCESS_CPU, false, 64 } },
+		RESIDENCY_GPU },
+	{ "read by both",
+		{ { ACCESS_CPU, false, AREA },
+		  { ACCESS_GPU, false, AREA } },
+		RESIDENCY_MIRROR },
+};
+
+static unsigned run(const struct pattern *p, int repeat,
+		    unsigned residency, bool mirror)
+{
+	struct sna_access a;
+	unsigned n;
+
+	memset(&a, 0, sizeof(a));
+	while (repeat--) {
+		for (n = 0; n < 4 && p->steps[n].pixels; n++) {
+			sna_access_record(&a, p->steps[n].side,
+					  p->steps[n].write,
+					  p->steps[n].pixels);
+			residency = sna_access_residency(&a, residency,
+							 mirror);
+		}
+	}
+
+	return residency;
+}
+
+static int check_patterns(void)
+{
+	unsigned i, r;
+	int ret = 0;
+
+	for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+		r = run(&patterns[i], 16, RESIDENCY_ANY, true);
+		if (r != patterns[i].expect) {
+			fprintf(stderr, "%s: chose %s, expected %s\n",
+				patterns[i].name, names[r],
+				names[patterns[i].expect]);
+			ret = 1;
+		}
+
+		r = run(&patterns[i], 16, RESIDENCY_ANY, false);
+		if (r == RESIDENCY_MIRROR) {
+			fprintf(stderr, "%s: chose mirror when not allowed\n",
+				patterns[i].name);
+			ret = 1;
+		}
+
+		r = run(&patterns[i], 16, RESIDENCY_MIRROR, false);
+		if (r == RESIDENCY_MIRROR) {
+			fprintf(stderr, "%s: kept mirror when no longer allowed\n",
+				patterns[i].name);
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
+
+static int check_warmup(void)
+{
+	struct sna_access a;
+	int n, ret = 0;
+
+	memset(&a, 0, sizeof(a));
+	for (n = 1; n < RESIDENCY_WARMUP; n++) {
+		sna_access_record(&a, ACCESS_GPU, true, AREA);
+		if (sna_access_residency(&a, RESIDENCY_ANY, true) != RESIDENCY_ANY) {
+			fprintf(stderr, "warmup: chose after %d accesses\n", n);
+			ret = 1;
+		}
+	}
+
+	sna_access_record(&a, ACCESS_GPU, true, AREA);
+	if (sna_access_residency(&a, RESIDENCY_ANY, true) != RESIDENCY_GPU) {
+		fprintf(stderr, "warmup: no choice after %d accesses\n", n);
+		ret = 1;
+	}
+
+	return ret;
+}
+
+static int check_hysteresis(void)
+{
+	struct sna_access a;
+	unsigned r = RESIDENCY_ANY, last, flips = 0;
+	int n, ret = 0;
+
+	memset(&a, 0, sizeof(a));
+
+	/* Equal and opposite traffic should settle, not oscillate */
+	for (n = 0; n < 256; n++) {
+		last = r;
+		sna_access_record(&a, n & 1 ? ACCESS_CPU : ACCESS_GPU, true, AREA/4);
+		r = sna_access_residency(&a, r, false);
+		flips += last != RESIDENCY_ANY && r != last;
+	}
+	if (flips > 1) {
+		fprintf(stderr, "hysteresis: flipped %d times\n", flips);
+		ret = 1;
+	}
+
+	/* But a change of habit is followed promptly */
+	for (n = 0; n < 16; n++) {
+		sna_access_record(&a, ACCESS_CPU, true, AREA/4);
+		r = sna_access_residency(&a, r, false);
+	}
+	if (r != RESIDENCY_CPU) {
+		fprintf(stderr, "hysteresis: stuck on %s after 16 CPU writes\n",
+			names[r]);
+		ret = 1;
+	}
+
+	return ret;
+}
+
+static int check_saturation(void)
+{
+	struct sna_access a;
+	unsigned r;
+	int n, ret = 0;
+
+	memset(&a, 0, sizeof(a));
+	for (n = 0; n < 64; n++)
+		sna_access_record(&a, ACCESS_GPU, true, UINT32_MAX);
+	if (a.write[ACCESS_GPU] != UINT32_MAX) {
+		fprintf(stderr, "saturation: wrapped to %u\n", a.write[ACCESS_GPU]);
+		ret = 1;
+	}
+
+	sna_access_record(&a, ACCESS_CPU, false, UINT32_MAX);
+	r = sna_access_residency(&a, RESIDENCY_GPU, true);
+	if (r != RESIDENCY_CPU) {
+		fprintf(stderr, "saturation: chose %s\n", names[r]);
+		ret = 1;
+	}
+
+	return ret;
+}
+
+int main(void)
+{
+	int ret = 0;
+
+	ret |= check_patterns();
+	ret |= check_warmup();
+	ret |= check_hysteresis();
+	ret |= check_saturation();
+
+	printf("%s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
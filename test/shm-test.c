@@ -134,6 +134,89 @@ static int test_subpage(Display *dpy)
 	return !_x_error_occurred;;
 }
 
+static int test_putimage(Display *dpy)
+{
+	const int width = 256;
+	const int height = 64;
+	XShmSegmentInfo shm_in, shm_out;
+	XImage *in, *out;
+	Pixmap pixmap;
+	XGCValues gcv;
+	int frame, x, y, failed = 0;
+	GC gc;
+
+	printf("Reusing %dx%d SHM images for Put/GetImage\n", width, height);
+	_x_error_occurred = 0;
+
+	in = XShmCreateImage(dpy, DefaultVisual(dpy, DefaultScreen(dpy)), 24,
+			     ZPixmap, NULL, &shm_in, width, height);
+	out = XShmCreateImage(dpy, DefaultVisual(dpy, DefaultScreen(dpy)), 24,
+			      ZPixmap, NULL, &shm_out, width, height);
+	if (in == NULL || out == NULL)
+		return 0;
+
+	shm_in.shmid = shmget(IPC_PRIVATE, in->bytes_per_line * height + 64,
+			      IPC_CREAT | 0666);
+	shm_out.shmid = shmget(IPC_PRIVATE, out->bytes_per_line * height,
+			       IPC_CREAT | 0666);
+	if (shm_in.shmid == -1 || shm_out.shmid == -1)
+		return 0;
+
+	/* Offset the source so it does not start on a page boundary */
+	shm_in.shmaddr = shmat(shm_in.shmid, 0, 0);
+	shm_out.shmaddr = shmat(shm_out.shmid, 0, 0);
+	shmctl(shm_in.shmid, IPC_RMID, NULL);
+	shmctl(shm_out.shmid, IPC_RMID, NULL);
+	if (shm_in.shmaddr == (char *) -1 || shm_out.shmaddr == (char *) -1)
+		return 0;
+
+	in->data = shm_in.shmaddr + 64;
+	out->data = shm_out.shmaddr;
+	shm_in.readOnly = True;
+	shm_out.readOnly = False;
+	XShmAttach(dpy, &shm_in);
+	XShmAttach(dpy, &shm_out);
+
+	pixmap = XCreatePixmap(dpy, DefaultRootWindow(dpy), width, height, 24);
+	gcv.graphics_exposures = False;
+	gc = XCreateGC(dpy, pixmap, GCGraphicsExposures, &gcv);
+
+	for (frame = 0; frame < 16 && !failed; frame++) {
+		/* Every frame must see the latest contents of the segment */
+		for (y = 0; y < height; y++)
+			for (x = 0; x < width; x++)
+				XPutPixel(in, x, y, (frame << 16 | y << 8 | x) & 0xffffff);
+
+		XShmPutImage(dpy, pixmap, gc, in, 0, 0, 0, 0, width, height, False);
+		/* and a sub-rectangle, which takes the other path */
+		XShmPutImage(dpy, pixmap, gc, in, 17, 3, 17, 3, 100, 40, False);
+		XShmGetImage(dpy, pixmap, out, 0, 0, AllPlanes);
+		XSync(dpy, False);
+
+		for (y = 0; y < height && !failed; y++)
+			for (x = 0; x < width && !failed; x++)
+				failed = (XGetPixel(out, x, y) & 0xffffff) != (XGetPixel(in, x, y) & 0xffffff);
+	}
+
+	if (_x_error_occurred == 0)
+		_x_error_occurred = failed;
+
+	printf("%s: %s\n", __func__, _x_error_occurred ? "failed" : "passed");
+
+	XFreeGC(dpy, gc);
+	XFreePixmap(dpy, pixmap);
+	XShmDetach(dpy, &shm_in);
+	XShmDetach(dpy, &shm_out);
+	XSync(dpy, False);
+	shmdt(shm_in.shmaddr);
+	shmdt(shm_out.shmaddr);
+	in->data = out->data = NULL;
+	XDestroyImage(in);
+	XDestroyImage(out);
+
+	return !_x_error_occurred;
+}
+
 static int
 _check_error_handler(Display     *display,
 		     XErrorEvent *event)
@@ -166,6 +249,7 @@ int main(void)
 	XSetErrorHandler(_check_error_handler);
 
 	error += test_subpage(dpy);
+	error += test_putimage(dpy);
 
 	return !!error;
 }
@@ -0,0 +1,222 @@
+/*
+ * Replays typical partial-update workloads through the TearFree damage
+ * history used for transformed CRTCs, checking that each reused buffer
+ * ends up identical to the front and reporting how many pixels had to be
+ * repainted per frame for 2, 3 and 4 deep buffering.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/sna/sna_damage_history.h"
+
+#define WIDTH 640
+#define HEIGHT 480
+#define FRAMES 240
+#define MAX_DEPTH 4
+
+struct buffer {
+	uint16_t *pixels;
+	uint32_t frame;
+	int valid;
+};
+
+static uint16_t front[WIDTH * HEIGHT];
+
+static void paint(uint16_t *dst, const uint16_t *src, pixman_region16_t *region)
+{
+	const pixman_box16_t *box;
+	int n, y;
+
+	box = pixman_region_rectangles(region, &n);
+	while (n--) {
+		for (y = box->y1; y < box->y2; y++)
+			memcpy(dst + y * WIDTH + box->x1,
+			       src + y * WIDTH + box->x1,
+			       (box->x2 - box->x1) * sizeof(*dst));
+		box++;
+	}
+}
+
+static uint64_t pixels(pixman_region16_t *region)
+{
+	const pixman_box16_t *box;
+	uint64_t count = 0;
+	int n;
+
+	box = pixman_region_rectangles(region, &n);
+	while (n--) {
+		count += (box->x2 - box->x1) * (box->y2 - box->y1);
+		box++;
+	}
+
+	return count;
+}
+
+static void damage(pixman_region16_t *region, int x, int y, int w, int h)
+{
+	pixman_region16_t r;
+
+	pixman_region_init_rect(&r, x, y, w, h);
+	pixman_region_intersect_rect(&r, &r, 0, 0, WIDTH, HEIGHT);
+	pixman_region_union(region, region, &r);
+	pixman_region_fini(&r);
+}
+
+enum workload { CURSOR, TYPING, SCROLL, VIDEO, SCATTER, FULL };
+
+static const char *workload_name[] = {
+	"cursor blink", "typing", "scrolling window", "video", "scattered", "fullscreen",
+};
+
+static void frame_damage(enum workload w, int frame, pixman_region16_t *region)
+{
+	switch (w) {
+	case CURSOR:
+		damage(region, 200, 150, 2, 16);
+		break;
+	case TYPING:
+		damage(region, 8 * (frame % 70) + 40, 16 * (frame / 70 % 20) + 40, 8, 16);
+		damage(region, 8 * (frame % 70) + 48, 16 * (frame / 70 % 20) + 40, 2, 16);
+		break;
+	case SCROLL:
+		damage(region, 100, 80, 400, 300);
+		break;
+	case VIDEO:
+		damage(region, 160, 120, 320, 240);
+		damage(region, 160, 370, 320, 8);
+		break;
+	case SCATTER:
+		{
+			int n = 1 + rand() % 4;
+			while (n--)
+				damage(region,
+				       rand() % WIDTH, rand() % HEIGHT,
+				       1 + rand() % 64, 1 + rand() % 64);
+		}
+		break;
+	case FULL:
+		damage(region, 0, 0, WIDTH, HEIGHT);
+		break;
+	}
+}
+
+static int run(enum workload w, int depth, uint64_t *copied)
+{
+	struct damage_history history;
+	struct buffer buf[MAX_DEPTH];
+	int frame, shown = -1, n;
+
+	srand(w);
+	damage_history_init(&history);
+	memset(buf, 0, sizeof(buf));
+	for (n = 0; n < depth; n++) {
+		buf[n].pixels = malloc(WIDTH * HEIGHT * sizeof(uint16_t));
+		if (buf[n].pixels == NULL)
+			return 0;
+	}
+
+	*copied = 0;
+	for (frame = 1; frame <= FRAMES; frame++) {
+		pixman_region16_t region;
+		uint32_t since;
+		int best = -1, empty = -1;
+
+		/* update the front; every pixel records when it was drawn */
+		pixman_region_init(&region);
+		frame_damage(w, frame, &region);
+		{
+			const pixman_box16_t *box;
+			int i, x, y;
+
+			box = pixman_region_rectangles(&region, &i);
+			while (i--) {
+				for (y = box->y1; y < box->y2; y++)
+					for (x = box->x1; x < box->x2; x++)
+						front[y * WIDTH + x] = frame;
+				box++;
+			}
+		}
+
+		/* as sna_crtc_get_scanout(), the newest idle buffer wins */
+		for (n = 0; n < depth; n++) {
+			if (!buf[n].valid) {
+				if (empty < 0)
+					empty = n;
+				continue;
+			}
+			if (n == shown)
+				continue;
+			if (best < 0 || (int32_t)(buf[n].frame - buf[best].frame) > 0)
+				best = n;
+		}
+		/* pretend the GPU is occasionally still busy with it */
+		if (best >= 0 && empty >= 0 && rand() % 4 == 0)
+			best = -1;
+		if (best < 0) {
+			best = empty;
+			buf[best].valid = 1;
+			buf[best].frame = 0;
+			memset(buf[best].pixels, 0xff, WIDTH * HEIGHT * sizeof(uint16_t));
+		}
+
+		since = buf[best].frame;
+		buf[best].frame = damage_history_push(&history, &region);
+		if (!damage_history_since(&history, &region, since)) {
+			pixman_region_fini(&region);
+			pixman_region_init_rect(&region, 0, 0, WIDTH, HEIGHT);
+		}
+
+		paint(buf[best].pixels, front, &region);
+		*copied += pixels(&region);
+		pixman_region_fini(&region);
+
+		if (memcmp(buf[best].pixels, front, sizeof(front))) {
+			fprintf(stderr, "%s, depth %d: buffer %d does not match the front on frame %d\n",
+				workload_name[w], depth, best, frame);
+			return 0;
+		}
+		shown = best;
+
+		/* a full modeset forgets everything */
+		if (frame == FRAMES / 2)
+			damage_history_reset(&history);
+	}
+
+	for (n = 0; n < depth; n++)
+		free(buf[n].pixels);
+	damage_history_fini(&history);
+	return 1;
+}
+
+int main(void)
+{
+	enum workload w;
+	int depth, ret = 0;
+
+	memset(front, 0, sizeof(front));
+	printf("%-18s", "pixels per frame");
+	for (depth = 2; depth <= MAX_DEPTH; depth++)
+		printf("   %d buffers", depth);
+	printf("   full copy\n");
+
+	for (w = CURSOR; w <= FULL; w++) {
+		printf("%-18s", workload_name[w]);
+		for (depth = 2; depth <= MAX_DEPTH; depth++) {
+			uint64_t copied;
+
+			memset(front, 0, sizeof(front));
+			if (!run(w, depth, &copied)) {
+				ret = 1;
+				printf("        FAIL");
+				continue;
+			}
+			printf("  %10llu", (unsigned long long)(copied / FRAMES));
+		}
+		printf("  %10u\n", WIDTH * HEIGHT);
+	}
+
+	return ret;
+}
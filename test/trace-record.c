@@ -0,0 +1,822 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Records the requests of real X clients for trace-replay. We listen as a
+ * new local display and pass every connection through to the real one,
+ * writing the core, RENDER, MIT-SHM, Present and XFIXES requests (and
+ * whether the server replied to each) to the trace as they go by.
+ *
+ *   trace-record [-d display] [-o file] [command [args...]]
+ *
+ * Given a command, it is run against us and recording stops when it
+ * exits; otherwise point clients at the display we print and interrupt
+ * us to finish. Only local clients in our byte order are recorded, and
+ * the server has to accept them without a cookie for our display, e.g.
+ * after xhost +si:localuser:$USER.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xproto.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xrender.h>
+
+#include "test.h"
+#include "trace.h"
+
+#define MAX_FDS 16
+#define MAX_CONN 64
+
+static const char *extensions[] = { "RENDER", "MIT-SHM", "Present", "XFIXES" };
+
+static uint8_t recorded[256];
+static int shm_major;
+
+static FILE *trace;
+static struct timespec start;
+static uint64_t requests, bytes;
+static int clients;
+
+static volatile sig_atomic_t done, child_exited;
+
+struct buffer {
+	uint8_t *data;
+	size_t len, size;
+};
+
+struct pending {
+	struct pending *next;
+	uint64_t seq;
+	struct trace_record rec;
+	uint8_t data[];
+};
+
+struct conn {
+	int client, server;
+	int index;
+	int native, setup, reply_setup;
+	struct buffer requests, replies;
+	uint64_t seq, last, sync;
+	struct pending *head, **tail;
+};
+
+static struct conn *conns[MAX_CONN];
+
+static uint16_t read16(const uint8_t *p)
+{
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec - start.tv_sec) * 1000000ull +
+		(ts.tv_nsec - start.tv_nsec) / 1000;
+}
+
+static void buffer_append(struct buffer *b, const void *data, size_t len)
+{
+	if (b->len + len > b->size) {
+		while (b->len + len > b->size)
+			b->size = b->size ? 2 * b->size : 65536;
+		b->data = realloc(b->data, b->size);
+		if (b->data == NULL)
+			die("out of memory\n");
+	}
+
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static void buffer_consume(struct buffer *b, size_t len)
+{
+	b->len -= len;
+	memmove(b->data, b->data + len, b->len);
+}
+
+static void write_record(const struct trace_record *rec, const void *data)
+{
+	if (fwrite(rec, sizeof(*rec), 1, trace) != 1 ||
+	    fwrite(data, rec->length, 1, trace) != 1)
+		die("failed to write the trace: %s\n", strerror(errno));
+
+	if ((rec->flags & TRACE_META) == 0) {
+		requests++;
+		bytes += rec->length;
+	}
+}
+
+static struct pending *queue(struct conn *c, uint64_t seq, int flags,
+			     const void *data, uint32_t len)
+{
+	struct pending *p;
+
+	p = malloc(sizeof(*p) + len);
+	if (p == NULL)
+		die("out of memory\n");
+
+	p->next = NULL;
+	p->seq = seq;
+	p->rec.time = now_us();
+	p->rec.client = c->index;
+	p->rec.flags = flags;
+	p->rec.pad = 0;
+	p->rec.length = len;
+	if (data)
+		memcpy(p->data, data, len);
+
+	*c->tail = p;
+	c->tail = &p->next;
+	return p;
+}
+
+static void queue_meta(struct conn *c, uint64_t seq,
+		       uint32_t type, uint32_t arg0, uint32_t arg1)
+{
+	struct trace_meta meta = { type, { arg0, arg1 } };
+	queue(c, seq, TRACE_META, &meta, sizeof(meta));
+}
+
+/* Once the server has moved past a request, we know whether it replied */
+static void retire(struct conn *c, uint64_t seq, int flags)
+{
+	struct pending *p;
+
+	while ((p = c->head) && p->seq <= seq) {
+		c->head = p->next;
+		if (c->head == NULL)
+			c->tail = &c->head;
+
+		if ((p->rec.flags & TRACE_META) == 0)
+			p->rec.flags |= flags;
+		write_record(&p->rec, p->data);
+		free(p);
+	}
+}
+
+static void record_request(struct conn *c, const uint8_t *p,
+			   uint32_t len, uint32_t hdr)
+{
+	struct pending *r;
+
+	if (p[0] == shm_major && shm_major && p[1] == 1 /* ShmAttach */) {
+		struct shmid_ds ds;
+
+		if (shmctl(read32(p + 8), IPC_STAT, &ds) == 0)
+			queue_meta(c, c->seq, TRACE_SHM_SEGMENT,
+				   read32(p + 4), ds.shm_segsz);
+	}
+
+	/* store BIG-REQUESTS in the normal form */
+	r = queue(c, c->seq, 0, NULL, len - hdr + 4);
+	memcpy(r->data, p, 4);
+	memcpy(r->data + 4, p + hdr, len - hdr);
+	if (hdr != 4)
+		memset(r->data + 2, 0, 2);
+}
+
+static void parse_requests(struct conn *c)
+{
+	struct buffer *b = &c->requests;
+	size_t used = 0;
+
+	while (c->native) {
+		const uint8_t *p = b->data + used;
+		size_t avail = b->len - used;
+		uint32_t len, hdr = 4;
+
+		if (!c->setup) {
+			const uint16_t order = 'l' | 'B' << 8;
+
+			if (avail < 12)
+				break;
+
+			/* 'l' or 'B' as it falls first in memory */
+			if (p[0] != ((const uint8_t *)&order)[0]) {
+				fprintf(stderr, "client %d uses the other byte order, not recorded\n",
+					c->index);
+				c->native = 0;
+				break;
+			}
+
+			len = 12 + ((read16(p + 6) + 3) & ~3) + ((read16(p + 8) + 3) & ~3);
+			if (avail < len)
+				break;
+
+			c->setup = 1;
+			used += len;
+			continue;
+		}
+
+		if (avail < 4)
+			break;
+
+		len = read16(p + 2) * 4;
+		if (len == 0) {
+			if (avail < 8)
+				break;
+
+			len = read32(p + 4) * 4;
+			hdr = 8;
+			if (len < 8) {
+				fprintf(stderr, "client %d sent a bad request, no longer recorded\n",
+					c->index);
+				c->native = 0;
+				break;
+			}
+		}
+		if (avail < len)
+			break;
+
+		c->seq++;
+		if (p[0] < 128 || recorded[p[0]])
+			record_request(c, p, len, hdr);
+
+		used += len;
+	}
+
+	if (c->native)
+		buffer_consume(b, used);
+	else
+		b->len = 0;
+}
+
+static void parse_replies(struct conn *c)
+{
+	struct buffer *b = &c->replies;
+	size_t used = 0;
+
+	while (c->native) {
+		const uint8_t *p = b->data + used;
+		size_t avail = b->len - used;
+		uint64_t seq;
+		uint32_t len;
+
+		if (!c->reply_setup) {
+			if (avail < 8)
+				break;
+
+			len = 8 + read16(p + 6) * 4;
+			if (avail < len)
+				break;
+
+			if (p[0] == 1 && len >= 20) {
+				struct trace_meta meta = {
+					TRACE_CLIENT, { read32(p + 12), read32(p + 16) }
+				};
+				struct trace_record rec = {
+					now_us(), c->index, TRACE_META, 0, sizeof(meta)
+				};
+
+				write_record(&rec, &meta);
+			}
+
+			c->reply_setup = 1;
+			used += len;
+			continue;
+		}
+
+		if (avail < 32)
+			break;
+
+		len = 32;
+		if (p[0] == 1 || (p[0] & 0x7f) == GenericEvent)
+			len += read32(p + 4) * 4;
+		if (avail < len)
+			break;
+
+		used += len;
+		if ((p[0] & 0x7f) == KeymapNotify) /* has no sequence number */
+			continue;
+
+		seq = c->last + (uint16_t)(read16(p + 2) - (uint16_t)c->last);
+		c->last = seq;
+
+		switch (p[0]) {
+		case 0: /* an error, the request is done with */
+			retire(c, seq, 0);
+			break;
+		case 1:
+			if (c->head && c->head->seq <= seq) {
+				struct pending *r;
+
+				for (r = c->head; r && r->seq <= seq; r = r->next)
+					if (r->seq == seq && (r->rec.flags & TRACE_META) == 0)
+						r->rec.flags |= TRACE_REPLY;
+			}
+			retire(c, seq, 0);
+			break;
+		default: /* events may precede the reply of the request */
+			retire(c, seq - 1, 0);
+			break;
+		}
+	}
+
+	if (c->native)
+		buffer_consume(b, used);
+	else
+		b->len = 0;
+}
+
+/* Pass along whatever is waiting, with any file descriptors */
+static ssize_t forward(int from, int to, struct buffer *b)
+{
+	char buf[65536];
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+	} control;
+	struct iovec iov = { buf, sizeof(buf) };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	int fds[MAX_FDS], nfd = 0, n;
+	ssize_t len, sent = 0;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = &control;
+	msg.msg_controllen = sizeof(control);
+
+	do
+		len = recvmsg(from, &msg, MSG_CMSG_CLOEXEC);
+	while (len < 0 && errno == EINTR);
+	if (len <= 0)
+		return len;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+			n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			if (n > MAX_FDS - nfd)
+				n = MAX_FDS - nfd;
+			memcpy(fds + nfd, CMSG_DATA(cmsg), n * sizeof(int));
+			nfd += n;
+		}
+	}
+
+	while (to != -1 && sent < len) {
+		ssize_t ret;
+
+		iov.iov_base = buf + sent;
+		iov.iov_len = len - sent;
+		msg.msg_control = NULL;
+		msg.msg_controllen = 0;
+		if (nfd && sent == 0) {
+			msg.msg_control = &control;
+			msg.msg_controllen = CMSG_SPACE(nfd * sizeof(int));
+			cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(nfd * sizeof(int));
+			memcpy(CMSG_DATA(cmsg), fds, nfd * sizeof(int));
+		}
+
+		ret = sendmsg(to, &msg, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			break; /* the other side is gone, it will tell us */
+		}
+		sent += ret;
+	}
+
+	for (n = 0; n < nfd; n++)
+		close(fds[n]);
+
+	buffer_append(b, buf, len);
+	return len;
+}
+
+static int connect_display(int display)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path),
+		 "/tmp/.X11-unix/X%d", display);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+		return fd;
+
+	/* or the abstract socket of the same name */
+	memmove(addr.sun_path + 1, addr.sun_path, sizeof(addr.sun_path) - 1);
+	addr.sun_path[0] = '\0';
+	if (connect(fd, (struct sockaddr *)&addr,
+		    offsetof(struct sockaddr_un, sun_path) + 1 + strlen(addr.sun_path + 1)) == 0)
+		return fd;
+
+	close(fd);
+	return -1;
+}
+
+static int listen_display(int *display, char *path, int len)
+{
+	struct sockaddr_un addr;
+	int fd, n;
+
+	for (n = 10; n < 64; n++) {
+		char lock[64];
+
+		snprintf(lock, sizeof(lock), "/tmp/.X%d-lock", n);
+		if (access(lock, F_OK) == 0)
+			continue;
+
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			return -1;
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		snprintf(addr.sun_path, sizeof(addr.sun_path),
+			 "/tmp/.X11-unix/X%d", n);
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+		    listen(fd, 8) == 0) {
+			*display = n;
+			snprintf(path, len, "%s", addr.sun_path);
+			return fd;
+		}
+
+		close(fd);
+	}
+
+	return -1;
+}
+
+static void accept_client(int listener, int display)
+{
+	struct conn *c;
+	int fd, n;
+
+	fd = accept(listener, NULL, NULL);
+	if (fd < 0)
+		return;
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	for (n = 0; n < MAX_CONN && conns[n]; n++)
+		;
+	if (n == MAX_CONN || clients == 255) {
+		fprintf(stderr, "too many clients, refusing another\n");
+		close(fd);
+		return;
+	}
+
+	c = calloc(1, sizeof(*c));
+	if (c == NULL)
+		die("out of memory\n");
+
+	c->client = fd;
+	c->server = connect_display(display);
+	if (c->server < 0) {
+		fprintf(stderr, "unable to connect to :%d\n", display);
+		close(fd);
+		free(c);
+		return;
+	}
+
+	c->index = clients++;
+	c->native = 1;
+	c->tail = &c->head;
+	conns[n] = c;
+}
+
+static void close_conn(int n)
+{
+	struct conn *c = conns[n];
+
+	retire(c, (uint64_t)-1, TRACE_UNKNOWN);
+
+	if (c->client != -1)
+		close(c->client);
+	close(c->server);
+	free(c->requests.data);
+	free(c->replies.data);
+	free(c);
+	conns[n] = NULL;
+}
+
+/*
+ * The client has gone: ask the server for one last reply, so that we
+ * learn which of the requests still outstanding had replies of their own.
+ */
+static int client_gone(struct conn *c)
+{
+	uint8_t get_input_focus[4] = { X_GetInputFocus, 0 };
+	const uint16_t length = 1;
+
+	memcpy(get_input_focus + 2, &length, sizeof(length));
+
+	close(c->client);
+	c->client = -1;
+
+	if (!c->native || !c->reply_setup || c->requests.len)
+		return 0;
+
+	if (write(c->server, get_input_focus, sizeof(get_input_focus)) != sizeof(get_input_focus))
+		return 0;
+
+	c->sync = ++c->seq;
+	return 1;
+}
+
+static void signal_handler(int sig)
+{
+	if (sig == SIGCHLD)
+		child_exited = 1;
+	else
+		done = 1;
+}
+
+static void write_header(Display *dpy)
+{
+	struct trace_header h;
+	struct trace_extension ext[ARRAY_SIZE(extensions)];
+	struct trace_visual *visual;
+	struct trace_format *format;
+	XRenderPictFormat *f;
+	XVisualInfo tmpl, *vi;
+	unsigned n;
+	int nvi, major, event, error;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+	h.version = TRACE_VERSION;
+	h.root = DefaultRootWindow(dpy);
+	h.colormap = DefaultColormap(dpy, DefaultScreen(dpy));
+	h.width = DisplayWidth(dpy, DefaultScreen(dpy));
+	h.height = DisplayHeight(dpy, DefaultScreen(dpy));
+
+	memset(ext, 0, sizeof(ext));
+	for (n = 0; n < ARRAY_SIZE(extensions); n++) {
+		if (!XQueryExtension(dpy, extensions[n], &major, &event, &error))
+			continue;
+
+		snprintf(ext[h.n_extensions].name, sizeof(ext[0].name),
+			 "%s", extensions[n]);
+		ext[h.n_extensions++].major = major;
+		recorded[major] = 1;
+		if (strcmp(extensions[n], "MIT-SHM") == 0)
+			shm_major = major;
+	}
+
+	vi = XGetVisualInfo(dpy, VisualNoMask, &tmpl, &nvi);
+	visual = calloc(nvi, sizeof(*visual));
+	for (n = 0; n < (unsigned)nvi; n++) {
+		visual[n].id = vi[n].visualid;
+		visual[n].depth = vi[n].depth;
+		visual[n].class = vi[n].class;
+		visual[n].bits_per_rgb = vi[n].bits_per_rgb;
+		visual[n].red_mask = vi[n].red_mask;
+		visual[n].green_mask = vi[n].green_mask;
+		visual[n].blue_mask = vi[n].blue_mask;
+	}
+	h.n_visuals = nvi;
+	XFree(vi);
+
+	for (n = 0; XRenderFindFormat(dpy, 0, NULL, n); n++)
+		;
+	format = calloc(n, sizeof(*format));
+	for (n = 0; (f = XRenderFindFormat(dpy, 0, NULL, n)); n++) {
+		format[n].id = f->id;
+		format[n].type = f->type;
+		format[n].depth = f->depth;
+		format[n].red = f->direct.red;
+		format[n].red_mask = f->direct.redMask;
+		format[n].green = f->direct.green;
+		format[n].green_mask = f->direct.greenMask;
+		format[n].blue = f->direct.blue;
+		format[n].blue_mask = f->direct.blueMask;
+		format[n].alpha = f->direct.alpha;
+		format[n].alpha_mask = f->direct.alphaMask;
+	}
+	h.n_formats = n;
+
+	if (fwrite(&h, sizeof(h), 1, trace) != 1 ||
+	    fwrite(ext, sizeof(ext[0]), h.n_extensions, trace) != h.n_extensions ||
+	    fwrite(visual, sizeof(*visual), h.n_visuals, trace) != h.n_visuals ||
+	    fwrite(format, sizeof(*format), h.n_formats, trace) != h.n_formats)
+		die("failed to write the trace: %s\n", strerror(errno));
+
+	free(visual);
+	free(format);
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [-d display] [-o file] [command [args...]]\n"
+	       "  -d  the display to record on (default $DISPLAY)\n"
+	       "  -o  the trace to write (default x11.trace)\n",
+	       name);
+}
+
+int main(int argc, char **argv)
+{
+	const char *name = NULL, *output = "x11.trace";
+	char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+	struct sigaction sa;
+	Display *dpy;
+	const char *colon;
+	pid_t child = -1;
+	int listener, upstream, display;
+	int i, n;
+
+	while ((i = getopt(argc, argv, "+d:ho:")) != -1) {
+		switch (i) {
+		case 'd':
+			name = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return i != 'h';
+		}
+	}
+
+	dpy = XOpenDisplay(name);
+	if (dpy == NULL)
+		die("unable to open display %s\n", XDisplayName(name));
+
+	colon = strrchr(DisplayString(dpy), ':');
+	if (colon == NULL ||
+	    (colon != DisplayString(dpy) &&
+	     strncmp(DisplayString(dpy), "unix:", 5)))
+		die("%s is not a local display\n", DisplayString(dpy));
+	upstream = atoi(colon + 1);
+
+	trace = fopen(output, "w");
+	if (trace == NULL)
+		die("unable to open %s: %s\n", output, strerror(errno));
+
+	write_header(dpy);
+	XCloseDisplay(dpy);
+
+	listener = listen_display(&display, path, sizeof(path));
+	if (listener < 0)
+		die("unable to find a free display to listen on\n");
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = signal_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGCHLD, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (optind < argc) {
+		char buf[16];
+
+		child = fork();
+		if (child == 0) {
+			snprintf(buf, sizeof(buf), ":%d", display);
+			setenv("DISPLAY", buf, 1);
+			execvp(argv[optind], argv + optind);
+			die("unable to run %s: %s\n", argv[optind], strerror(errno));
+		}
+		if (child < 0)
+			die("unable to fork: %s\n", strerror(errno));
+	} else
+		printf("Recording clients of :%d to %s, interrupt to finish\n",
+		       display, output);
+
+	while (!done) {
+		struct pollfd pfd[1 + 2 * MAX_CONN];
+		int idx[1 + 2 * MAX_CONN];
+		int nfd = 0, active = 0;
+
+		if (child_exited) {
+			child_exited = 0;
+			if (waitpid(child, NULL, WNOHANG) == child)
+				child = -1;
+		}
+
+		pfd[nfd].fd = listener;
+		pfd[nfd].events = POLLIN;
+		idx[nfd++] = -1;
+		for (n = 0; n < MAX_CONN; n++) {
+			if (conns[n] == NULL)
+				continue;
+
+			active++;
+			if (conns[n]->client != -1) {
+				pfd[nfd].fd = conns[n]->client;
+				pfd[nfd].events = POLLIN;
+				idx[nfd++] = n;
+			}
+			pfd[nfd].fd = conns[n]->server;
+			pfd[nfd].events = POLLIN;
+			idx[nfd++] = n;
+		}
+
+		/* the command and all it started have finished */
+		if (optind < argc && child == -1 && active == 0)
+			break;
+
+		if (poll(pfd, nfd, 1000) <= 0)
+			continue;
+
+		if (pfd[0].revents)
+			accept_client(listener, upstream);
+
+		for (i = 1; i < nfd; i++) {
+			struct conn *c = conns[idx[i]];
+
+			if (c == NULL || pfd[i].revents == 0)
+				continue;
+
+			if (pfd[i].fd == c->client) {
+				if (forward(c->client, c->server, &c->requests) <= 0) {
+					if (!client_gone(c))
+						close_conn(idx[i]);
+					continue;
+				}
+				parse_requests(c);
+			} else {
+				if (forward(c->server, c->client, &c->replies) <= 0) {
+					close_conn(idx[i]);
+					continue;
+				}
+				parse_replies(c);
+				if (c->sync && c->last >= c->sync)
+					close_conn(idx[i]);
+			}
+		}
+	}
+
+	for (n = 0; n < MAX_CONN; n++)
+		if (conns[n])
+			close_conn(n);
+
+	close(listener);
+	unlink(path);
+
+	fclose(trace);
+	printf("Recorded %llu requests (%.1fMB) from %d clients over %.1fs into %s\n",
+	       (unsigned long long)requests, bytes / 1e6, clients,
+	       now_us() / 1e6, output);
+
+	if (child > 0) {
+		kill(child, SIGTERM);
+		waitpid(child, NULL, 0);
+	}
+
+	return 0;
+}
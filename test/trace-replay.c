@@ -0,0 +1,1048 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Replays a session recorded by trace-record against the display under
+ * test, either as fast as it will go or (-r) at the pace it was recorded,
+ * and reports the end-to-end throughput. With -p every request is
+ * followed by a round trip so that the time can be split by request.
+ *
+ *   trace-replay [-d display] [-r] [-p] file
+ *
+ * All the clients of the session are replayed over our one connection,
+ * their resources translated to ones of our own, the recorded root window
+ * to our fullscreen window and the visuals and picture formats to the
+ * nearest equivalent. The contents of shared memory were not recorded,
+ * so MIT-SHM segments are recreated empty, and anything created through
+ * extensions we do not record (DRI3 buffers, SYNC fences, GLX) is not
+ * there to use. The errors that follow are counted, not fatal.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xlibint.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xrender.h>
+#include <X11/extensions/render.h>
+
+#include "test.h"
+#include "trace.h"
+
+enum kind { RES_NONE, RES_XID, RES_VISUAL, RES_FORMAT };
+
+enum list {
+	LIST_NONE,
+	LIST_GLYPHS8,
+	LIST_GLYPHS16,
+	LIST_GLYPHS32,
+	LIST_ANIM_CURSOR,
+	LIST_PRESENT_NOTIFY,
+};
+
+/* Where the resources are in each request we translate */
+struct layout {
+	struct { uint8_t offset, kind; } field[4];
+	uint8_t mask, values; /* offsets of a value-mask and its list */
+	uint32_t resources; /* the bits of the mask that are resources */
+	uint8_t list;
+	uint8_t skip;
+};
+
+#define W(x) { { { 4, RES_XID }, { 8, x } } }
+#define WINDOW W(RES_NONE)
+#define DRAW_GC W(RES_XID)
+
+#define CW_RESOURCES (CWBackPixmap | CWBorderPixmap | CWColormap | CWCursor)
+#define GC_RESOURCES (GCTile | GCStipple | GCFont | GCClipMask)
+#define CP_RESOURCES (CPAlphaMap | CPClipMask)
+
+static const struct layout core[128] = {
+	[X_CreateWindow] = { { { 4, RES_XID }, { 8, RES_XID }, { 24, RES_VISUAL } }, 28, 32, CW_RESOURCES },
+	[X_ChangeWindowAttributes] = { { { 4, RES_XID } }, 8, 12, CW_RESOURCES },
+	[X_GetWindowAttributes] = WINDOW,
+	[X_DestroyWindow] = WINDOW,
+	[X_DestroySubwindows] = WINDOW,
+	[X_ChangeSaveSet] = WINDOW,
+	[X_ReparentWindow] = DRAW_GC,
+	[X_MapWindow] = WINDOW,
+	[X_MapSubwindows] = WINDOW,
+	[X_UnmapWindow] = WINDOW,
+	[X_UnmapSubwindows] = WINDOW,
+	[X_ConfigureWindow] = { { { 4, RES_XID } }, 8, 12, CWSibling },
+	[X_CirculateWindow] = WINDOW,
+	[X_GetGeometry] = WINDOW,
+	[X_QueryTree] = WINDOW,
+	[X_ChangeProperty] = WINDOW,
+	[X_DeleteProperty] = WINDOW,
+	[X_GetProperty] = WINDOW,
+	[X_ListProperties] = WINDOW,
+	[X_SetSelectionOwner] = WINDOW,
+	[X_ConvertSelection] = WINDOW,
+	[X_SendEvent] = WINDOW,
+	[X_GrabPointer] = { .skip = 1 },
+	[X_GrabButton] = { .skip = 1 },
+	[X_GrabKeyboard] = { .skip = 1 },
+	[X_GrabKey] = { .skip = 1 },
+	[X_GrabServer] = { .skip = 1 },
+	[X_UngrabServer] = { .skip = 1 },
+	[X_QueryPointer] = WINDOW,
+	[X_GetMotionEvents] = WINDOW,
+	[X_TranslateCoords] = DRAW_GC,
+	[X_WarpPointer] = { .skip = 1 },
+	[X_SetInputFocus] = { .skip = 1 },
+	[X_OpenFont] = WINDOW,
+	[X_CloseFont] = WINDOW,
+	[X_QueryFont] = WINDOW,
+	[X_QueryTextExtents] = WINDOW,
+	[X_ListFontsWithInfo] = { .skip = 1 }, /* more than one reply */
+	[X_SetFontPath] = { .skip = 1 },
+	[X_CreatePixmap] = DRAW_GC,
+	[X_FreePixmap] = WINDOW,
+	[X_CreateGC] = { { { 4, RES_XID }, { 8, RES_XID } }, 12, 16, GC_RESOURCES },
+	[X_ChangeGC] = { { { 4, RES_XID } }, 8, 12, GC_RESOURCES },
+	[X_CopyGC] = DRAW_GC,
+	[X_SetDashes] = WINDOW,
+	[X_SetClipRectangles] = WINDOW,
+	[X_FreeGC] = WINDOW,
+	[X_ClearArea] = WINDOW,
+	[X_CopyArea] = { { { 4, RES_XID }, { 8, RES_XID }, { 12, RES_XID } } },
+	[X_CopyPlane] = { { { 4, RES_XID }, { 8, RES_XID }, { 12, RES_XID } } },
+	[X_PolyPoint] = DRAW_GC,
+	[X_PolyLine] = DRAW_GC,
+	[X_PolySegment] = DRAW_GC,
+	[X_PolyRectangle] = DRAW_GC,
+	[X_PolyArc] = DRAW_GC,
+	[X_FillPoly] = DRAW_GC,
+	[X_PolyFillRectangle] = DRAW_GC,
+	[X_PolyFillArc] = DRAW_GC,
+	[X_PutImage] = DRAW_GC,
+	[X_GetImage] = WINDOW,
+	[X_PolyText8] = DRAW_GC,
+	[X_PolyText16] = DRAW_GC,
+	[X_ImageText8] = DRAW_GC,
+	[X_ImageText16] = DRAW_GC,
+	[X_CreateColormap] = { { { 4, RES_XID }, { 8, RES_XID }, { 12, RES_VISUAL } } },
+	[X_FreeColormap] = WINDOW,
+	[X_CopyColormapAndFree] = DRAW_GC,
+	[X_InstallColormap] = WINDOW,
+	[X_UninstallColormap] = WINDOW,
+	[X_ListInstalledColormaps] = WINDOW,
+	[X_AllocColor] = WINDOW,
+	[X_AllocNamedColor] = WINDOW,
+	[X_AllocColorCells] = WINDOW,
+	[X_AllocColorPlanes] = WINDOW,
+	[X_FreeColors] = WINDOW,
+	[X_StoreColors] = WINDOW,
+	[X_StoreNamedColor] = WINDOW,
+	[X_QueryColors] = WINDOW,
+	[X_LookupColor] = WINDOW,
+	[X_CreateCursor] = { { { 4, RES_XID }, { 8, RES_XID }, { 12, RES_XID } } },
+	[X_CreateGlyphCursor] = { { { 4, RES_XID }, { 8, RES_XID }, { 12, RES_XID } } },
+	[X_FreeCursor] = WINDOW,
+	[X_RecolorCursor] = WINDOW,
+	[X_QueryBestSize] = WINDOW,
+	[X_ChangeKeyboardMapping] = { .skip = 1 },
+	[X_ChangeKeyboardControl] = { .skip = 1 },
+	[X_Bell] = { .skip = 1 },
+	[X_ChangePointerControl] = { .skip = 1 },
+	[X_SetScreenSaver] = { .skip = 1 },
+	[X_ChangeHosts] = { .skip = 1 },
+	[X_SetAccessControl] = { .skip = 1 },
+	[X_SetCloseDownMode] = { .skip = 1 },
+	[X_KillClient] = { .skip = 1 },
+	[X_ForceScreenSaver] = { .skip = 1 },
+	[X_SetPointerMapping] = { .skip = 1 },
+	[X_SetModifierMapping] = { .skip = 1 },
+};
+
+#define COMPOSITE_GLYPHS(glyphs) \
+	{ { { 8, RES_XID }, { 12, RES_XID }, { 16, RES_FORMAT }, { 20, RES_XID } }, .list = glyphs }
+
+static const struct layout render[] = {
+	[X_RenderQueryPictIndexValues] = { { { 4, RES_FORMAT } } },
+	[X_RenderCreatePicture] = { { { 4, RES_XID }, { 8, RES_XID }, { 12, RES_FORMAT } }, 16, 20, CP_RESOURCES },
+	[X_RenderChangePicture] = { { { 4, RES_XID } }, 8, 12, CP_RESOURCES },
+	[X_RenderSetPictureClipRectangles] = WINDOW,
+	[X_RenderFreePicture] = WINDOW,
+	[X_RenderComposite] = { { { 8, RES_XID }, { 12, RES_XID }, { 16, RES_XID } } },
+	[X_RenderTrapezoids] = { { { 8, RES_XID }, { 12, RES_XID }, { 16, RES_FORMAT } } },
+	[X_RenderTriangles] = { { { 8, RES_XID }, { 12, RES_XID }, { 16, RES_FORMAT } } },
+	[X_RenderTriStrip] = { { { 8, RES_XID }, { 12, RES_XID }, { 16, RES_FORMAT } } },
+	[X_RenderTriFan] = { { { 8, RES_XID }, { 12, RES_XID }, { 16, RES_FORMAT } } },
+	[X_RenderCreateGlyphSet] = W(RES_FORMAT),
+	[X_RenderReferenceGlyphSet] = DRAW_GC,
+	[X_RenderFreeGlyphSet] = WINDOW,
+	[X_RenderAddGlyphs] = WINDOW,
+	[X_RenderFreeGlyphs] = WINDOW,
+	[X_RenderCompositeGlyphs8] = COMPOSITE_GLYPHS(LIST_GLYPHS8),
+	[X_RenderCompositeGlyphs16] = COMPOSITE_GLYPHS(LIST_GLYPHS16),
+	[X_RenderCompositeGlyphs32] = COMPOSITE_GLYPHS(LIST_GLYPHS32),
+	[X_RenderFillRectangles] = { { { 8, RES_XID } } },
+	[X_RenderCreateCursor] = DRAW_GC,
+	[X_RenderSetPictureTransform] = WINDOW,
+	[X_RenderQueryFilters] = WINDOW,
+	[X_RenderSetPictureFilter] = WINDOW,
+	[X_RenderCreateAnimCursor] = { { { 4, RES_XID } }, .list = LIST_ANIM_CURSOR },
+	[X_RenderAddTraps] = WINDOW,
+	[X_RenderCreateSolidFill] = WINDOW,
+	[X_RenderCreateLinearGradient] = WINDOW,
+	[X_RenderCreateRadialGradient] = WINDOW,
+	[X_RenderCreateConicalGradient] = WINDOW,
+};
+
+/* MIT-SHM, whose segments we make ourselves */
+#define SHM_ATTACH 1
+#define SHM_ATTACH_FD 6
+#define SHM_CREATE_SEGMENT 7
+
+static const struct layout shm[] = {
+	[SHM_ATTACH] = WINDOW,
+	[2] = WINDOW, /* Detach */
+	[3] = { { { 4, RES_XID }, { 8, RES_XID }, { 32, RES_XID } } }, /* PutImage */
+	[4] = { { { 4, RES_XID }, { 24, RES_XID } } }, /* GetImage */
+	[5] = { { { 4, RES_XID }, { 8, RES_XID }, { 20, RES_XID } } }, /* CreatePixmap */
+	[SHM_ATTACH_FD] = WINDOW,
+	[SHM_CREATE_SEGMENT] = WINDOW,
+};
+
+#define PRESENT_PIXMAP 1
+
+static const struct layout present[] = {
+	[PRESENT_PIXMAP] = { { { 4, RES_XID }, { 8, RES_XID }, { 16, RES_XID }, { 20, RES_XID } }, .list = LIST_PRESENT_NOTIFY },
+	[2] = WINDOW, /* NotifyMSC */
+	[3] = DRAW_GC, /* SelectInput */
+	[4] = WINDOW, /* QueryCapabilities */
+};
+
+static const struct layout xfixes[] = {
+	[1] = { { { 8, RES_XID } } }, /* ChangeSaveSet */
+	[2] = WINDOW, /* SelectSelectionInput */
+	[3] = WINDOW, /* SelectCursorInput */
+	[5] = WINDOW, /* CreateRegion */
+	[6] = DRAW_GC, /* CreateRegionFromBitmap */
+	[7] = DRAW_GC, /* CreateRegionFromWindow */
+	[8] = DRAW_GC, /* CreateRegionFromGC */
+	[9] = DRAW_GC, /* CreateRegionFromPicture */
+	[10] = WINDOW, /* DestroyRegion */
+	[11] = WINDOW, /* SetRegion */
+	[12] = DRAW_GC, /* CopyRegion */
+	[13] = { { { 4, RES_XID }, { 8, RES_XID }, { 12, RES_XID } } }, /* UnionRegion */
+	[14] = { { { 4, RES_XID }, { 8, RES_XID }, { 12, RES_XID } } }, /* IntersectRegion */
+	[15] = { { { 4, RES_XID }, { 8, RES_XID }, { 12, RES_XID } } }, /* SubtractRegion */
+	[16] = { { { 4, RES_XID }, { 16, RES_XID } } }, /* InvertRegion */
+	[17] = WINDOW, /* TranslateRegion */
+	[18] = DRAW_GC, /* RegionExtents */
+	[19] = WINDOW, /* FetchRegion */
+	[20] = DRAW_GC, /* SetGCClipRegion */
+	[21] = { { { 4, RES_XID }, { 16, RES_XID } } }, /* SetWindowShapeRegion */
+	[22] = DRAW_GC, /* SetPictureClipRegion */
+	[23] = WINDOW, /* SetCursorName */
+	[24] = WINDOW, /* GetCursorName */
+	[26] = DRAW_GC, /* ChangeCursor */
+	[27] = WINDOW, /* ChangeCursorByName */
+	[28] = DRAW_GC, /* ExpandRegion */
+	[29] = WINDOW, /* HideCursor */
+	[30] = WINDOW, /* ShowCursor */
+	[31] = { .skip = 1 }, /* CreatePointerBarrier */
+	[33] = { .skip = 1 }, /* SetClientDisconnectMode */
+};
+
+static const struct {
+	const char *name;
+	const struct layout *layout;
+	unsigned count;
+} known[] = {
+	{ "RENDER", render, ARRAY_SIZE(render) },
+	{ "MIT-SHM", shm, ARRAY_SIZE(shm) },
+	{ "Present", present, ARRAY_SIZE(present) },
+	{ "XFIXES", xfixes, ARRAY_SIZE(xfixes) },
+};
+
+struct extension {
+	char name[24];
+	const struct layout *layout;
+	unsigned count;
+	uint8_t major; /* on our display, 0 if missing */
+};
+
+struct request_stat {
+	uint64_t count, bytes, errors;
+	double time;
+};
+
+struct replay {
+	struct test_display *t;
+	Display *dpy;
+
+	struct trace_header h;
+	struct extension *ext[256]; /* by recorded major */
+	uint8_t recorded[256]; /* recorded major, by ours */
+
+	struct trace_visual *visuals;
+	VisualID *visual_map;
+	struct trace_format *formats;
+	uint32_t *format_map;
+
+	struct { uint32_t base, mask; int valid; } clients[256];
+
+	struct {
+		uint32_t *key, *value;
+		unsigned size, count;
+	} map;
+
+	uint32_t shm_seg, shm_size; /* from the last TRACE_SHM_SEGMENT */
+	struct { int shmid; void *addr; } *segments;
+	int n_segments;
+
+	uint64_t requests, bytes, skipped, errors;
+	struct request_stat stats[256][64];
+};
+
+static struct replay *current;
+
+static uint32_t read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static void write32(uint8_t *p, uint32_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static int error_handler(Display *dpy, XErrorEvent *e)
+{
+	struct replay *r = current;
+
+	r->errors++;
+	r->stats[r->recorded[e->request_code]][e->request_code & 0x80 ? e->minor_code & 63 : 0].errors++;
+	return 0;
+}
+
+static void map_insert(struct replay *r, uint32_t key, uint32_t value);
+
+static void map_grow(struct replay *r)
+{
+	uint32_t *key = r->map.key, *value = r->map.value;
+	unsigned n, size = r->map.size;
+
+	r->map.size = size ? 2 * size : 4096;
+	r->map.count = 0;
+	r->map.key = calloc(r->map.size, sizeof(uint32_t));
+	r->map.value = calloc(r->map.size, sizeof(uint32_t));
+	if (r->map.key == NULL || r->map.value == NULL)
+		die("out of memory\n");
+
+	for (n = 0; n < size; n++)
+		if (key[n])
+			map_insert(r, key[n], value[n]);
+
+	free(key);
+	free(value);
+}
+
+static uint32_t *map_find(struct replay *r, uint32_t key)
+{
+	unsigned n = (key * 0x9e3779b1u) & (r->map.size - 1);
+
+	while (r->map.key[n] && r->map.key[n] != key)
+		n = (n + 1) & (r->map.size - 1);
+
+	return &r->map.key[n];
+}
+
+static void map_insert(struct replay *r, uint32_t key, uint32_t value)
+{
+	uint32_t *slot;
+
+	if (2 * (r->map.count + 1) > r->map.size)
+		map_grow(r);
+
+	slot = map_find(r, key);
+	if (*slot == 0)
+		r->map.count++;
+	*slot = key;
+	r->map.value[slot - r->map.key] = value;
+}
+
+/* A new client took the XIDs of an old one: forget what they were */
+static void map_forget(struct replay *r, uint32_t base, uint32_t mask)
+{
+	uint32_t *key = r->map.key, *value = r->map.value;
+	unsigned n, size = r->map.size;
+
+	r->map.key = r->map.value = NULL;
+	r->map.size = r->map.count = 0;
+	map_grow(r);
+
+	for (n = 0; n < size; n++)
+		if (key[n] && (key[n] & ~mask) != base)
+			map_insert(r, key[n], value[n]);
+
+	free(key);
+	free(value);
+}
+
+static uint32_t translate_xid(struct replay *r, uint32_t xid)
+{
+	unsigned n;
+
+	if (xid == 0)
+		return 0;
+
+	if (xid == r->h.root)
+		return r->t->root;
+	if (xid == r->h.colormap)
+		return DefaultColormap(r->dpy, DefaultScreen(r->dpy));
+
+	for (n = 0; n < ARRAY_SIZE(r->clients); n++) {
+		uint32_t *slot;
+
+		if (!r->clients[n].valid ||
+		    (xid & ~r->clients[n].mask) != r->clients[n].base)
+			continue;
+
+		slot = map_find(r, xid);
+		if (*slot == 0) {
+			map_insert(r, xid, XAllocID(r->dpy));
+			slot = map_find(r, xid);
+		}
+		return r->map.value[slot - r->map.key];
+	}
+
+	return xid; /* predefined, or from a source we cannot follow */
+}
+
+static uint32_t translate_visual(struct replay *r, uint32_t id)
+{
+	unsigned n;
+
+	for (n = 0; n < r->h.n_visuals; n++)
+		if (r->visuals[n].id == id)
+			return r->visual_map[n];
+
+	return id;
+}
+
+static uint32_t translate_format(struct replay *r, uint32_t id)
+{
+	unsigned n;
+
+	for (n = 0; n < r->h.n_formats; n++)
+		if (r->formats[n].id == id)
+			return r->format_map[n];
+
+	return id;
+}
+
+static void translate(struct replay *r, uint8_t *p, uint32_t offset, uint32_t len, int kind)
+{
+	if (offset + 4 > len)
+		return;
+
+	switch (kind) {
+	case RES_XID:
+		write32(p + offset, translate_xid(r, read32(p + offset)));
+		break;
+	case RES_VISUAL:
+		write32(p + offset, translate_visual(r, read32(p + offset)));
+		break;
+	case RES_FORMAT:
+		write32(p + offset, translate_format(r, read32(p + offset)));
+		break;
+	}
+}
+
+static void translate_glyphs(struct replay *r, uint8_t *p, uint32_t len, int size)
+{
+	uint32_t offset = 28;
+
+	while (offset + 8 <= len) {
+		int count = p[offset];
+
+		offset += 8;
+		if (count == 0xff) { /* a change of glyphset */
+			translate(r, p, offset, len, RES_XID);
+			offset += 4;
+		} else
+			offset += (count * size + 3) & ~3;
+	}
+}
+
+/* Make our own segment for the client's, returning its shmid */
+static int shm_segment(struct replay *r, uint32_t seg, uint32_t size)
+{
+	void *addr;
+	int shmid;
+
+	if (size == 0)
+		size = seg == r->shm_seg && r->shm_size ? r->shm_size : (uint32_t)r->t->max_shm_size;
+
+	shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+	if (shmid == -1)
+		return -1;
+
+	addr = shmat(shmid, NULL, 0);
+	if (addr == (void *)-1) {
+		shmctl(shmid, IPC_RMID, NULL);
+		return -1;
+	}
+
+	r->segments = realloc(r->segments, (r->n_segments + 1) * sizeof(*r->segments));
+	if (r->segments == NULL)
+		die("out of memory\n");
+	r->segments[r->n_segments].shmid = shmid;
+	r->segments[r->n_segments].addr = addr;
+	r->n_segments++;
+
+	return shmid;
+}
+
+/*
+ * Rewrite a recorded request for our display; returns 0 if it is to be
+ * skipped. Fills in whether we are to wait for its reply.
+ */
+static int prepare(struct replay *r, uint8_t *p, uint32_t *len, int *reply)
+{
+	const struct layout *l;
+	const struct extension *ext = NULL;
+	uint8_t major = p[0], minor = 0;
+	unsigned n;
+
+	if (major < 128) {
+		l = &core[major];
+	} else {
+		ext = r->ext[major];
+		if (ext == NULL || ext->major == 0)
+			return 0;
+
+		minor = p[1];
+		l = minor < ext->count ? &ext->layout[minor] : NULL;
+		p[0] = ext->major;
+	}
+
+	if (l == NULL)
+		return 1; /* not ours to translate, send as it was */
+
+	if (l->skip)
+		return 0;
+
+	for (n = 0; n < ARRAY_SIZE(l->field) && l->field[n].offset; n++)
+		translate(r, p, l->field[n].offset, *len, l->field[n].kind);
+
+	if (l->mask && l->mask + 4u <= *len) {
+		uint32_t mask = read32(p + l->mask);
+		uint32_t offset = l->values;
+		int bit;
+
+		if (l == &core[X_ConfigureWindow])
+			mask &= 0xffff;
+
+		for (bit = 0; bit < 32; bit++) {
+			if ((mask & (1u << bit)) == 0)
+				continue;
+			if (l->resources & (1u << bit))
+				translate(r, p, offset, *len, RES_XID);
+			offset += 4;
+		}
+	}
+
+	switch (l->list) {
+	case LIST_GLYPHS8:
+		translate_glyphs(r, p, *len, 1);
+		break;
+	case LIST_GLYPHS16:
+		translate_glyphs(r, p, *len, 2);
+		break;
+	case LIST_GLYPHS32:
+		translate_glyphs(r, p, *len, 4);
+		break;
+	case LIST_ANIM_CURSOR:
+		for (n = 8; n + 8 <= *len; n += 8)
+			translate(r, p, n, *len, RES_XID);
+		break;
+	case LIST_PRESENT_NOTIFY:
+		/* no CRTC or fences of ours to wait on */
+		if (*len >= 72)
+			memset(p + 28, 0, 12);
+		for (n = 72; n + 8 <= *len; n += 8)
+			translate(r, p, n, *len, RES_XID);
+		break;
+	}
+
+	if (ext && ext->layout == shm) {
+		int shmid;
+
+		switch (minor) {
+		case SHM_ATTACH:
+			if (*len < 16)
+				return 0;
+			shmid = shm_segment(r, read32(p + 4), 0);
+			if (shmid == -1)
+				return 0;
+			write32(p + 8, shmid);
+			break;
+
+		case SHM_ATTACH_FD:
+		case SHM_CREATE_SEGMENT:
+			/* the fd is long gone, attach a segment instead */
+			if (*len < 12)
+				return 0;
+			shmid = shm_segment(r, read32(p + 4),
+					    minor == SHM_CREATE_SEGMENT ? read32(p + 8) : 0);
+			if (shmid == -1)
+				return 0;
+			p[12] = minor == SHM_CREATE_SEGMENT ? p[12] : p[8];
+			p[13] = p[14] = p[15] = 0;
+			write32(p + 8, shmid);
+			p[1] = SHM_ATTACH;
+			p[2] = 4;
+			p[3] = 0;
+			*len = 16;
+			*reply = 0;
+			break;
+		}
+	}
+
+	return 1;
+}
+
+/* Send a request as it stands, and wait for the reply if there is one */
+static void send_request(Display *dpy, const uint8_t *p, uint32_t len, int reply)
+{
+	xReq *req;
+
+	LockDisplay(dpy);
+
+	req = _XGetRequest(dpy, p[0], len > 8 ? 8 : len);
+	req->data = p[1];
+	if (len > 4)
+		memcpy(req + 1, p + 4, 4);
+	if (len > 8) {
+		unsigned long words = (len - 8) >> 2;
+
+		SetReqLen(req, words, words);
+		Data(dpy, (const char *)p + 8, len - 8);
+	}
+
+	if (reply) {
+		xReply rep;
+
+		if (_XReply(dpy, &rep, 0, xFalse))
+			_XEatDataWords(dpy, rep.generic.length);
+	}
+
+	UnlockDisplay(dpy);
+	SyncHandle();
+}
+
+static int read_record(FILE *file, struct trace_record *rec,
+		       uint8_t **data, uint32_t *size)
+{
+	if (fread(rec, sizeof(*rec), 1, file) != 1)
+		return 0;
+
+	if (rec->length < 4 || rec->length & 3)
+		die("corrupt trace\n");
+
+	/* with room for rewriting requests as larger ones */
+	if (rec->length + 16 > *size) {
+		*size = rec->length + 16;
+		*data = realloc(*data, *size);
+		if (*data == NULL)
+			die("out of memory\n");
+	}
+
+	return fread(*data, rec->length, 1, file) == 1;
+}
+
+static void read_header(struct replay *r, FILE *file)
+{
+	struct trace_extension ext;
+	XVisualInfo tmpl, *vi;
+	unsigned n, k;
+	int nvi;
+
+	if (fread(&r->h, sizeof(r->h), 1, file) != 1 ||
+	    memcmp(r->h.magic, TRACE_MAGIC, sizeof(r->h.magic)) ||
+	    r->h.version != TRACE_VERSION)
+		die("not a trace, or one from a different version\n");
+
+	for (n = 0; n < r->h.n_extensions; n++) {
+		struct extension *e;
+		int major, event, error;
+
+		if (fread(&ext, sizeof(ext), 1, file) != 1)
+			die("corrupt trace\n");
+
+		e = calloc(1, sizeof(*e));
+		if (e == NULL)
+			die("out of memory\n");
+
+		memcpy(e->name, ext.name, sizeof(e->name));
+		e->name[sizeof(e->name) - 1] = '\0';
+		for (k = 0; k < ARRAY_SIZE(known); k++) {
+			if (strcmp(known[k].name, e->name) == 0) {
+				e->layout = known[k].layout;
+				e->count = known[k].count;
+			}
+		}
+
+		if (XQueryExtension(r->dpy, e->name, &major, &event, &error)) {
+			e->major = major;
+			r->recorded[major] = ext.major;
+		} else
+			fprintf(stderr, "%s is missing, its requests will be skipped\n",
+				e->name);
+
+		r->ext[ext.major] = e;
+	}
+	for (n = 0; n < 128; n++)
+		r->recorded[n] = n;
+
+	r->visuals = calloc(r->h.n_visuals, sizeof(*r->visuals));
+	r->visual_map = calloc(r->h.n_visuals, sizeof(*r->visual_map));
+	if (fread(r->visuals, sizeof(*r->visuals), r->h.n_visuals, file) != r->h.n_visuals)
+		die("corrupt trace\n");
+
+	vi = XGetVisualInfo(r->dpy, VisualNoMask, &tmpl, &nvi);
+	for (n = 0; n < r->h.n_visuals; n++) {
+		const struct trace_visual *v = &r->visuals[n];
+
+		r->visual_map[n] = XVisualIDFromVisual(DefaultVisual(r->dpy, DefaultScreen(r->dpy)));
+		for (k = 0; k < (unsigned)nvi; k++) {
+			if (vi[k].depth == v->depth &&
+			    vi[k].class == v->class &&
+			    vi[k].red_mask == v->red_mask &&
+			    vi[k].green_mask == v->green_mask &&
+			    vi[k].blue_mask == v->blue_mask) {
+				r->visual_map[n] = vi[k].visualid;
+				if (vi[k].visualid == v->id)
+					break;
+			}
+		}
+	}
+	XFree(vi);
+
+	r->formats = calloc(r->h.n_formats, sizeof(*r->formats));
+	r->format_map = calloc(r->h.n_formats, sizeof(*r->format_map));
+	if (fread(r->formats, sizeof(*r->formats), r->h.n_formats, file) != r->h.n_formats)
+		die("corrupt trace\n");
+
+	for (n = 0; n < r->h.n_formats; n++) {
+		const struct trace_format *f = &r->formats[n];
+		XRenderPictFormat templ, *match;
+
+		memset(&templ, 0, sizeof(templ));
+		templ.type = f->type;
+		templ.depth = f->depth;
+		templ.direct.red = f->red;
+		templ.direct.redMask = f->red_mask;
+		templ.direct.green = f->green;
+		templ.direct.greenMask = f->green_mask;
+		templ.direct.blue = f->blue;
+		templ.direct.blueMask = f->blue_mask;
+		templ.direct.alpha = f->alpha;
+		templ.direct.alphaMask = f->alpha_mask;
+
+		match = XRenderFindFormat(r->dpy,
+					  PictFormatType | PictFormatDepth |
+					  PictFormatRed | PictFormatRedMask |
+					  PictFormatGreen | PictFormatGreenMask |
+					  PictFormatBlue | PictFormatBlueMask |
+					  PictFormatAlpha | PictFormatAlphaMask,
+					  &templ, 0);
+		r->format_map[n] = match ? match->id : f->id;
+	}
+}
+
+static void meta(struct replay *r, const struct trace_record *rec,
+		 const struct trace_meta *m)
+{
+	unsigned n;
+
+	switch (m->type) {
+	case TRACE_CLIENT:
+		for (n = 0; n < ARRAY_SIZE(r->clients); n++) {
+			if (r->clients[n].valid && r->clients[n].base == m->arg[0]) {
+				r->clients[n].valid = 0;
+				map_forget(r, m->arg[0], m->arg[1]);
+			}
+		}
+		r->clients[rec->client].base = m->arg[0];
+		r->clients[rec->client].mask = m->arg[1];
+		r->clients[rec->client].valid = 1;
+		break;
+
+	case TRACE_SHM_SEGMENT:
+		r->shm_seg = m->arg[0];
+		r->shm_size = m->arg[1];
+		break;
+	}
+}
+
+static const char *request_name(struct replay *r, int major, int minor,
+				char *buf, int len)
+{
+	char key[64];
+
+	if (major < 128) {
+		snprintf(key, sizeof(key), "%d", major);
+		XGetErrorDatabaseText(r->dpy, "XRequest", key, "", buf, len);
+		if (*buf == '\0')
+			snprintf(buf, len, "core %d", major);
+	} else {
+		snprintf(key, sizeof(key), "%s.%d", r->ext[major]->name, minor);
+		XGetErrorDatabaseText(r->dpy, "XRequest", key, "", buf, len);
+		if (*buf == '\0')
+			snprintf(buf, len, "%s %d", r->ext[major]->name, minor);
+	}
+
+	return buf;
+}
+
+struct row {
+	int major, minor;
+	const struct request_stat *stat;
+};
+
+static int profile;
+
+static int cmp_row(const void *a, const void *b)
+{
+	const struct request_stat *x = ((const struct row *)a)->stat;
+	const struct request_stat *y = ((const struct row *)b)->stat;
+
+	if (profile)
+		return x->time < y->time ? 1 : x->time > y->time ? -1 : 0;
+	else
+		return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+static void report(struct replay *r, double recorded, double elapsed)
+{
+	struct row *rows;
+	int major, minor, n = 0, i;
+
+	printf("Replayed %llu requests (%.1fMB) in %.3fs, recorded over %.3fs: %.0f requests/s, %.1fMB/s\n",
+	       (unsigned long long)r->requests, r->bytes / 1e6,
+	       elapsed, recorded,
+	       r->requests / elapsed, r->bytes / 1e6 / elapsed);
+	printf("%llu skipped, %llu errors\n",
+	       (unsigned long long)r->skipped, (unsigned long long)r->errors);
+
+	rows = malloc(256 * 64 * sizeof(*rows));
+	if (rows == NULL)
+		return;
+
+	for (major = 0; major < 256; major++)
+		for (minor = 0; minor < 64; minor++)
+			if (r->stats[major][minor].count) {
+				rows[n].major = major;
+				rows[n].minor = minor;
+				rows[n].stat = &r->stats[major][minor];
+				n++;
+			}
+	qsort(rows, n, sizeof(*rows), cmp_row);
+
+	printf("\n%-32s %10s %10s %8s", "request", "count", "MB", "errors");
+	if (profile)
+		printf(" %10s %10s %6s", "ms", "us/req", "%");
+	printf("\n");
+
+	for (i = 0; i < n; i++) {
+		const struct request_stat *s = rows[i].stat;
+		char name[64];
+
+		printf("%-32s %10llu %10.2f %8llu",
+		       request_name(r, rows[i].major, rows[i].minor, name, sizeof(name)),
+		       (unsigned long long)s->count, s->bytes / 1e6,
+		       (unsigned long long)s->errors);
+		if (profile)
+			printf(" %10.2f %10.2f %5.1f%%",
+			       1e3 * s->time, 1e6 * s->time / s->count,
+			       100 * s->time / elapsed);
+		printf("\n");
+	}
+
+	free(rows);
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [-d display] [-r] [-p] file\n"
+	       "  -r  replay at the pace it was recorded\n"
+	       "  -p  time each request with a round trip\n",
+	       name);
+}
+
+int main(int argc, char **argv)
+{
+	struct test test;
+	struct replay *r;
+	struct trace_record rec;
+	struct timespec tv;
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	uint64_t first = -1, last = 0;
+	double start, elapsed;
+	int realtime = 0;
+	FILE *file;
+	int i;
+
+	while ((i = getopt(argc, argv, "d:hpr")) != -1) {
+		switch (i) {
+		case 'd': /* for test_init() */
+			break;
+		case 'p':
+			profile = 1;
+			break;
+		case 'r':
+			realtime = 1;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return i != 'h';
+		}
+	}
+	if (optind + 1 != argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	file = fopen(argv[optind], "r");
+	if (file == NULL)
+		die("unable to open %s\n", argv[optind]);
+
+	test_init(&test, argc, argv);
+
+	r = calloc(1, sizeof(*r));
+	if (r == NULL)
+		die("out of memory\n");
+	r->t = &test.out;
+	r->dpy = test.out.dpy;
+	map_grow(r);
+
+	read_header(r, file);
+
+	current = r;
+	XSetErrorHandler(error_handler);
+	XSync(r->dpy, False);
+
+	start = now();
+	test_timer_start(r->t, &tv);
+	while (read_record(file, &rec, &data, &size)) {
+		struct request_stat *s;
+		int major = data[0], minor;
+		int reply = rec.flags & TRACE_REPLY;
+		uint32_t len = rec.length;
+		double then = 0;
+
+		if (rec.flags & TRACE_META) {
+			if (len >= sizeof(struct trace_meta))
+				meta(r, &rec, (const struct trace_meta *)data);
+			continue;
+		}
+
+		minor = major & 0x80 ? data[1] & 63 : 0;
+		if (rec.flags & TRACE_UNKNOWN || !prepare(r, data, &len, &reply)) {
+			r->skipped++;
+			continue;
+		}
+
+		if (first == (uint64_t)-1)
+			first = rec.time;
+		last = rec.time;
+
+		if (realtime) {
+			double due = start + (rec.time - first) / 1e6;
+
+			if (now() < due) {
+				struct timespec ts;
+
+				XFlush(r->dpy);
+				due -= now();
+				ts.tv_sec = due;
+				ts.tv_nsec = (due - ts.tv_sec) * 1e9;
+				nanosleep(&ts, NULL);
+			}
+		}
+
+		if (profile)
+			then = now();
+
+		send_request(r->dpy, data, len, reply);
+
+		if (profile) {
+			XSync(r->dpy, False);
+			r->stats[major][minor].time += now() - then;
+		}
+
+		s = &r->stats[major][minor];
+		s->count++;
+		s->bytes += len;
+		r->requests++;
+		r->bytes += len;
+
+		/* the events our clients asked for */
+		if ((r->requests & 255) == 0 || profile) {
+			while (XPending(r->dpy)) {
+				XEvent ev;
+				XNextEvent(r->dpy, &ev);
+			}
+		}
+	}
+	elapsed = test_timer_stop(r->t, &tv);
+	fclose(file);
+
+	XSync(r->dpy, False);
+	for (i = 0; i < r->n_segments; i++) {
+		shmdt(r->segments[i].addr);
+		shmctl(r->segments[i].shmid, IPC_RMID, NULL);
+	}
+
+	report(r, first == (uint64_t)-1 ? 0 : (last - first) / 1e6, elapsed);
+	return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/*
+ * The file written by trace-record and read back by trace-replay.
+ *
+ * A header describing the server the session was recorded on (so that
+ * its root window, visuals, picture formats and extension opcodes can be
+ * translated to those of the display the trace is replayed against),
+ * followed by one record per request in the order the server saw them,
+ * each with the request exactly as sent by the client. Requests using
+ * BIG-REQUESTS are stored in the normal form, with the length taken from
+ * the record rather than the request header. Everything is in host byte
+ * order.
+ */
+
+#define TRACE_MAGIC "XTRACE\0\1"
+#define TRACE_VERSION 1
+
+struct trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t root, colormap;
+	uint16_t width, height;
+	uint32_t n_extensions, n_visuals, n_formats;
+};
+
+/* The extensions we record, and their major opcodes on that server */
+struct trace_extension {
+	char name[24];
+	uint8_t major;
+	uint8_t pad[3];
+};
+
+struct trace_visual {
+	uint32_t id;
+	uint8_t depth, class;
+	uint16_t bits_per_rgb;
+	uint32_t red_mask, green_mask, blue_mask;
+};
+
+struct trace_format {
+	uint32_t id;
+	uint8_t type, depth;
+	uint16_t red, red_mask;
+	uint16_t green, green_mask;
+	uint16_t blue, blue_mask;
+	uint16_t alpha, alpha_mask;
+	uint16_t pad;
+};
+
+#define TRACE_REPLY 0x1 /* the server replied */
+#define TRACE_UNKNOWN 0x2 /* the client went away before we could tell */
+#define TRACE_META 0x80 /* a struct trace_meta, not a request */
+
+struct trace_record {
+	uint64_t time; /* us since recording began */
+	uint8_t client;
+	uint8_t flags;
+	uint16_t pad;
+	uint32_t length; /* bytes that follow, a multiple of 4 */
+};
+
+enum trace_meta_type {
+	TRACE_CLIENT, /* a connection was accepted: its XID range */
+	TRACE_SHM_SEGMENT, /* the size of the segment attached next */
+};
+
+struct trace_meta {
+	uint32_t type;
+	uint32_t arg[2];
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * Checks the software vblank clock used for fake vblanks (sna_present.c)
+ * when a CRTC has no hardware vblank: that it runs at the exact refresh of
+ * the mode without accumulating rounding, that every deadline it hands out
+ * falls on the vblank it was asked for, that real vblanks re-anchor it and
+ * that the count carries on across a mode change. Also shows how far the
+ * millisecond OsTimer it replaces would have drifted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/sna/sna_vblank_clock.h"
+
+struct mode {
+	const char *name;
+	unsigned htotal, vtotal, clock;
+};
+
+static const struct mode modes[] = {
+	{ "1920x1080@60", 2200, 1125, 148500 },
+	{ "1920x1080@59.94", 2200, 1125, 148352 },
+	{ "1920x1080@120", 2080, 1144, 285550 },
+	{ "2560x1440@144", 2720, 1525, 597370 },
+	{ "3840x2160@60", 4400, 2250, 594000 },
+	{ "7680x4320@60", 8800, 4500, 2376000 },
+	{ "no mode", 0, 0, 0 },
+};
+
+#define START 123456789012345ull
+
+static double period_ns(const struct mode *m)
+{
+	if (m->clock == 0)
+		return 1e9 / 60;
+
+	return (double)m->htotal * m->vtotal * 1e6 / m->clock;
+}
+
+static int check_mode(const struct mode *m)
+{
+	static const uint64_t frames[] = {
+		0, 1, 2, 59, 60, 61, 1000, 123457, 1000003,
+		1ull << 32, (1ull << 32) + 17, 1ull << 36,
+	};
+	struct vblank_clock c;
+	double period = period_ns(m);
+	long double worst = 0;
+	uint64_t ms_drift;
+	unsigned i;
+	int ret = 0;
+
+	vblank_clock_init(&c, START);
+	vblank_clock_set_mode(&c, START, m->htotal, m->vtotal, m->clock);
+
+	for (i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+		uint64_t msc = frames[i], t;
+		long double exact, err;
+
+		t = vblank_clock_time(&c, msc);
+		exact = START + (long double)msc * m->htotal * m->vtotal * 1e6 / m->clock;
+		if (m->clock == 0)
+			exact = START + (long double)msc * 1e9 / 60;
+
+		err = t - exact;
+		if (err < -exact * 1e-18L || err >= 1 + exact * 1e-18L) {
+			fprintf(stderr, "%s: vblank %llu at %llu, expected %.1Lf\n",
+				m->name, (unsigned long long)msc,
+				(unsigned long long)t, exact);
+			ret = 1;
+		}
+		if (err > worst)
+			worst = err;
+
+		if (vblank_clock_msc(&c, t) != msc) {
+			fprintf(stderr, "%s: deadline for %llu wakes at %llu\n",
+				m->name, (unsigned long long)msc,
+				(unsigned long long)vblank_clock_msc(&c, t));
+			ret = 1;
+		}
+		if (msc && vblank_clock_msc(&c, t - 1) != msc - 1) {
+			fprintf(stderr, "%s: %llu began early\n",
+				m->name, (unsigned long long)msc);
+			ret = 1;
+		}
+	}
+
+	/* As msc_to_delay() did, whole milliseconds per frame */
+	ms_drift = (uint64_t)(3600e9 / period) * (uint64_t)(period / 1e6) * 1000000;
+	printf("%s: period %.3fus, off by at most %.1Lfns; rounded to ms, %.1fs adrift after an hour\n",
+	       m->name, period / 1e3, worst,
+	       (3600e9 - ms_drift) / 1e9);
+
+	return ret;
+}
+
+static int check_sync(void)
+{
+	struct vblank_clock c;
+	uint64_t ust, t, msc;
+	int ret = 0;
+
+	vblank_clock_init(&c, START);
+	vblank_clock_set_mode(&c, START, 2200, 1125, 148500);
+
+	/* the hardware reports vblank 1000 a little late */
+	ust = START / 1000 + 1000 * 16667 + 250;
+	vblank_clock_sync(&c, 1000, ust);
+	if (vblank_clock_time(&c, 1000) != ust * 1000) {
+		fprintf(stderr, "sync: vblank not re-anchored\n");
+		ret = 1;
+	}
+	t = vblank_clock_time(&c, 1001);
+	if (t - ust * 1000 != 16666667) {
+		fprintf(stderr, "sync: next vblank %lluns later\n",
+			(unsigned long long)(t - ust * 1000));
+		ret = 1;
+	}
+	if (vblank_clock_msc(&c, ust * 1000 - 1) != 1000) {
+		fprintf(stderr, "sync: went backwards\n");
+		ret = 1;
+	}
+
+	/* switch to 144Hz halfway through frame 1010 */
+	t = vblank_clock_time(&c, 1010) + 8000000;
+	vblank_clock_set_mode(&c, t, 2720, 1525, 597370);
+	msc = vblank_clock_msc(&c, t);
+	if (msc != 1010) {
+		fprintf(stderr, "mode change: msc jumped from 1010 to %llu\n",
+			(unsigned long long)msc);
+		ret = 1;
+	}
+	t = vblank_clock_time(&c, 1012) - vblank_clock_time(&c, 1011);
+	if (t < 6943000 || t > 6944000) {
+		fprintf(stderr, "mode change: period is now %lluns\n",
+			(unsigned long long)t);
+		ret = 1;
+	}
+
+	return ret;
+}
+
+int main(void)
+{
+	unsigned i;
+	int ret = 0;
+
+	for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+		ret |= check_mode(&modes[i]);
+	ret |= check_sync();
+
+	printf("%s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
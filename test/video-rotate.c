@@ -0,0 +1,290 @@
+/*
+ * Checks the tiled rotation kernels used for the rotated Xv uploads
+ * (overlay and sprites) against the original per-pixel loops from
+ * sna_video.c, for the planar luma/chroma, interleaved CbCr and packed
+ * 4:2:2 layouts under every rotation, for each implementation this CPU
+ * supports.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/sna/rotate.h"
+
+#define MAX_SIZE 300
+
+static void ref_plane(uint8_t *dst, const uint8_t *src,
+		      int dstPitch, int srcPitch, int w, int h, int angle)
+{
+	const uint8_t *s;
+	int i, j, x = 0;
+
+	switch (angle) {
+	case 90:
+		for (i = 0; i < h; i++) {
+			s = src;
+			for (j = 0; j < w; j++)
+				dst[i + ((x + w - j - 1) * dstPitch)] = *s++;
+			src += srcPitch;
+		}
+		break;
+	case 180:
+		for (i = 0; i < h; i++) {
+			s = src;
+			for (j = 0; j < w; j++) {
+				dst[(x + w - j - 1) +
+				    ((h - i - 1) * dstPitch)] = *s++;
+			}
+			src += srcPitch;
+		}
+		break;
+	case 270:
+		for (i = 0; i < h; i++) {
+			s = src;
+			for (j = 0; j < w; j++) {
+				dst[(h - i - 1) + (x + j * dstPitch)] = *s++;
+			}
+			src += srcPitch;
+		}
+		break;
+	}
+}
+
+static void ref_cbcr_plane(uint16_t *dst, const uint16_t *src,
+			   int dstPitch, int srcPitch, int w, int h, int angle)
+{
+	const uint16_t *s;
+	int i, j, x = 0;
+
+	switch (angle) {
+	case 90:
+		for (i = 0; i < h; i++) {
+			s = src;
+			for (j = 0; j < w; j++)
+				dst[i + ((x + w - j - 1) * dstPitch)] = *s++;
+			src += srcPitch;
+		}
+		break;
+	case 180:
+		for (i = 0; i < h; i++) {
+			s = src;
+			for (j = 0; j < w; j++) {
+				dst[(x + w - j - 1) +
+				    ((h - i - 1) * dstPitch)] = *s++;
+			}
+			src += srcPitch;
+		}
+		break;
+	case 270:
+		for (i = 0; i < h; i++) {
+			s = src;
+			for (j = 0; j < w; j++) {
+				dst[(h - i - 1) + (x + j * dstPitch)] = *s++;
+			}
+			src += srcPitch;
+		}
+		break;
+	}
+}
+
+static void ref_packed(uint8_t *dst, const uint8_t *buf,
+		       int dst_pitch, int pitch, int w, int h, int angle)
+{
+	const uint8_t *src = buf, *s;
+	int i, j;
+
+	switch (angle) {
+	case 90:
+		h <<= 1;
+		for (i = 0; i < h; i += 2) {
+			s = src;
+			for (j = 0; j < w; j++) {
+				/* Copy Y */
+				dst[(i + 0) + ((w - j - 1) * dst_pitch)] = *s;
+				s += 2;
+			}
+			src += pitch;
+		}
+		h >>= 1;
+		src = buf;
+		for (i = 0; i < h; i += 2) {
+			for (j = 0; j < w; j += 2) {
+				/* Copy U */
+				dst[((i * 2) + 1) + ((w - j - 1) * dst_pitch)] = src[(j * 2) + 1 + (i * pitch)];
+				dst[((i * 2) + 1) + ((w - j - 2) * dst_pitch)] = src[(j * 2) + 1 + ((i + 1) * pitch)];
+				/* Copy V */
+				dst[((i * 2) + 3) + ((w - j - 1) * dst_pitch)] = src[(j * 2) + 3 + (i * pitch)];
+				dst[((i * 2) + 3) + ((w - j - 2) * dst_pitch)] = src[(j * 2) + 3 + ((i + 1) * pitch)];
+			}
+		}
+		break;
+	case 180:
+		w <<= 1;
+		for (i = 0; i < h; i++) {
+			s = src;
+			for (j = 0; j < w; j += 4) {
+				dst[(w - j - 4) + ((h - i - 1) * dst_pitch)] = *s++;
+				dst[(w - j - 3) + ((h - i - 1) * dst_pitch)] = *s++;
+				dst[(w - j - 2) + ((h - i - 1) * dst_pitch)] = *s++;
+				dst[(w - j - 1) + ((h - i - 1) * dst_pitch)] = *s++;
+			}
+			src += pitch;
+		}
+		break;
+	case 270:
+		h <<= 1;
+		for (i = 0; i < h; i += 2) {
+			s = src;
+			for (j = 0; j < w; j++) {
+				/* Copy Y */
+				dst[(h - i - 2) + (j * dst_pitch)] = *s;
+				s += 2;
+			}
+			src += pitch;
+		}
+		h >>= 1;
+		src = buf;
+		for (i = 0; i < h; i += 2) {
+			for (j = 0; j < w; j += 2) {
+				/* Copy U */
+				dst[(((h - i) * 2) - 3) + (j * dst_pitch)] = src[(j * 2) + 1 + (i * pitch)];
+				dst[(((h - i) * 2) - 3) + ((j + 1) * dst_pitch)] = src[(j * 2) + 1 + ((i + 1) * pitch)];
+				/* Copy V */
+				dst[(((h - i) * 2) - 1) + (j * dst_pitch)] = src[(j * 2) + 3 + (i * pitch)];
+				dst[(((h - i) * 2) - 1) + ((j + 1) * dst_pitch)] = src[(j * 2) + 3 + ((i + 1) * pitch)];
+			}
+		}
+		break;
+	}
+}
+
+/* As sna_rotate_plane() */
+static void rotate_plane(const void *src, void *dst, int bpp,
+			 int src_pitch, int dst_pitch,
+			 int w, int h, int angle)
+{
+	int sx, sy, step[4];
+
+	rotate_blt_angle(angle, w, h, &sx, &sy, step);
+	if (angle == 90 || angle == 270) {
+		int t = w;
+		w = h;
+		h = t;
+	}
+
+	rotate_blt(src, dst, bpp, src_pitch, dst_pitch,
+		   sx, sy, 0, 0, w, h, step);
+}
+
+enum layout { PLANE, CBCR, PACKED };
+
+static const char *layout_name[] = { "plane", "cbcr", "packed" };
+
+static int check(enum layout layout, int w, int h, int angle,
+		 const uint8_t *src, uint8_t *ref, uint8_t *out)
+{
+	int cpp = layout == PLANE ? 1 : layout == CBCR ? 2 : 4;
+	int src_w = layout == PACKED ? w / 2 : w;
+	int src_pitch = (src_w * cpp + 7) & ~7;
+	int dst_w = angle == 180 ? w : h;
+	int dst_h = angle == 180 ? h : w;
+	int dst_pitch, size;
+
+	dst_pitch = dst_w * (layout == PACKED ? 2 : cpp);
+	dst_pitch = (dst_pitch + 64 + 63) & ~63;
+	size = dst_pitch * dst_h;
+
+	memset(ref, 0x5a, size);
+	memset(out, 0x5a, size);
+
+	switch (layout) {
+	case PLANE:
+		ref_plane(ref, src, dst_pitch, src_pitch, w, h, angle);
+		rotate_plane(src, out, 8, src_pitch, dst_pitch, w, h, angle);
+		break;
+	case CBCR:
+		ref_cbcr_plane((uint16_t *)ref, (const uint16_t *)src,
+			       dst_pitch / 2, src_pitch / 2, w, h, angle);
+		rotate_plane(src, out, 16, src_pitch, dst_pitch, w, h, angle);
+		break;
+	case PACKED:
+		ref_packed(ref, src, dst_pitch, src_pitch, w, h, angle);
+		if (angle == 180)
+			rotate_plane(src, out, 32, src_pitch, dst_pitch,
+				     w / 2, h, angle);
+		else
+			rotate_yuy2(src, out, src_pitch, dst_pitch, w, h, angle);
+		break;
+	}
+
+	if (memcmp(ref, out, size)) {
+		int x, y;
+
+		for (y = 0; y < dst_h; y++)
+			for (x = 0; x < dst_pitch; x++)
+				if (ref[y * dst_pitch + x] != out[y * dst_pitch + x]) {
+					fprintf(stderr, "%s: %s %dx%d rotated by %d differs at byte (%d, %d)\n",
+						rotate_blt_name(), layout_name[layout],
+						w, h, angle, x, y);
+					return 0;
+				}
+	}
+
+	return 1;
+}
+
+int main(void)
+{
+	static const int sizes[][2] = {
+		{ 2, 2 }, { 4, 2 }, { 6, 10 }, { 16, 16 }, { 18, 34 },
+		{ 32, 32 }, { 64, 48 }, { 66, 130 }, { 176, 144 },
+		{ 256, 8 }, { 8, 256 }, { 298, 290 },
+	};
+	static const int angles[] = { 90, 180, 270 };
+	unsigned flags[2] = { 0 }, nflags = 1;
+	uint8_t *src, *ref, *out;
+	unsigned f, i, a;
+	enum layout l;
+	int ret = 0;
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		flags[nflags++] = ROTATE_SSE2;
+#endif
+
+	src = malloc(MAX_SIZE * MAX_SIZE * 4);
+	ref = malloc((MAX_SIZE + 64) * MAX_SIZE * 4);
+	out = malloc((MAX_SIZE + 64) * MAX_SIZE * 4);
+	if (!src || !ref || !out)
+		return 1;
+
+	srand(0);
+	for (i = 0; i < MAX_SIZE * MAX_SIZE * 4; i++)
+		src[i] = rand();
+
+	for (f = 0; f < nflags; f++) {
+		int tests = 0, failed = 0;
+
+		rotate_blt_init(flags[f]);
+		for (l = PLANE; l <= PACKED; l++)
+			for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+				for (a = 0; a < sizeof(angles)/sizeof(angles[0]); a++) {
+					tests++;
+					if (!check(l, sizes[i][0], sizes[i][1], angles[a],
+						   src, ref, out))
+						failed++;
+				}
+
+		printf("%s: %d/%d passed\n", rotate_blt_name(), tests - failed, tests);
+		if (failed)
+			ret = 1;
+	}
+
+	free(out);
+	free(ref);
+	free(src);
+	return ret;
+}
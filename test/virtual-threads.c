@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "config.h"
+
+/*
+ * Runs intel-virtual-output -t with two Xvfb servers as its targets and
+ * checks that what is drawn over each VIRTUAL output of the source reaches
+ * its target, frame after frame, and that a target is repainted when part
+ * of it is exposed. The workers sending to the targets read the targets'
+ * events into Xlib's queue whilst the main loop sleeps, so the latter
+ * must be told to look (see worker_run() in tools/virtual.c).
+ *
+ * Needs a source display with two VIRTUAL outputs, i.e. the intel driver
+ * with Option "VirtualHeads", plus Xvfb and xrandr; skipped otherwise.
+ * The tool is found through $INTEL_VIRTUAL_OUTPUT, or in ../tools.
+ */
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xrandr.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#define WIDTH 640
+#define HEIGHT 480
+#define TIMEOUT 2000 /* ms for an update to reach a target */
+
+struct target {
+	pid_t pid;
+	char name[16];
+	Display *dpy;
+	char output[64]; /* the VIRTUAL output on the source */
+	int x, y;
+};
+
+static int spawn(const char *const argv[], int fd)
+{
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		int null = open("/dev/null", 0);
+		dup2(null, 0);
+		if (fd != 1)
+			dup2(null, 1);
+		execvp(argv[0], (char **)argv);
+		_exit(127);
+	}
+
+	return pid;
+}
+
+/* Let Xvfb pick a free display and tell us which (-displayfd) */
+static int start_xvfb(struct target *t)
+{
+	char fd[16], buf[16];
+	int p[2], len = 0, n;
+	const char *argv[] = {
+		"Xvfb", "-displayfd", fd,
+		"-screen", "0", "640x480x24",
+		"-nolisten", "tcp", NULL
+	};
+
+	if (pipe(p))
+		return 0;
+
+	sprintf(fd, "%d", p[1]);
+	t->pid = spawn(argv, p[1]);
+	close(p[1]);
+	if (t->pid < 0) {
+		close(p[0]);
+		return 0;
+	}
+
+	while (len < (int)sizeof(buf) - 1 &&
+	       (n = read(p[0], buf + len, sizeof(buf) - 1 - len)) > 0) {
+		len += n;
+		if (buf[len-1] == '\n')
+			break;
+	}
+	close(p[0]);
+	if (len == 0)
+		return 0;
+
+	buf[len] = '\0';
+	snprintf(t->name, sizeof(t->name), ":%d", atoi(buf));
+	t->dpy = XOpenDisplay(t->name);
+	return t->dpy != NULL;
+}
+
+static void stop(pid_t pid)
+{
+	if (pid > 0) {
+		kill(pid, SIGTERM);
+		waitpid(pid, NULL, 0);
+	}
+}
+
+/* The VIRTUAL outputs with a mode, i.e. those connected to a target */
+static int find_outputs(Display *dpy, struct target *t, int count)
+{
+	XRRScreenResources *res;
+	int i, n = 0;
+
+	res = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
+	if (res == NULL)
+		return 0;
+
+	for (i = 0; i < res->noutput && n < count; i++) {
+		XRROutputInfo *output;
+
+		output = XRRGetOutputInfo(dpy, res, res->outputs[i]);
+		if (output == NULL)
+			continue;
+
+		if (strncmp(output->name, "VIRTUAL", 7) == 0 && output->nmode)
+			snprintf(t[n++].output, sizeof(t->output), "%s", output->name);
+
+		XRRFreeOutputInfo(output);
+	}
+
+	XRRFreeScreenResources(res);
+	return n;
+}
+
+static int count_virtual(Display *dpy)
+{
+	XRRScreenResources *res;
+	int i, n = 0;
+
+	res = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
+	if (res == NULL)
+		return 0;
+
+	for (i = 0; i < res->noutput; i++) {
+		XRROutputInfo *output;
+
+		output = XRRGetOutputInfo(dpy, res, res->outputs[i]);
+		if (output == NULL)
+			continue;
+
+		n += strncmp(output->name, "VIRTUAL", 7) == 0;
+		XRRFreeOutputInfo(output);
+	}
+
+	XRRFreeScreenResources(res);
+	return n;
+}
+
+static int xrandr(Display *dpy, const char *output, const char *args)
+{
+	char cmd[1024];
+
+	snprintf(cmd, sizeof(cmd), "xrandr -d %s --output %s %s",
+		 DisplayString(dpy), output, args);
+	return system(cmd) == 0;
+}
+
+static unsigned long alloc_pixel(Display *dpy, unsigned rgb)
+{
+	XColor c;
+
+	c.red = (rgb >> 16 & 0xff) * 0x101;
+	c.green = (rgb >> 8 & 0xff) * 0x101;
+	c.blue = (rgb & 0xff) * 0x101;
+	c.flags = DoRed | DoGreen | DoBlue;
+	XAllocColor(dpy, DefaultColormap(dpy, DefaultScreen(dpy)), &c);
+
+	return c.pixel;
+}
+
+static unsigned read_rgb(Display *dpy, int x, int y)
+{
+	XImage *image;
+	XColor c;
+
+	image = XGetImage(dpy, DefaultRootWindow(dpy), x, y, 1, 1,
+			  AllPlanes, ZPixmap);
+	if (image == NULL)
+		return 0;
+
+	c.pixel = XGetPixel(image, 0, 0);
+	XDestroyImage(image);
+
+	XQueryColor(dpy, DefaultColormap(dpy, DefaultScreen(dpy)), &c);
+	return (c.red >> 8) << 16 | (c.green >> 8) << 8 | c.blue >> 8;
+}
+
+/* Wait for the middle and the corners of the target to become rgb */
+static int wait_for(struct target *t, unsigned rgb)
+{
+	const int x[] = { WIDTH/2, 0, WIDTH-1, 0, WIDTH-1 };
+	const int y[] = { HEIGHT/2, 0, 0, HEIGHT-1, HEIGHT-1 };
+	int ms, i;
+
+	for (ms = 0; ms < TIMEOUT; ms += 10) {
+		for (i = 0; i < 5; i++) {
+			if (read_rgb(t->dpy, x[i], y[i]) != rgb)
+				break;
+		}
+		if (i == 5)
+			return 1;
+
+		usleep(10000);
+	}
+
+	return 0;
+}
+
+static Window cover(Display *dpy, int x, int y, unsigned long pixel)
+{
+	XSetWindowAttributes attr;
+	Window w;
+
+	attr.override_redirect = 1;
+	attr.background_pixel = pixel;
+	w = XCreateWindow(dpy, DefaultRootWindow(dpy),
+			  x, y, WIDTH, HEIGHT, 0,
+			  CopyFromParent, InputOutput, CopyFromParent,
+			  CWOverrideRedirect | CWBackPixel, &attr);
+	XMapWindow(dpy, w);
+	XSync(dpy, False);
+
+	return w;
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned colours[] = {
+		0xff0000, 0x00ff00, 0x0000ff, 0xffff00, 0x00ffff, 0xff00ff,
+	};
+	struct target t[2];
+	const char *ivo;
+	Display *src;
+	Window win[2];
+	pid_t tool;
+	int i, n, frame, ret = 77;
+
+	memset(t, 0, sizeof(t));
+
+	src = XOpenDisplay(argc > 2 && strcmp(argv[1], "-d") == 0 ? argv[2] : NULL);
+	if (src == NULL)
+		return 77;
+
+	if (count_virtual(src) < 2) {
+		printf("No VIRTUAL outputs on %s, skipping\n", DisplayString(src));
+		return 77;
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (!start_xvfb(&t[i])) {
+			printf("Unable to start Xvfb, skipping\n");
+			goto out_xvfb;
+		}
+	}
+
+	ivo = getenv("INTEL_VIRTUAL_OUTPUT") ?: "../tools/intel-virtual-output";
+	{
+		const char *args[] = {
+			ivo, "-t", "-S", "-f", "-d", DisplayString(src),
+			t[0].name, t[1].name, NULL
+		};
+		tool = spawn(args, 1);
+	}
+
+	for (n = 0; n < 500 && find_outputs(src, t, 2) < 2; n++)
+		usleep(10000);
+	if (n == 500) {
+		printf("%s did not connect to %s and %s, skipping\n",
+		       ivo, t[0].name, t[1].name);
+		goto out_tool;
+	}
+
+	/* side by side, past the end of the existing screen */
+	for (i = 0; i < 2; i++) {
+		char pos[64];
+
+		t[i].x = DisplayWidth(src, DefaultScreen(src)) + i * WIDTH;
+		t[i].y = 0;
+		sprintf(pos, "--auto --pos %dx%d", t[i].x, t[i].y);
+		if (!xrandr(src, t[i].output, pos)) {
+			printf("Unable to enable %s, skipping\n", t[i].output);
+			goto out_outputs;
+		}
+	}
+
+	ret = 0;
+	printf("Testing intel-virtual-output -t, %s -> %s, %s -> %s: ",
+	       t[0].output, t[0].name, t[1].output, t[1].name);
+	fflush(stdout);
+
+	/* Every frame reaches every target */
+	for (frame = 0; frame < 32; frame++) {
+		unsigned rgb = colours[frame % 6];
+
+		for (i = 0; i < 2; i++)
+			win[i] = cover(src, t[i].x, t[i].y,
+				       alloc_pixel(src, rgb));
+
+		for (i = 0; i < 2; i++) {
+			if (!wait_for(&t[i], rgb)) {
+				fprintf(stderr, "frame %d: %s not updated to %06x\n",
+					frame, t[i].name, rgb);
+				ret = 1;
+			}
+		}
+
+		for (i = 0; i < 2; i++)
+			XDestroyWindow(src, win[i]);
+	}
+
+	/* and exposures on the target are repainted from the source */
+	for (i = 0; i < 2; i++)
+		win[i] = cover(src, t[i].x, t[i].y, alloc_pixel(src, 0x808080));
+	for (frame = 0; frame < 32; frame++) {
+		for (i = 0; i < 2; i++) {
+			Window w;
+
+			if (!wait_for(&t[i], 0x808080)) {
+				fprintf(stderr, "expose %d: %s not painted\n",
+					frame, t[i].name);
+				ret = 1;
+			}
+
+			/* Uncover the target's root, it is then repainted */
+			w = cover(t[i].dpy, 0, 0,
+				  alloc_pixel(t[i].dpy, colours[frame % 6]));
+			XDestroyWindow(t[i].dpy, w);
+			XSync(t[i].dpy, False);
+		}
+	}
+	for (i = 0; i < 2; i++) {
+		if (!wait_for(&t[i], 0x808080)) {
+			fprintf(stderr, "expose: %s not repainted\n", t[i].name);
+			ret = 1;
+		}
+	}
+	for (i = 0; i < 2; i++)
+		XDestroyWindow(src, win[i]);
+	XSync(src, False);
+
+	printf("%s\n", ret ? "FAIL" : "PASS");
+
+out_outputs:
+	for (i = 0; i < 2; i++)
+		if (t[i].output[0])
+			xrandr(src, t[i].output, "--off");
+out_tool:
+	stop(tool);
+out_xvfb:
+	for (i = 0; i < 2; i++) {
+		if (t[i].dpy)
+			XCloseDisplay(t[i].dpy);
+		stop(t[i].pid);
+	}
+	XCloseDisplay(src);
+	return ret;
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright © 2026 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Reads the per-operation trace exported by a running SNA server
+ * (see src/sna/sna_trace.h): where each operation was drawn and why,
+ * and the bytes migrated between the CPU and GPU copies of each pixmap,
+ * summarising the pixmaps that bounce back and forth between the two.
+ * Tracing in the server is enabled for as long as we are attached.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/sna/sna_trace_reader.h"
+
+#define MAX_PIXMAPS 4096 /* tracked per interval, a power of two */
+
+struct pixmap {
+	uint32_t serial;
+	uint16_t width, height;
+	uint8_t bpp;
+	int8_t last; /* direction of the last migration, +1 up, -1 down */
+	unsigned uploads, downloads, flips, fallbacks;
+	uint64_t upload_bytes, download_bytes;
+};
+
+static struct {
+	uint64_t count[SNA_TRACE_NUM_OPS][SNA_TRACE_NUM_PATHS];
+	uint64_t reason[SNA_TRACE_NUM_OPS][SNA_TRACE_NUM_REASONS];
+	uint64_t bytes[SNA_TRACE_NUM_OPS];
+	uint64_t lost;
+	struct pixmap pixmap[MAX_PIXMAPS];
+	unsigned num_pixmaps;
+} stats;
+
+static volatile sig_atomic_t done;
+
+static void signal_done(int sig)
+{
+	done = 1;
+}
+
+static int find_ring(const char *arg, char *name, int len)
+{
+	int pid, screen = 0, found;
+
+	if (arg) {
+		if (sscanf(arg, "%d.%d", &pid, &screen) < 1) {
+			fprintf(stderr, "Expected pid[.screen], not '%s'\n", arg);
+			return -1;
+		}
+		snprintf(name, len, SNA_TRACE_NAME, pid, screen);
+		return 0;
+	}
+
+	/* With no server named, take the only one running */
+	found = sna_trace_find(name, len, stderr);
+	if (found < 0) {
+		fprintf(stderr, "Unable to search /dev/shm for a server, name one as pid[.screen]\n");
+		return -1;
+	}
+	if (found == 0) {
+		fprintf(stderr, "No SNA server found\n");
+		return -1;
+	}
+	if (found > 1) {
+		fprintf(stderr, "Found %d screens, name one as pid[.screen]\n", found);
+		return -1;
+	}
+
+	return 0;
+}
+
+static struct pixmap *lookup(const struct sna_trace_event *e)
+{
+	unsigned i = e->pixmap * 2654435761u;
+
+	for (;;) {
+		struct pixmap *p;
+
+		i &= MAX_PIXMAPS - 1;
+		p = &stats.pixmap[i++];
+		if (p->serial == e->pixmap)
+			return p;
+
+		if (p->serial == 0) {
+			if (stats.num_pixmaps == MAX_PIXMAPS / 2)
+				return NULL;
+
+			stats.num_pixmaps++;
+			p->serial = e->pixmap;
+			p->width = e->pixmap_width;
+			p->height = e->pixmap_height;
+			p->bpp = e->bpp;
+			return p;
+		}
+	}
+}
+
+static void record(const struct sna_trace_event *e, uint64_t start, int verbose)
+{
+	struct pixmap *p;
+
+	if (e->op >= SNA_TRACE_NUM_OPS ||
+	    e->path >= SNA_TRACE_NUM_PATHS ||
+	    e->reason >= SNA_TRACE_NUM_REASONS)
+		return;
+
+	if (verbose)
+		printf("%10.6f %-9s %-6s %5dx%-5d pixmap %u (%dx%d@%d) %u bytes %s\n",
+		       (e->time - start) / 1e9,
+		       sna_trace_op_name(e->op),
+		       sna_trace_path_name(e->path),
+		       e->width, e->height,
+		       e->pixmap,
+		       e->pixmap_width, e->pixmap_height, e->bpp,
+		       e->bytes,
+		       sna_trace_reason_name(e->reason));
+
+	stats.count[e->op][e->path]++;
+	stats.reason[e->op][e->reason]++;
+	stats.bytes[e->op] += e->bytes;
+
+	if (e->pixmap == 0)
+		return;
+
+	p = lookup(e);
+	if (p == NULL)
+		return;
+
+	switch (e->op) {
+	case SNA_TRACE_UPLOAD:
+		p->uploads++;
+		p->upload_bytes += e->bytes;
+		p->flips += p->last < 0;
+		p->last = 1;
+		break;
+	case SNA_TRACE_DOWNLOAD:
+		p->downloads++;
+		p->download_bytes += e->bytes;
+		p->flips += p->last > 0;
+		p->last = -1;
+		break;
+	default:
+		p->fallbacks += e->path == SNA_TRACE_CPU;
+		break;
+	}
+}
+
+static int cmp_pixmap(const void *A, const void *B)
+{
+	const struct pixmap *a = A, *b = B;
+
+	if (a->flips != b->flips)
+		return a->flips < b->flips ? 1 : -1;
+
+	if (a->upload_bytes + a->download_bytes != b->upload_bytes + b->download_bytes)
+		return a->upload_bytes + a->download_bytes < b->upload_bytes + b->download_bytes ? 1 : -1;
+
+	return 0;
+}
+
+static void report(double elapsed, unsigned top)
+{
+	unsigned op, path, reason, i, n;
+
+	printf("--- %.1fs", elapsed);
+	if (stats.lost)
+		printf(", %llu events lost", (unsigned long long)stats.lost);
+	printf(" ---\n");
+
+	for (op = 0; op < SNA_TRACE_NUM_OPS; op++) {
+		uint64_t total = 0;
+
+		for (path = 0; path < SNA_TRACE_NUM_PATHS; path++)
+			total += stats.count[op][path];
+		if (total == 0)
+			continue;
+
+		printf("%-9s %8llu:", sna_trace_op_name(op),
+		       (unsigned long long)total);
+		for (path = 0; path < SNA_TRACE_NUM_PATHS; path++)
+			if (stats.count[op][path])
+				printf(" %s %llu", sna_trace_path_name(path),
+				       (unsigned long long)stats.count[op][path]);
+		if (stats.bytes[op])
+			printf(", %.1f MiB", stats.bytes[op] / (1024. * 1024.));
+		printf("\n");
+
+		for (reason = 1; reason < SNA_TRACE_NUM_REASONS; reason++)
+			if (stats.reason[op][reason])
+				printf("%18llu %s\n",
+				       (unsigned long long)stats.reason[op][reason],
+				       sna_trace_reason_name(reason));
+	}
+
+	/* Gather the pixmaps to the front for sorting */
+	for (i = n = 0; i < MAX_PIXMAPS; i++)
+		if (stats.pixmap[i].serial)
+			stats.pixmap[n++] = stats.pixmap[i];
+	qsort(stats.pixmap, n, sizeof(stats.pixmap[0]), cmp_pixmap);
+
+	for (i = 0; i < n && i < top; i++) {
+		const struct pixmap *p = &stats.pixmap[i];
+
+		if (p->uploads + p->downloads == 0)
+			break;
+
+		if (i == 0)
+			printf("pixmap              flips  uploads (MiB)  downloads (MiB)  cpu\n");
+		printf("%-8u %4dx%-4d@%-2d %6u %8u %6.1f %10u %6.1f %5u\n",
+		       p->serial, p->width, p->height, p->bpp,
+		       p->flips,
+		       p->uploads, p->upload_bytes / (1024. * 1024.),
+		       p->downloads, p->download_bytes / (1024. * 1024.),
+		       p->fallbacks);
+	}
+
+	fflush(stdout);
+	memset(&stats, 0, sizeof(stats));
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-i seconds] [-n pixmaps] [-v] [pid[.screen]]\n"
+		"  -i  seconds between summaries (default 5, 0 for a single one on exit)\n"
+		"  -n  number of pixmaps listed by migration ping-pong (default 10)\n"
+		"  -v  print every event as well\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	static struct sna_trace_event buf[SNA_TRACE_SIZE];
+	struct sna_trace_reader reader;
+	double interval = 5;
+	unsigned top = 10;
+	int verbose = 0;
+	uint64_t start, last;
+	char name[256];
+	int c;
+
+	while ((c = getopt(argc, argv, "i:n:vh")) != -1) {
+		switch (c) {
+		case 'i':
+			interval = atof(optarg);
+			break;
+		case 'n':
+			top = atoi(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return c != 'h';
+		}
+	}
+
+	if (find_ring(optind < argc ? argv[optind] : NULL, name, sizeof(name)))
+		return 1;
+
+	if (!sna_trace_attach(&reader, name)) {
+		if (errno == EPROTO)
+			fprintf(stderr, "%s is not a trace we understand\n", name);
+		else
+			fprintf(stderr, "Unable to open %s: %s\n", name, strerror(errno));
+		return 1;
+	}
+
+	signal(SIGINT, signal_done);
+	signal(SIGTERM, signal_done);
+	signal(SIGHUP, signal_done);
+	signal(SIGPIPE, signal_done);
+
+	fprintf(stderr, "Tracing %s\n", name);
+
+	start = last = sna_trace_now();
+	while (!done) {
+		struct timespec delay = { 0, 10 * 1000 * 1000 };
+		const struct sna_trace_event *e;
+		unsigned n;
+
+		e = sna_trace_read(&reader, buf, &n);
+		while (n--)
+			record(e++, start, verbose);
+		stats.lost += reader.lost;
+		reader.lost = 0;
+
+		if (interval > 0 && sna_trace_now() - last >= interval * 1e9) {
+			report((sna_trace_now() - last) / 1e9, top);
+			last = sna_trace_now();
+		}
+
+		nanosleep(&delay, NULL);
+	}
+
+	sna_trace_detach(&reader);
+	report((sna_trace_now() - last) / 1e9, top);
+
+	return 0;
+}
@@ -59,10 +59,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <time.h>
 #include <signal.h>
 #include <getopt.h>
 #include <limits.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <fcntl.h>
 #include <assert.h>
 
@@ -84,6 +87,14 @@ static int verbose;
 #define CURSOR 0x20
 #define SCREEN 0x40
 #define POLL 0x80
+#define STATS 0x100
+
+/* Send to each target display from its own thread (-t) */
+static int threaded;
+
+/* Damage is transferred in tiles of 64x64, skipping those that are unchanged */
+#define TILE_SHIFT 6
+#define TILE_SIZE (1 << TILE_SHIFT)
 
 struct display {
 	Display *dpy;
@@ -130,6 +141,8 @@ struct display {
 	int skip_clone;
 	int skip_frame;
 
+	struct worker *worker;
+
 	struct {
 		int timeout;
 		int interval;
@@ -174,9 +187,35 @@ struct clone {
 	XImage image;
 
 	int width, height, depth;
-	struct { int x1, x2, y1, y2; } damaged;
+	pixman_region32_t damage;
+	uint64_t damaged; /* when the damage was first reported */
+	uint64_t *tiles; /* hash of each tile as last sent, 0 if unknown */
+	int tile_stride;
 	int rr_update;
 
+	struct {
+		uint64_t start;
+		uint64_t fetched, sent;
+		int frames, tiles, unchanged;
+		int presented, dropped;
+		uint64_t latency, max_latency;
+	} stats;
+
+	/*
+	 * When threaded, frames are fetched into one buffer of the shm
+	 * segment whilst the target's worker sends another.
+	 */
+	struct frame {
+		struct frame *next;
+		struct clone *clone;
+		XImage image;
+		pixman_region32_t region; /* relative to the clone */
+		uint64_t damaged;
+		int dx, dy;
+		enum { FRAME_IDLE, FRAME_QUEUED, FRAME_SENDING } state;
+	} frame[2];
+	int nframe;
+
 	struct dri3_fence {
 		XID xid;
 		void *addr;
@@ -189,6 +228,8 @@ struct context {
 	struct clone *active;
 	struct pollfd *pfd;
 #define timer pfd[0].fd
+#define wakeup pfd[1].fd
+	int wake; /* written to by the workers, see worker_run() */
 	Display *record;
 	int nclone;
 	int ndisplay;
@@ -209,6 +250,14 @@ static inline int is_power_of_2(unsigned long n)
 	return n && ((n & (n - 1)) == 0);
 }
 
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 static int xlib_vendor_is_xorg(Display *dpy)
 {
 	const char *const vendor = ServerVendor(dpy);
@@ -511,6 +560,27 @@ static int timerfd(int hz)
 	return fd;
 }
 
+/*
+ * A worker reads events from the target into Xlib's queue whilst waiting
+ * for its transfers, where the main loop would not see them until the
+ * next unrelated wakeup. So it pokes the main loop through this pipe.
+ */
+static int wakefd(int *wr)
+{
+	int fd[2];
+
+	if (pipe(fd))
+		return -errno;
+
+	fcntl(fd[0], F_SETFL, O_NONBLOCK);
+	fcntl(fd[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fd[1], F_SETFL, O_NONBLOCK);
+	fcntl(fd[1], F_SETFD, FD_CLOEXEC);
+
+	*wr = fd[1];
+	return fd[0];
+}
+
 static int context_init(struct context *ctx)
 {
 	struct pollfd *pfd;
@@ -535,6 +605,12 @@ static int context_init(struct context *ctx)
 		return pfd->fd;
 	pfd->events = POLLIN;
 
+	pfd = memset(&ctx->pfd[ctx->nfd++], 0, sizeof(struct pollfd));
+	pfd->fd = wakefd(&ctx->wake);
+	if (pfd->fd < 0)
+		return pfd->fd;
+	pfd->events = POLLIN;
+
 	return 0;
 }
 
@@ -584,6 +660,57 @@ static void display_mark_flush(struct display *display)
 	display->flush = 1;
 }
 
+struct worker {
+	Display *dpy;
+	int notify; /* the main loop, see wakefd() */
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t wake, idle;
+	struct frame *head, **tail;
+	int busy;
+	int quit;
+};
+
+/* The last SHM transfer to the target, also set by its worker */
+static void clone_set_serial(struct clone *c, unsigned long serial)
+{
+	struct worker *w = c->dst.display->worker;
+
+	if (w)
+		pthread_mutex_lock(&w->mutex);
+	c->dst.serial = serial;
+	if (w)
+		pthread_mutex_unlock(&w->mutex);
+}
+
+static unsigned long clone_get_serial(struct clone *c)
+{
+	struct worker *w = c->dst.display->worker;
+	unsigned long serial;
+
+	if (w)
+		pthread_mutex_lock(&w->mutex);
+	serial = c->dst.serial;
+	if (w)
+		pthread_mutex_unlock(&w->mutex);
+
+	return serial;
+}
+
+/* Wait for the target's worker to send everything queued */
+static void display_drain(struct display *display)
+{
+	struct worker *w = display->worker;
+
+	if (w == NULL)
+		return;
+
+	pthread_mutex_lock(&w->mutex);
+	while (w->head || w->busy)
+		pthread_cond_wait(&w->idle, &w->mutex);
+	pthread_mutex_unlock(&w->mutex);
+}
+
 static int mode_equal(const XRRModeInfo *a, const XRRModeInfo *b)
 {
 	return (a->width == b->width &&
@@ -1162,6 +1289,8 @@ static int clone_init_xfer(struct clone *clone)
 	if (width == clone->width && height == clone->height)
 		return 0;
 
+	display_drain(clone->dst.display);
+
 	if (clone->shm.shmaddr) {
 		if (clone->src.use_shm)
 			XShmDetach(clone->src.dpy, &clone->src.shm);
@@ -1183,8 +1312,7 @@ static int clone_init_xfer(struct clone *clone)
 	}
 
 	if ((width | height) == 0) {
-		clone->damaged.x2 = clone->damaged.y2 = INT_MIN;
-		clone->damaged.x1 = clone->damaged.y1 = INT_MAX;
+		pixman_region32_clear(&clone->damage);
 		return 0;
 	}
 
@@ -1234,8 +1362,13 @@ disable_dri3:
 		DBG(DRAW, ("%s-%s create xfer, trying SHM\n",
 		     DisplayString(clone->dst.dpy), clone->dst.name));
 
+		/* SHM pixmaps are bound to the start of the segment */
+		clone->nframe = 1;
+		if (threaded && !clone->src.use_shm_pixmap && !clone->dst.use_shm_pixmap)
+			clone->nframe = 2;
+
 		clone->shm.shmid = shmget(IPC_PRIVATE,
-					  height * stride_for_depth(width, clone->depth),
+					  clone->nframe * height * stride_for_depth(width, clone->depth),
 					  IPC_CREAT | 0666);
 		if (clone->shm.shmid == -1)
 			return errno;
@@ -1270,10 +1403,16 @@ disable_dri3:
 	output_init_xfer(clone, &clone->src);
 	output_init_xfer(clone, &clone->dst);
 
-	clone->damaged.x1 = clone->src.x;
-	clone->damaged.x2 = clone->src.x + width;
-	clone->damaged.y1 = clone->src.y;
-	clone->damaged.y2 = clone->src.y + height;
+	free(clone->tiles);
+	clone->tile_stride = (width + TILE_SIZE - 1) >> TILE_SHIFT;
+	clone->tiles = calloc(clone->tile_stride * ((height + TILE_SIZE - 1) >> TILE_SHIFT),
+			      sizeof(uint64_t));
+
+	pixman_region32_fini(&clone->damage);
+	pixman_region32_init_rect(&clone->damage,
+				  clone->src.x, clone->src.y,
+				  width, height);
+	clone->damaged = now_us();
 
 	display_mark_flush(clone->dst.display);
 	return 0;
@@ -1909,158 +2048,556 @@ static void ximage_prepare(XImage *image, int width, int height)
 	image->bytes_per_line = stride_for_depth(width, image->depth);
 }
 
-static void get_src(struct clone *c, const XRectangle *clip)
+static int xfer_size(struct clone *c, int width, int height)
+{
+	return height * stride_for_depth(width, c->depth);
+}
+
+/*
+ * Read the full width of the rows spanned by the boxes, as XShmGetImage
+ * writes packed rows from the start of the image. Boxes come y-x banded,
+ * so each band is fetched just once.
+ */
+static void get_src_shm(struct clone *c, Drawable d, int x, int y,
+			const pixman_box32_t *box, int n)
+{
+	int stride = stride_for_depth(c->width, c->depth);
+	char *data = c->image.data;
+	int y2 = 0;
+
+	while (n--) {
+		int y1 = box->y1 > y2 ? box->y1 : y2;
+
+		if (box->y2 > y1) {
+			ximage_prepare(&c->image, c->width, box->y2 - y1);
+			c->image.data = data + y1 * stride;
+			XShmGetImage(c->src.dpy, d, &c->image,
+				     x, y + y1, AllPlanes);
+			c->stats.fetched += xfer_size(c, c->width, box->y2 - y1);
+			y2 = box->y2;
+		}
+		box++;
+	}
+
+	c->image.data = data;
+}
+
+static void get_src_image(struct clone *c, Drawable d, int x, int y,
+			  const pixman_box32_t *box, int n)
+{
+	ximage_prepare(&c->image, c->width, c->height);
+	while (n--) {
+		XGetSubImage(c->src.dpy, d,
+			     x + box->x1, y + box->y1,
+			     box->x2 - box->x1, box->y2 - box->y1,
+			     AllPlanes, ZPixmap,
+			     &c->image, box->x1, box->y1);
+		c->stats.fetched += xfer_size(c, box->x2 - box->x1, box->y2 - box->y1);
+		box++;
+	}
+}
+
+/* Fetch the boxes (relative to the clone) into the image at the same offsets */
+static void get_src(struct clone *c, const pixman_box32_t *box, int n)
 {
-	DBG(DRAW,("%s-%s get_src(%d,%d)x(%d,%d)\n", DisplayString(c->dst.dpy), c->dst.name,
-	     clip->x, clip->y, clip->width, clip->height));
+	int i;
+
+	DBG(DRAW,("%s-%s get_src %d boxes\n", DisplayString(c->dst.dpy), c->dst.name, n));
 
 	c->image.obdata = (char *)&c->src.shm;
 
 	if (c->src.use_render) {
 		DBG(DRAW, ("%s-%s get_src via XRender\n",
 			   DisplayString(c->dst.dpy), c->dst.name));
-		XRenderComposite(c->src.dpy, PictOpSrc,
-				 c->src.win_picture, 0, c->src.pix_picture,
-				 clip->x, clip->y,
-				 0, 0,
-				 0, 0,
-				 clip->width, clip->height);
+		for (i = 0; i < n; i++)
+			XRenderComposite(c->src.dpy, PictOpSrc,
+					 c->src.win_picture, 0, c->src.pix_picture,
+					 c->src.x + box[i].x1, c->src.y + box[i].y1,
+					 0, 0,
+					 box[i].x1, box[i].y1,
+					 box[i].x2 - box[i].x1, box[i].y2 - box[i].y1);
 		if (c->src.use_shm_pixmap) {
 			XSync(c->src.dpy, False);
-		} else if (c->src.use_shm) {
-			ximage_prepare(&c->image, clip->width, clip->height);
-			XShmGetImage(c->src.dpy, c->src.pixmap, &c->image,
-				     clip->x, clip->y, AllPlanes);
-		} else {
-			ximage_prepare(&c->image, c->width, c->height);
-			XGetSubImage(c->src.dpy, c->src.pixmap,
-				     clip->x, clip->y, clip->width, clip->height,
-				     AllPlanes, ZPixmap,
-				     &c->image, 0, 0);
-		}
+			for (i = 0; i < n; i++)
+				c->stats.fetched += xfer_size(c, box[i].x2 - box[i].x1, box[i].y2 - box[i].y1);
+		} else if (c->src.use_shm)
+			get_src_shm(c, c->src.pixmap, 0, 0, box, n);
+		else
+			get_src_image(c, c->src.pixmap, 0, 0, box, n);
 	} else if (c->src.pixmap) {
 		DBG(DRAW, ("%s-%s get_src XCopyArea (SHM/DRI3)\n",
 			   DisplayString(c->dst.dpy), c->dst.name));
-		XCopyArea(c->src.dpy, c->src.window, c->src.pixmap, c->src.gc,
-			  clip->x, clip->y,
-			  clip->width, clip->height,
-			  0, 0);
+		for (i = 0; i < n; i++) {
+			XCopyArea(c->src.dpy, c->src.window, c->src.pixmap, c->src.gc,
+				  c->src.x + box[i].x1, c->src.y + box[i].y1,
+				  box[i].x2 - box[i].x1, box[i].y2 - box[i].y1,
+				  box[i].x1, box[i].y1);
+			c->stats.fetched += xfer_size(c, box[i].x2 - box[i].x1, box[i].y2 - box[i].y1);
+		}
 		XSync(c->src.dpy, False);
 	} else if (c->src.use_shm) {
 		DBG(DRAW, ("%s-%s get_src XShmGetImage\n",
 			   DisplayString(c->dst.dpy), c->dst.name));
-		ximage_prepare(&c->image, clip->width, clip->height);
-		XShmGetImage(c->src.dpy, c->src.window, &c->image,
-			     clip->x, clip->y, AllPlanes);
+		get_src_shm(c, c->src.window, c->src.x, c->src.y, box, n);
 	} else {
 		DBG(DRAW, ("%s-%s get_src XGetSubImage (slow)\n",
 			   DisplayString(c->dst.dpy), c->dst.name));
-		ximage_prepare(&c->image, c->width, c->height);
-		XGetSubImage(c->src.dpy, c->src.window,
-			     clip->x, clip->y, clip->width, clip->height,
-			     AllPlanes, ZPixmap,
-			     &c->image, 0, 0);
+		get_src_image(c, c->src.window, c->src.x, c->src.y, box, n);
 	}
 	c->src.display->flush = 0;
 }
 
-static void put_dst(struct clone *c, const XRectangle *clip)
+static uint64_t boxes_size(struct clone *c, const pixman_box32_t *box, int n)
 {
-	DBG(DRAW, ("%s-%s put_dst(%d,%d)x(%d,%d)\n", DisplayString(c->dst.dpy), c->dst.name,
-	     clip->x, clip->y, clip->width, clip->height));
+	uint64_t size = 0;
+
+	while (n--) {
+		size += xfer_size(c, box->x2 - box->x1, box->y2 - box->y1);
+		box++;
+	}
 
-	c->image.obdata = (char *)&c->dst.shm;
+	return size;
+}
+
+/*
+ * Send the boxes (relative to the clone) from the image to the target at
+ * (dx, dy), returning whether the target needs a flush to complete it.
+ */
+static int put_dst(struct clone *c, XImage *image, int dx, int dy,
+		   const pixman_box32_t *box, int n)
+{
+	int send = 0;
+	int i;
+
+	DBG(DRAW, ("%s-%s put_dst %d boxes, offset (%d, %d)\n",
+	     DisplayString(c->dst.dpy), c->dst.name, n, dx, dy));
+
+	image->obdata = (char *)&c->dst.shm;
+	ximage_prepare(image, c->width, c->height);
 
 	if (c->dst.use_render) {
-		if (c->dst.use_shm_pixmap) {
-			DBG(DRAW, ("%s-%s using SHM pixmap composite\n",
-			     DisplayString(c->dst.dpy), c->dst.name));
-		} else if (c->dst.use_shm) {
-			DBG(DRAW, ("%s-%s using SHM image composite\n",
-			     DisplayString(c->dst.dpy), c->dst.name));
-			XShmPutImage(c->dst.dpy, c->dst.pixmap, c->dst.gc, &c->image,
-				     0, 0,
-				     0, 0,
-				     clip->width, clip->height,
-				     False);
-		} else {
-			DBG(DRAW, ("%s-%s using composite\n",
-			     DisplayString(c->dst.dpy), c->dst.name));
-			XPutImage(c->dst.dpy, c->dst.pixmap, c->dst.gc, &c->image,
-				  0, 0,
-				  0, 0,
-				  clip->width, clip->height);
-		}
-		if (c->dst.use_shm)
-			c->dst.serial = NextRequest(c->dst.dpy);
-		XRenderComposite(c->dst.dpy, PictOpSrc,
-				 c->dst.pix_picture, 0, c->dst.win_picture,
-				 0, 0,
-				 0, 0,
-				 clip->x, clip->y,
-				 clip->width, clip->height);
-		c->dst.display->send |= c->dst.use_shm;
+		for (i = 0; i < n; i++) {
+			int w = box[i].x2 - box[i].x1, h = box[i].y2 - box[i].y1;
+
+			if (c->dst.use_shm_pixmap) {
+				DBG(DRAW, ("%s-%s using SHM pixmap composite\n",
+				     DisplayString(c->dst.dpy), c->dst.name));
+			} else if (c->dst.use_shm) {
+				DBG(DRAW, ("%s-%s using SHM image composite\n",
+				     DisplayString(c->dst.dpy), c->dst.name));
+				XShmPutImage(c->dst.dpy, c->dst.pixmap, c->dst.gc, image,
+					     box[i].x1, box[i].y1,
+					     box[i].x1, box[i].y1,
+					     w, h,
+					     False);
+			} else {
+				DBG(DRAW, ("%s-%s using composite\n",
+				     DisplayString(c->dst.dpy), c->dst.name));
+				XPutImage(c->dst.dpy, c->dst.pixmap, c->dst.gc, image,
+					  box[i].x1, box[i].y1,
+					  box[i].x1, box[i].y1,
+					  w, h);
+			}
+		}
+		for (i = 0; i < n; i++) {
+			if (c->dst.use_shm)
+				clone_set_serial(c, NextRequest(c->dst.dpy));
+			XRenderComposite(c->dst.dpy, PictOpSrc,
+					 c->dst.pix_picture, 0, c->dst.win_picture,
+					 box[i].x1, box[i].y1,
+					 0, 0,
+					 dx + box[i].x1, dy + box[i].y1,
+					 box[i].x2 - box[i].x1, box[i].y2 - box[i].y1);
+		}
+		send = c->dst.use_shm;
 	} else if (c->dst.pixmap) {
 		DBG(DRAW, ("%s-%s using SHM or DRI3 pixmap\n",
 		     DisplayString(c->dst.dpy), c->dst.name));
-		c->dst.serial = NextRequest(c->dst.dpy);
-		XCopyArea(c->dst.dpy, c->dst.pixmap, c->dst.window, c->dst.gc,
-			  0, 0,
-			  clip->width, clip->height,
-			  clip->x, clip->y);
-		c->dst.display->send = 1;
+		for (i = 0; i < n; i++) {
+			clone_set_serial(c, NextRequest(c->dst.dpy));
+			XCopyArea(c->dst.dpy, c->dst.pixmap, c->dst.window, c->dst.gc,
+				  box[i].x1, box[i].y1,
+				  box[i].x2 - box[i].x1, box[i].y2 - box[i].y1,
+				  dx + box[i].x1, dy + box[i].y1);
+		}
+		send = 1;
 	} else if (c->dst.use_shm) {
 		DBG(DRAW, ("%s-%s using SHM image\n",
 		     DisplayString(c->dst.dpy), c->dst.name));
-		c->dst.serial = NextRequest(c->dst.dpy);
-		XShmPutImage(c->dst.dpy, c->dst.window, c->dst.gc, &c->image,
-			     0, 0,
-			     clip->x, clip->y,
-			     clip->width, clip->height,
-			     True);
+		for (i = 0; i < n; i++) {
+			clone_set_serial(c, NextRequest(c->dst.dpy));
+			XShmPutImage(c->dst.dpy, c->dst.window, c->dst.gc, image,
+				     box[i].x1, box[i].y1,
+				     dx + box[i].x1, dy + box[i].y1,
+				     box[i].x2 - box[i].x1, box[i].y2 - box[i].y1,
+				     i == n - 1);
+		}
 	} else {
 		DBG(DRAW, ("%s-%s using image\n",
 		     DisplayString(c->dst.dpy), c->dst.name));
-		XPutImage(c->dst.dpy, c->dst.window, c->dst.gc, &c->image,
-			  0, 0,
-			  clip->x, clip->y,
-			  clip->width, clip->height);
-		c->dst.serial = 0;
+		for (i = 0; i < n; i++)
+			XPutImage(c->dst.dpy, c->dst.window, c->dst.gc, image,
+				  box[i].x1, box[i].y1,
+				  dx + box[i].x1, dy + box[i].y1,
+				  box[i].x2 - box[i].x1, box[i].y2 - box[i].y1);
+		clone_set_serial(c, 0);
+	}
+
+	return send;
+}
+
+static uint64_t tile_hash(const XImage *image, int stride,
+			  int x, int y, int width, int height)
+{
+	const int cpp = image->bits_per_pixel / 8;
+	const uint8_t *row = (const uint8_t *)image->data + y * stride + x * cpp;
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	width *= cpp;
+	while (height--) {
+		const uint8_t *p = row;
+		int len = width;
+		uint64_t v;
+
+		for (; len >= 8; len -= 8, p += 8) {
+			memcpy(&v, p, 8);
+			hash = (hash ^ v) * 0x9e3779b97f4a7c15ull;
+			hash ^= hash >> 29;
+		}
+		if (len) {
+			v = 0;
+			memcpy(&v, p, len);
+			hash = (hash ^ v) * 0x9e3779b97f4a7c15ull;
+			hash ^= hash >> 29;
+		}
+		row += stride;
+	}
+
+	return hash | 1; /* 0 is reserved for unknown */
+}
+
+/*
+ * Round the damage out to whole tiles, fetch those and reduce the damage
+ * to the tiles whose contents differ from what we last sent.
+ */
+static void clone_fetch_tiles(struct clone *c)
+{
+	int stride = stride_for_depth(c->width, c->depth);
+	pixman_region32_t tiles, changed;
+	const pixman_box32_t *box;
+	int n, i;
+
+	pixman_region32_init(&tiles);
+	box = pixman_region32_rectangles(&c->damage, &n);
+	for (i = 0; i < n; i++) {
+		int x1 = box[i].x1 & ~(TILE_SIZE - 1);
+		int y1 = box[i].y1 & ~(TILE_SIZE - 1);
+		int x2 = (box[i].x2 + TILE_SIZE - 1) & ~(TILE_SIZE - 1);
+		int y2 = (box[i].y2 + TILE_SIZE - 1) & ~(TILE_SIZE - 1);
+
+		if (x2 > c->width)
+			x2 = c->width;
+		if (y2 > c->height)
+			y2 = c->height;
+		pixman_region32_union_rect(&tiles, &tiles,
+					   x1, y1, x2 - x1, y2 - y1);
+	}
+
+	box = pixman_region32_rectangles(&tiles, &n);
+	get_src(c, box, n);
+
+	/* the boxes are now tile aligned, so each tile is visited once */
+	pixman_region32_init(&changed);
+	for (i = 0; i < n; i++) {
+		int tx, ty;
+
+		for (ty = box[i].y1 >> TILE_SHIFT; ty << TILE_SHIFT < box[i].y2; ty++) {
+			int y = ty << TILE_SHIFT;
+			int h = box[i].y2 - y < TILE_SIZE ? box[i].y2 - y : TILE_SIZE;
+			int run = -1;
+
+			for (tx = box[i].x1 >> TILE_SHIFT; tx << TILE_SHIFT < box[i].x2; tx++) {
+				int x = tx << TILE_SHIFT;
+				int w = box[i].x2 - x < TILE_SIZE ? box[i].x2 - x : TILE_SIZE;
+				uint64_t *tile = &c->tiles[ty * c->tile_stride + tx];
+				uint64_t hash = tile_hash(&c->image, stride, x, y, w, h);
+
+				c->stats.tiles++;
+				if (*tile == hash) {
+					c->stats.unchanged++;
+					if (run >= 0) {
+						pixman_region32_union_rect(&changed, &changed,
+									   run, y, x - run, h);
+						run = -1;
+					}
+					continue;
+				}
+
+				*tile = hash;
+				if (run < 0)
+					run = x;
+			}
+			if (run >= 0)
+				pixman_region32_union_rect(&changed, &changed,
+							   run, y, box[i].x2 - run, h);
+		}
 	}
+
+	DBG(DRAW, ("%s-%s %d damaged tiles, %d changed boxes\n",
+	     DisplayString(c->dst.dpy), c->dst.name,
+	     (int)pixman_region32_n_rects(&tiles), (int)pixman_region32_n_rects(&changed)));
+
+	pixman_region32_fini(&tiles);
+	pixman_region32_fini(&c->damage);
+	c->damage = changed;
+}
+
+static void *worker_run(void *arg)
+{
+	struct worker *w = arg;
+
+	pthread_mutex_lock(&w->mutex);
+	while (!w->quit) {
+		struct frame *f = w->head;
+		const pixman_box32_t *box;
+		struct clone *c;
+		uint64_t latency;
+		int n;
+
+		if (f == NULL) {
+			w->busy = 0;
+			pthread_cond_broadcast(&w->idle);
+			pthread_cond_wait(&w->wake, &w->mutex);
+			continue;
+		}
+
+		w->head = f->next;
+		if (w->head == NULL)
+			w->tail = &w->head;
+		f->state = FRAME_SENDING;
+		w->busy = 1;
+		pthread_mutex_unlock(&w->mutex);
+
+		c = f->clone;
+		box = pixman_region32_rectangles(&f->region, &n);
+		put_dst(c, &f->image, f->dx, f->dy, box, n);
+		/* once processed, the buffer is free to be refilled */
+		XSync(w->dpy, False);
+		latency = now_us() - f->damaged;
+
+		/* XSync may have queued events for the main loop */
+		if (XEventsQueued(w->dpy, QueuedAlready) &&
+		    write(w->notify, "", 1) < 0 && errno != EAGAIN)
+			DBG(POLL, ("%s failed to wake the main loop: %d\n",
+			     DisplayString(w->dpy), errno));
+
+		pthread_mutex_lock(&w->mutex);
+		c->stats.sent += boxes_size(c, box, n);
+		c->stats.presented++;
+		c->stats.latency += latency;
+		if (latency > c->stats.max_latency)
+			c->stats.max_latency = latency;
+
+		pixman_region32_clear(&f->region);
+		f->state = FRAME_IDLE;
+	}
+	pthread_mutex_unlock(&w->mutex);
+
+	return NULL;
+}
+
+static void display_start_worker(struct display *display)
+{
+	struct worker *w;
+
+	if (display->worker)
+		return;
+
+	w = calloc(1, sizeof(*w));
+	if (w == NULL)
+		return;
+
+	w->dpy = display->dpy;
+	w->notify = display->ctx->wake;
+	w->tail = &w->head;
+	pthread_mutex_init(&w->mutex, NULL);
+	pthread_cond_init(&w->wake, NULL);
+	pthread_cond_init(&w->idle, NULL);
+
+	if (pthread_create(&w->thread, NULL, worker_run, w)) {
+		pthread_cond_destroy(&w->idle);
+		pthread_cond_destroy(&w->wake);
+		pthread_mutex_destroy(&w->mutex);
+		free(w);
+		return;
+	}
+
+	DBG(X11, ("%s started worker\n", DisplayString(display->dpy)));
+	display->worker = w;
+}
+
+static void display_stop_worker(struct display *display)
+{
+	struct worker *w = display->worker;
+
+	if (w == NULL)
+		return;
+
+	pthread_mutex_lock(&w->mutex);
+	w->quit = 1;
+	pthread_cond_signal(&w->wake);
+	pthread_mutex_unlock(&w->mutex);
+
+	pthread_join(w->thread, NULL);
+
+	pthread_cond_destroy(&w->idle);
+	pthread_cond_destroy(&w->wake);
+	pthread_mutex_destroy(&w->mutex);
+	free(w);
+
+	display->worker = NULL;
+}
+
+/*
+ * Pick the buffer to fetch the next frame into. If a frame is still
+ * waiting for the worker, the latest frame wins: we take it back, refetch
+ * into the same buffer and send the union of both. If every buffer is
+ * being sent, the damage keeps accumulating until one is free.
+ */
+static struct frame *clone_next_frame(struct clone *c)
+{
+	struct worker *w = c->dst.display->worker;
+	struct frame *f = NULL, **prev;
+	int n;
+
+	pthread_mutex_lock(&w->mutex);
+	for (n = 0; n < c->nframe; n++) {
+		if (c->frame[n].state != FRAME_QUEUED)
+			continue;
+
+		f = &c->frame[n];
+		for (prev = &w->head; *prev != f; prev = &(*prev)->next)
+			;
+		*prev = f->next;
+		if (w->tail == &f->next)
+			w->tail = prev;
+		f->state = FRAME_IDLE;
+		c->stats.dropped++;
+		break;
+	}
+	for (n = 0; f == NULL && n < c->nframe; n++) {
+		if (c->frame[n].state == FRAME_IDLE)
+			f = &c->frame[n];
+	}
+	pthread_mutex_unlock(&w->mutex);
+
+	return f;
+}
+
+static void clone_queue_frame(struct clone *c, struct frame *f)
+{
+	struct worker *w = c->dst.display->worker;
+
+	if (!pixman_region32_not_empty(&f->region))
+		f->damaged = c->damaged;
+	pixman_region32_union(&f->region, &f->region, &c->damage);
+	if (!pixman_region32_not_empty(&f->region))
+		return;
+
+	f->clone = c;
+	f->image = c->image;
+	f->dx = c->dst.x;
+	f->dy = c->dst.y;
+
+	DBG(DRAW, ("%s-%s queue frame %d, %d boxes\n",
+	     DisplayString(c->dst.dpy), c->dst.name,
+	     (int)(f - c->frame), (int)pixman_region32_n_rects(&f->region)));
+
+	pthread_mutex_lock(&w->mutex);
+	f->next = NULL;
+	*w->tail = f;
+	w->tail = &f->next;
+	f->state = FRAME_QUEUED;
+	pthread_cond_signal(&w->wake);
+	pthread_mutex_unlock(&w->mutex);
+}
+
+static void clone_stats(struct clone *c)
+{
+	struct worker *w = c->dst.display->worker;
+	uint64_t now, elapsed;
+
+	if (!(verbose & STATS))
+		return;
+
+	now = now_us();
+	if (c->stats.start == 0)
+		c->stats.start = now;
+
+	elapsed = now - c->stats.start;
+	if (elapsed < 1000000)
+		return;
+
+	if (w)
+		pthread_mutex_lock(&w->mutex);
+
+	printf("%s-%s: %.1f frames/s, %.1f presented/s (%d dropped), latency %.1fms (max %.1fms), fetched %.1f MiB/s, sent %.1f MiB/s, %d/%d tiles unchanged\n",
+	       DisplayString(c->dst.dpy), c->dst.name,
+	       c->stats.frames * 1e6 / elapsed,
+	       c->stats.presented * 1e6 / elapsed,
+	       c->stats.dropped,
+	       c->stats.presented ? c->stats.latency / 1e3 / c->stats.presented : 0.,
+	       c->stats.max_latency / 1e3,
+	       c->stats.fetched * 1e6 / elapsed / (1 << 20),
+	       c->stats.sent * 1e6 / elapsed / (1 << 20),
+	       c->stats.unchanged, c->stats.tiles);
+
+	memset(&c->stats, 0, sizeof(c->stats));
+	c->stats.start = now;
+
+	if (w)
+		pthread_mutex_unlock(&w->mutex);
 }
 
 static int clone_paint(struct clone *c)
 {
-	XRectangle clip;
+	const pixman_box32_t *box;
+	struct frame *f = NULL;
+	int n, i;
 
 	if (c->width == 0 || c->height == 0)
 		return 0;
 
-	DBG(DRAW, ("%s-%s paint clone, damaged (%d, %d), (%d, %d) [(%d, %d), (%d,  %d)]\n",
+	DBG(DRAW, ("%s-%s paint clone, damaged %d boxes (%d, %d), (%d, %d) [(%d, %d), (%d,  %d)]\n",
 	     DisplayString(c->dst.dpy), c->dst.name,
-	     c->damaged.x1, c->damaged.y1,
-	     c->damaged.x2, c->damaged.y2,
+	     (int)pixman_region32_n_rects(&c->damage),
+	     c->damage.extents.x1, c->damage.extents.y1,
+	     c->damage.extents.x2, c->damage.extents.y2,
 	     c->src.x, c->src.y,
 	     c->src.x + c->width, c->src.y + c->height));
 
-	if (c->damaged.x1 < c->src.x)
-		c->damaged.x1 = c->src.x;
-	if (c->damaged.x2 > c->src.x + c->width)
-		c->damaged.x2 = c->src.x + c->width;
-	if (c->damaged.x2 <= c->damaged.x1)
+	pixman_region32_intersect_rect(&c->damage, &c->damage,
+				       c->src.x, c->src.y,
+				       c->width, c->height);
+	if (!pixman_region32_not_empty(&c->damage))
 		goto done;
 
-	if (c->damaged.y1 < c->src.y)
-		c->damaged.y1 = c->src.y;
-	if (c->damaged.y2 > c->src.y + c->height)
-		c->damaged.y2 = c->src.y + c->height;
-	if (c->damaged.y2 <= c->damaged.y1)
-		goto done;
+	if (threaded && !c->dri3.xid) {
+		display_start_worker(c->dst.display);
+		if (c->dst.display->worker) {
+			f = clone_next_frame(c);
+			if (f == NULL) {
+				DBG(DRAW, ("%s-%s all frames in flight\n",
+				     DisplayString(c->dst.dpy), c->dst.name));
+				return EAGAIN;
+			}
+		}
+	}
 
 	DBG(DRAW, ("%s-%s is damaged, last SHM serial: %ld, now %ld\n",
 	     DisplayString(c->dst.dpy), c->dst.name,
-	     (long)c->dst.serial, (long)LastKnownRequestProcessed(c->dst.dpy)));
-	if (c->dst.serial > LastKnownRequestProcessed(c->dst.dpy)) {
+	     (long)clone_get_serial(c), (long)LastKnownRequestProcessed(c->dst.dpy)));
+	if (f == NULL && clone_get_serial(c) > LastKnownRequestProcessed(c->dst.dpy)) {
 		struct pollfd pfd;
 
 		pfd.fd = ConnectionNumber(c->dst.dpy);
@@ -2068,7 +2605,7 @@ static int clone_paint(struct clone *c)
 		XEventsQueued(c->dst.dpy,
 			      poll(&pfd, 1, 0) ? QueuedAfterReading : QueuedAfterFlush);
 
-		if (c->dst.serial > LastKnownRequestProcessed(c->dst.dpy)) {
+		if (clone_get_serial(c) > LastKnownRequestProcessed(c->dst.dpy)) {
 			c->dst.display->skip_clone++;
 			return EAGAIN;
 		}
@@ -2077,73 +2614,117 @@ static int clone_paint(struct clone *c)
 	c->dst.display->skip_clone = 0;
 	c->dst.display->skip_frame = 0;
 
-	if (FORCE_FULL_REDRAW) {
-		c->damaged.x1 = c->src.x;
-		c->damaged.y1 = c->src.y;
-		c->damaged.x2 = c->src.x + c->width;
-		c->damaged.y2 = c->src.y + c->height;
-	}
+	if (FORCE_FULL_REDRAW)
+		pixman_region32_reset(&c->damage,
+				      &(pixman_box32_t){ c->src.x, c->src.y,
+							 c->src.x + c->width,
+							 c->src.y + c->height });
+
+	/* from here on, the damage is relative to the clone */
+	pixman_region32_translate(&c->damage, -c->src.x, -c->src.y);
+	c->stats.frames++;
 
 	if (c->dri3.xid) {
-		if (c->src.use_render) {
-			XRenderComposite(c->src.dpy, PictOpSrc,
-					 c->src.win_picture, 0, c->src.pix_picture,
-					 c->damaged.x1, c->damaged.y1,
-					 0, 0,
-					 c->damaged.x1 + c->dst.x - c->src.x,
-					 c->damaged.y1 + c->dst.y - c->src.y,
-					 c->damaged.x2 - c->damaged.x1,
-					 c->damaged.y2 - c->damaged.y1);
-		} else {
-			XCopyArea(c->src.dpy, c->src.window, c->src.pixmap, c->src.gc,
-				  c->damaged.x1, c->damaged.y1,
-				  c->damaged.x2 - c->damaged.x1,
-				  c->damaged.y2 - c->damaged.y1,
-				  c->damaged.x1 + c->dst.x - c->src.x,
-				  c->damaged.y1 + c->dst.y - c->src.y);
+		box = pixman_region32_rectangles(&c->damage, &n);
+		for (i = 0; i < n; i++) {
+			int w = box[i].x2 - box[i].x1, h = box[i].y2 - box[i].y1;
+
+			if (c->src.use_render) {
+				XRenderComposite(c->src.dpy, PictOpSrc,
+						 c->src.win_picture, 0, c->src.pix_picture,
+						 c->src.x + box[i].x1, c->src.y + box[i].y1,
+						 0, 0,
+						 c->dst.x + box[i].x1, c->dst.y + box[i].y1,
+						 w, h);
+			} else {
+				XCopyArea(c->src.dpy, c->src.window, c->src.pixmap, c->src.gc,
+					  c->src.x + box[i].x1, c->src.y + box[i].y1,
+					  w, h,
+					  c->dst.x + box[i].x1, c->dst.y + box[i].y1);
+			}
+			c->stats.sent += xfer_size(c, w, h);
 		}
 		dri3_fence_flush(c->src.dpy, &c->dri3);
 	} else {
-		clip.x = c->damaged.x1;
-		clip.y = c->damaged.y1;
-		clip.width  = c->damaged.x2 - c->damaged.x1;
-		clip.height = c->damaged.y2 - c->damaged.y1;
-		get_src(c, &clip);
+		char *data = c->image.data;
+		uint64_t latency;
+
+		if (f)
+			c->image.data += (f - c->frame) * xfer_size(c, c->width, c->height);
+
+		if (c->tiles && !FORCE_FULL_REDRAW)
+			clone_fetch_tiles(c);
+		else
+			get_src(c, pixman_region32_rectangles(&c->damage, NULL),
+				pixman_region32_n_rects(&c->damage));
+
+		if (f) {
+			/* and the worker sends it whilst we fetch the next */
+			clone_queue_frame(c, f);
+			c->image.data = data;
+			goto done;
+		}
 
-		DBG(DRAW, ("%s-%s target offset %dx%d\n",
-			   DisplayString(c->dst.dpy), c->dst.name,
-			   c->dst.x - c->src.x, c->dst.y - c->src.y));
+		if (!pixman_region32_not_empty(&c->damage))
+			goto done;
 
-		clip.x += c->dst.x - c->src.x;
-		clip.y += c->dst.y - c->src.y;
-		put_dst(c, &clip);
+		box = pixman_region32_rectangles(&c->damage, &n);
+		c->dst.display->send |= put_dst(c, &c->image, c->dst.x, c->dst.y, box, n);
+		c->stats.sent += boxes_size(c, box, n);
+		c->stats.presented++;
+		latency = now_us() - c->damaged;
+		c->stats.latency += latency;
+		if (latency > c->stats.max_latency)
+			c->stats.max_latency = latency;
 	}
 	display_mark_flush(c->dst.display);
 
 done:
-	c->damaged.x2 = c->damaged.y2 = INT_MIN;
-	c->damaged.x1 = c->damaged.y1 = INT_MAX;
+	pixman_region32_clear(&c->damage);
+	clone_stats(c);
 	return 0;
 }
 
 static void clone_damage(struct clone *c, const XRectangle *rec)
 {
-	int v;
+	if (!pixman_region32_not_empty(&c->damage))
+		c->damaged = now_us();
+	pixman_region32_union_rect(&c->damage, &c->damage,
+				   rec->x, rec->y, rec->width, rec->height);
 
-	if ((v = rec->x) < c->damaged.x1)
-		c->damaged.x1 = v;
-	if ((v = (int)rec->x + rec->width) > c->damaged.x2)
-		c->damaged.x2 = v;
-	if ((v = rec->y) < c->damaged.y1)
-		c->damaged.y1 = v;
-	if ((v = (int)rec->y + rec->height) > c->damaged.y2)
-		c->damaged.y2 = v;
-
-	DBG(DAMAGE, ("%s-%s damaged: +(%d,%d)x(%d, %d) -> (%d, %d), (%d, %d)\n",
+	DBG(DAMAGE, ("%s-%s damaged: +(%d,%d)x(%d, %d) -> %d boxes (%d, %d), (%d, %d)\n",
 	     DisplayString(c->dst.display->dpy), c->dst.name,
 	     rec->x, rec->y, rec->width, rec->height,
-	     c->damaged.x1, c->damaged.y1,
-	     c->damaged.x2, c->damaged.y2));
+	     (int)pixman_region32_n_rects(&c->damage),
+	     c->damage.extents.x1, c->damage.extents.y1,
+	     c->damage.extents.x2, c->damage.extents.y2));
+}
+
+/* The target lost its contents, so resend the area whatever its tiles hold */
+static void clone_expose(struct clone *c, const XRectangle *rec)
+{
+	int x1, y1, x2, y2, tx, ty;
+
+	clone_damage(c, rec);
+	if (c->tiles == NULL)
+		return;
+
+	x1 = rec->x - c->src.x;
+	y1 = rec->y - c->src.y;
+	x2 = x1 + rec->width;
+	y2 = y1 + rec->height;
+	if (x1 < 0)
+		x1 = 0;
+	if (y1 < 0)
+		y1 = 0;
+	if (x2 > c->width)
+		x2 = c->width;
+	if (y2 > c->height)
+		y2 = c->height;
+
+	for (ty = y1 >> TILE_SHIFT; ty << TILE_SHIFT < y2; ty++)
+		for (tx = x1 >> TILE_SHIFT; tx << TILE_SHIFT < x2; tx++)
+			c->tiles[ty * c->tile_stride + tx] = 0;
 }
 
 static void usage(const char *arg0)
@@ -2154,8 +2735,9 @@ static void usage(const char *arg0)
 	printf("  -b                   start bumblebee\n");
 	printf("  -a                   connect to all local displays (e.g. :1, :2, etc)\n");
 	printf("  -S                   disable use of a singleton and launch a fresh intel-virtual-output process\n");
+	printf("  -t                   send to each target display from its own thread\n");
 	printf("  -v                   all verbose output, implies -f\n");
-	printf("  -V <category>        specific verbose output, implies -f\n");
+	printf("  -V <category>        specific verbose output, implies -f (0x100 for transfer rates)\n");
 	printf("  -h                   this help\n");
 	printf("If no target displays are parsed on the commandline, \n");
 	printf("intel-virtual-output will attempt to connect to any local display\n");
@@ -2458,14 +3040,17 @@ static int add_display(struct context *ctx, Display *dpy)
 
 	if (is_power_of_2(ctx->ndisplay)) {
 		struct display *new_display;
+		int n;
+
+		/* the workers reach their display through the clones */
+		for (n = 1; n < ctx->ndisplay; n++)
+			display_drain(&ctx->display[n]);
 
 		new_display = realloc(ctx->display, 2*ctx->ndisplay*sizeof(struct display));
 		if (new_display == NULL)
 			return -ENOMEM;
 
 		if (new_display != ctx->display) {
-			int n;
-
 			for (n = 0; n < ctx->nclone; n++) {
 				struct clone *clone = &ctx->clones[n];
 				clone->src.display = new_display + (clone->src.display - ctx->display);
@@ -2621,7 +3206,7 @@ static int display_init_damage(struct display *display)
 		return EINVAL;
 	}
 
-	display->damage = XDamageCreate(display->dpy, display->root, XDamageReportBoundingBox);
+	display->damage = XDamageCreate(display->dpy, display->root, XDamageReportRawRectangles);
 	if (display->damage == 0)
 		return EACCES;
 
@@ -2632,7 +3217,7 @@ static void display_reset_damage(struct display *display)
 {
 	Damage damage;
 
-	damage = XDamageCreate(display->dpy, display->root, XDamageReportBoundingBox);
+	damage = XDamageCreate(display->dpy, display->root, XDamageReportRawRectangles);
 	if (damage) {
 		XDamageDestroy(display->dpy, display->damage);
 		display->damage = damage;
@@ -2679,9 +3264,16 @@ static void rebuild_clones(struct context *ctx, struct clone *new_clones)
 
 static struct clone *add_clone(struct context *ctx)
 {
+	struct clone *clone;
+	int n;
+
 	if (is_power_of_2(ctx->nclone)) {
 		struct clone *new_clones;
 
+		/* the workers hold pointers into the clones they are sending */
+		for (n = 1; n < ctx->ndisplay; n++)
+			display_drain(&ctx->display[n]);
+
 		new_clones = realloc(ctx->clones, 2*ctx->nclone*sizeof(struct clone));
 		if (new_clones == NULL)
 			return NULL;
@@ -2690,7 +3282,12 @@ static struct clone *add_clone(struct context *ctx)
 			rebuild_clones(ctx, new_clones);
 	}
 
-	return memset(&ctx->clones[ctx->nclone++], 0, sizeof(struct clone));
+	clone = memset(&ctx->clones[ctx->nclone++], 0, sizeof(struct clone));
+	pixman_region32_init(&clone->damage);
+	for (n = 0; n < 2; n++)
+		pixman_region32_init(&clone->frame[n].region);
+	clone->nframe = 1;
+	return clone;
 }
 
 static struct display *last_display(struct context *ctx)
@@ -3280,6 +3877,8 @@ static void display_cleanup(struct display *display)
 	XRRScreenResources *res;
 	int n;
 
+	display_stop_worker(display);
+
 	XGrabServer(dpy);
 
 	res = _XRRGetScreenResourcesCurrent(dpy, display->root);
@@ -3398,7 +3997,7 @@ int main(int argc, char **argv)
 
 	signal(SIGPIPE, SIG_IGN);
 
-	while ((i = getopt(argc, argv, "abd:fhSvV:")) != -1) {
+	while ((i = getopt(argc, argv, "abd:fhStvV:")) != -1) {
 		switch (i) {
 		case 'd':
 			src_name = optarg;
@@ -3415,6 +4014,9 @@ int main(int argc, char **argv)
 		case 'S':
 			singleton = 0;
 			break;
+		case 't':
+			threaded = 1;
+			break;
 		case 'v':
 			verbose = ~0;
 			daemonize = 0;
@@ -3430,6 +4032,10 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/* the main loop keeps reading events from the targets being sent to */
+	if (threaded && !XInitThreads())
+		threaded = 0;
+
 	if (verbose)
 		printf("intel-virtual-output: version %d.%d.%d\n",
 		       PACKAGE_VERSION_MAJOR,
@@ -3592,12 +4198,22 @@ int main(int argc, char **argv)
 		}
 		idle = 1;
 
-		/* pfd[0] is the timer, pfd[1] is the local display, pfd[2] is the mouse, pfd[3+] are the remotes */
+		/* pfd[0] is the timer, pfd[1] is the workers, pfd[2] is the local display, pfd[3] is the mouse, pfd[4+] are the remotes */
 
-		if (ctx.pfd[1].revents || XPending(ctx.display[0].dpy)) {
-			DBG(POLL,("%s woken up\n", DisplayString(ctx.display[0].dpy)));
+		if (ctx.pfd[1].revents) {
+			char buf[64];
+
+			DBG(POLL, ("woken up by a worker\n"));
+			while (read(ctx.wakeup, buf, sizeof(buf)) > 0)
+				;
 			ctx.pfd[1].revents = 0;
 			idle = 0;
+		}
+
+		if (ctx.pfd[2].revents || XPending(ctx.display[0].dpy)) {
+			DBG(POLL,("%s woken up\n", DisplayString(ctx.display[0].dpy)));
+			ctx.pfd[2].revents = 0;
+			idle = 0;
 
 			do {
 				XNextEvent(ctx.display->dpy, &e);
@@ -3672,10 +4288,10 @@ int main(int argc, char **argv)
 		}
 
 		for (i = 1; i < ctx.ndisplay; i++) {
-			if (ctx.pfd[i+2].revents == 0 && !XPending(ctx.display[i].dpy))
+			if (ctx.pfd[i+3].revents == 0 && !XPending(ctx.display[i].dpy))
 				continue;
 
-			ctx.pfd[i+2].revents = 0;
+			ctx.pfd[i+3].revents = 0;
 			idle = 0;
 
 			DBG(POLL, ("%s woken up\n", DisplayString(ctx.display[i].dpy)));
@@ -3702,7 +4318,7 @@ int main(int argc, char **argv)
 						r.y = clone->src.y + xe->y;
 						r.width  = xe->width;
 						r.height = xe->height;
-						clone_damage(clone, &r);
+						clone_expose(clone, &r);
 						damaged++;
 					}
 